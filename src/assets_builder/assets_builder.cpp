@@ -3,8 +3,12 @@
 #include "dummy_defs.h"
 #include "dummy_math.h"
 #include "dummy_string.h"
+#include "dummy_memory.h"
+#include "dummy_random.h"
 #include "dummy_animation.h"
 #include "dummy_assets.h"
+#include "dummy_platform.h"
+#include "dummy_skinning.h"
 
 #undef PI
 
@@ -20,15 +24,34 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <chrono>
 
 #undef global
 #undef internal
 #undef persist
 #include <filesystem>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#if _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #define global
 #define internal
 #define persist
 
+#include "dummy_animation.cpp"
+#include "dummy_skinning.cpp"
+#include "dummy_assets.cpp"
+
 // todo: some models have weird bone transformations
 // https://github.com/assimp/assimp/issues/1974
 // probably related:
@@ -54,6 +77,238 @@ using hashtable = std::unordered_map<TKey, TValue>;
 
 namespace fs = std::filesystem;
 
+struct platform_work_queue_entry
+{
+    platform_work_queue_callback *Callback;
+    void *Data;
+};
+
+// Builder version of the platform work queue: persistent std::thread workers started by CreateBuilderPlatformApi
+// wait on a condition variable, the thread that calls CompleteAllWork helps with the work. Workers are joined when the
+// queue goes out of scope
+struct platform_work_queue
+{
+    u32 ThreadCount;
+    dynamic_array<std::thread> Threads;
+
+    std::mutex Mutex;
+    std::condition_variable WorkAdded;
+    std::condition_variable WorkCompleted;
+
+    dynamic_array<platform_work_queue_entry> Entries;
+    u32 NextEntryToRead;
+    u32 CompletionCount;
+    b32 IsShuttingDown;
+
+    ~platform_work_queue()
+    {
+        {
+            std::lock_guard<std::mutex> Lock(Mutex);
+            IsShuttingDown = true;
+        }
+
+        WorkAdded.notify_all();
+
+        for (u32 ThreadIndex = 0; ThreadIndex < Threads.size(); ++ThreadIndex)
+        {
+            Threads[ThreadIndex].join();
+        }
+    }
+};
+
+internal PLATFORM_ADD_WORK_QUEUE_ENTRY(BuilderAddWorkQueueEntry)
+{
+    {
+        std::lock_guard<std::mutex> Lock(Queue->Mutex);
+        Queue->Entries.push_back({ Callback, Data });
+    }
+
+    Queue->WorkAdded.notify_one();
+}
+
+// Returns false if there is nothing to do, Lock is held on entry and on return (but not while the entry runs)
+internal b32
+BuilderDoNextWorkQueueEntry(platform_work_queue *Queue, u32 ThreadIndex, std::unique_lock<std::mutex> &Lock)
+{
+    b32 Result = Queue->NextEntryToRead < Queue->Entries.size();
+
+    if (Result)
+    {
+        platform_work_queue_entry Entry = Queue->Entries[Queue->NextEntryToRead++];
+
+        Lock.unlock();
+        Entry.Callback(Queue, ThreadIndex, Entry.Data);
+        Lock.lock();
+
+        ++Queue->CompletionCount;
+
+        if (Queue->CompletionCount == Queue->Entries.size())
+        {
+            Queue->WorkCompleted.notify_all();
+        }
+    }
+
+    return Result;
+}
+
+internal void
+BuilderWorkerThread(platform_work_queue *Queue, u32 ThreadIndex)
+{
+    std::unique_lock<std::mutex> Lock(Queue->Mutex);
+
+    while (!Queue->IsShuttingDown)
+    {
+        if (!BuilderDoNextWorkQueueEntry(Queue, ThreadIndex, Lock))
+        {
+            Queue->WorkAdded.wait(Lock);
+        }
+    }
+}
+
+internal PLATFORM_COMPLETE_ALL_WORK(BuilderCompleteAllWork)
+{
+    std::unique_lock<std::mutex> Lock(Queue->Mutex);
+
+    while (BuilderDoNextWorkQueueEntry(Queue, 0, Lock))
+    {
+    }
+
+    Queue->WorkCompleted.wait(Lock, [Queue]() { return Queue->CompletionCount == Queue->Entries.size(); });
+
+    Queue->Entries.clear();
+    Queue->NextEntryToRead = 0;
+    Queue->CompletionCount = 0;
+}
+
+internal PLATFORM_READ_FILE(BuilderReadFile)
+{
+    read_file_result Result = {};
+
+    FILE *File = fopen(FileName, "rb");
+
+    if (File)
+    {
+        fseek(File, 0, SEEK_END);
+        u32 FileSize = (u32)ftell(File);
+        fseek(File, 0, SEEK_SET);
+
+        // Save room for the terminating NULL character
+        Result.Contents = PushSize(Arena, Text ? FileSize + 1 : FileSize);
+
+        if (fread(Result.Contents, 1, FileSize, File) == FileSize)
+        {
+            Result.Size = FileSize;
+
+            if (Text)
+            {
+                ((u8 *)Result.Contents)[FileSize] = 0;
+            }
+        }
+        else
+        {
+            Result.Contents = 0;
+        }
+
+        fclose(File);
+    }
+
+    return Result;
+}
+
+internal PLATFORM_MAP_FILE(BuilderMapFile)
+{
+    mapped_file Result = {};
+
+#if _WIN32
+    HANDLE FileHandle = CreateFileA(FileName, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0);
+
+    if (FileHandle != INVALID_HANDLE_VALUE)
+    {
+        LARGE_INTEGER FileSize;
+        HANDLE MappingHandle = GetFileSizeEx(FileHandle, &FileSize) ? CreateFileMappingA(FileHandle, 0, PAGE_READONLY, 0, 0, 0) : 0;
+
+        if (MappingHandle)
+        {
+            Result.Contents = MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0);
+            Result.Size = Result.Contents ? (umm)FileSize.QuadPart : 0;
+
+            CloseHandle(MappingHandle);
+        }
+
+        CloseHandle(FileHandle);
+    }
+#else
+    i32 FileDescriptor = open(FileName, O_RDONLY);
+
+    if (FileDescriptor != -1)
+    {
+        struct stat FileStat;
+
+        if (fstat(FileDescriptor, &FileStat) == 0 && FileStat.st_size > 0)
+        {
+            void *Contents = mmap(0, FileStat.st_size, PROT_READ, MAP_PRIVATE, FileDescriptor, 0);
+
+            if (Contents != MAP_FAILED)
+            {
+                Result.Contents = Contents;
+                Result.Size = (umm)FileStat.st_size;
+            }
+        }
+
+        // Mapping keeps the file open
+        close(FileDescriptor);
+    }
+#endif
+
+    return Result;
+}
+
+internal PLATFORM_UNMAP_FILE(BuilderUnmapFile)
+{
+    if (File->Contents)
+    {
+#if _WIN32
+        UnmapViewOfFile(File->Contents);
+#else
+        munmap(File->Contents, File->Size);
+#endif
+    }
+
+    *File = {};
+}
+
+inline platform_api
+CreateBuilderPlatformApi(platform_work_queue *Queue)
+{
+    platform_api Result = {};
+
+    Result.ReadFile = BuilderReadFile;
+    Result.MapFile = BuilderMapFile;
+    Result.UnmapFile = BuilderUnmapFile;
+
+    if (Queue->Threads.empty())
+    {
+        u32 ThreadCount = std::thread::hardware_concurrency();
+        Queue->ThreadCount = ThreadCount > 0 ? ThreadCount : 1;
+        Queue->NextEntryToRead = 0;
+        Queue->CompletionCount = 0;
+        Queue->IsShuttingDown = false;
+
+        // 0 is reserved for the thread that calls CompleteAllWork
+        for (u32 ThreadIndex = 1; ThreadIndex < Queue->ThreadCount; ++ThreadIndex)
+        {
+            Queue->Threads.push_back(std::thread(BuilderWorkerThread, Queue, ThreadIndex));
+        }
+    }
+
+    Result.WorkQueue = Queue;
+    Result.WorkQueueThreadCount = Queue->ThreadCount;
+    Result.AddWorkQueueEntry = BuilderAddWorkQueueEntry;
+    Result.CompleteAllWork = BuilderCompleteAllWork;
+
+    return Result;
+}
+
 // good material: https://assimp-docs.readthedocs.io/en/latest/usage/use_the_lib.html
 
 struct assimp_node
@@ -312,6 +567,60 @@ FindJointIndexByName(const char *JointName, skeleton *Skeleton)
     return Result;
 }
 
+// Channel keys are sorted by time, Cursor is the last found key (times are sampled in increasing order)
+inline u32
+FindAssimpKeyIndex(f64 *KeyTimes, u32 KeyTimeStride, u32 KeyCount, f64 Time, u32 *Cursor)
+{
+    u32 Result = *Cursor;
+
+    while (Result + 1 < KeyCount && *(f64 *)((u8 *)KeyTimes + (Result + 1) * KeyTimeStride) <= Time)
+    {
+        ++Result;
+    }
+
+    *Cursor = Result;
+
+    return Result;
+}
+
+internal vec3
+SampleAssimpVectorKeys(aiVectorKey *Keys, u32 KeyCount, f64 Time, u32 *Cursor)
+{
+    u32 KeyIndex = FindAssimpKeyIndex(&Keys[0].mTime, sizeof(aiVectorKey), KeyCount, Time, Cursor);
+    aiVectorKey *PrevKey = Keys + KeyIndex;
+
+    vec3 Result = AssimpVector2Vector(PrevKey->mValue);
+
+    if (KeyIndex + 1 < KeyCount && Time > PrevKey->mTime)
+    {
+        aiVectorKey *NextKey = Keys + KeyIndex + 1;
+        f32 t = (f32)((Time - PrevKey->mTime) / (NextKey->mTime - PrevKey->mTime));
+
+        Result = Lerp(Result, t, AssimpVector2Vector(NextKey->mValue));
+    }
+
+    return Result;
+}
+
+internal quat
+SampleAssimpQuatKeys(aiQuatKey *Keys, u32 KeyCount, f64 Time, u32 *Cursor)
+{
+    u32 KeyIndex = FindAssimpKeyIndex(&Keys[0].mTime, sizeof(aiQuatKey), KeyCount, Time, Cursor);
+    aiQuatKey *PrevKey = Keys + KeyIndex;
+
+    quat Result = AssimpQuaternion2Quaternion(PrevKey->mValue);
+
+    if (KeyIndex + 1 < KeyCount && Time > PrevKey->mTime)
+    {
+        aiQuatKey *NextKey = Keys + KeyIndex + 1;
+        f32 t = (f32)((Time - PrevKey->mTime) / (NextKey->mTime - PrevKey->mTime));
+
+        Result = Slerp(Result, t, AssimpQuaternion2Quaternion(NextKey->mValue));
+    }
+
+    return Result;
+}
+
 internal void
 ProcessAssimpAnimation(aiAnimation *AssimpAnimation, animation_clip *Animation, skeleton *Skeleton)
 {
@@ -319,6 +628,9 @@ ProcessAssimpAnimation(aiAnimation *AssimpAnimation, animation_clip *Animation,
 
     CopyString(AssimpAnimation->mName.C_Str(), Animation->Name, (u32)(AssimpAnimation->mName.length + 1));
     Animation->Duration = (f32)AssimpAnimation->mDuration / (f32)AssimpAnimation->mTicksPerSecond;
+    Animation->Format = AnimationClipFormat_KeyFrames;
+    Animation->TimelineCount = 0;
+    Animation->Timelines = 0;
     Animation->PoseSampleCount = AssimpAnimation->mNumChannels;
     Animation->PoseSamples = (animation_sample *)malloc(Animation->PoseSampleCount * sizeof(animation_sample));
 
@@ -327,28 +639,60 @@ ProcessAssimpAnimation(aiAnimation *AssimpAnimation, animation_clip *Animation,
         // Channel desribes the movement of a single joint over time
         aiNodeAnim *Channel = AssimpAnimation->mChannels[ChannelIndex];
 
-        Assert((Channel->mNumPositionKeys == Channel->mNumRotationKeys) && (Channel->mNumPositionKeys == Channel->mNumScalingKeys));
+        Assert(Channel->mNumPositionKeys > 0 && Channel->mNumRotationKeys > 0 && Channel->mNumScalingKeys > 0);
+
+        // Position, rotation and scale keys don't have to be aligned, 
+        // key frames are created at every key time of any channel and the other channels are interpolated
+        dynamic_array<f64> KeyTimes;
+        KeyTimes.reserve(Channel->mNumPositionKeys + Channel->mNumRotationKeys + Channel->mNumScalingKeys);
+
+        for (u32 KeyIndex = 0; KeyIndex < Channel->mNumPositionKeys; ++KeyIndex)
+        {
+            KeyTimes.push_back(Channel->mPositionKeys[KeyIndex].mTime);
+        }
+
+        for (u32 KeyIndex = 0; KeyIndex < Channel->mNumRotationKeys; ++KeyIndex)
+        {
+            KeyTimes.push_back(Channel->mRotationKeys[KeyIndex].mTime);
+        }
+
+        for (u32 KeyIndex = 0; KeyIndex < Channel->mNumScalingKeys; ++KeyIndex)
+        {
+            KeyTimes.push_back(Channel->mScalingKeys[KeyIndex].mTime);
+        }
+
+        std::sort(KeyTimes.begin(), KeyTimes.end());
+        KeyTimes.erase(std::unique(KeyTimes.begin(), KeyTimes.end()), KeyTimes.end());
 
         animation_sample *AnimationSample = Animation->PoseSamples + ChannelIndex;
         AnimationSample->JointIndex = FindJointIndexByName(Channel->mNodeName.C_Str(), Skeleton);
-        AnimationSample->KeyFrameCount = Channel->mNumPositionKeys;
+        AnimationSample->KeyFrameCount = (u32)KeyTimes.size();
         AnimationSample->KeyFrames = (key_frame *)malloc(AnimationSample->KeyFrameCount * sizeof(key_frame));
 
-        for (u32 KeyIndex = 0; KeyIndex < Channel->mNumPositionKeys; ++KeyIndex)
-        {
-            aiVectorKey *PositionKey = Channel->mPositionKeys + KeyIndex;
-            aiQuatKey *RotationKey = Channel->mRotationKeys + KeyIndex;
-            aiVectorKey *ScalingKey = Channel->mScalingKeys + KeyIndex;
+        u32 PositionCursor = 0;
+        u32 RotationCursor = 0;
+        u32 ScalingCursor = 0;
 
-            Assert((PositionKey->mTime == RotationKey->mTime) && (PositionKey->mTime == ScalingKey->mTime));
+        for (u32 KeyIndex = 0; KeyIndex < AnimationSample->KeyFrameCount; ++KeyIndex)
+        {
+            f64 Time = KeyTimes[KeyIndex];
 
             key_frame *KeyFrame = AnimationSample->KeyFrames + KeyIndex;
-            KeyFrame->Time = (f32)PositionKey->mTime / (f32)AssimpAnimation->mTicksPerSecond;
-            KeyFrame->Pose.Rotation = AssimpQuaternion2Quaternion(RotationKey->mValue);
-            KeyFrame->Pose.Translation = AssimpVector2Vector(PositionKey->mValue);
-            KeyFrame->Pose.Scale = AssimpVector2Vector(ScalingKey->mValue);
+            KeyFrame->Time = (f32)(Time / AssimpAnimation->mTicksPerSecond);
+            KeyFrame->Pose.Rotation = SampleAssimpQuatKeys(Channel->mRotationKeys, Channel->mNumRotationKeys, Time, &RotationCursor);
+            KeyFrame->Pose.Translation = SampleAssimpVectorKeys(Channel->mPositionKeys, Channel->mNumPositionKeys, Time, &PositionCursor);
+            KeyFrame->Pose.Scale = SampleAssimpVectorKeys(Channel->mScalingKeys, Channel->mNumScalingKeys, Time, &ScalingCursor);
         }
     }
+
+    // Runtime sampler walks joints and pose samples together
+    std::sort(
+        Animation->PoseSamples,
+        Animation->PoseSamples + Animation->PoseSampleCount,
+        [](const animation_sample &A, const animation_sample &B) -> b32
+    {
+        return A.JointIndex < B.JointIndex;
+    });
 }
 
 internal void
@@ -611,29 +955,6 @@ ProcessAssimpBoneHierarchy(
     CurrentIndexParent = Joint->ParentIndex;
 }
 
-// todo: duplicate
-internal mat4
-CalculateGlobalJointPose(joint *CurrentJoint, joint_pose *CurrentJointPose, skeleton_pose *Pose)
-{
-    mat4 Result = mat4(1.f);
-
-    while (true)
-    {
-        mat4 GlobalPose = Transform(*CurrentJointPose);
-        Result = GlobalPose * Result;
-
-        if (CurrentJoint->ParentIndex == -1)
-        {
-            break;
-        }
-
-        CurrentJointPose = Pose->LocalJointPoses + CurrentJoint->ParentIndex;
-        CurrentJoint = Pose->Skeleton->Joints + CurrentJoint->ParentIndex;
-    }
-    
-    return Result;
-}
-
 // todo: duplicate
 inline u32
 GetMeshVerticesSize(mesh *Mesh)
@@ -713,17 +1034,31 @@ ProcessAssimpSkeleton(const aiScene *AssimpScene, skeleton *Skeleton, skeleton_p
 
         i32 CurrentIndexForward = 0;
         i32 CurrentIndexParent = -1;
+        // Preorder traversal: every joint is written after its parent
         ProcessAssimpBoneHierarchy(RootNode, SceneNodes, Pose, CurrentIndexForward, CurrentIndexParent);
 
-        for (u32 JointIndex = 0; JointIndex < JointCount; ++JointIndex)
-        {
-            joint *Joint = Skeleton->Joints + JointIndex;
-            joint_pose *LocalJointPose = Pose->LocalJointPoses + JointIndex;
-            mat4 *GlobalJointPose = Pose->GlobalJointPoses + JointIndex;
+        CalculateGlobalJointPoses(Pose);
+    }
+}
+
+// Runtime computes global poses in a single forward pass (CalculateGlobalJointPoses)
+internal b32
+IsSkeletonParentBeforeChild(skeleton *Skeleton)
+{
+    b32 Result = true;
+
+    for (u32 JointIndex = 0; JointIndex < Skeleton->JointCount; ++JointIndex)
+    {
+        i32 ParentIndex = Skeleton->Joints[JointIndex].ParentIndex;
 
-            *GlobalJointPose = CalculateGlobalJointPose(Joint, LocalJointPose, Pose);
+        if (ParentIndex < -1 || ParentIndex >= (i32)JointIndex)
+        {
+            Result = false;
+            break;
         }
     }
+
+    return Result;
 }
 
 internal void
@@ -794,596 +1129,3558 @@ LoadModelAsset(const char *FilePath, model_asset *Asset, u32 Flags)
     }
 }
 
+// Moves the ground plane motion of the root translation joint into the root motion track, the joint is left above the origin. 
+// Local space of the root translation joint is the entity space (skeleton root pose is replaced by the entity transform), 
+// the overall turn of the clip is spread evenly over time and is removed from the joint rotation as well
 internal void
-LoadAnimationClipAsset(const char *FilePath, u32 Flags, model_asset *Asset, const char *AnimationName, b32 IsLooping, b32 InPlace, u32 AnimationIndex)
+ExtractRootMotion(animation_clip *Animation, skeleton *Skeleton)
 {
-    const aiScene *AssimpScene = aiImportFile(FilePath, Flags);
-
-    Assert(AssimpScene);
-    Assert(AssimpScene->mNumAnimations == 1);
+    Assert(Animation->Format == AnimationClipFormat_KeyFrames);
+    Assert(Skeleton->Joints[ROOT_TRANSLATION_JOINT_INDEX].ParentIndex == 0);
 
-    aiAnimation *AssimpAnimation = AssimpScene->mAnimations[0];
-    animation_clip *Animation = Asset->Animations + AnimationIndex;
+    animation_sample *RootSample = 0;
 
-    ProcessAssimpAnimation(AssimpAnimation, Animation, &Asset->Skeleton);
+    for (u32 PoseSampleIndex = 0; PoseSampleIndex < Animation->PoseSampleCount; ++PoseSampleIndex)
+    {
+        if (Animation->PoseSamples[PoseSampleIndex].JointIndex == ROOT_TRANSLATION_JOINT_INDEX)
+        {
+            RootSample = Animation->PoseSamples + PoseSampleIndex;
+            break;
+        }
+    }
 
-    CopyString(AnimationName, Animation->Name, MAX_ANIMATION_NAME_LENGTH);
-    Animation->IsLooping = IsLooping;
-    Animation->InPlace = InPlace;
+    Assert(RootSample && RootSample->KeyFrameCount > 0);
 
-    aiReleaseImport(AssimpScene);
-}
+    key_frame *FirstKeyFrame = RootSample->KeyFrames;
+    key_frame *LastKeyFrame = RootSample->KeyFrames + RootSample->KeyFrameCount - 1;
 
-// For testing
-internal void
-ReadAssetFile(const char *FilePath, model_asset *Asset, model_asset *OriginalAsset)
-{
-    FILE *AssetFile = fopen(FilePath, "rb");
-    
-    fseek(AssetFile, 0, SEEK_END);
-    u32 FileSize = ftell(AssetFile);
-    fseek(AssetFile, 0, SEEK_SET);
+    quat Turn = Normalize(LastKeyFrame->Pose.Rotation) * Conjugate(Normalize(FirstKeyFrame->Pose.Rotation));
+    vec3 TurnForward = Rotate(vec3(0.f, 0.f, 1.f), Turn);
+    f32 TotalYaw = Atan2(TurnForward.x, TurnForward.z);
+    f32 TotalTime = LastKeyFrame->Time - FirstKeyFrame->Time;
 
-    void *Buffer = malloc(FileSize);
+    vec3 StartTranslation = FirstKeyFrame->Pose.Translation;
 
-    fread(Buffer, FileSize, 1, AssetFile);
+    root_motion_track *Track = &Animation->RootMotion;
+    Track->KeyFrameCount = RootSample->KeyFrameCount;
+    Track->KeyFrames = (root_motion_key *)malloc(Track->KeyFrameCount * sizeof(root_motion_key));
 
-    model_asset_header *Header = (model_asset_header *)Buffer;
+    for (u32 KeyFrameIndex = 0; KeyFrameIndex < RootSample->KeyFrameCount; ++KeyFrameIndex)
+    {
+        key_frame *KeyFrame = RootSample->KeyFrames + KeyFrameIndex;
+        root_motion_key *RootMotionKeyFrame = Track->KeyFrames + KeyFrameIndex;
 
-    model_asset_skeleton_header *SkeletonHeader = (model_asset_skeleton_header *)((u8 *)Buffer + Header->SkeletonHeaderOffset);
-    skeleton Skeleton = {};
-    Skeleton.JointCount = SkeletonHeader->JointCount;
-    Skeleton.Joints = (joint *)((u8*)Buffer + SkeletonHeader->JointsOffset);
+        f32 Yaw = TotalTime > 0.f ? TotalYaw * (KeyFrame->Time - FirstKeyFrame->Time) / TotalTime : 0.f;
 
-    model_asset_skeleton_pose_header *SkeletonPoseHeader = (model_asset_skeleton_pose_header *)((u8 *)Buffer + Header->SkeletonPoseHeaderOffset);
-    skeleton_pose BindPose = {};
-    BindPose.LocalJointPoses = (joint_pose *)((u8*)Buffer + SkeletonPoseHeader->LocalJointPosesOffset);
-    BindPose.GlobalJointPoses = (mat4 *)((u8*)Buffer + SkeletonPoseHeader->GlobalJointPosesOffset);
+        RootMotionKeyFrame->Time = KeyFrame->Time;
+        RootMotionKeyFrame->Translation = vec3(KeyFrame->Pose.Translation.x - StartTranslation.x, 0.f, KeyFrame->Pose.Translation.z - StartTranslation.z);
+        RootMotionKeyFrame->Yaw = Yaw;
 
-    model_asset_meshes_header *MeshesHeader = (model_asset_meshes_header *)((u8 *)Buffer + Header->MeshesHeaderOffset);
+        KeyFrame->Pose.Translation = vec3(0.f, KeyFrame->Pose.Translation.y, 0.f);
+        KeyFrame->Pose.Rotation = AxisAngle2Quat(vec4(0.f, 1.f, 0.f, -Yaw)) * KeyFrame->Pose.Rotation;
+    }
+}
 
-    u32 NextMeshHeaderOffset = 0;
+// Position error (relative to the skeleton size) allowed at the end of the deepest joint chain
+#define KEY_REDUCTION_RELATIVE_TOLERANCE 0.001f
 
-    for (u32 MeshIndex = 0; MeshIndex < MeshesHeader->MeshCount; ++MeshIndex)
-    {
-        model_asset_mesh_header *MeshHeader = (model_asset_mesh_header *)((u8 *)Buffer + 
-            MeshesHeader->MeshesOffset + NextMeshHeaderOffset);
-        mesh Mesh = {};
+struct key_frame_channel_tolerance
+{
+    f32 Rotation;
+    f32 Translation;
+    f32 Scale;
+};
 
-        Mesh.MaterialIndex = MeshHeader->MaterialIndex;
-        Mesh.VertexCount = MeshHeader->VertexCount;
-        Mesh.IndexCount = MeshHeader->IndexCount;
+enum key_frame_channel
+{
+    KeyFrameChannel_Rotation,
+    KeyFrameChannel_Translation,
+    KeyFrameChannel_Scale,
 
-        u32 VerticesOffset = 0;
+    KeyFrameChannel_Count
+};
 
-        if (MeshHeader->HasPositions)
-        {
-            Mesh.Positions = (vec3 *)((u8 *)Buffer + MeshHeader->VerticesOffset + VerticesOffset);
+// Length of the longest chain of bones below each joint
+internal void
+CalculateJointChainLengths(skeleton *Skeleton, f32 *BoneLengths, f32 *ChainLengths)
+{
+    for (u32 JointIndex = 0; JointIndex < Skeleton->JointCount; ++JointIndex)
+    {
+        ChainLengths[JointIndex] = 0.f;
+    }
+
+    // Parents always come before children
+    for (i32 JointIndex = Skeleton->JointCount - 1; JointIndex >= 0; --JointIndex)
+    {
+        joint *Joint = Skeleton->Joints + JointIndex;
+
+        if (Joint->ParentIndex >= 0)
+        {
+            ChainLengths[Joint->ParentIndex] = Max(ChainLengths[Joint->ParentIndex], ChainLengths[JointIndex] + BoneLengths[JointIndex]);
+        }
+    }
+}
+
+inline f32
+GetRotationAngle(quat A, quat B)
+{
+    f32 d = Abs(Dot(Normalize(A), Normalize(B)));
+    f32 Result = 2.f * Acos(Min(d, 1.f));
+
+    return Result;
+}
+
+inline b32
+IsKeyFrameChannelReconstructed(key_frame *KeyFrames, u32 FromIndex, u32 ToIndex, key_frame_channel Channel, key_frame_channel_tolerance Tolerance)
+{
+    key_frame *From = KeyFrames + FromIndex;
+    key_frame *To = KeyFrames + ToIndex;
+
+    for (u32 KeyFrameIndex = FromIndex + 1; KeyFrameIndex < ToIndex; ++KeyFrameIndex)
+    {
+        key_frame *KeyFrame = KeyFrames + KeyFrameIndex;
+
+        f32 t = (KeyFrame->Time - From->Time) / (To->Time - From->Time);
+        joint_pose Pose = Lerp(&From->Pose, t, &To->Pose);
+
+        switch (Channel)
+        {
+            case KeyFrameChannel_Rotation:
+            {
+                if (GetRotationAngle(Pose.Rotation, KeyFrame->Pose.Rotation) > Tolerance.Rotation)
+                {
+                    return false;
+                }
+
+                break;
+            }
+            case KeyFrameChannel_Translation:
+            {
+                if (Magnitude(Pose.Translation - KeyFrame->Pose.Translation) > Tolerance.Translation)
+                {
+                    return false;
+                }
+
+                break;
+            }
+            case KeyFrameChannel_Scale:
+            {
+                if (Magnitude(Pose.Scale - KeyFrame->Pose.Scale) > Tolerance.Scale)
+                {
+                    return false;
+                }
+
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Removes key frames that are reconstructed by interpolating their neighbours within tolerance. 
+// Each channel is reduced separately and a key frame is kept if any of the channels needs it, then the merged key set is checked against every channel. 
+// Errors of all joints along a chain add up, so the error budget is split between the joints of the deepest chain. 
+// Rotation and scale errors of a joint are amplified by the length of the chain below it, so their tolerances are divided by that length
+internal void
+ReduceAnimationClipKeyFrames(animation_clip *Animation, skeleton *Skeleton, skeleton_pose *BindPose)
+{
+    Assert(Animation->Format == AnimationClipFormat_KeyFrames);
+
+    // Bones can be stretched by the clip, the longest one is used
+    dynamic_array<f32> BoneLengths(Skeleton->JointCount);
+
+    for (u32 JointIndex = 0; JointIndex < Skeleton->JointCount; ++JointIndex)
+    {
+        BoneLengths[JointIndex] = Magnitude(BindPose->LocalJointPoses[JointIndex].Translation);
+    }
+
+    for (u32 PoseSampleIndex = 0; PoseSampleIndex < Animation->PoseSampleCount; ++PoseSampleIndex)
+    {
+        animation_sample *PoseSample = Animation->PoseSamples + PoseSampleIndex;
+
+        for (u32 KeyFrameIndex = 0; KeyFrameIndex < PoseSample->KeyFrameCount; ++KeyFrameIndex)
+        {
+            f32 BoneLength = Magnitude(PoseSample->KeyFrames[KeyFrameIndex].Pose.Translation);
+            BoneLengths[PoseSample->JointIndex] = Max(BoneLengths[PoseSample->JointIndex], BoneLength);
+        }
+    }
+
+    dynamic_array<f32> ChainLengths(Skeleton->JointCount);
+    CalculateJointChainLengths(Skeleton, BoneLengths.data(), ChainLengths.data());
+
+    f32 SkeletonSize = 0.f;
+
+    for (u32 JointIndex = 0; JointIndex < Skeleton->JointCount; ++JointIndex)
+    {
+        SkeletonSize = Max(SkeletonSize, ChainLengths[JointIndex]);
+    }
+
+    u32 SkeletonDepth = 1;
+    dynamic_array<u32> JointDepths(Skeleton->JointCount);
+
+    for (u32 JointIndex = 0; JointIndex < Skeleton->JointCount; ++JointIndex)
+    {
+        joint *Joint = Skeleton->Joints + JointIndex;
+
+        JointDepths[JointIndex] = Joint->ParentIndex >= 0 ? JointDepths[Joint->ParentIndex] + 1 : 1;
+
+        if (JointDepths[JointIndex] > SkeletonDepth)
+        {
+            SkeletonDepth = JointDepths[JointIndex];
+        }
+    }
+
+    f32 PositionTolerance = Max(SkeletonSize, 1.f) * KEY_REDUCTION_RELATIVE_TOLERANCE / (f32)SkeletonDepth;
+
+    u32 TotalKeyFrameCount = 0;
+    u32 ReducedKeyFrameCount = 0;
+
+    for (u32 PoseSampleIndex = 0; PoseSampleIndex < Animation->PoseSampleCount; ++PoseSampleIndex)
+    {
+        animation_sample *PoseSample = Animation->PoseSamples + PoseSampleIndex;
+
+        TotalKeyFrameCount += PoseSample->KeyFrameCount;
+
+        if (PoseSample->KeyFrameCount <= 2)
+        {
+            ReducedKeyFrameCount += PoseSample->KeyFrameCount;
+            continue;
+        }
+
+        f32 EffectiveLength = Max(Max(ChainLengths[PoseSample->JointIndex], BoneLengths[PoseSample->JointIndex]), PositionTolerance);
+
+        key_frame_channel_tolerance Tolerance;
+        Tolerance.Rotation = PositionTolerance / EffectiveLength;
+        Tolerance.Translation = PositionTolerance;
+        Tolerance.Scale = PositionTolerance / EffectiveLength;
+
+        dynamic_array<b32> KeepKeyFrames(PoseSample->KeyFrameCount, false);
+        KeepKeyFrames[0] = true;
+        KeepKeyFrames[PoseSample->KeyFrameCount - 1] = true;
+
+        for (u32 Channel = 0; Channel < KeyFrameChannel_Count; ++Channel)
+        {
+            u32 FromIndex = 0;
+
+            while (FromIndex < PoseSample->KeyFrameCount - 1)
+            {
+                u32 ToIndex = FromIndex + 1;
+
+                // Extending the segment while skipped key frames are reconstructed
+                while (ToIndex + 1 < PoseSample->KeyFrameCount && 
+                    IsKeyFrameChannelReconstructed(PoseSample->KeyFrames, FromIndex, ToIndex + 1, (key_frame_channel)Channel, Tolerance))
+                {
+                    ++ToIndex;
+                }
+
+                KeepKeyFrames[ToIndex] = true;
+                FromIndex = ToIndex;
+            }
+        }
+
+        // Key frames kept for another channel can split a segment so that interpolating to them exceeds the tolerance of this channel, 
+        // segments of the merged key set are checked again and split until every channel is reconstructed
+        b32 IsSplit = true;
+
+        while (IsSplit)
+        {
+            IsSplit = false;
+
+            u32 FromIndex = 0;
+
+            for (u32 ToIndex = 1; ToIndex < PoseSample->KeyFrameCount; ++ToIndex)
+            {
+                if (KeepKeyFrames[ToIndex])
+                {
+                    for (u32 Channel = 0; Channel < KeyFrameChannel_Count; ++Channel)
+                    {
+                        if (!IsKeyFrameChannelReconstructed(PoseSample->KeyFrames, FromIndex, ToIndex, (key_frame_channel)Channel, Tolerance))
+                        {
+                            KeepKeyFrames[(FromIndex + ToIndex) / 2] = true;
+                            IsSplit = true;
+                            break;
+                        }
+                    }
+
+                    FromIndex = ToIndex;
+                }
+            }
+        }
+
+        u32 KeyFrameCount = 0;
+
+        for (u32 KeyFrameIndex = 0; KeyFrameIndex < PoseSample->KeyFrameCount; ++KeyFrameIndex)
+        {
+            if (KeepKeyFrames[KeyFrameIndex])
+            {
+                PoseSample->KeyFrames[KeyFrameCount++] = PoseSample->KeyFrames[KeyFrameIndex];
+            }
+        }
+
+        PoseSample->KeyFrameCount = KeyFrameCount;
+        ReducedKeyFrameCount += KeyFrameCount;
+    }
+
+    printf("%s: %d -> %d key frames (position tolerance %.4f)\n", Animation->Name, TotalKeyFrameCount, ReducedKeyFrameCount, PositionTolerance);
+}
+
+// Reference pose is the first key frame of each track, so the additive clip starts with no change to the pose it's applied to
+internal void
+MakeAdditiveAnimationClip(animation_clip *Animation)
+{
+    Assert(Animation->Format == AnimationClipFormat_KeyFrames);
+
+    for (u32 PoseSampleIndex = 0; PoseSampleIndex < Animation->PoseSampleCount; ++PoseSampleIndex)
+    {
+        animation_sample *PoseSample = Animation->PoseSamples + PoseSampleIndex;
+
+        Assert(PoseSample->KeyFrameCount > 0);
+
+        joint_pose ReferencePose = PoseSample->KeyFrames[0].Pose;
+        quat InvReferenceRotation = Conjugate(Normalize(ReferencePose.Rotation));
+
+        for (u32 KeyFrameIndex = 0; KeyFrameIndex < PoseSample->KeyFrameCount; ++KeyFrameIndex)
+        {
+            joint_pose *Pose = &PoseSample->KeyFrames[KeyFrameIndex].Pose;
+
+            quat DeltaRotation = Normalize(InvReferenceRotation * Pose->Rotation);
+
+            // Keeping deltas close to identity, so that weighting towards identity takes the short path
+            if (DeltaRotation.w < 0.f)
+            {
+                DeltaRotation = -DeltaRotation;
+            }
+
+            Pose->Rotation = DeltaRotation;
+            Pose->Translation = Pose->Translation - ReferencePose.Translation;
+            Pose->Scale = vec3(
+                Pose->Scale.x / ReferencePose.Scale.x,
+                Pose->Scale.y / ReferencePose.Scale.y,
+                Pose->Scale.z / ReferencePose.Scale.z
+            );
+        }
+    }
+
+    Animation->IsAdditive = true;
+}
+
+internal void
+LoadAnimationClipAsset(const char *FilePath, u32 Flags, model_asset *Asset, const char *AnimationName, b32 IsLooping, b32 InPlace, u32 AnimationIndex, b32 IsAdditive = false)
+{
+    const aiScene *AssimpScene = aiImportFile(FilePath, Flags);
+
+    Assert(AssimpScene);
+    Assert(AssimpScene->mNumAnimations == 1);
+
+    aiAnimation *AssimpAnimation = AssimpScene->mAnimations[0];
+    animation_clip *Animation = Asset->Animations + AnimationIndex;
+
+    ProcessAssimpAnimation(AssimpAnimation, Animation, &Asset->Skeleton);
+
+    CopyString(AnimationName, Animation->Name, MAX_ANIMATION_NAME_LENGTH);
+    Animation->IsLooping = IsLooping;
+    Animation->InPlace = InPlace;
+    Animation->IsAdditive = false;
+    Animation->RootMotion = {};
+
+    if (InPlace)
+    {
+        ExtractRootMotion(Animation, &Asset->Skeleton);
+    }
+
+    ReduceAnimationClipKeyFrames(Animation, &Asset->Skeleton, &Asset->BindPose);
+
+    if (IsAdditive)
+    {
+        Assert(!InPlace);
+        MakeAdditiveAnimationClip(Animation);
+    }
+
+    aiReleaseImport(AssimpScene);
+}
+
+#define MOTION_DATABASE_SAMPLE_RATE 30.f
+
+struct motion_feature_group
+{
+    u32 FirstFeature;
+    u32 FeatureCount;
+    f32 Weight;
+};
+
+// Features of a group are normalized together, so that noisy dimensions (e.g. sideways trajectory) aren't amplified
+global motion_feature_group MotionFeatureGroups[] = 
+{
+    { MotionFeature_LeftFootPosition, 3, 0.75f },
+    { MotionFeature_RightFootPosition, 3, 0.75f },
+    { MotionFeature_LeftFootVelocity, 3, 1.f },
+    { MotionFeature_RightFootVelocity, 3, 1.f },
+    { MotionFeature_HipVelocity, 3, 1.f },
+    { MotionFeature_TrajectoryPositions, 2 * MOTION_TRAJECTORY_POINT_COUNT, 2.f },
+    { MotionFeature_TrajectoryDirections, 2 * MOTION_TRAJECTORY_POINT_COUNT, 1.5f }
+};
+
+inline f32
+WrapMotionClipTime(animation_clip *Clip, f32 Time)
+{
+    f32 Result = Time;
+
+    if (Result > Clip->Duration)
+    {
+        Result = Clip->IsLooping ? Result - Clip->Duration : Clip->Duration;
+    }
+
+    return Result;
+}
+
+// Root motion over Delta (which can be longer than the clip), relative to the entity at Time
+internal root_motion
+GetMotionFeatureRootMotion(animation_clip *Clip, f32 Time, f32 Delta)
+{
+    root_motion Result = {};
+    Result.Duration = Delta;
+
+    if (Clip->RootMotion.KeyFrameCount > 0)
+    {
+        f32 Step = 1.f / MOTION_DATABASE_SAMPLE_RATE;
+
+        while (Delta > 0.f)
+        {
+            f32 StepDelta = Min(Step, Delta);
+            f32 NextTime = WrapMotionClipTime(Clip, Time + StepDelta);
+
+            root_motion StepMotion = GetAnimationClipRootMotion(Clip, Time, NextTime);
+
+            Result.Translation += RotateYaw(StepMotion.Translation, Result.Yaw);
+            Result.Yaw += StepMotion.Yaw;
+
+            Time = NextTime;
+            Delta -= StepDelta;
+        }
+    }
+
+    return Result;
+}
+
+// Entity space positions of the joints at the clip time
+internal void
+SampleMotionJointPositions(skeleton_pose *Pose, skeleton_pose *BindPose, animation_state *State, f32 Time, u32 *JointIndices, u32 JointCount, vec3 *Positions)
+{
+    for (u32 JointIndex = 0; JointIndex < Pose->Skeleton->JointCount; ++JointIndex)
+    {
+        Pose->LocalJointPoses[JointIndex] = BindPose->LocalJointPoses[JointIndex];
+    }
+
+    State->Time = Time;
+    AnimateSkeletonPose(Pose, State);
+    UpdateGlobalJointPoses(Pose, CreateTransform(vec3(0.f), vec3(1.f), quat(0.f, 0.f, 0.f, 1.f)));
+
+    for (u32 Index = 0; Index < JointCount; ++Index)
+    {
+        Positions[Index] = GetTranslation(Pose->GlobalJointPoses[JointIndices[Index]]);
+    }
+}
+
+internal void
+CalculateMotionFeatures(skeleton_pose *Pose, skeleton_pose *BindPose, animation_state *State, motion_database *Database, u32 *JointIndices, f32 Time, f32 *Features)
+{
+    animation_clip *Clip = State->Clip;
+    f32 VelocityStep = 1.f / Database->SampleRate;
+
+    // Left foot, right foot, hips
+    vec3 Positions[3];
+    vec3 NextPositions[3];
+
+    SampleMotionJointPositions(Pose, BindPose, State, Time, JointIndices, ArrayCount(Positions), Positions);
+    SampleMotionJointPositions(Pose, BindPose, State, WrapMotionClipTime(Clip, Time + VelocityStep), JointIndices, ArrayCount(NextPositions), NextPositions);
+
+    // Joints move along with the entity
+    root_motion StepMotion = GetMotionFeatureRootMotion(Clip, Time, VelocityStep);
+
+    vec3 Velocities[3];
+    for (u32 Index = 0; Index < ArrayCount(Velocities); ++Index)
+    {
+        Velocities[Index] = (StepMotion.Translation + RotateYaw(NextPositions[Index], StepMotion.Yaw) - Positions[Index]) / VelocityStep;
+    }
+
+    for (u32 Axis = 0; Axis < 3; ++Axis)
+    {
+        Features[MotionFeature_LeftFootPosition + Axis] = Positions[0].Elements[Axis];
+        Features[MotionFeature_RightFootPosition + Axis] = Positions[1].Elements[Axis];
+        Features[MotionFeature_LeftFootVelocity + Axis] = Velocities[0].Elements[Axis];
+        Features[MotionFeature_RightFootVelocity + Axis] = Velocities[1].Elements[Axis];
+        Features[MotionFeature_HipVelocity + Axis] = Velocities[2].Elements[Axis];
+    }
+
+    for (u32 PointIndex = 0; PointIndex < MOTION_TRAJECTORY_POINT_COUNT; ++PointIndex)
+    {
+        root_motion Trajectory = GetMotionFeatureRootMotion(Clip, Time, Database->TrajectoryTimes[PointIndex]);
+
+        Features[MotionFeature_TrajectoryPositions + PointIndex * 2 + 0] = Trajectory.Translation.x;
+        Features[MotionFeature_TrajectoryPositions + PointIndex * 2 + 1] = Trajectory.Translation.z;
+        Features[MotionFeature_TrajectoryDirections + PointIndex * 2 + 0] = Sin(Trajectory.Yaw);
+        Features[MotionFeature_TrajectoryDirections + PointIndex * 2 + 1] = Cos(Trajectory.Yaw);
+    }
+
+    for (u32 FeatureIndex = MotionFeature_Count; FeatureIndex < MOTION_FEATURE_STRIDE; ++FeatureIndex)
+    {
+        Features[FeatureIndex] = 0.f;
+    }
+}
+
+// Splits by the feature with the largest variance at the median, children of a node are stored next to each other
+internal void
+BuildMotionKdNode(dynamic_array<motion_kd_node> &Nodes, u32 NodeIndex, f32 *Features, u32 *FrameOrder, u32 FirstFrameIndex, u32 FrameCount)
+{
+    motion_kd_node Node = {};
+    Node.FirstFrameIndex = FirstFrameIndex;
+
+    if (FrameCount <= MOTION_KD_TREE_LEAF_SIZE)
+    {
+        Node.FrameCount = FrameCount;
+        Nodes[NodeIndex] = Node;
+
+        return;
+    }
+
+    f32 MaxVariance = -1.f;
+
+    for (u32 FeatureIndex = 0; FeatureIndex < MotionFeature_Count; ++FeatureIndex)
+    {
+        f64 Sum = 0.0;
+        f64 SquaredSum = 0.0;
+
+        for (u32 FrameIndex = FirstFrameIndex; FrameIndex < FirstFrameIndex + FrameCount; ++FrameIndex)
+        {
+            f64 Value = Features[FrameOrder[FrameIndex] * MOTION_FEATURE_STRIDE + FeatureIndex];
+            Sum += Value;
+            SquaredSum += Value * Value;
+        }
+
+        f32 Variance = (f32)(SquaredSum / FrameCount - Square((f32)(Sum / FrameCount)));
+
+        if (Variance > MaxVariance)
+        {
+            MaxVariance = Variance;
+            Node.SplitFeature = FeatureIndex;
+        }
+    }
+
+    u32 Median = FrameCount / 2;
+    u32 SplitFeature = Node.SplitFeature;
+
+    std::nth_element(
+        FrameOrder + FirstFrameIndex, FrameOrder + FirstFrameIndex + Median, FrameOrder + FirstFrameIndex + FrameCount,
+        [Features, SplitFeature](u32 A, u32 B) -> bool
+        {
+            return Features[A * MOTION_FEATURE_STRIDE + SplitFeature] < Features[B * MOTION_FEATURE_STRIDE + SplitFeature];
+        }
+    );
+
+    Node.SplitValue = Features[FrameOrder[FirstFrameIndex + Median] * MOTION_FEATURE_STRIDE + SplitFeature];
+    Node.ChildIndex = (u32)Nodes.size();
+
+    Nodes.push_back({});
+    Nodes.push_back({});
+    Nodes[NodeIndex] = Node;
+
+    BuildMotionKdNode(Nodes, Node.ChildIndex, Features, FrameOrder, FirstFrameIndex, Median);
+    BuildMotionKdNode(Nodes, Node.ChildIndex + 1, Features, FrameOrder, FirstFrameIndex + Median, FrameCount - Median);
+}
+
+// Reorders frames into KD-tree leaf order, frames are expected to be in clip order
+internal void
+BuildMotionKdTree(motion_database *Database)
+{
+    u32 FrameCount = Database->FrameCount;
+
+    dynamic_array<u32> FrameOrder(FrameCount);
+    for (u32 FrameIndex = 0; FrameIndex < FrameCount; ++FrameIndex)
+    {
+        FrameOrder[FrameIndex] = FrameIndex;
+    }
+
+    dynamic_array<motion_kd_node> Nodes(1);
+    BuildMotionKdNode(Nodes, 0, Database->Features, FrameOrder.data(), 0, FrameCount);
+
+    f32 *Features = (f32 *)malloc(FrameCount * MOTION_FEATURE_STRIDE * sizeof(f32));
+    motion_database_frame *Frames = (motion_database_frame *)malloc(FrameCount * sizeof(motion_database_frame));
+
+    for (u32 FrameIndex = 0; FrameIndex < FrameCount; ++FrameIndex)
+    {
+        u32 SourceFrameIndex = FrameOrder[FrameIndex];
+
+        for (u32 FeatureIndex = 0; FeatureIndex < MOTION_FEATURE_STRIDE; ++FeatureIndex)
+        {
+            Features[FrameIndex * MOTION_FEATURE_STRIDE + FeatureIndex] = Database->Features[SourceFrameIndex * MOTION_FEATURE_STRIDE + FeatureIndex];
+        }
+
+        Frames[FrameIndex] = Database->Frames[SourceFrameIndex];
+        Database->ClipFrameIndices[SourceFrameIndex] = FrameIndex;
+    }
+
+    free(Database->Features);
+    free(Database->Frames);
+
+    Database->Features = Features;
+    Database->Frames = Frames;
+
+    Database->NodeCount = (u32)Nodes.size();
+    Database->Nodes = (motion_kd_node *)malloc(Database->NodeCount * sizeof(motion_kd_node));
+
+    for (u32 NodeIndex = 0; NodeIndex < Database->NodeCount; ++NodeIndex)
+    {
+        Database->Nodes[NodeIndex] = Nodes[NodeIndex];
+    }
+}
+
+// Per-group mean and deviation, scaled by the group weight
+internal void
+NormalizeMotionFeatures(motion_database *Database)
+{
+    for (u32 FeatureIndex = 0; FeatureIndex < MOTION_FEATURE_STRIDE; ++FeatureIndex)
+    {
+        Database->Offsets[FeatureIndex] = 0.f;
+        Database->Scales[FeatureIndex] = 0.f;
+    }
+
+    for (u32 GroupIndex = 0; GroupIndex < ArrayCount(MotionFeatureGroups); ++GroupIndex)
+    {
+        motion_feature_group *Group = MotionFeatureGroups + GroupIndex;
+
+        f64 Variance = 0.0;
+
+        for (u32 FeatureIndex = Group->FirstFeature; FeatureIndex < Group->FirstFeature + Group->FeatureCount; ++FeatureIndex)
+        {
+            f64 Sum = 0.0;
+            for (u32 FrameIndex = 0; FrameIndex < Database->FrameCount; ++FrameIndex)
+            {
+                Sum += Database->Features[FrameIndex * MOTION_FEATURE_STRIDE + FeatureIndex];
+            }
+
+            f64 Mean = Sum / Database->FrameCount;
+
+            for (u32 FrameIndex = 0; FrameIndex < Database->FrameCount; ++FrameIndex)
+            {
+                f64 Delta = Database->Features[FrameIndex * MOTION_FEATURE_STRIDE + FeatureIndex] - Mean;
+                Variance += Delta * Delta;
+            }
+
+            Database->Offsets[FeatureIndex] = (f32)Mean;
+        }
+
+        f32 Deviation = Sqrt((f32)(Variance / (Database->FrameCount * Group->FeatureCount)));
+
+        for (u32 FeatureIndex = Group->FirstFeature; FeatureIndex < Group->FirstFeature + Group->FeatureCount; ++FeatureIndex)
+        {
+            // Constant groups (e.g. directions of clips that don't turn) are left unscaled
+            Database->Scales[FeatureIndex] = Deviation > EPSILON ? Group->Weight / Deviation : Group->Weight;
+        }
+    }
+
+    for (u32 FrameIndex = 0; FrameIndex < Database->FrameCount; ++FrameIndex)
+    {
+        f32 *Features = Database->Features + FrameIndex * MOTION_FEATURE_STRIDE;
+
+        for (u32 FeatureIndex = 0; FeatureIndex < MOTION_FEATURE_STRIDE; ++FeatureIndex)
+        {
+            Features[FeatureIndex] = NormalizeMotionFeature(Database, FeatureIndex, Features[FeatureIndex]);
+        }
+    }
+}
+
+// Frames of the clips sampled at MOTION_DATABASE_SAMPLE_RATE. 
+// Non-looping clips are cut where the trajectory would run past their end
+internal void
+BuildMotionDatabase(model_asset *Asset, const char **ClipNames, u32 ClipCount)
+{
+    skeleton *Skeleton = &Asset->Skeleton;
+
+    motion_database *Database = &Asset->MotionDatabase;
+    *Database = {};
+    Database->SampleRate = MOTION_DATABASE_SAMPLE_RATE;
+    Database->TrajectoryTimes[0] = 1.f / 3.f;
+    Database->TrajectoryTimes[1] = 2.f / 3.f;
+    Database->TrajectoryTimes[2] = 1.f;
+    Database->Animations = Asset->Animations;
+
+    u32 JointIndices[] =
+    {
+        GetJointIndex(Skeleton, "mixamorig:LeftFoot"),
+        GetJointIndex(Skeleton, "mixamorig:RightFoot"),
+        ROOT_TRANSLATION_JOINT_INDEX
+    };
+
+    dynamic_array<joint_pose> LocalJointPoses(Skeleton->JointCount);
+    dynamic_array<mat4> GlobalJointPoses(Skeleton->JointCount);
+
+    skeleton_pose Pose = {};
+    Pose.Skeleton = Skeleton;
+    Pose.LocalJointPoses = LocalJointPoses.data();
+    Pose.GlobalJointPoses = GlobalJointPoses.data();
+
+    f32 TrajectoryDuration = Database->TrajectoryTimes[MOTION_TRAJECTORY_POINT_COUNT - 1];
+
+    Database->ClipCount = ClipCount;
+    Database->Clips = (motion_database_clip *)malloc(ClipCount * sizeof(motion_database_clip));
+
+    for (u32 ClipIndex = 0; ClipIndex < ClipCount; ++ClipIndex)
+    {
+        motion_database_clip *DatabaseClip = Database->Clips + ClipIndex;
+        DatabaseClip->AnimationIndex = U32_MAX;
+
+        for (u32 AnimationIndex = 0; AnimationIndex < Asset->AnimationCount; ++AnimationIndex)
+        {
+            if (StringEquals(Asset->Animations[AnimationIndex].Name, ClipNames[ClipIndex]))
+            {
+                DatabaseClip->AnimationIndex = AnimationIndex;
+                break;
+            }
+        }
+
+        Assert(DatabaseClip->AnimationIndex != U32_MAX);
+
+        animation_clip *Clip = Asset->Animations + DatabaseClip->AnimationIndex;
+
+        Assert(!Clip->IsAdditive);
+
+        // Last frame of a looping clip is the first one
+        f32 EndTime = Clip->IsLooping ? Clip->Duration - 1.f / Database->SampleRate : Max(Clip->Duration - TrajectoryDuration, 0.f);
+
+        DatabaseClip->FirstFrameIndex = Database->FrameCount;
+        DatabaseClip->FrameCount = (u32)(EndTime * Database->SampleRate) + 1;
+
+        Database->FrameCount += DatabaseClip->FrameCount;
+    }
+
+    Database->Frames = (motion_database_frame *)malloc(Database->FrameCount * sizeof(motion_database_frame));
+    Database->Features = (f32 *)malloc(Database->FrameCount * MOTION_FEATURE_STRIDE * sizeof(f32));
+    Database->ClipFrameIndices = (u32 *)malloc(Database->FrameCount * sizeof(u32));
+
+    for (u32 ClipIndex = 0; ClipIndex < ClipCount; ++ClipIndex)
+    {
+        motion_database_clip *DatabaseClip = Database->Clips + ClipIndex;
+        animation_clip *Clip = Asset->Animations + DatabaseClip->AnimationIndex;
+
+        dynamic_array<u32> KeyFrameCursors(GetKeyFrameCursorCount(Clip));
+
+        animation_state State = {};
+        State.Clip = Clip;
+        State.KeyFrameCursors = KeyFrameCursors.data();
+
+        for (u32 ClipFrameIndex = 0; ClipFrameIndex < DatabaseClip->FrameCount; ++ClipFrameIndex)
+        {
+            u32 FrameIndex = DatabaseClip->FirstFrameIndex + ClipFrameIndex;
+
+            motion_database_frame *Frame = Database->Frames + FrameIndex;
+            Frame->ClipIndex = ClipIndex;
+            Frame->Time = ClipFrameIndex / Database->SampleRate;
+
+            f32 *Features = Database->Features + FrameIndex * MOTION_FEATURE_STRIDE;
+            CalculateMotionFeatures(&Pose, &Asset->BindPose, &State, Database, JointIndices, Frame->Time, Features);
+
+            f32 Speed = Magnitude(vec2(
+                Features[MotionFeature_TrajectoryPositions + (MOTION_TRAJECTORY_POINT_COUNT - 1) * 2 + 0],
+                Features[MotionFeature_TrajectoryPositions + (MOTION_TRAJECTORY_POINT_COUNT - 1) * 2 + 1]
+            )) / TrajectoryDuration;
+
+            Database->MaxSpeed = Max(Database->MaxSpeed, Speed);
+        }
+    }
+
+    NormalizeMotionFeatures(Database);
+    BuildMotionKdTree(Database);
+
+    printf("Motion database: %d clips, %d frames, %d KD-tree nodes (max speed %.2f)\n", Database->ClipCount, Database->FrameCount, Database->NodeCount, Database->MaxSpeed);
+}
+
+#define ANIMATION_TEXTURE_SAMPLE_RATE 30.f
+
+// Bakes skinning matrices of the clips for GPU-only playback (see animation_texture)
+internal void
+BakeAnimationTexture(model_asset *Asset, const char **ClipNames, u32 ClipCount)
+{
+    skeleton *Skeleton = &Asset->Skeleton;
+
+    animation_texture *AnimationTexture = &Asset->AnimationTexture;
+    *AnimationTexture = {};
+    // Clip table has to fit into the first row
+    u32 JointTexelCount = Skeleton->JointCount * ANIMATION_TEXTURE_TEXELS_PER_JOINT;
+    AnimationTexture->Width = JointTexelCount > ClipCount ? JointTexelCount : ClipCount;
+    AnimationTexture->Height = 1;
+
+    AnimationTexture->ClipCount = ClipCount;
+    AnimationTexture->Clips = (animation_texture_clip *)malloc(ClipCount * sizeof(animation_texture_clip));
+
+    for (u32 ClipIndex = 0; ClipIndex < ClipCount; ++ClipIndex)
+    {
+        animation_texture_clip *TextureClip = AnimationTexture->Clips + ClipIndex;
+        TextureClip->AnimationIndex = U32_MAX;
+
+        for (u32 AnimationIndex = 0; AnimationIndex < Asset->AnimationCount; ++AnimationIndex)
+        {
+            if (StringEquals(Asset->Animations[AnimationIndex].Name, ClipNames[ClipIndex]))
+            {
+                TextureClip->AnimationIndex = AnimationIndex;
+                break;
+            }
+        }
+
+        Assert(TextureClip->AnimationIndex != U32_MAX);
+
+        animation_clip *Clip = Asset->Animations + TextureClip->AnimationIndex;
+
+        Assert(!Clip->IsAdditive);
+
+        // Last frame of a looping clip is the first one
+        TextureClip->FirstRow = AnimationTexture->Height;
+        TextureClip->FrameCount = (u32)ceil(Clip->Duration * ANIMATION_TEXTURE_SAMPLE_RATE) + (Clip->IsLooping ? 0 : 1);
+
+        Assert(TextureClip->FrameCount > 1);
+
+        AnimationTexture->Height += TextureClip->FrameCount;
+    }
+
+    AnimationTexture->Texels = (vec4 *)calloc(AnimationTexture->Width * AnimationTexture->Height, sizeof(vec4));
+
+    dynamic_array<joint_pose> LocalJointPoses(Skeleton->JointCount);
+    dynamic_array<mat4> GlobalJointPoses(Skeleton->JointCount);
+    dynamic_array<mat4> SkinningMatrices(Skeleton->JointCount);
+
+    skeleton_pose Pose = {};
+    Pose.Skeleton = Skeleton;
+    Pose.LocalJointPoses = LocalJointPoses.data();
+    Pose.GlobalJointPoses = GlobalJointPoses.data();
+
+    for (u32 ClipIndex = 0; ClipIndex < ClipCount; ++ClipIndex)
+    {
+        animation_texture_clip *TextureClip = AnimationTexture->Clips + ClipIndex;
+        animation_clip *Clip = Asset->Animations + TextureClip->AnimationIndex;
+
+        AnimationTexture->Texels[ClipIndex] = vec4((f32)TextureClip->FirstRow, (f32)TextureClip->FrameCount, Clip->Duration, Clip->IsLooping ? 1.f : 0.f);
+
+        dynamic_array<u32> KeyFrameCursors(GetKeyFrameCursorCount(Clip));
+
+        animation_state State = {};
+        State.Clip = Clip;
+        State.KeyFrameCursors = KeyFrameCursors.data();
+
+        u32 FrameStepCount = Clip->IsLooping ? TextureClip->FrameCount : TextureClip->FrameCount - 1;
+
+        for (u32 FrameIndex = 0; FrameIndex < TextureClip->FrameCount; ++FrameIndex)
+        {
+            for (u32 JointIndex = 0; JointIndex < Skeleton->JointCount; ++JointIndex)
+            {
+                Pose.LocalJointPoses[JointIndex] = Asset->BindPose.LocalJointPoses[JointIndex];
+            }
+
+            State.Time = Min(FrameIndex * Clip->Duration / FrameStepCount, Clip->Duration);
+            AnimateSkeletonPose(&Pose, &State);
+            UpdateGlobalJointPoses(&Pose, CreateTransform(vec3(0.f), vec3(1.f), quat(0.f, 0.f, 0.f, 1.f)));
+            CalculateSkinningPalette(&Pose, SkinningMatrices.data());
+
+            vec4 *Row = AnimationTexture->Texels + (TextureClip->FirstRow + FrameIndex) * AnimationTexture->Width;
+
+            for (u32 JointIndex = 0; JointIndex < Skeleton->JointCount; ++JointIndex)
+            {
+                mat4 *SkinningMatrix = SkinningMatrices.data() + JointIndex;
+
+                for (u32 RowIndex = 0; RowIndex < ANIMATION_TEXTURE_TEXELS_PER_JOINT; ++RowIndex)
+                {
+                    Row[JointIndex * ANIMATION_TEXTURE_TEXELS_PER_JOINT + RowIndex] = SkinningMatrix->Rows[RowIndex];
+                }
+            }
+        }
+    }
+
+    printf("Animation texture: %d clips, %dx%d texels\n", AnimationTexture->ClipCount, AnimationTexture->Width, AnimationTexture->Height);
+}
+
+#define ANIMATION_SAMPLE_RATE 30.f
+
+#define COMPRESSION_ROTATION_TOLERANCE 0.000001f
+#define COMPRESSION_VECTOR_TOLERANCE 0.00001f
+
+inline compressed_quat
+CompressQuat(quat Value)
+{
+    Value = Normalize(Value);
+
+    u32 LargestIndex = 0;
+    for (u32 ElementIndex = 1; ElementIndex < 4; ++ElementIndex)
+    {
+        if (Abs(Value.Elements[ElementIndex]) > Abs(Value.Elements[LargestIndex]))
+        {
+            LargestIndex = ElementIndex;
+        }
+    }
+
+    // q and -q represent the same rotation, so the dropped component is always positive
+    if (Value.Elements[LargestIndex] < 0.f)
+    {
+        Value = -Value;
+    }
+
+    u16 Quantized[3];
+    u32 QuantizedIndex = 0;
+
+    for (u32 ElementIndex = 0; ElementIndex < 4; ++ElementIndex)
+    {
+        if (ElementIndex != LargestIndex)
+        {
+            f32 Normalized = Clamp((Value.Elements[ElementIndex] + SQRT_HALF) / (2.f * SQRT_HALF), 0.f, 1.f);
+            Quantized[QuantizedIndex++] = (u16)(Normalized * 32767.f + 0.5f);
+        }
+    }
+
+    compressed_quat Result;
+    Result.Elements[0] = (u16)(((LargestIndex >> 1) << 15) | Quantized[0]);
+    Result.Elements[1] = (u16)(((LargestIndex & 1) << 15) | Quantized[1]);
+    Result.Elements[2] = Quantized[2];
+
+    return Result;
+}
+
+inline quantized_vec3
+QuantizeVec3(vec3 Value, vec3 Min, vec3 Extent)
+{
+    quantized_vec3 Result;
+
+    for (u32 ElementIndex = 0; ElementIndex < 3; ++ElementIndex)
+    {
+        f32 Normalized = Extent.Elements[ElementIndex] > 0.f
+            ? Clamp((Value.Elements[ElementIndex] - Min.Elements[ElementIndex]) / Extent.Elements[ElementIndex], 0.f, 1.f)
+            : 0.f;
+
+        Result.Elements[ElementIndex] = (u16)(Normalized * 65535.f + 0.5f);
+    }
+
+    return Result;
+}
+
+internal b32
+IsConstantRotationChannel(animation_sample *PoseSample)
+{
+    b32 Result = true;
+
+    quat FirstRotation = Normalize(PoseSample->KeyFrames[0].Pose.Rotation);
+
+    for (u32 KeyFrameIndex = 1; KeyFrameIndex < PoseSample->KeyFrameCount; ++KeyFrameIndex)
+    {
+        quat Rotation = Normalize(PoseSample->KeyFrames[KeyFrameIndex].Pose.Rotation);
+
+        if (1.f - Abs(Dot(FirstRotation, Rotation)) > COMPRESSION_ROTATION_TOLERANCE)
+        {
+            Result = false;
+            break;
+        }
+    }
+
+    return Result;
+}
+
+// Translation or scale channel, also calculates the quantization range
+internal b32
+IsConstantVectorChannel(animation_sample *PoseSample, b32 IsScale, vec3 *RangeMin, vec3 *RangeExtent)
+{
+    vec3 FirstValue = IsScale ? PoseSample->KeyFrames[0].Pose.Scale : PoseSample->KeyFrames[0].Pose.Translation;
+    vec3 RangeMax = FirstValue;
+    *RangeMin = FirstValue;
+
+    for (u32 KeyFrameIndex = 1; KeyFrameIndex < PoseSample->KeyFrameCount; ++KeyFrameIndex)
+    {
+        vec3 Value = IsScale ? PoseSample->KeyFrames[KeyFrameIndex].Pose.Scale : PoseSample->KeyFrames[KeyFrameIndex].Pose.Translation;
+
+        for (u32 ElementIndex = 0; ElementIndex < 3; ++ElementIndex)
+        {
+            RangeMin->Elements[ElementIndex] = Min(RangeMin->Elements[ElementIndex], Value.Elements[ElementIndex]);
+            RangeMax.Elements[ElementIndex] = Max(RangeMax.Elements[ElementIndex], Value.Elements[ElementIndex]);
+        }
+    }
+
+    *RangeExtent = RangeMax - *RangeMin;
+
+    b32 Result = 
+        RangeExtent->x <= COMPRESSION_VECTOR_TOLERANCE && 
+        RangeExtent->y <= COMPRESSION_VECTOR_TOLERANCE && 
+        RangeExtent->z <= COMPRESSION_VECTOR_TOLERANCE;
+
+    if (Result)
+    {
+        *RangeMin = FirstValue;
+        *RangeExtent = vec3(0.f);
+    }
+
+    return Result;
+}
+
+internal u32
+AddAnimationTimeline(dynamic_array<dynamic_array<f32>> &Timelines, animation_sample *PoseSample)
+{
+    dynamic_array<f32> Times(PoseSample->KeyFrameCount);
+
+    for (u32 KeyFrameIndex = 0; KeyFrameIndex < PoseSample->KeyFrameCount; ++KeyFrameIndex)
+    {
+        Times[KeyFrameIndex] = PoseSample->KeyFrames[KeyFrameIndex].Time;
+    }
+
+    for (u32 TimelineIndex = 0; TimelineIndex < Timelines.size(); ++TimelineIndex)
+    {
+        if (Timelines[TimelineIndex] == Times)
+        {
+            return TimelineIndex;
+        }
+    }
+
+    Timelines.push_back(Times);
+
+    return (u32)(Timelines.size() - 1);
+}
+
+// Smallest three rotations, 16-bit range-quantized translations and scales,
+// constant channels store a single value, identical key frame times are shared between samples
+internal animation_clip
+CompressAnimationClip(animation_clip *Animation)
+{
+    Assert(Animation->Format == AnimationClipFormat_KeyFrames);
+
+    animation_clip Result = *Animation;
+    Result.Format = AnimationClipFormat_Compressed;
+    Result.CompressedPoseSamples = (compressed_animation_sample *)malloc(Result.PoseSampleCount * sizeof(compressed_animation_sample));
+
+    dynamic_array<dynamic_array<f32>> Timelines;
+
+    for (u32 PoseSampleIndex = 0; PoseSampleIndex < Animation->PoseSampleCount; ++PoseSampleIndex)
+    {
+        animation_sample *PoseSample = Animation->PoseSamples + PoseSampleIndex;
+        compressed_animation_sample *CompressedPoseSample = Result.CompressedPoseSamples + PoseSampleIndex;
+
+        Assert(PoseSample->KeyFrameCount > 0);
+
+        b32 ConstantRotation = IsConstantRotationChannel(PoseSample);
+        b32 ConstantTranslation = IsConstantVectorChannel(PoseSample, false, &CompressedPoseSample->TranslationMin, &CompressedPoseSample->TranslationExtent);
+        b32 ConstantScale = IsConstantVectorChannel(PoseSample, true, &CompressedPoseSample->ScaleMin, &CompressedPoseSample->ScaleExtent);
+
+        CompressedPoseSample->JointIndex = PoseSample->JointIndex;
+        CompressedPoseSample->RotationStride = ConstantRotation ? 0 : 1;
+        CompressedPoseSample->TranslationStride = ConstantTranslation ? 0 : 1;
+        CompressedPoseSample->ScaleStride = ConstantScale ? 0 : 1;
+
+        // Static joint
+        if (ConstantRotation && ConstantTranslation && ConstantScale)
+        {
+            CompressedPoseSample->KeyFrameCount = 1;
+            CompressedPoseSample->TimelineIndex = 0;
+        }
+        else
+        {
+            CompressedPoseSample->KeyFrameCount = PoseSample->KeyFrameCount;
+            CompressedPoseSample->TimelineIndex = AddAnimationTimeline(Timelines, PoseSample);
+        }
+
+        u32 RotationCount = ConstantRotation ? 1 : CompressedPoseSample->KeyFrameCount;
+        u32 TranslationCount = ConstantTranslation ? 1 : CompressedPoseSample->KeyFrameCount;
+        u32 ScaleCount = ConstantScale ? 1 : CompressedPoseSample->KeyFrameCount;
+
+        CompressedPoseSample->Rotations = (compressed_quat *)malloc(RotationCount * sizeof(compressed_quat));
+        CompressedPoseSample->Translations = (quantized_vec3 *)malloc(TranslationCount * sizeof(quantized_vec3));
+        CompressedPoseSample->Scales = (quantized_vec3 *)malloc(ScaleCount * sizeof(quantized_vec3));
+
+        for (u32 RotationIndex = 0; RotationIndex < RotationCount; ++RotationIndex)
+        {
+            CompressedPoseSample->Rotations[RotationIndex] = CompressQuat(PoseSample->KeyFrames[RotationIndex].Pose.Rotation);
+        }
+
+        for (u32 TranslationIndex = 0; TranslationIndex < TranslationCount; ++TranslationIndex)
+        {
+            CompressedPoseSample->Translations[TranslationIndex] = QuantizeVec3(PoseSample->KeyFrames[TranslationIndex].Pose.Translation,
+                CompressedPoseSample->TranslationMin, CompressedPoseSample->TranslationExtent);
+        }
+
+        for (u32 ScaleIndex = 0; ScaleIndex < ScaleCount; ++ScaleIndex)
+        {
+            CompressedPoseSample->Scales[ScaleIndex] = QuantizeVec3(PoseSample->KeyFrames[ScaleIndex].Pose.Scale,
+                CompressedPoseSample->ScaleMin, CompressedPoseSample->ScaleExtent);
+        }
+    }
+
+    Result.TimelineCount = (u32)Timelines.size();
+    Result.Timelines = (animation_timeline *)malloc(Result.TimelineCount * sizeof(animation_timeline));
+
+    for (u32 TimelineIndex = 0; TimelineIndex < Result.TimelineCount; ++TimelineIndex)
+    {
+        animation_timeline *Timeline = Result.Timelines + TimelineIndex;
+        Timeline->KeyFrameCount = (u32)Timelines[TimelineIndex].size();
+        Timeline->Times = (f32 *)malloc(Timeline->KeyFrameCount * sizeof(f32));
+
+        memcpy(Timeline->Times, Timelines[TimelineIndex].data(), Timeline->KeyFrameCount * sizeof(f32));
+    }
+
+    return Result;
+}
+
+internal u64
+GetAnimationClipFileSize(animation_clip *Animation)
+{
+    u64 Result = sizeof(model_asset_animation_header);
+
+    if (Animation->Format == AnimationClipFormat_KeyFrames)
+    {
+        for (u32 PoseSampleIndex = 0; PoseSampleIndex < Animation->PoseSampleCount; ++PoseSampleIndex)
+        {
+            Result += sizeof(model_asset_animation_sample_header) + Animation->PoseSamples[PoseSampleIndex].KeyFrameCount * sizeof(key_frame);
+        }
+    }
+    else if (Animation->Format == AnimationClipFormat_Compressed)
+    {
+        for (u32 TimelineIndex = 0; TimelineIndex < Animation->TimelineCount; ++TimelineIndex)
+        {
+            Result += sizeof(model_asset_animation_timeline_header) + Animation->Timelines[TimelineIndex].KeyFrameCount * sizeof(f32);
+        }
+
+        for (u32 PoseSampleIndex = 0; PoseSampleIndex < Animation->PoseSampleCount; ++PoseSampleIndex)
+        {
+            compressed_animation_sample *PoseSample = Animation->CompressedPoseSamples + PoseSampleIndex;
+
+            u32 RotationCount = PoseSample->RotationStride ? PoseSample->KeyFrameCount : 1;
+            u32 TranslationCount = PoseSample->TranslationStride ? PoseSample->KeyFrameCount : 1;
+            u32 ScaleCount = PoseSample->ScaleStride ? PoseSample->KeyFrameCount : 1;
+
+            Result += sizeof(model_asset_compressed_animation_sample_header) +
+                RotationCount * sizeof(compressed_quat) + (TranslationCount + ScaleCount) * sizeof(quantized_vec3);
+        }
+    }
+    else
+    {
+        Result += Animation->PoseSampleCount * sizeof(u32) + 
+            Animation->FrameCount * AnimationFrameChannel_Count * Animation->PoseSampleCount * sizeof(f32);
+    }
+
+    return Result;
+}
+
+// Samples all joints at the same rate, so the runtime can find key frames directly from the time
+internal animation_clip
+ResampleAnimationClip(animation_clip *Animation, skeleton *Skeleton, f32 SampleRate)
+{
+    Assert(Animation->Format == AnimationClipFormat_KeyFrames);
+
+    animation_clip Result = *Animation;
+    Result.Format = AnimationClipFormat_Uniform;
+    Result.SampleRate = SampleRate;
+    Result.FrameCount = (u32)ceil(Animation->Duration * SampleRate) + 1;
+    Result.FrameJointIndices = (u32 *)malloc(Result.PoseSampleCount * sizeof(u32));
+
+    u32 FrameSize = Result.PoseSampleCount * AnimationFrameChannel_Count;
+    Result.Frames = (f32 *)malloc(Result.FrameCount * FrameSize * sizeof(f32));
+
+    for (u32 PoseSampleIndex = 0; PoseSampleIndex < Animation->PoseSampleCount; ++PoseSampleIndex)
+    {
+        Result.FrameJointIndices[PoseSampleIndex] = Animation->PoseSamples[PoseSampleIndex].JointIndex;
+    }
+
+    skeleton_pose Pose = {};
+    Pose.Skeleton = Skeleton;
+    Pose.LocalJointPoses = (joint_pose *)malloc(Skeleton->JointCount * sizeof(joint_pose));
+
+    animation_state AnimationState = {};
+    AnimationState.Clip = Animation;
+    AnimationState.KeyFrameCursors = (u32 *)calloc(Animation->PoseSampleCount, sizeof(u32));
+
+    for (u32 FrameIndex = 0; FrameIndex < Result.FrameCount; ++FrameIndex)
+    {
+        // Last frame is clamped to the end of the clip
+        AnimationState.Time = Min(FrameIndex / SampleRate, Animation->Duration);
+        AnimateSkeletonPoseKeyFrames(&Pose, &AnimationState);
+
+        f32 *Frame = Result.Frames + FrameIndex * FrameSize;
+        f32 *PrevFrame = Frame - FrameSize;
+
+        for (u32 PoseSampleIndex = 0; PoseSampleIndex < Result.PoseSampleCount; ++PoseSampleIndex)
+        {
+            joint_pose *LocalJointPose = Pose.LocalJointPoses + Result.FrameJointIndices[PoseSampleIndex];
+
+            quat Rotation = Normalize(LocalJointPose->Rotation);
+
+            // Keeping neighbouring rotations in the same hemisphere (runtime uses nlerp without sign fix)
+            if (FrameIndex > 0)
+            {
+                quat PrevRotation = quat(
+                    PrevFrame[AnimationFrameChannel_RotationX * Result.PoseSampleCount + PoseSampleIndex],
+                    PrevFrame[AnimationFrameChannel_RotationY * Result.PoseSampleCount + PoseSampleIndex],
+                    PrevFrame[AnimationFrameChannel_RotationZ * Result.PoseSampleCount + PoseSampleIndex],
+                    PrevFrame[AnimationFrameChannel_RotationW * Result.PoseSampleCount + PoseSampleIndex]
+                );
+
+                if (Dot(PrevRotation, Rotation) < 0.f)
+                {
+                    Rotation = -Rotation;
+                }
+            }
+
+            f32 Values[AnimationFrameChannel_Count] =
+            {
+                Rotation.x, Rotation.y, Rotation.z, Rotation.w,
+                LocalJointPose->Translation.x, LocalJointPose->Translation.y, LocalJointPose->Translation.z,
+                LocalJointPose->Scale.x, LocalJointPose->Scale.y, LocalJointPose->Scale.z
+            };
+
+            for (u32 ChannelIndex = 0; ChannelIndex < AnimationFrameChannel_Count; ++ChannelIndex)
+            {
+                Frame[ChannelIndex * Result.PoseSampleCount + PoseSampleIndex] = Values[ChannelIndex];
+            }
+        }
+    }
+
+    free(AnimationState.KeyFrameCursors);
+    free(Pose.LocalJointPoses);
+
+    return Result;
+}
+
+// For testing
+internal void
+ReadAssetFile(const char *FilePath, model_asset *Asset, model_asset *OriginalAsset)
+{
+    FILE *AssetFile = fopen(FilePath, "rb");
+    
+    fseek(AssetFile, 0, SEEK_END);
+    u32 FileSize = ftell(AssetFile);
+    fseek(AssetFile, 0, SEEK_SET);
+
+    void *Buffer = malloc(FileSize);
+
+    fread(Buffer, FileSize, 1, AssetFile);
+
+    model_asset_header *Header = (model_asset_header *)Buffer;
+
+    model_asset_skeleton_header *SkeletonHeader = (model_asset_skeleton_header *)((u8 *)Buffer + Header->SkeletonHeaderOffset);
+    skeleton Skeleton = {};
+    Skeleton.JointCount = SkeletonHeader->JointCount;
+    Skeleton.Joints = (joint *)((u8*)Buffer + SkeletonHeader->JointsOffset);
+
+    model_asset_skeleton_pose_header *SkeletonPoseHeader = (model_asset_skeleton_pose_header *)((u8 *)Buffer + Header->SkeletonPoseHeaderOffset);
+    skeleton_pose BindPose = {};
+    BindPose.LocalJointPoses = (joint_pose *)((u8*)Buffer + SkeletonPoseHeader->LocalJointPosesOffset);
+    BindPose.GlobalJointPoses = (mat4 *)((u8*)Buffer + SkeletonPoseHeader->GlobalJointPosesOffset);
+
+    model_asset_meshes_header *MeshesHeader = (model_asset_meshes_header *)((u8 *)Buffer + Header->MeshesHeaderOffset);
+
+    u32 NextMeshHeaderOffset = 0;
+
+    for (u32 MeshIndex = 0; MeshIndex < MeshesHeader->MeshCount; ++MeshIndex)
+    {
+        model_asset_mesh_header *MeshHeader = (model_asset_mesh_header *)((u8 *)Buffer + 
+            MeshesHeader->MeshesOffset + NextMeshHeaderOffset);
+        mesh Mesh = {};
+
+        Mesh.MaterialIndex = MeshHeader->MaterialIndex;
+        Mesh.VertexCount = MeshHeader->VertexCount;
+        Mesh.IndexCount = MeshHeader->IndexCount;
+
+        u32 VerticesOffset = 0;
+
+        if (MeshHeader->HasPositions)
+        {
+            Mesh.Positions = (vec3 *)((u8 *)Buffer + MeshHeader->VerticesOffset + VerticesOffset);
+            VerticesOffset += sizeof(vec3) * MeshHeader->VertexCount;
+        }
+
+        if (MeshHeader->HasNormals)
+        {
+            Mesh.Normals = (vec3 *)((u8 *)Buffer + MeshHeader->VerticesOffset + VerticesOffset);
+            VerticesOffset += sizeof(vec3) * MeshHeader->VertexCount;
+        }
+
+        if (MeshHeader->HasTangents)
+        {
+            Mesh.Tangents = (vec3 *)((u8 *)Buffer + MeshHeader->VerticesOffset + VerticesOffset);
+            VerticesOffset += sizeof(vec3) * MeshHeader->VertexCount;
+        }
+
+        if (MeshHeader->HasBitangets)
+        {
+            Mesh.Bitangents = (vec3 *)((u8 *)Buffer + MeshHeader->VerticesOffset + VerticesOffset);
             VerticesOffset += sizeof(vec3) * MeshHeader->VertexCount;
         }
 
-        if (MeshHeader->HasNormals)
+        if (MeshHeader->HasTextureCoords)
+        {
+            Mesh.TextureCoords = (vec2 *)((u8 *)Buffer + MeshHeader->VerticesOffset + VerticesOffset);
+            VerticesOffset += sizeof(vec2) * MeshHeader->VertexCount;
+        }
+
+        if (MeshHeader->HasWeights)
+        {
+            Mesh.Weights = (vec4 *)((u8 *)Buffer + MeshHeader->VerticesOffset + VerticesOffset);
+            VerticesOffset += sizeof(vec4) * MeshHeader->VertexCount;
+        }
+
+        if (MeshHeader->HasJointIndices)
+        {
+            Mesh.JointIndices = (i32 *)((u8 *)Buffer + MeshHeader->VerticesOffset + VerticesOffset);
+            VerticesOffset += sizeof(i32) * 4 * MeshHeader->VertexCount;
+        }
+
+        Mesh.Indices = (u32 *)((u8 *)Buffer + MeshHeader->IndicesOffset);
+
+        NextMeshHeaderOffset += sizeof(model_asset_mesh_header) + VerticesOffset + MeshHeader->IndexCount * sizeof(u32);
+    }
+
+    model_asset_materials_header *MaterialsHeader = (model_asset_materials_header *)((u8 *)Buffer + Header->MaterialsHeaderOffset);
+
+    u64 NextMaterialHeaderOffset = 0;
+    for (u32 MaterialIndex = 0; MaterialIndex < MaterialsHeader->MaterialCount; ++MaterialIndex)
+    {
+        model_asset_material_header *MaterialHeader = (model_asset_material_header *)((u8 *)Buffer +
+            MaterialsHeader->MaterialsOffset + NextMaterialHeaderOffset);
+        mesh_material Material = {};
+        Material.PropertyCount = MaterialHeader->PropertyCount;
+        Material.Properties = (material_property *)((u8 *)Buffer + MaterialHeader->PropertiesOffset);
+
+        u64 NextMaterialPropertyHeaderOffset = 0;
+        for (u32 MaterialPropertyIndex = 0; MaterialPropertyIndex < MaterialHeader->PropertyCount; ++MaterialPropertyIndex)
+        {
+            model_asset_material_property_header *MaterialPropertyHeader = (model_asset_material_property_header *)
+                ((u8 *)Buffer + MaterialHeader->PropertiesOffset + NextMaterialPropertyHeaderOffset);
+
+            material_property *MaterialProperty = Material.Properties + MaterialPropertyIndex;
+
+            MaterialProperty->Type = MaterialPropertyHeader->Type;
+            switch (MaterialProperty->Type)
+            {
+                case MaterialProperty_Float_Shininess:
+                {
+                    MaterialProperty->Value = MaterialPropertyHeader->Value;
+
+                    NextMaterialPropertyHeaderOffset += sizeof(model_asset_material_property_header);
+
+                    break;
+                }
+                case MaterialProperty_Color_Ambient:
+                case MaterialProperty_Color_Diffuse:
+                case MaterialProperty_Color_Specular:
+                {
+                    MaterialProperty->Color = MaterialPropertyHeader->Color;
+
+                    NextMaterialPropertyHeaderOffset += sizeof(model_asset_material_property_header);
+
+                    break;
+                }
+                case MaterialProperty_Texture_Diffuse:
+                {
+                    MaterialProperty->Bitmap = MaterialPropertyHeader->Bitmap;
+                    MaterialProperty->Bitmap.Pixels = (void *)((u8 *)Buffer + MaterialPropertyHeader->BitmapOffset);
+
+#if 1
+                    char FileName[64];
+                    FormatString(FileName, ArrayCount(FileName), "Diffuse - %d - %d.bmp", MaterialIndex, MaterialPropertyIndex);
+
+                    stbi_write_bmp(FileName, MaterialProperty->Bitmap.Width, MaterialProperty->Bitmap.Height, MaterialProperty->Bitmap.Channels, MaterialProperty->Bitmap.Pixels);
+#endif
+
+                    u32 BitmapSize = MaterialProperty->Bitmap.Width * MaterialProperty->Bitmap.Height * MaterialProperty->Bitmap.Channels;
+
+                    NextMaterialPropertyHeaderOffset += sizeof(model_asset_material_property_header) + BitmapSize;
+
+                    break;
+                }
+                case MaterialProperty_Texture_Specular:
+                {
+                    MaterialProperty->Bitmap = MaterialPropertyHeader->Bitmap;
+                    MaterialProperty->Bitmap.Pixels = (void *)((u8 *)Buffer + MaterialPropertyHeader->BitmapOffset);
+
+#if 1
+                    char FileName[64];
+                    FormatString(FileName, ArrayCount(FileName), "Specular - %d - %d.bmp", MaterialIndex, MaterialPropertyIndex);
+
+                    stbi_write_bmp(FileName, MaterialProperty->Bitmap.Width, MaterialProperty->Bitmap.Height, MaterialProperty->Bitmap.Channels, MaterialProperty->Bitmap.Pixels);
+#endif
+
+                    u32 BitmapSize = MaterialProperty->Bitmap.Width * MaterialProperty->Bitmap.Height * MaterialProperty->Bitmap.Channels;
+
+                    NextMaterialPropertyHeaderOffset += sizeof(model_asset_material_property_header) + BitmapSize;
+
+                    break;
+                }
+                case MaterialProperty_Texture_Shininess:
+                {
+                    MaterialProperty->Bitmap = MaterialPropertyHeader->Bitmap;
+                    MaterialProperty->Bitmap.Pixels = (void *)((u8 *)Buffer + MaterialPropertyHeader->BitmapOffset);
+
+#if 1
+                    char FileName[64];
+                    FormatString(FileName, ArrayCount(FileName), "Shininess - %d - %d.bmp", MaterialIndex, MaterialPropertyIndex);
+
+                    stbi_write_bmp(FileName, MaterialProperty->Bitmap.Width, MaterialProperty->Bitmap.Height, MaterialProperty->Bitmap.Channels, MaterialProperty->Bitmap.Pixels);
+#endif
+
+                    u32 BitmapSize = MaterialProperty->Bitmap.Width * MaterialProperty->Bitmap.Height * MaterialProperty->Bitmap.Channels;
+
+                    NextMaterialPropertyHeaderOffset += sizeof(model_asset_material_property_header) + BitmapSize;
+
+                    break;
+                }
+                case MaterialProperty_Texture_Normal:
+                {
+                    MaterialProperty->Bitmap = MaterialPropertyHeader->Bitmap;
+                    MaterialProperty->Bitmap.Pixels = (void *)((u8 *)Buffer + MaterialPropertyHeader->BitmapOffset);
+
+#if 1
+                    char FileName[64];
+                    FormatString(FileName, ArrayCount(FileName), "Normal - %d - %d.bmp", MaterialIndex, MaterialPropertyIndex);
+
+                    stbi_write_bmp(FileName, MaterialProperty->Bitmap.Width, MaterialProperty->Bitmap.Height, MaterialProperty->Bitmap.Channels, MaterialProperty->Bitmap.Pixels);
+#endif
+
+                    u32 BitmapSize = MaterialProperty->Bitmap.Width * MaterialProperty->Bitmap.Height * MaterialProperty->Bitmap.Channels;
+
+                    NextMaterialPropertyHeaderOffset += sizeof(model_asset_material_property_header) + BitmapSize;
+
+                    break;
+                }
+                default:
+                {
+                    Assert(!"Invalid material property");
+                }
+            }
+        }
+
+        NextMaterialHeaderOffset += sizeof(model_asset_material_header) + NextMaterialPropertyHeaderOffset;
+    }
+
+    model_asset_animations_header *AnimationsHeader = (model_asset_animations_header *)((u8 *)Buffer + Header->AnimationsHeaderOffset);
+
+    u64 NextAnimationHeaderOffset = 0;
+
+    for (u32 AnimationIndex = 0; AnimationIndex < AnimationsHeader->AnimationCount; ++AnimationIndex)
+    {
+        model_asset_animation_header *AnimationHeader = (model_asset_animation_header *)((u8 *)Buffer + 
+            AnimationsHeader->AnimationsOffset + NextAnimationHeaderOffset);
+        animation_clip Animation = {};
+        CopyString(AnimationHeader->Name, Animation.Name, MAX_ANIMATION_NAME_LENGTH);
+        Animation.Duration = AnimationHeader->Duration;
+        Animation.IsLooping = AnimationHeader->IsLooping;
+        Animation.InPlace = AnimationHeader->InPlace;
+        Animation.IsAdditive = AnimationHeader->IsAdditive;
+        Animation.Format = AnimationHeader->Format;
+        Animation.PoseSampleCount = AnimationHeader->PoseSampleCount;
+        Animation.PoseSamples = (animation_sample *)((u8 *)Buffer + AnimationHeader->PoseSamplesOffset);
+
+        u64 NextAnimationSampleHeaderOffset = 0;
+
+        if (Animation.Format == AnimationClipFormat_KeyFrames)
+        {
+            for (u32 AnimationPoseIndex = 0; AnimationPoseIndex < AnimationHeader->PoseSampleCount; ++AnimationPoseIndex)
+            {
+                model_asset_animation_sample_header *AnimationSampleHeader = (model_asset_animation_sample_header *)
+                    ((u8 *)Buffer + AnimationHeader->PoseSamplesOffset + NextAnimationSampleHeaderOffset);
+
+                animation_sample *AnimationSample = Animation.PoseSamples + AnimationPoseIndex;
+
+                AnimationSample->KeyFrameCount = AnimationSampleHeader->KeyFrameCount;
+                AnimationSample->KeyFrames = (key_frame *)((u8 *)Buffer + AnimationSampleHeader->KeyFramesOffset);
+
+                NextAnimationSampleHeaderOffset += sizeof(model_asset_animation_sample_header) + 
+                    AnimationSampleHeader->KeyFrameCount * sizeof(key_frame);
+            }
+        }
+        else if (Animation.Format == AnimationClipFormat_Uniform)
+        {
+            NextAnimationSampleHeaderOffset = AnimationHeader->PoseSampleCount * sizeof(u32) + 
+                AnimationHeader->FrameCount * AnimationFrameChannel_Count * AnimationHeader->PoseSampleCount * sizeof(f32);
+        }
+        else
+        {
+            // Timelines and compressed pose samples
+            NextAnimationSampleHeaderOffset = AnimationHeader->PoseSamplesOffset - AnimationHeader->TimelinesOffset;
+
+            for (u32 AnimationPoseIndex = 0; AnimationPoseIndex < AnimationHeader->PoseSampleCount; ++AnimationPoseIndex)
+            {
+                model_asset_compressed_animation_sample_header *AnimationSampleHeader = (model_asset_compressed_animation_sample_header *)
+                    ((u8 *)Buffer + AnimationHeader->TimelinesOffset + NextAnimationSampleHeaderOffset);
+
+                u32 RotationCount = AnimationSampleHeader->RotationStride ? AnimationSampleHeader->KeyFrameCount : 1;
+                u32 TranslationCount = AnimationSampleHeader->TranslationStride ? AnimationSampleHeader->KeyFrameCount : 1;
+                u32 ScaleCount = AnimationSampleHeader->ScaleStride ? AnimationSampleHeader->KeyFrameCount : 1;
+
+                NextAnimationSampleHeaderOffset += sizeof(model_asset_compressed_animation_sample_header) +
+                    RotationCount * sizeof(compressed_quat) + (TranslationCount + ScaleCount) * sizeof(quantized_vec3);
+            }
+        }
+
+        Animation.RootMotion.KeyFrameCount = AnimationHeader->RootMotionKeyFrameCount;
+        Animation.RootMotion.KeyFrames = (root_motion_key *)((u8 *)Buffer + AnimationHeader->RootMotionOffset);
+
+        NextAnimationHeaderOffset += sizeof(model_asset_animation_header) + NextAnimationSampleHeaderOffset + 
+            AnimationHeader->RootMotionKeyFrameCount * sizeof(root_motion_key);
+    }
+
+    fclose(AssetFile);
+}
+
+internal void
+WriteAssetFile(const char *FilePath, model_asset *Asset)
+{
+    FILE *AssetFile = fopen(FilePath, "wb");
+
+    model_asset_header Header = {};
+    Header.MagicValue = MODEL_ASSET_MAGIC_VALUE;
+    Header.Version = MODEL_ASSET_VERSION;
+    // will be filled later
+    Header.SkeletonHeaderOffset = 0;
+    Header.MeshesHeaderOffset = 0;
+    Header.MaterialsHeaderOffset = 0;
+    Header.AnimationsHeaderOffset = 0;
+
+    u64 CurrentStreamPosition = 0;
+
+    fwrite(&Header, sizeof(model_asset_header), 1, AssetFile);
+
+    CurrentStreamPosition = ftell(AssetFile);
+    Header.SkeletonHeaderOffset = CurrentStreamPosition;
+
+    // Writing skeleton
+    model_asset_skeleton_header SkeletonHeader = {};
+    SkeletonHeader.JointCount = Asset->Skeleton.JointCount;
+    SkeletonHeader.JointsOffset = Header.SkeletonHeaderOffset + sizeof(SkeletonHeader);
+
+    fwrite(&SkeletonHeader, sizeof(model_asset_skeleton_header), 1, AssetFile);
+    fwrite(Asset->Skeleton.Joints, sizeof(joint), Asset->Skeleton.JointCount, AssetFile);
+
+    CurrentStreamPosition = ftell(AssetFile);
+    Header.SkeletonPoseHeaderOffset = CurrentStreamPosition;
+
+    // Writing skeleton bind pose
+    model_asset_skeleton_pose_header SkeletonPoseHeader = {};
+    SkeletonPoseHeader.LocalJointPosesOffset = Header.SkeletonPoseHeaderOffset + sizeof(model_asset_skeleton_pose_header);
+    SkeletonPoseHeader.GlobalJointPosesOffset = SkeletonPoseHeader.LocalJointPosesOffset + SkeletonHeader.JointCount * sizeof(joint_pose);
+
+    fwrite(&SkeletonPoseHeader, sizeof(model_asset_skeleton_pose_header), 1, AssetFile);
+    fwrite(Asset->BindPose.LocalJointPoses, sizeof(joint_pose), Asset->Skeleton.JointCount, AssetFile);
+    fwrite(Asset->BindPose.GlobalJointPoses, sizeof(mat4), Asset->Skeleton.JointCount, AssetFile);
+
+    CurrentStreamPosition = ftell(AssetFile);
+    Header.MeshesHeaderOffset = CurrentStreamPosition;
+
+    // Writing meshes
+    model_asset_meshes_header MeshesHeader = {};
+    MeshesHeader.MeshCount = Asset->MeshCount;
+    MeshesHeader.MeshesOffset = Header.MeshesHeaderOffset + sizeof(model_asset_meshes_header);
+
+    fwrite(&MeshesHeader, sizeof(model_asset_meshes_header), 1, AssetFile);
+
+    u32 TotalPrevMeshSize = 0;
+    for (u32 MeshIndex = 0; MeshIndex < Asset->MeshCount; ++MeshIndex)
+    {
+        mesh *Mesh = Asset->Meshes + MeshIndex;
+
+        model_asset_mesh_header MeshHeader = {};
+        MeshHeader.MaterialIndex = Mesh->MaterialIndex;
+        MeshHeader.VertexCount = Mesh->VertexCount;
+        MeshHeader.IndexCount = Mesh->IndexCount;
+        MeshHeader.VerticesOffset = MeshesHeader.MeshesOffset + sizeof(model_asset_mesh_header) + TotalPrevMeshSize;
+        MeshHeader.IndicesOffset = MeshHeader.VerticesOffset + GetMeshVerticesSize(Mesh);
+
+        MeshHeader.HasPositions = Mesh->Positions != 0;
+        MeshHeader.HasNormals = Mesh->Normals != 0;
+        MeshHeader.HasTangents = Mesh->Tangents != 0;
+        MeshHeader.HasBitangets = Mesh->Bitangents != 0;
+        MeshHeader.HasTextureCoords = Mesh->TextureCoords != 0;
+        MeshHeader.HasWeights = Mesh->Weights != 0;
+        MeshHeader.HasJointIndices = Mesh->JointIndices != 0;
+
+        TotalPrevMeshSize += sizeof(model_asset_mesh_header) + GetMeshVerticesSize(Mesh) + Mesh->IndexCount * sizeof(u32);
+
+        fwrite(&MeshHeader, sizeof(model_asset_mesh_header), 1, AssetFile);
+
+        if (MeshHeader.HasPositions)
+        {
+            fwrite(Mesh->Positions, sizeof(vec3), Mesh->VertexCount, AssetFile);
+        }
+
+        if (MeshHeader.HasNormals)
+        {
+            fwrite(Mesh->Normals, sizeof(vec3), Mesh->VertexCount, AssetFile);
+        }
+
+        if (MeshHeader.HasTangents)
+        {
+            fwrite(Mesh->Tangents, sizeof(vec3), Mesh->VertexCount, AssetFile);
+        }
+
+        if (MeshHeader.HasBitangets)
+        {
+            fwrite(Mesh->Bitangents, sizeof(vec3), Mesh->VertexCount, AssetFile);
+        }
+
+        if (MeshHeader.HasTextureCoords)
+        {
+            fwrite(Mesh->TextureCoords, sizeof(vec2), Mesh->VertexCount, AssetFile);
+        }
+
+        if (MeshHeader.HasWeights)
+        {
+            fwrite(Mesh->Weights, sizeof(vec4), Mesh->VertexCount, AssetFile);
+        }
+
+        if (MeshHeader.HasJointIndices)
+        {
+            fwrite(Mesh->JointIndices, sizeof(i32) * 4, Mesh->VertexCount, AssetFile);
+        }
+
+        fwrite(Mesh->Indices, sizeof(u32), Mesh->IndexCount, AssetFile);
+    }
+
+    CurrentStreamPosition = ftell(AssetFile);
+    Header.MaterialsHeaderOffset = CurrentStreamPosition;
+
+    // Writing materials
+    model_asset_materials_header MaterialsHeader = {};
+    MaterialsHeader.MaterialCount = Asset->MaterialCount;
+    MaterialsHeader.MaterialsOffset = Header.MaterialsHeaderOffset + sizeof(model_asset_materials_header);
+
+    fwrite(&MaterialsHeader, sizeof(model_asset_materials_header), 1, AssetFile);
+
+    u32 TotalPrevPropertiesSize = 0;
+    for (u32 MaterialIndex = 0; MaterialIndex < MaterialsHeader.MaterialCount; ++MaterialIndex)
+    {
+        mesh_material *Material = Asset->Materials + MaterialIndex;
+
+        model_asset_material_header MaterialHeader = {};
+        MaterialHeader.PropertyCount = Material->PropertyCount;
+        MaterialHeader.PropertiesOffset = MaterialsHeader.MaterialsOffset + sizeof(model_asset_material_header) +
+            MaterialIndex * sizeof(model_asset_material_header) + TotalPrevPropertiesSize;
+
+        fwrite(&MaterialHeader, sizeof(model_asset_material_header), 1, AssetFile);
+
+        u32 PrevPropertiesSize = 0;
+        for (u32 MaterialPropertyIndex = 0; MaterialPropertyIndex < Material->PropertyCount; ++MaterialPropertyIndex)
+        {
+            material_property *MaterialProperty = Material->Properties + MaterialPropertyIndex;
+
+            model_asset_material_property_header MaterialPropertyHeader = {};
+            MaterialPropertyHeader.Type = MaterialProperty->Type;
+
+            switch (MaterialProperty->Type)
+            {
+            case MaterialProperty_Float_Shininess:
+            {
+                MaterialPropertyHeader.Value = MaterialProperty->Value;
+
+                fwrite(&MaterialPropertyHeader, sizeof(model_asset_material_property_header), 1, AssetFile);
+
+                PrevPropertiesSize += sizeof(model_asset_material_property_header);
+
+                break;
+            }
+            case MaterialProperty_Color_Ambient:
+            case MaterialProperty_Color_Diffuse:
+            case MaterialProperty_Color_Specular:
+            {
+                MaterialPropertyHeader.Color = MaterialProperty->Color;
+
+                fwrite(&MaterialPropertyHeader, sizeof(model_asset_material_property_header), 1, AssetFile);
+
+                PrevPropertiesSize += sizeof(model_asset_material_property_header);
+
+                break;
+            }
+            case MaterialProperty_Texture_Diffuse:
+            case MaterialProperty_Texture_Specular:
+            case MaterialProperty_Texture_Shininess:
+            case MaterialProperty_Texture_Normal:
+            {
+                MaterialPropertyHeader.Bitmap = MaterialProperty->Bitmap;
+                MaterialPropertyHeader.BitmapOffset = MaterialHeader.PropertiesOffset + sizeof(model_asset_material_property_header) + PrevPropertiesSize;
+
+                fwrite(&MaterialPropertyHeader, sizeof(model_asset_material_property_header), 1, AssetFile);
+
+                u32 BitmapSize = MaterialProperty->Bitmap.Width * MaterialProperty->Bitmap.Height * MaterialProperty->Bitmap.Channels;
+                fwrite(MaterialPropertyHeader.Bitmap.Pixels, sizeof(u8), BitmapSize, AssetFile);
+
+                PrevPropertiesSize += sizeof(model_asset_material_property_header) + BitmapSize;
+
+                break;
+            }
+            default:
+            {
+                Assert(!"Invalid material property");
+            }
+            }
+        }
+
+        TotalPrevPropertiesSize += PrevPropertiesSize;
+    }
+
+
+    CurrentStreamPosition = ftell(AssetFile);
+    Header.AnimationsHeaderOffset = CurrentStreamPosition;
+
+    // Writing animation clips
+    model_asset_animations_header AnimationsHeader = {};
+    AnimationsHeader.AnimationCount = Asset->AnimationCount;
+    AnimationsHeader.AnimationsOffset = Header.AnimationsHeaderOffset + sizeof(model_asset_animations_header);
+
+    fwrite(&AnimationsHeader, sizeof(model_asset_animations_header), 1, AssetFile);
+
+    for (u32 AnimationIndex = 0; AnimationIndex < Asset->AnimationCount; ++AnimationIndex)
+    {
+        animation_clip *Animation = Asset->Animations + AnimationIndex;
+
+        u64 AnimationHeaderOffset = ftell(AssetFile);
+
+        model_asset_animation_header AnimationHeader = {};
+        CopyString(Animation->Name, AnimationHeader.Name, MAX_ANIMATION_NAME_LENGTH);
+        AnimationHeader.Duration = Animation->Duration;
+        AnimationHeader.IsLooping = Animation->IsLooping;
+        AnimationHeader.InPlace = Animation->InPlace;
+        AnimationHeader.IsAdditive = Animation->IsAdditive;
+        AnimationHeader.Format = Animation->Format;
+        AnimationHeader.PoseSampleCount = Animation->PoseSampleCount;
+        AnimationHeader.TimelineCount = Animation->TimelineCount;
+
+        switch (Animation->Format)
+        {
+            case AnimationClipFormat_KeyFrames:
+            {
+                AnimationHeader.PoseSamplesOffset = AnimationHeaderOffset + sizeof(model_asset_animation_header);
+
+                fwrite(&AnimationHeader, sizeof(model_asset_animation_header), 1, AssetFile);
+
+                for (u32 AnimationPoseIndex = 0; AnimationPoseIndex < Animation->PoseSampleCount; ++AnimationPoseIndex)
+                {
+                    animation_sample *AnimationPose = Animation->PoseSamples + AnimationPoseIndex;
+
+                    model_asset_animation_sample_header AnimationSampleHeader = {};
+                    AnimationSampleHeader.JointIndex = AnimationPose->JointIndex;
+                    AnimationSampleHeader.KeyFrameCount = AnimationPose->KeyFrameCount;
+                    AnimationSampleHeader.KeyFramesOffset = ftell(AssetFile) + sizeof(model_asset_animation_sample_header);
+
+                    fwrite(&AnimationSampleHeader, sizeof(model_asset_animation_sample_header), 1, AssetFile);
+                    fwrite(AnimationPose->KeyFrames, sizeof(key_frame), AnimationPose->KeyFrameCount, AssetFile);
+                }
+
+                break;
+            }
+            case AnimationClipFormat_Compressed:
+            {
+                u64 TimelinesSize = 0;
+                for (u32 TimelineIndex = 0; TimelineIndex < Animation->TimelineCount; ++TimelineIndex)
+                {
+                    TimelinesSize += sizeof(model_asset_animation_timeline_header) + Animation->Timelines[TimelineIndex].KeyFrameCount * sizeof(f32);
+                }
+
+                AnimationHeader.TimelinesOffset = AnimationHeaderOffset + sizeof(model_asset_animation_header);
+                AnimationHeader.PoseSamplesOffset = AnimationHeader.TimelinesOffset + TimelinesSize;
+
+                fwrite(&AnimationHeader, sizeof(model_asset_animation_header), 1, AssetFile);
+
+                for (u32 TimelineIndex = 0; TimelineIndex < Animation->TimelineCount; ++TimelineIndex)
+                {
+                    animation_timeline *Timeline = Animation->Timelines + TimelineIndex;
+
+                    model_asset_animation_timeline_header TimelineHeader = {};
+                    TimelineHeader.KeyFrameCount = Timeline->KeyFrameCount;
+                    TimelineHeader.TimesOffset = ftell(AssetFile) + sizeof(model_asset_animation_timeline_header);
+
+                    fwrite(&TimelineHeader, sizeof(model_asset_animation_timeline_header), 1, AssetFile);
+                    fwrite(Timeline->Times, sizeof(f32), Timeline->KeyFrameCount, AssetFile);
+                }
+
+                for (u32 AnimationPoseIndex = 0; AnimationPoseIndex < Animation->PoseSampleCount; ++AnimationPoseIndex)
+                {
+                    compressed_animation_sample *AnimationPose = Animation->CompressedPoseSamples + AnimationPoseIndex;
+
+                    u32 RotationCount = AnimationPose->RotationStride ? AnimationPose->KeyFrameCount : 1;
+                    u32 TranslationCount = AnimationPose->TranslationStride ? AnimationPose->KeyFrameCount : 1;
+                    u32 ScaleCount = AnimationPose->ScaleStride ? AnimationPose->KeyFrameCount : 1;
+
+                    model_asset_compressed_animation_sample_header AnimationSampleHeader = {};
+                    AnimationSampleHeader.JointIndex = AnimationPose->JointIndex;
+                    AnimationSampleHeader.KeyFrameCount = AnimationPose->KeyFrameCount;
+                    AnimationSampleHeader.TimelineIndex = AnimationPose->TimelineIndex;
+                    AnimationSampleHeader.RotationStride = AnimationPose->RotationStride;
+                    AnimationSampleHeader.TranslationStride = AnimationPose->TranslationStride;
+                    AnimationSampleHeader.ScaleStride = AnimationPose->ScaleStride;
+                    AnimationSampleHeader.TranslationMin = AnimationPose->TranslationMin;
+                    AnimationSampleHeader.TranslationExtent = AnimationPose->TranslationExtent;
+                    AnimationSampleHeader.ScaleMin = AnimationPose->ScaleMin;
+                    AnimationSampleHeader.ScaleExtent = AnimationPose->ScaleExtent;
+                    AnimationSampleHeader.RotationsOffset = ftell(AssetFile) + sizeof(model_asset_compressed_animation_sample_header);
+                    AnimationSampleHeader.TranslationsOffset = AnimationSampleHeader.RotationsOffset + RotationCount * sizeof(compressed_quat);
+                    AnimationSampleHeader.ScalesOffset = AnimationSampleHeader.TranslationsOffset + TranslationCount * sizeof(quantized_vec3);
+
+                    fwrite(&AnimationSampleHeader, sizeof(model_asset_compressed_animation_sample_header), 1, AssetFile);
+                    fwrite(AnimationPose->Rotations, sizeof(compressed_quat), RotationCount, AssetFile);
+                    fwrite(AnimationPose->Translations, sizeof(quantized_vec3), TranslationCount, AssetFile);
+                    fwrite(AnimationPose->Scales, sizeof(quantized_vec3), ScaleCount, AssetFile);
+                }
+
+                break;
+            }
+            case AnimationClipFormat_Uniform:
+            {
+                u64 FrameSize = Animation->PoseSampleCount * AnimationFrameChannel_Count;
+
+                AnimationHeader.SampleRate = Animation->SampleRate;
+                AnimationHeader.FrameCount = Animation->FrameCount;
+                AnimationHeader.PoseSamplesOffset = AnimationHeaderOffset + sizeof(model_asset_animation_header);
+                AnimationHeader.FramesOffset = AnimationHeader.PoseSamplesOffset + Animation->PoseSampleCount * sizeof(u32);
+
+                fwrite(&AnimationHeader, sizeof(model_asset_animation_header), 1, AssetFile);
+                fwrite(Animation->FrameJointIndices, sizeof(u32), Animation->PoseSampleCount, AssetFile);
+                fwrite(Animation->Frames, sizeof(f32), Animation->FrameCount * FrameSize, AssetFile);
+
+                break;
+            }
+            default:
+            {
+                Assert(!"Invalid animation clip format");
+            }
+        }
+
+        if (Animation->RootMotion.KeyFrameCount > 0)
+        {
+            AnimationHeader.RootMotionKeyFrameCount = Animation->RootMotion.KeyFrameCount;
+            AnimationHeader.RootMotionOffset = ftell(AssetFile);
+
+            fwrite(Animation->RootMotion.KeyFrames, sizeof(root_motion_key), Animation->RootMotion.KeyFrameCount, AssetFile);
+
+            // Header is written before the pose samples, updating it now that the offset is known
+            u64 AnimationEndOffset = ftell(AssetFile);
+
+            fseek(AssetFile, (long)AnimationHeaderOffset, SEEK_SET);
+            fwrite(&AnimationHeader, sizeof(model_asset_animation_header), 1, AssetFile);
+            fseek(AssetFile, (long)AnimationEndOffset, SEEK_SET);
+        }
+    }
+
+    // Writing motion database
+    motion_database *MotionDatabase = &Asset->MotionDatabase;
+
+    if (MotionDatabase->FrameCount > 0)
+    {
+        CurrentStreamPosition = ftell(AssetFile);
+        Header.MotionDatabaseHeaderOffset = CurrentStreamPosition;
+
+        model_asset_motion_database_header MotionDatabaseHeader = {};
+        MotionDatabaseHeader.SampleRate = MotionDatabase->SampleRate;
+        MotionDatabaseHeader.MaxSpeed = MotionDatabase->MaxSpeed;
+
+        for (u32 PointIndex = 0; PointIndex < MOTION_TRAJECTORY_POINT_COUNT; ++PointIndex)
+        {
+            MotionDatabaseHeader.TrajectoryTimes[PointIndex] = MotionDatabase->TrajectoryTimes[PointIndex];
+        }
+
+        for (u32 FeatureIndex = 0; FeatureIndex < MOTION_FEATURE_STRIDE; ++FeatureIndex)
+        {
+            MotionDatabaseHeader.Offsets[FeatureIndex] = MotionDatabase->Offsets[FeatureIndex];
+            MotionDatabaseHeader.Scales[FeatureIndex] = MotionDatabase->Scales[FeatureIndex];
+        }
+
+        MotionDatabaseHeader.FrameCount = MotionDatabase->FrameCount;
+        MotionDatabaseHeader.ClipCount = MotionDatabase->ClipCount;
+        MotionDatabaseHeader.NodeCount = MotionDatabase->NodeCount;
+
+        MotionDatabaseHeader.FeaturesOffset = Header.MotionDatabaseHeaderOffset + sizeof(model_asset_motion_database_header);
+        MotionDatabaseHeader.FramesOffset = MotionDatabaseHeader.FeaturesOffset + MotionDatabase->FrameCount * MOTION_FEATURE_STRIDE * sizeof(f32);
+        MotionDatabaseHeader.ClipsOffset = MotionDatabaseHeader.FramesOffset + MotionDatabase->FrameCount * sizeof(motion_database_frame);
+        MotionDatabaseHeader.ClipFrameIndicesOffset = MotionDatabaseHeader.ClipsOffset + MotionDatabase->ClipCount * sizeof(motion_database_clip);
+        MotionDatabaseHeader.NodesOffset = MotionDatabaseHeader.ClipFrameIndicesOffset + MotionDatabase->FrameCount * sizeof(u32);
+
+        fwrite(&MotionDatabaseHeader, sizeof(model_asset_motion_database_header), 1, AssetFile);
+        fwrite(MotionDatabase->Features, sizeof(f32), MotionDatabase->FrameCount * MOTION_FEATURE_STRIDE, AssetFile);
+        fwrite(MotionDatabase->Frames, sizeof(motion_database_frame), MotionDatabase->FrameCount, AssetFile);
+        fwrite(MotionDatabase->Clips, sizeof(motion_database_clip), MotionDatabase->ClipCount, AssetFile);
+        fwrite(MotionDatabase->ClipFrameIndices, sizeof(u32), MotionDatabase->FrameCount, AssetFile);
+        fwrite(MotionDatabase->Nodes, sizeof(motion_kd_node), MotionDatabase->NodeCount, AssetFile);
+    }
+
+    // Writing animation texture
+    animation_texture *AnimationTexture = &Asset->AnimationTexture;
+
+    if (AnimationTexture->ClipCount > 0)
+    {
+        CurrentStreamPosition = ftell(AssetFile);
+        Header.AnimationTextureHeaderOffset = CurrentStreamPosition;
+
+        model_asset_animation_texture_header AnimationTextureHeader = {};
+        AnimationTextureHeader.Width = AnimationTexture->Width;
+        AnimationTextureHeader.Height = AnimationTexture->Height;
+        AnimationTextureHeader.ClipCount = AnimationTexture->ClipCount;
+
+        AnimationTextureHeader.TexelsOffset = Header.AnimationTextureHeaderOffset + sizeof(model_asset_animation_texture_header);
+        AnimationTextureHeader.ClipsOffset = AnimationTextureHeader.TexelsOffset + AnimationTexture->Width * AnimationTexture->Height * sizeof(vec4);
+
+        fwrite(&AnimationTextureHeader, sizeof(model_asset_animation_texture_header), 1, AssetFile);
+        fwrite(AnimationTexture->Texels, sizeof(vec4), AnimationTexture->Width * AnimationTexture->Height, AssetFile);
+        fwrite(AnimationTexture->Clips, sizeof(animation_texture_clip), AnimationTexture->ClipCount, AssetFile);
+    }
+
+    fseek(AssetFile, 0, SEEK_SET);
+    fwrite(&Header, sizeof(model_asset_header), 1, AssetFile);
+
+    fclose(AssetFile);
+}
+
+// Previous output is removed if the asset can't be exported, so it is not packed either
+internal b32
+ExportModelAsset(const char *FilePath, model_asset *Asset)
+{
+    b32 Result = IsSkeletonParentBeforeChild(&Asset->Skeleton);
+
+    if (Result)
+    {
+        WriteAssetFile(FilePath, Asset);
+    }
+    else
+    {
+        printf("Error: %s joints are not stored parent-before-child, asset not written\n", FilePath);
+        fs::remove(FilePath);
+    }
+
+    return Result;
+}
+
+// Flags of the whole Pelegrini import (model and clips)
+global u32 PelegriniImportFlags =
+    aiProcess_Triangulate |
+    aiProcess_FlipUVs |
+    aiProcess_GenNormals |
+    aiProcess_CalcTangentSpace |
+    aiProcess_JoinIdenticalVertices |
+    aiProcess_ValidateDataStructure |
+    aiProcess_LimitBoneWeights |
+    //aiProcess_GlobalScale |
+    aiProcess_RemoveRedundantMaterials |
+    aiProcess_FixInfacingNormals |
+    aiProcess_OptimizeGraph;
+
+#define PELEGRINI_MODEL_PATH "models\\pelegrini\\pelegrini.fbx"
+#define PELEGRINI_ASSET_PATH "assets\\pelegrini.asset"
+
+struct animation_clip_source
+{
+    const char *FilePath;
+    const char *AnimationName;
+    b32 IsLooping;
+    b32 InPlace;
+    b32 IsAdditive;
+};
+
+// todo: create config file
+global animation_clip_source PelegriniAnimationClips[] =
+{
+    { "models\\pelegrini\\animations\\idle (1).fbx", "Idle", true, false },
+    { "models\\pelegrini\\animations\\idle (2).fbx", "Idle_2", false, false },
+    { "models\\pelegrini\\animations\\idle (3).fbx", "Idle_3", false, false },
+    { "models\\pelegrini\\animations\\idle (4).fbx", "Idle_4", true, false },
+    { "models\\pelegrini\\animations\\walking.fbx", "Walking", true, true },
+    { "models\\pelegrini\\animations\\running.fbx", "Running", true, true },
+    { "models\\pelegrini\\animations\\samba.fbx", "Samba", true, false },
+    // Breathing on top of other clips
+    { "models\\pelegrini\\animations\\idle (1).fbx", "Idle_Additive", true, false, true }
+};
+
+struct animation_clip_job
+{
+    animation_clip_source *Source;
+    u32 Flags;
+    model_asset *Asset;
+    u32 AnimationIndex;
+};
+
+// Clips only read the skeleton and the bind pose of the asset, each job fills its own slot of Asset->Animations
+internal PLATFORM_WORK_QUEUE_CALLBACK(LoadAnimationClipAssetJob)
+{
+    animation_clip_job *Job = (animation_clip_job *)Data;
+    animation_clip_source *Source = Job->Source;
+
+    LoadAnimationClipAsset(Source->FilePath, Job->Flags, Job->Asset, Source->AnimationName, Source->IsLooping, Source->InPlace, Job->AnimationIndex, Source->IsAdditive);
+}
+
+internal void
+LoadPelegriniModel(model_asset *Asset, platform_api *Platform)
+{
+    u32 Flags = PelegriniImportFlags;
+
+    LoadModelAsset(PELEGRINI_MODEL_PATH, Asset, Flags);
+
+    animation_clip_job AnimationJobs[ArrayCount(PelegriniAnimationClips)];
+
+    Asset->AnimationCount = ArrayCount(AnimationJobs);
+    Asset->Animations = (animation_clip *)malloc(Asset->AnimationCount * sizeof(animation_clip));
+
+    for (u32 AnimationIndex = 0; AnimationIndex < Asset->AnimationCount; ++AnimationIndex)
+    {
+        animation_clip_job *Job = AnimationJobs + AnimationIndex;
+        Job->Source = PelegriniAnimationClips + AnimationIndex;
+        Job->Flags = Flags;
+        Job->Asset = Asset;
+        Job->AnimationIndex = AnimationIndex;
+
+        Platform->AddWorkQueueEntry(Platform->WorkQueue, LoadAnimationClipAssetJob, Job);
+    }
+
+    Platform->CompleteAllWork(Platform->WorkQueue);
+
+    // Locomotion only: the dance moves the character without root motion
+    const char *MotionClipNames[] = { "Idle", "Idle_2", "Idle_3", "Idle_4", "Walking", "Running" };
+    BuildMotionDatabase(Asset, MotionClipNames, ArrayCount(MotionClipNames));
+
+    // Crowd clips, root motion clips play in place
+    const char *CrowdClipNames[] = { "Idle", "Idle_4", "Walking", "Running", "Samba" };
+    BakeAnimationTexture(Asset, CrowdClipNames, ArrayCount(CrowdClipNames));
+}
+
+internal b32
+ProcessPelegriniModel(platform_api *Platform)
+{
+    model_asset Asset;
+    LoadPelegriniModel(&Asset, Platform);
+
+    for (u32 AnimationIndex = 0; AnimationIndex < Asset.AnimationCount; ++AnimationIndex)
+    {
+        animation_clip *Animation = Asset.Animations + AnimationIndex;
+
+#if 1
+        // Resampled clips are faster to sample, but sparse key frames would be bloated by resampling. 
+        // Key frames are already reduced at this point, so the reduction decides the format: 
+        // clips that reduce below the size of the resampled clip keep their reduced key frames, dense ones are resampled
+        animation_clip ResampledAnimation = ResampleAnimationClip(Animation, &Asset.Skeleton, ANIMATION_SAMPLE_RATE);
+
+        u64 KeyFramesSize = GetAnimationClipFileSize(Animation);
+        u64 ResampledSize = GetAnimationClipFileSize(&ResampledAnimation);
+
+        if (ResampledSize <= KeyFramesSize)
+        {
+            printf("%s: uniform (%llu bytes, reduced key frames %llu bytes)\n", Animation->Name, ResampledSize, KeyFramesSize);
+            *Animation = ResampledAnimation;
+        }
+        else
+#endif
+        {
+            printf("%s: reduced key frames (%llu bytes)\n", Animation->Name, GetAnimationClipFileSize(Animation));
+            *Animation = CompressAnimationClip(Animation);
+        }
+    }
+
+    b32 Result = ExportModelAsset(PELEGRINI_ASSET_PATH, &Asset);
+
+#if 1
+    if (Result)
+    {
+        model_asset TestAsset = {};
+        ReadAssetFile(PELEGRINI_ASSET_PATH, &TestAsset, &Asset);
+    }
+#endif
+
+    return Result;
+}
+
+global u32 AssetImportFlags =
+    aiProcess_Triangulate |
+    aiProcess_FlipUVs |
+    aiProcess_GenNormals |
+    aiProcess_CalcTangentSpace |
+    aiProcess_JoinIdenticalVertices |
+    aiProcess_ValidateDataStructure |
+    aiProcess_OptimizeMeshes |
+    aiProcess_LimitBoneWeights |
+    //aiProcess_GlobalScale |
+    aiProcess_RemoveRedundantMaterials |
+    aiProcess_FixInfacingNormals |
+    aiProcess_OptimizeGraph;
+
+internal b32
+ProcessAsset(const char *FilePath, const char *OutputPath)
+{
+    model_asset Asset;
+    LoadModelAsset(FilePath, &Asset, AssetImportFlags);
+    // todo: check if has animations and process them as well
+
+
+
+    b32 Result = ExportModelAsset(OutputPath, &Asset);
+    return Result;
+}
+
+struct asset_build_job
+{
+    char FilePath[64];
+    char OutputPath[64];
+    b32 IsBuilt;
+};
+
+// Source files are independent and every job writes its own asset file, so the output does not depend on the order
+internal PLATFORM_WORK_QUEUE_CALLBACK(ProcessAssetJob)
+{
+    asset_build_job *Job = (asset_build_job *)Data;
+
+    Job->IsBuilt = ProcessAsset(Job->FilePath, Job->OutputPath);
+}
+
+// Bump when processing changes the output without a change of MODEL_ASSET_VERSION
+#define ASSET_BUILDER_VERSION 1
+
+#define BUILD_CACHE_PATH "assets\\build.cache"
+#define BUILD_CACHE_MAGIC_VALUE 0x48435542
+#define MAX_BUILD_CACHE_PATH_LENGTH 128
+#define MAX_BUILD_CACHE_DEPENDENCY_COUNT 16
+
+struct build_cache_header
+{
+    u32 MagicValue;
+    u32 BuilderVersion;
+    u32 AssetVersion;
+    u32 EntryCount;
+};
+
+struct build_cache_dependency
+{
+    char FilePath[MAX_BUILD_CACHE_PATH_LENGTH];
+    u64 ContentHash;
+};
+
+// Output is reused while the import flags and every source file it was built from are unchanged
+struct build_cache_entry
+{
+    char OutputPath[MAX_BUILD_CACHE_PATH_LENGTH];
+    u32 ImportFlags;
+
+    u32 DependencyCount;
+    build_cache_dependency Dependencies[MAX_BUILD_CACHE_DEPENDENCY_COUNT];
+};
+
+struct build_cache
+{
+    // Cache of another builder version is ignored
+    b32 IsVersionChanged;
+    dynamic_array<build_cache_entry> Entries;
+};
+
+// 64-bit FNV-1a
+internal u64
+HashFileContents(const char *FilePath)
+{
+    u64 Result = 0xcbf29ce484222325;
+
+    if (fs::exists(FilePath) && fs::file_size(FilePath) > 0)
+    {
+        mapped_file File = BuilderMapFile((char *)FilePath);
+        u8 *Contents = (u8 *)File.Contents;
+
+        for (umm ByteIndex = 0; ByteIndex < File.Size; ++ByteIndex)
+        {
+            Result ^= Contents[ByteIndex];
+            Result *= 0x100000001b3;
+        }
+
+        BuilderUnmapFile(&File);
+    }
+
+    return Result;
+}
+
+internal void
+LoadBuildCache(const char *CachePath, build_cache *Cache)
+{
+    Cache->IsVersionChanged = false;
+    Cache->Entries.clear();
+
+    FILE *CacheFile = fopen(CachePath, "rb");
+
+    if (CacheFile)
+    {
+        build_cache_header Header = {};
+        fread(&Header, sizeof(build_cache_header), 1, CacheFile);
+
+        if (
+            Header.MagicValue == BUILD_CACHE_MAGIC_VALUE &&
+            Header.BuilderVersion == ASSET_BUILDER_VERSION &&
+            Header.AssetVersion == MODEL_ASSET_VERSION
+        )
+        {
+            Cache->Entries.resize(Header.EntryCount);
+
+            if (fread(Cache->Entries.data(), sizeof(build_cache_entry), Header.EntryCount, CacheFile) != Header.EntryCount)
+            {
+                Cache->Entries.clear();
+            }
+        }
+        else
+        {
+            Cache->IsVersionChanged = true;
+        }
+
+        fclose(CacheFile);
+    }
+}
+
+internal void
+WriteBuildCache(const char *CachePath, dynamic_array<build_cache_entry> &Entries)
+{
+    FILE *CacheFile = fopen(CachePath, "wb");
+    Assert(CacheFile);
+
+    build_cache_header Header = {};
+    Header.MagicValue = BUILD_CACHE_MAGIC_VALUE;
+    Header.BuilderVersion = ASSET_BUILDER_VERSION;
+    Header.AssetVersion = MODEL_ASSET_VERSION;
+    Header.EntryCount = (u32)Entries.size();
+
+    fwrite(&Header, sizeof(build_cache_header), 1, CacheFile);
+    fwrite(Entries.data(), sizeof(build_cache_entry), Entries.size(), CacheFile);
+
+    fclose(CacheFile);
+}
+
+internal build_cache_entry
+CreateBuildCacheEntry(const char *OutputPath, u32 ImportFlags, const char **FilePaths, u32 FilePathCount)
+{
+    Assert(FilePathCount <= MAX_BUILD_CACHE_DEPENDENCY_COUNT);
+
+    // Zeroed, so that entries are compared and written with deterministic padding
+    build_cache_entry Result = {};
+    CopyString(OutputPath, Result.OutputPath, MAX_BUILD_CACHE_PATH_LENGTH);
+    Result.ImportFlags = ImportFlags;
+    Result.DependencyCount = FilePathCount;
+
+    for (u32 DependencyIndex = 0; DependencyIndex < FilePathCount; ++DependencyIndex)
+    {
+        build_cache_dependency *Dependency = Result.Dependencies + DependencyIndex;
+
+        CopyString(FilePaths[DependencyIndex], Dependency->FilePath, MAX_BUILD_CACHE_PATH_LENGTH);
+        Dependency->ContentHash = HashFileContents(FilePaths[DependencyIndex]);
+    }
+
+    return Result;
+}
+
+internal build_cache_entry *
+FindBuildCacheEntry(build_cache *Cache, const char *OutputPath)
+{
+    build_cache_entry *Result = 0;
+
+    for (u32 EntryIndex = 0; EntryIndex < Cache->Entries.size(); ++EntryIndex)
+    {
+        if (StringEquals(Cache->Entries[EntryIndex].OutputPath, OutputPath))
+        {
+            Result = Cache->Entries.data() + EntryIndex;
+            break;
+        }
+    }
+
+    return Result;
+}
+
+enum asset_build_status
+{
+    AssetBuildStatus_UpToDate,
+    AssetBuildStatus_Outdated,
+    // Can't be built, previous output (if any) is kept
+    AssetBuildStatus_MissingSource
+};
+
+// Prints the reason when the output has to be rebuilt or can't be built
+internal asset_build_status
+GetAssetBuildStatus(build_cache *Cache, build_cache_entry *Entry)
+{
+    build_cache_dependency *MissingDependency = 0;
+
+    for (u32 DependencyIndex = 0; DependencyIndex < Entry->DependencyCount; ++DependencyIndex)
+    {
+        if (!fs::exists(Entry->Dependencies[DependencyIndex].FilePath))
         {
-            Mesh.Normals = (vec3 *)((u8 *)Buffer + MeshHeader->VerticesOffset + VerticesOffset);
-            VerticesOffset += sizeof(vec3) * MeshHeader->VertexCount;
+            MissingDependency = Entry->Dependencies + DependencyIndex;
+            break;
         }
+    }
 
-        if (MeshHeader->HasTangents)
+    char Reason[256] = "";
+
+    build_cache_entry *CachedEntry = FindBuildCacheEntry(Cache, Entry->OutputPath);
+
+    if (Cache->IsVersionChanged)
+    {
+        FormatString(Reason, ArrayCount(Reason), "builder version changed");
+    }
+    else if (!CachedEntry)
+    {
+        FormatString(Reason, ArrayCount(Reason), "not in the build cache");
+    }
+    else if (!fs::exists(Entry->OutputPath))
+    {
+        FormatString(Reason, ArrayCount(Reason), "output is missing");
+    }
+    else if (CachedEntry->ImportFlags != Entry->ImportFlags)
+    {
+        FormatString(Reason, ArrayCount(Reason), "import flags changed");
+    }
+    else if (CachedEntry->DependencyCount != Entry->DependencyCount)
+    {
+        FormatString(Reason, ArrayCount(Reason), "dependency list changed");
+    }
+    else
+    {
+        for (u32 DependencyIndex = 0; DependencyIndex < Entry->DependencyCount; ++DependencyIndex)
         {
-            Mesh.Tangents = (vec3 *)((u8 *)Buffer + MeshHeader->VerticesOffset + VerticesOffset);
-            VerticesOffset += sizeof(vec3) * MeshHeader->VertexCount;
+            build_cache_dependency *CachedDependency = CachedEntry->Dependencies + DependencyIndex;
+            build_cache_dependency *Dependency = Entry->Dependencies + DependencyIndex;
+
+            if (!StringEquals(CachedDependency->FilePath, Dependency->FilePath))
+            {
+                FormatString(Reason, ArrayCount(Reason), "dependency list changed");
+                break;
+            }
+
+            if (CachedDependency->ContentHash != Dependency->ContentHash)
+            {
+                FormatString(Reason, ArrayCount(Reason), "%s changed", Dependency->FilePath);
+                break;
+            }
         }
+    }
 
-        if (MeshHeader->HasBitangets)
+    asset_build_status Result = AssetBuildStatus_UpToDate;
+
+    if (MissingDependency)
+    {
+        printf("Skipping %s: %s is missing\n", Entry->OutputPath, MissingDependency->FilePath);
+        Result = AssetBuildStatus_MissingSource;
+    }
+    else if (!StringEquals(Reason, ""))
+    {
+        printf("Rebuilding %s: %s\n", Entry->OutputPath, Reason);
+        Result = AssetBuildStatus_Outdated;
+    }
+
+    return Result;
+}
+
+inline u64
+AlignAssetPackOffset(u64 Offset, u64 Alignment)
+{
+    u64 Result = (Offset + Alignment - 1) / Alignment * Alignment;
+    return Result;
+}
+
+// Packs every .asset file of the directory, entries are named by file stem (e.g. "pelegrini")
+internal void
+WriteAssetPack(const char *PackPath, const char *AssetDirectory)
+{
+    dynamic_array<fs::path> AssetPaths;
+
+    for (const fs::directory_entry &Entry : fs::directory_iterator(AssetDirectory))
+    {
+        if (Entry.is_regular_file() && Entry.path().extension() == ".asset")
         {
-            Mesh.Bitangents = (vec3 *)((u8 *)Buffer + MeshHeader->VerticesOffset + VerticesOffset);
-            VerticesOffset += sizeof(vec3) * MeshHeader->VertexCount;
+            // Stale outputs of older builders are not shipped
+            model_asset_header Header = {};
+
+            FILE *AssetFile = fopen(Entry.path().generic_string().c_str(), "rb");
+
+            if (AssetFile)
+            {
+                fread(&Header, sizeof(model_asset_header), 1, AssetFile);
+                fclose(AssetFile);
+            }
+
+            if (Header.MagicValue == MODEL_ASSET_MAGIC_VALUE && Header.Version == MODEL_ASSET_VERSION)
+            {
+                AssetPaths.push_back(Entry.path());
+            }
+            else
+            {
+                printf("Warning: %s is not a version %d model asset, skipped\n", Entry.path().generic_string().c_str(), MODEL_ASSET_VERSION);
+            }
+        }
+    }
+
+    // Directory iteration order is unspecified
+    std::sort(AssetPaths.begin(), AssetPaths.end());
+
+    u32 EntryCount = (u32)AssetPaths.size();
+
+    u32 NameIndexSize = 1;
+    while (NameIndexSize < EntryCount * 2)
+    {
+        NameIndexSize *= 2;
+    }
+
+    asset_pack_header Header = {};
+    Header.MagicValue = ASSET_PACK_MAGIC_VALUE;
+    Header.Version = ASSET_PACK_VERSION;
+    Header.EntryCount = EntryCount;
+    Header.NameIndexSize = NameIndexSize;
+    Header.EntriesOffset = AlignAssetPackOffset(sizeof(asset_pack_header), 64);
+    Header.NameIndexOffset = AlignAssetPackOffset(Header.EntriesOffset + EntryCount * sizeof(asset_pack_entry), 64);
+
+    dynamic_array<asset_pack_entry> Entries(EntryCount);
+    dynamic_array<u32> NameIndex(NameIndexSize, U32_MAX);
+
+    u64 Offset = Header.NameIndexOffset + NameIndexSize * sizeof(u32);
+
+    for (u32 EntryIndex = 0; EntryIndex < EntryCount; ++EntryIndex)
+    {
+        asset_pack_entry *Entry = Entries.data() + EntryIndex;
+        string Name = AssetPaths[EntryIndex].stem().generic_string();
+
+        Assert(Name.size() < MAX_ASSET_PACK_NAME_LENGTH);
+
+        *Entry = {};
+        CopyString(Name.c_str(), Entry->Name, MAX_ASSET_PACK_NAME_LENGTH);
+        Entry->NameHash = Hash(Entry->Name);
+        Entry->Offset = AlignAssetPackOffset(Offset, ASSET_PACK_ALIGNMENT);
+        Entry->Size = fs::file_size(AssetPaths[EntryIndex]);
+
+        Offset = Entry->Offset + Entry->Size;
+
+        u32 SlotMask = NameIndexSize - 1;
+        u32 Slot = Entry->NameHash & SlotMask;
+
+        while (NameIndex[Slot] != U32_MAX)
+        {
+            Assert(!StringEquals(Entries[NameIndex[Slot]].Name, Entry->Name));
+            Slot = (Slot + 1) & SlotMask;
+        }
+
+        NameIndex[Slot] = EntryIndex;
+    }
+
+    FILE *PackFile = fopen(PackPath, "wb");
+    Assert(PackFile);
+
+    // Gaps between the aligned parts are zeroed
+    dynamic_array<u8> Contents(Offset, 0);
+
+    memcpy(Contents.data(), &Header, sizeof(asset_pack_header));
+    memcpy(Contents.data() + Header.EntriesOffset, Entries.data(), EntryCount * sizeof(asset_pack_entry));
+    memcpy(Contents.data() + Header.NameIndexOffset, NameIndex.data(), NameIndexSize * sizeof(u32));
+
+    for (u32 EntryIndex = 0; EntryIndex < EntryCount; ++EntryIndex)
+    {
+        asset_pack_entry *Entry = Entries.data() + EntryIndex;
+
+        FILE *AssetFile = fopen(AssetPaths[EntryIndex].generic_string().c_str(), "rb");
+        Assert(AssetFile);
+
+        fread(Contents.data() + Entry->Offset, 1, Entry->Size, AssetFile);
+        fclose(AssetFile);
+    }
+
+    fwrite(Contents.data(), 1, Contents.size(), PackFile);
+    fclose(PackFile);
+
+    printf("Asset pack %s: %d assets, %.2f MB\n", PackPath, EntryCount, Offset / (f64)Megabytes(1));
+}
+
+// Benchmarks
+
+inline f64
+GetWallClockMilliseconds()
+{
+    f64 Result = std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+    return Result;
+}
+
+// Old key frame search (linear scan from the first key frame), kept as a reference
+internal void
+FindClosestKeyFramesLinear(animation_sample *PoseSample, f32 CurrentTime, key_frame **Prev, key_frame **Next)
+{
+    if (PoseSample->KeyFrameCount > 1)
+    {
+        b32 Found = false;
+
+        for (u32 KeyFrameIndex = 0; KeyFrameIndex < PoseSample->KeyFrameCount - 1; ++KeyFrameIndex)
+        {
+            key_frame *CurrentKeyFrame = PoseSample->KeyFrames + KeyFrameIndex;
+            key_frame *NextKeyFrame = PoseSample->KeyFrames + KeyFrameIndex + 1;
+
+            if (CurrentKeyFrame->Time <= CurrentTime && CurrentTime < NextKeyFrame->Time)
+            {
+                Found = true;
+
+                *Prev = CurrentKeyFrame;
+                *Next = NextKeyFrame;
+
+                break;
+            }
+        }
+
+        if (!Found)
+        {
+            *Prev = Last(PoseSample->KeyFrames, PoseSample->KeyFrameCount);
+            *Next = First(PoseSample->KeyFrames);
+        }
+    }
+    else
+    {
+        *Prev = First(PoseSample->KeyFrames);
+        *Next = First(PoseSample->KeyFrames);
+    }
+}
+
+internal void
+BenchmarkKeyFrameSearch(model_asset *Asset, memory_arena *Arena)
+{
+    f32 FrameTime = 1.f / 60.f;
+    u32 IterationCount = 100;
+
+    printf("Key frame search (%d loops of each clip at 60 fps):\n", IterationCount);
+
+    for (u32 AnimationIndex = 0; AnimationIndex < Asset->AnimationCount; ++AnimationIndex)
+    {
+        animation_clip *Clip = Asset->Animations + AnimationIndex;
+
+        scoped_memory ScopedMemory(Arena);
+        animation_state AnimationState = CreateAnimationState(Clip, ScopedMemory.Arena);
+
+        u32 KeyFrameCount = 0;
+        for (u32 PoseSampleIndex = 0; PoseSampleIndex < Clip->PoseSampleCount; ++PoseSampleIndex)
+        {
+            KeyFrameCount += Clip->PoseSamples[PoseSampleIndex].KeyFrameCount;
+        }
+
+        u32 StepCount = (u32)(Clip->Duration / FrameTime) + 1;
+
+        // Both searches have to agree
+        for (u32 Step = 0; Step < StepCount; ++Step)
+        {
+            f32 Time = Step * FrameTime;
+
+            for (u32 PoseSampleIndex = 0; PoseSampleIndex < Clip->PoseSampleCount; ++PoseSampleIndex)
+            {
+                animation_sample *PoseSample = Clip->PoseSamples + PoseSampleIndex;
+
+                key_frame *LinearPrev;
+                key_frame *LinearNext;
+                FindClosestKeyFramesLinear(PoseSample, Time, &LinearPrev, &LinearNext);
+
+                key_frame *CursorPrev;
+                key_frame *CursorNext;
+                FindClosestKeyFrames(PoseSample, Time, AnimationState.KeyFrameCursors + PoseSampleIndex, &CursorPrev, &CursorNext);
+
+                Assert(LinearPrev == CursorPrev && LinearNext == CursorNext);
+            }
+        }
+
+        // Prevents the compiler from throwing the searches away
+        f32 Checksum = 0.f;
+
+        f64 LinearStart = GetWallClockMilliseconds();
+        for (u32 Iteration = 0; Iteration < IterationCount; ++Iteration)
+        {
+            for (u32 Step = 0; Step < StepCount; ++Step)
+            {
+                f32 Time = Step * FrameTime;
+
+                for (u32 PoseSampleIndex = 0; PoseSampleIndex < Clip->PoseSampleCount; ++PoseSampleIndex)
+                {
+                    key_frame *Prev;
+                    key_frame *Next;
+                    FindClosestKeyFramesLinear(Clip->PoseSamples + PoseSampleIndex, Time, &Prev, &Next);
+
+                    Checksum += Prev->Time;
+                }
+            }
+        }
+        f64 LinearElapsed = GetWallClockMilliseconds() - LinearStart;
+
+        f64 CursorStart = GetWallClockMilliseconds();
+        for (u32 Iteration = 0; Iteration < IterationCount; ++Iteration)
+        {
+            for (u32 Step = 0; Step < StepCount; ++Step)
+            {
+                f32 Time = Step * FrameTime;
+
+                for (u32 PoseSampleIndex = 0; PoseSampleIndex < Clip->PoseSampleCount; ++PoseSampleIndex)
+                {
+                    key_frame *Prev;
+                    key_frame *Next;
+                    FindClosestKeyFrames(Clip->PoseSamples + PoseSampleIndex, Time, AnimationState.KeyFrameCursors + PoseSampleIndex, &Prev, &Next);
+
+                    Checksum += Prev->Time;
+                }
+            }
+        }
+        f64 CursorElapsed = GetWallClockMilliseconds() - CursorStart;
+
+        f64 PoseCount = (f64)IterationCount * StepCount;
+
+        printf("  %-8s %7d keys: linear %8.4f ms/pose, cursor %8.4f ms/pose (x%.1f) [%f]\n",
+            Clip->Name, KeyFrameCount, LinearElapsed / PoseCount, CursorElapsed / PoseCount, LinearElapsed / CursorElapsed, Checksum);
+    }
+}
+
+internal f64
+BenchmarkSkeletonPoseSampling(model_asset *Asset, animation_clip *Animation, u32 IterationCount, f32 FrameTime, skeleton_pose *Pose, memory_arena *Arena)
+{
+    scoped_memory ScopedMemory(Arena);
+    animation_state AnimationState = CreateAnimationState(Animation, ScopedMemory.Arena);
+
+    u32 StepCount = (u32)(Animation->Duration / FrameTime) + 1;
+
+    f64 Start = GetWallClockMilliseconds();
+    for (u32 Iteration = 0; Iteration < IterationCount; ++Iteration)
+    {
+        for (u32 Step = 0; Step < StepCount; ++Step)
+        {
+            AnimationState.Time = Step * FrameTime;
+            AnimateSkeletonPose(Pose, &AnimationState);
+        }
+    }
+    f64 Result = (GetWallClockMilliseconds() - Start) / ((f64)IterationCount * StepCount);
+
+    return Result;
+}
+
+internal void
+BenchmarkAnimationClipFormats(model_asset *Asset, memory_arena *Arena)
+{
+    f32 FrameTime = 1.f / 60.f;
+    u32 IterationCount = 20;
+
+    skeleton_pose Pose = {};
+    Pose.Skeleton = &Asset->Skeleton;
+    Pose.LocalJointPoses = PushArray(Arena, Asset->Skeleton.JointCount, joint_pose);
+
+    skeleton_pose FormatPose = {};
+    FormatPose.Skeleton = &Asset->Skeleton;
+    FormatPose.LocalJointPoses = PushArray(Arena, Asset->Skeleton.JointCount, joint_pose);
+
+    const char *FormatNames[] = { "key frames", "compressed", "uniform" };
+
+    printf("Animation clip formats (size, max error against key frames, sampling time):\n");
+
+    u64 TotalSizes[ArrayCount(FormatNames)] = {};
+
+    for (u32 AnimationIndex = 0; AnimationIndex < Asset->AnimationCount; ++AnimationIndex)
+    {
+        animation_clip *Animation = Asset->Animations + AnimationIndex;
+
+        animation_clip Formats[ArrayCount(FormatNames)] =
+        {
+            *Animation,
+            CompressAnimationClip(Animation),
+            ResampleAnimationClip(Animation, &Asset->Skeleton, ANIMATION_SAMPLE_RATE)
+        };
+
+        printf("  %s:\n", Animation->Name);
+
+        for (u32 FormatIndex = 0; FormatIndex < ArrayCount(Formats); ++FormatIndex)
+        {
+            animation_clip *FormatAnimation = Formats + FormatIndex;
+
+            u64 Size = GetAnimationClipFileSize(FormatAnimation);
+            TotalSizes[FormatIndex] += Size;
+
+            // Error at every frame
+            f32 MaxRotationError = 0.f;
+            f32 MaxTranslationError = 0.f;
+            {
+                scoped_memory ScopedMemory(Arena);
+
+                animation_state AnimationState = CreateAnimationState(Animation, ScopedMemory.Arena);
+                animation_state FormatAnimationState = CreateAnimationState(FormatAnimation, ScopedMemory.Arena);
+
+                for (f32 Time = 0.f; Time < Animation->Duration; Time += FrameTime)
+                {
+                    AnimationState.Time = Time;
+                    FormatAnimationState.Time = Time;
+
+                    AnimateSkeletonPose(&Pose, &AnimationState);
+                    AnimateSkeletonPose(&FormatPose, &FormatAnimationState);
+
+                    for (u32 JointIndex = 0; JointIndex < Asset->Skeleton.JointCount; ++JointIndex)
+                    {
+                        joint_pose *A = Pose.LocalJointPoses + JointIndex;
+                        joint_pose *B = FormatPose.LocalJointPoses + JointIndex;
+
+                        MaxRotationError = Max(MaxRotationError, 1.f - Abs(Dot(Normalize(A->Rotation), Normalize(B->Rotation))));
+                        MaxTranslationError = Max(MaxTranslationError, Magnitude(A->Translation - B->Translation));
+                    }
+                }
+            }
+
+            f64 SamplingTime = BenchmarkSkeletonPoseSampling(Asset, FormatAnimation, IterationCount, FrameTime, &FormatPose, Arena);
+
+            printf("    %-10s %9llu bytes, error: rotation %f, translation %f; %8.4f ms/pose\n",
+                FormatNames[FormatIndex], Size, MaxRotationError, MaxTranslationError, SamplingTime);
+        }
+    }
+
+    for (u32 FormatIndex = 0; FormatIndex < ArrayCount(FormatNames); ++FormatIndex)
+    {
+        printf("  Total %-10s %9llu bytes\n", FormatNames[FormatIndex], TotalSizes[FormatIndex]);
+    }
+}
+
+// Reference: walks the parent chain for every joint
+internal mat4
+CalculateGlobalJointPoseFromParentChain(joint *CurrentJoint, joint_pose *CurrentJointPose, skeleton_pose *Pose)
+{
+    mat4 Result = mat4(1.f);
+
+    while (true)
+    {
+        mat4 Global = Transform(*CurrentJointPose);
+        Result = Global * Result;
+
+        if (CurrentJoint->ParentIndex == -1)
+        {
+            break;
         }
 
-        if (MeshHeader->HasTextureCoords)
+        CurrentJointPose = Pose->LocalJointPoses + CurrentJoint->ParentIndex;
+        CurrentJoint = Pose->Skeleton->Joints + CurrentJoint->ParentIndex;
+    }
+
+    return Result;
+}
+
+internal void
+BenchmarkGlobalJointPoses(model_asset *Asset, memory_arena *Arena)
+{
+    scoped_memory ScopedMemory(Arena);
+
+    skeleton *Skeleton = &Asset->Skeleton;
+
+    skeleton_pose Pose = {};
+    Pose.Skeleton = Skeleton;
+    Pose.LocalJointPoses = PushArray(ScopedMemory.Arena, Skeleton->JointCount, joint_pose);
+    Pose.GlobalJointPoses = PushArray(ScopedMemory.Arena, Skeleton->JointCount, mat4);
+
+    mat4 *ReferenceGlobalJointPoses = PushArray(ScopedMemory.Arena, Skeleton->JointCount, mat4);
+
+    // Some moving pose to make sure the result doesn't depend on bind pose specifics
+    animation_clip *Animation = Asset->Animations;
+    animation_state AnimationState = CreateAnimationState(Animation, ScopedMemory.Arena);
+    AnimationState.Time = Animation->Duration * 0.5f;
+    AnimateSkeletonPose(&Pose, &AnimationState);
+
+    for (u32 JointIndex = 0; JointIndex < Skeleton->JointCount; ++JointIndex)
+    {
+        joint *Joint = Skeleton->Joints + JointIndex;
+        ReferenceGlobalJointPoses[JointIndex] = CalculateGlobalJointPoseFromParentChain(Joint, Pose.LocalJointPoses + JointIndex, &Pose);
+    }
+
+    CalculateGlobalJointPoses(&Pose);
+
+    f32 MaxError = 0.f;
+    for (u32 JointIndex = 0; JointIndex < Skeleton->JointCount; ++JointIndex)
+    {
+        mat4 *A = ReferenceGlobalJointPoses + JointIndex;
+        mat4 *B = Pose.GlobalJointPoses + JointIndex;
+
+        for (u32 RowIndex = 0; RowIndex < 4; ++RowIndex)
         {
-            Mesh.TextureCoords = (vec2 *)((u8 *)Buffer + MeshHeader->VerticesOffset + VerticesOffset);
-            VerticesOffset += sizeof(vec2) * MeshHeader->VertexCount;
+            for (u32 ColumnIndex = 0; ColumnIndex < 4; ++ColumnIndex)
+            {
+                MaxError = Max(MaxError, Abs(A->Elements[RowIndex][ColumnIndex] - B->Elements[RowIndex][ColumnIndex]));
+            }
         }
+    }
 
-        if (MeshHeader->HasWeights)
-        {
-            Mesh.Weights = (vec4 *)((u8 *)Buffer + MeshHeader->VerticesOffset + VerticesOffset);
-            VerticesOffset += sizeof(vec4) * MeshHeader->VertexCount;
-        }
+    Assert(MaxError < 0.001f);
 
-        if (MeshHeader->HasJointIndices)
+    u32 IterationCount = 10000;
+
+    f64 ParentChainStart = GetWallClockMilliseconds();
+    for (u32 Iteration = 0; Iteration < IterationCount; ++Iteration)
+    {
+        for (u32 JointIndex = 0; JointIndex < Skeleton->JointCount; ++JointIndex)
         {
-            Mesh.JointIndices = (i32 *)((u8 *)Buffer + MeshHeader->VerticesOffset + VerticesOffset);
-            VerticesOffset += sizeof(i32) * 4 * MeshHeader->VertexCount;
+            joint *Joint = Skeleton->Joints + JointIndex;
+            Pose.GlobalJointPoses[JointIndex] = CalculateGlobalJointPoseFromParentChain(Joint, Pose.LocalJointPoses + JointIndex, &Pose);
         }
+    }
+    f64 ParentChainElapsed = GetWallClockMilliseconds() - ParentChainStart;
 
-        Mesh.Indices = (u32 *)((u8 *)Buffer + MeshHeader->IndicesOffset);
-
-        NextMeshHeaderOffset += sizeof(model_asset_mesh_header) + VerticesOffset + MeshHeader->IndexCount * sizeof(u32);
+    f64 SinglePassStart = GetWallClockMilliseconds();
+    for (u32 Iteration = 0; Iteration < IterationCount; ++Iteration)
+    {
+        CalculateGlobalJointPoses(&Pose);
     }
+    f64 SinglePassElapsed = GetWallClockMilliseconds() - SinglePassStart;
 
-    model_asset_materials_header *MaterialsHeader = (model_asset_materials_header *)((u8 *)Buffer + Header->MaterialsHeaderOffset);
+    printf("Global joint poses (%u joints, max difference %f):\n", Skeleton->JointCount, MaxError);
+    printf("  parent chain: %8.4f us/pose\n", ParentChainElapsed * 1000.0 / IterationCount);
+    printf("  single pass:  %8.4f us/pose (%.2fx)\n", SinglePassElapsed * 1000.0 / IterationCount, ParentChainElapsed / SinglePassElapsed);
+}
 
-    u64 NextMaterialHeaderOffset = 0;
-    for (u32 MaterialIndex = 0; MaterialIndex < MaterialsHeader->MaterialCount; ++MaterialIndex)
-    {
-        model_asset_material_header *MaterialHeader = (model_asset_material_header *)((u8 *)Buffer +
-            MaterialsHeader->MaterialsOffset + NextMaterialHeaderOffset);
-        mesh_material Material = {};
-        Material.PropertyCount = MaterialHeader->PropertyCount;
-        Material.Properties = (material_property *)((u8 *)Buffer + MaterialHeader->PropertiesOffset);
+internal void
+BenchmarkSkinningPalette(model_asset *Asset, memory_arena *Arena)
+{
+    scoped_memory ScopedMemory(Arena);
 
-        u64 NextMaterialPropertyHeaderOffset = 0;
-        for (u32 MaterialPropertyIndex = 0; MaterialPropertyIndex < MaterialHeader->PropertyCount; ++MaterialPropertyIndex)
-        {
-            model_asset_material_property_header *MaterialPropertyHeader = (model_asset_material_property_header *)
-                ((u8 *)Buffer + MaterialHeader->PropertiesOffset + NextMaterialPropertyHeaderOffset);
+    skeleton *Skeleton = &Asset->Skeleton;
 
-            material_property *MaterialProperty = Material.Properties + MaterialPropertyIndex;
+    skeleton_pose Pose = {};
+    Pose.Skeleton = Skeleton;
+    Pose.LocalJointPoses = PushArray(ScopedMemory.Arena, Skeleton->JointCount, joint_pose);
+    Pose.GlobalJointPoses = PushArray(ScopedMemory.Arena, Skeleton->JointCount, mat4);
 
-            MaterialProperty->Type = MaterialPropertyHeader->Type;
-            switch (MaterialProperty->Type)
-            {
-                case MaterialProperty_Float_Shininess:
-                {
-                    MaterialProperty->Value = MaterialPropertyHeader->Value;
+    mat4 *ReferencePalette = PushArray(ScopedMemory.Arena, Skeleton->JointCount, mat4);
+    mat4 *Palette = PushArray(ScopedMemory.Arena, Skeleton->JointCount, mat4);
 
-                    NextMaterialPropertyHeaderOffset += sizeof(model_asset_material_property_header);
+    animation_clip *Animation = Asset->Animations;
+    animation_state AnimationState = CreateAnimationState(Animation, ScopedMemory.Arena);
+    AnimationState.Time = Animation->Duration * 0.5f;
+    AnimateSkeletonPose(&Pose, &AnimationState);
+    CalculateGlobalJointPoses(&Pose);
 
-                    break;
-                }
-                case MaterialProperty_Color_Ambient:
-                case MaterialProperty_Color_Diffuse:
-                case MaterialProperty_Color_Specular:
-                {
-                    MaterialProperty->Color = MaterialPropertyHeader->Color;
+    u32 IterationCount = 10000;
 
-                    NextMaterialPropertyHeaderOffset += sizeof(model_asset_material_property_header);
+    f64 ScalarStart = GetWallClockMilliseconds();
+    for (u32 Iteration = 0; Iteration < IterationCount; ++Iteration)
+    {
+        for (u32 JointIndex = 0; JointIndex < Skeleton->JointCount; ++JointIndex)
+        {
+            joint *Joint = Skeleton->Joints + JointIndex;
+            ReferencePalette[JointIndex] = Pose.GlobalJointPoses[JointIndex] * Joint->InvBindTranform;
+        }
+    }
+    f64 ScalarElapsed = GetWallClockMilliseconds() - ScalarStart;
 
-                    break;
-                }
-                case MaterialProperty_Texture_Diffuse:
-                {
-                    MaterialProperty->Bitmap = MaterialPropertyHeader->Bitmap;
-                    MaterialProperty->Bitmap.Pixels = (void *)((u8 *)Buffer + MaterialPropertyHeader->BitmapOffset);
+    f64 BatchedStart = GetWallClockMilliseconds();
+    for (u32 Iteration = 0; Iteration < IterationCount; ++Iteration)
+    {
+        CalculateSkinningPalette(&Pose, Palette);
+    }
+    f64 BatchedElapsed = GetWallClockMilliseconds() - BatchedStart;
 
-#if 1
-                    char FileName[64];
-                    FormatString(FileName, ArrayCount(FileName), "Diffuse - %d - %d.bmp", MaterialIndex, MaterialPropertyIndex);
+    f32 MaxError = 0.f;
+    for (u32 JointIndex = 0; JointIndex < Skeleton->JointCount; ++JointIndex)
+    {
+        for (u32 RowIndex = 0; RowIndex < 4; ++RowIndex)
+        {
+            for (u32 ColumnIndex = 0; ColumnIndex < 4; ++ColumnIndex)
+            {
+                MaxError = Max(MaxError, Abs(ReferencePalette[JointIndex].Elements[RowIndex][ColumnIndex] - Palette[JointIndex].Elements[RowIndex][ColumnIndex]));
+            }
+        }
+    }
 
-                    stbi_write_bmp(FileName, MaterialProperty->Bitmap.Width, MaterialProperty->Bitmap.Height, MaterialProperty->Bitmap.Channels, MaterialProperty->Bitmap.Pixels);
-#endif
+    Assert(MaxError < 0.001f);
 
-                    u32 BitmapSize = MaterialProperty->Bitmap.Width * MaterialProperty->Bitmap.Height * MaterialProperty->Bitmap.Channels;
+    printf("Skinning palette (%u joints, max difference %f):\n", Skeleton->JointCount, MaxError);
+    printf("  scalar:  %8.4f us/palette\n", ScalarElapsed * 1000.0 / IterationCount);
+    printf("  batched: %8.4f us/palette (%.2fx)\n", BatchedElapsed * 1000.0 / IterationCount, ScalarElapsed / BatchedElapsed);
+}
 
-                    NextMaterialPropertyHeaderOffset += sizeof(model_asset_material_property_header) + BitmapSize;
+inline f32
+GetMaxDifference(vec3 *A, vec3 *B, u32 Count)
+{
+    f32 Result = 0.f;
 
-                    break;
-                }
-                case MaterialProperty_Texture_Specular:
-                {
-                    MaterialProperty->Bitmap = MaterialPropertyHeader->Bitmap;
-                    MaterialProperty->Bitmap.Pixels = (void *)((u8 *)Buffer + MaterialPropertyHeader->BitmapOffset);
+    for (u32 Index = 0; Index < Count; ++Index)
+    {
+        Result = Max(Result, Abs(A[Index].x - B[Index].x));
+        Result = Max(Result, Abs(A[Index].y - B[Index].y));
+        Result = Max(Result, Abs(A[Index].z - B[Index].z));
+    }
 
-#if 1
-                    char FileName[64];
-                    FormatString(FileName, ArrayCount(FileName), "Specular - %d - %d.bmp", MaterialIndex, MaterialPropertyIndex);
+    return Result;
+}
 
-                    stbi_write_bmp(FileName, MaterialProperty->Bitmap.Width, MaterialProperty->Bitmap.Height, MaterialProperty->Bitmap.Channels, MaterialProperty->Bitmap.Pixels);
-#endif
+internal void
+BenchmarkSkinning(model_asset *Asset, memory_arena *Arena)
+{
+    scoped_memory ScopedMemory(Arena);
 
-                    u32 BitmapSize = MaterialProperty->Bitmap.Width * MaterialProperty->Bitmap.Height * MaterialProperty->Bitmap.Channels;
+    skeleton *Skeleton = &Asset->Skeleton;
 
-                    NextMaterialPropertyHeaderOffset += sizeof(model_asset_material_property_header) + BitmapSize;
+    skeleton_pose Pose = {};
+    Pose.Skeleton = Skeleton;
+    Pose.LocalJointPoses = PushArray(ScopedMemory.Arena, Skeleton->JointCount, joint_pose);
+    Pose.GlobalJointPoses = PushArray(ScopedMemory.Arena, Skeleton->JointCount, mat4);
 
-                    break;
-                }
-                case MaterialProperty_Texture_Shininess:
-                {
-                    MaterialProperty->Bitmap = MaterialPropertyHeader->Bitmap;
-                    MaterialProperty->Bitmap.Pixels = (void *)((u8 *)Buffer + MaterialPropertyHeader->BitmapOffset);
+    mat4 *SkinningMatrices = PushArray(ScopedMemory.Arena, Skeleton->JointCount, mat4);
+    mat4 *TransposedSkinningMatrices = PushArray(ScopedMemory.Arena, Skeleton->JointCount, mat4);
 
-#if 1
-                    char FileName[64];
-                    FormatString(FileName, ArrayCount(FileName), "Shininess - %d - %d.bmp", MaterialIndex, MaterialPropertyIndex);
+    animation_clip *Animation = Asset->Animations;
+    animation_state AnimationState = CreateAnimationState(Animation, ScopedMemory.Arena);
+    AnimationState.Time = Animation->Duration * 0.5f;
+    AnimateSkeletonPose(&Pose, &AnimationState);
+    CalculateGlobalJointPoses(&Pose);
+    CalculateSkinningPalette(&Pose, SkinningMatrices);
+    TransposeSkinningMatrices(Skeleton->JointCount, SkinningMatrices, TransposedSkinningMatrices);
 
-                    stbi_write_bmp(FileName, MaterialProperty->Bitmap.Width, MaterialProperty->Bitmap.Height, MaterialProperty->Bitmap.Channels, MaterialProperty->Bitmap.Pixels);
-#endif
+    u32 TotalVertexCount = 0;
+    for (u32 MeshIndex = 0; MeshIndex < Asset->MeshCount; ++MeshIndex)
+    {
+        mesh *Mesh = Asset->Meshes + MeshIndex;
 
-                    u32 BitmapSize = MaterialProperty->Bitmap.Width * MaterialProperty->Bitmap.Height * MaterialProperty->Bitmap.Channels;
+        if (Mesh->Weights)
+        {
+            TotalVertexCount += Mesh->VertexCount;
+        }
+    }
 
-                    NextMaterialPropertyHeaderOffset += sizeof(model_asset_material_property_header) + BitmapSize;
+    // Reference, single thread and work queue outputs
+    vec3 *Positions[3];
+    vec3 *Normals[3];
 
-                    break;
-                }
-                case MaterialProperty_Texture_Normal:
-                {
-                    MaterialProperty->Bitmap = MaterialPropertyHeader->Bitmap;
-                    MaterialProperty->Bitmap.Pixels = (void *)((u8 *)Buffer + MaterialPropertyHeader->BitmapOffset);
+    for (u32 OutputIndex = 0; OutputIndex < ArrayCount(Positions); ++OutputIndex)
+    {
+        Positions[OutputIndex] = PushArray(ScopedMemory.Arena, TotalVertexCount, vec3);
+        Normals[OutputIndex] = PushArray(ScopedMemory.Arena, TotalVertexCount, vec3);
+    }
 
-#if 1
-                    char FileName[64];
-                    FormatString(FileName, ArrayCount(FileName), "Normal - %d - %d.bmp", MaterialIndex, MaterialPropertyIndex);
+    platform_work_queue Queue = {};
+    platform_api Platform = CreateBuilderPlatformApi(&Queue);
 
-                    stbi_write_bmp(FileName, MaterialProperty->Bitmap.Width, MaterialProperty->Bitmap.Height, MaterialProperty->Bitmap.Channels, MaterialProperty->Bitmap.Pixels);
-#endif
+    b32 UseAVX = IsAVXSupported();
+    u32 IterationCount = 100;
+    f64 Elapsed[3] = {};
 
-                    u32 BitmapSize = MaterialProperty->Bitmap.Width * MaterialProperty->Bitmap.Height * MaterialProperty->Bitmap.Channels;
+    for (u32 OutputIndex = 0; OutputIndex < ArrayCount(Positions); ++OutputIndex)
+    {
+        f64 Start = GetWallClockMilliseconds();
 
-                    NextMaterialPropertyHeaderOffset += sizeof(model_asset_material_property_header) + BitmapSize;
+        for (u32 Iteration = 0; Iteration < IterationCount; ++Iteration)
+        {
+            u32 VertexOffset = 0;
 
-                    break;
+            for (u32 MeshIndex = 0; MeshIndex < Asset->MeshCount; ++MeshIndex)
+            {
+                mesh *Mesh = Asset->Meshes + MeshIndex;
+
+                if (!Mesh->Weights)
+                {
+                    continue;
                 }
-                default:
+
+                // Outputs are indexed like the mesh streams
+                vec3 *MeshPositions = Positions[OutputIndex] + VertexOffset;
+                vec3 *MeshNormals = Normals[OutputIndex] + VertexOffset;
+
+                if (OutputIndex == 2)
                 {
-                    Assert(!"Invalid material property");
+                    SkinMesh(&Platform, Mesh, Skeleton->JointCount, SkinningMatrices, MeshPositions, MeshNormals, ScopedMemory.Arena);
+                }
+                else
+                {
+                    skinning_job Job = {};
+                    Job.Mesh = Mesh;
+                    Job.SkinningMatrices = SkinningMatrices;
+                    Job.TransposedSkinningMatrices = TransposedSkinningMatrices;
+                    Job.FirstVertexIndex = 0;
+                    Job.VertexCount = Mesh->VertexCount;
+                    Job.Positions = MeshPositions;
+                    Job.Normals = MeshNormals;
+
+                    if (OutputIndex == 0 || !UseAVX)
+                    {
+                        SkinVerticesScalar(&Job);
+                    }
+                    else
+                    {
+                        SkinVerticesAVX(&Job);
+                    }
                 }
+
+                VertexOffset += Mesh->VertexCount;
             }
         }
 
-        NextMaterialHeaderOffset += sizeof(model_asset_material_header) + NextMaterialPropertyHeaderOffset;
+        Elapsed[OutputIndex] = GetWallClockMilliseconds() - Start;
     }
 
-    model_asset_animations_header *AnimationsHeader = (model_asset_animations_header *)((u8 *)Buffer + Header->AnimationsHeaderOffset);
+    f32 MaxPositionError = Max(GetMaxDifference(Positions[0], Positions[1], TotalVertexCount), GetMaxDifference(Positions[0], Positions[2], TotalVertexCount));
+    f32 MaxNormalError = Max(GetMaxDifference(Normals[0], Normals[1], TotalVertexCount), GetMaxDifference(Normals[0], Normals[2], TotalVertexCount));
 
-    u64 NextAnimationHeaderOffset = 0;
+    Assert(MaxPositionError < 0.001f);
+    Assert(MaxNormalError < 0.001f);
 
-    for (u32 AnimationIndex = 0; AnimationIndex < AnimationsHeader->AnimationCount; ++AnimationIndex)
+    printf("CPU skinning (%u vertices, %u threads, %s, max difference %f / %f):\n",
+        TotalVertexCount, Queue.ThreadCount, UseAVX ? "AVX" : "no AVX", MaxPositionError, MaxNormalError);
+    printf("  scalar:      %8.4f ms/model\n", Elapsed[0] / IterationCount);
+    printf("  SIMD:        %8.4f ms/model (%.2fx)\n", Elapsed[1] / IterationCount, Elapsed[0] / Elapsed[1]);
+    printf("  SIMD+queue:  %8.4f ms/model (%.2fx)\n", Elapsed[2] / IterationCount, Elapsed[0] / Elapsed[2]);
+}
+
+// Reference: per-joint slerp
+internal void
+LerpSkeletonPoseScalar(skeleton_pose *From, f32 t, skeleton_pose *To, skeleton_pose *Dest)
+{
+    for (u32 JointIndex = 0; JointIndex < Dest->Skeleton->JointCount; ++JointIndex)
     {
-        model_asset_animation_header *AnimationHeader = (model_asset_animation_header *)((u8 *)Buffer + 
-            AnimationsHeader->AnimationsOffset + NextAnimationHeaderOffset);
-        animation_clip Animation = {};
-        CopyString(AnimationHeader->Name, Animation.Name, MAX_ANIMATION_NAME_LENGTH);
-        Animation.Duration = AnimationHeader->Duration;
-        Animation.IsLooping = AnimationHeader->IsLooping;
-        Animation.InPlace = AnimationHeader->InPlace;
-        Animation.PoseSampleCount = AnimationHeader->PoseSampleCount;
-        Animation.PoseSamples = (animation_sample *)((u8 *)Buffer + AnimationHeader->PoseSamplesOffset);
+        Dest->LocalJointPoses[JointIndex] = Lerp(From->LocalJointPoses + JointIndex, t, To->LocalJointPoses + JointIndex);
+    }
+}
 
-        u64 NextAnimationSampleHeaderOffset = 0;
+internal void
+BenchmarkPoseBlending(model_asset *Asset, memory_arena *Arena)
+{
+    scoped_memory ScopedMemory(Arena);
+
+    skeleton *Skeleton = &Asset->Skeleton;
+
+    skeleton_pose Poses[3] = {};
+    for (u32 PoseIndex = 0; PoseIndex < ArrayCount(Poses); ++PoseIndex)
+    {
+        Poses[PoseIndex].Skeleton = Skeleton;
+        Poses[PoseIndex].LocalJointPoses = PushArray(ScopedMemory.Arena, Skeleton->JointCount, joint_pose);
+    }
 
-        for (u32 AnimationPoseIndex = 0; AnimationPoseIndex < AnimationHeader->PoseSampleCount; ++AnimationPoseIndex)
+    skeleton_pose *From = Poses + 0;
+    skeleton_pose *To = Poses + 1;
+    skeleton_pose *Dest = Poses + 2;
+
+    animation_clip *FromAnimation = Asset->Animations;
+    animation_clip *ToAnimation = Asset->Animations + (Asset->AnimationCount - 1);
+
+    animation_state FromState = CreateAnimationState(FromAnimation, ScopedMemory.Arena);
+    animation_state ToState = CreateAnimationState(ToAnimation, ScopedMemory.Arena);
+    FromState.Time = FromAnimation->Duration * 0.25f;
+    ToState.Time = ToAnimation->Duration * 0.75f;
+
+    AnimateSkeletonPose(From, &FromState);
+    AnimateSkeletonPose(To, &ToState);
+
+    skeleton_pose_soa FromSoa = CreateSkeletonPoseSoa(Skeleton, ScopedMemory.Arena);
+    skeleton_pose_soa ToSoa = CreateSkeletonPoseSoa(Skeleton, ScopedMemory.Arena);
+    skeleton_pose_soa DestSoa = CreateSkeletonPoseSoa(Skeleton, ScopedMemory.Arena);
+
+    CopySkeletonPoseToSoa(From, &FromSoa);
+    CopySkeletonPoseToSoa(To, &ToSoa);
+
+    // nlerp vs slerp error
+    f32 MaxRotationError = 0.f;
+    f32 MaxTranslationError = 0.f;
+    for (f32 t = 0.f; t <= 1.f; t += 0.125f)
+    {
+        LerpSkeletonPoseScalar(From, t, To, Dest);
+
+        joint_pose *ReferenceJointPoses = PushArray(ScopedMemory.Arena, Skeleton->JointCount, joint_pose);
+        for (u32 JointIndex = 0; JointIndex < Skeleton->JointCount; ++JointIndex)
         {
-            model_asset_animation_sample_header *AnimationSampleHeader = (model_asset_animation_sample_header *)
-                ((u8 *)Buffer + AnimationHeader->PoseSamplesOffset + NextAnimationSampleHeaderOffset);
+            ReferenceJointPoses[JointIndex] = Dest->LocalJointPoses[JointIndex];
+        }
 
-            animation_sample *AnimationSample = Animation.PoseSamples + AnimationPoseIndex;
+        Lerp(From, t, To, Dest);
 
-            AnimationSample->KeyFrameCount = AnimationSampleHeader->KeyFrameCount;
-            AnimationSample->KeyFrames = (key_frame *)((u8 *)Buffer + AnimationSampleHeader->KeyFramesOffset);
+        for (u32 JointIndex = 0; JointIndex < Skeleton->JointCount; ++JointIndex)
+        {
+            joint_pose *A = ReferenceJointPoses + JointIndex;
+            joint_pose *B = Dest->LocalJointPoses + JointIndex;
 
-            NextAnimationSampleHeaderOffset += sizeof(model_asset_animation_sample_header) + 
-                AnimationSampleHeader->KeyFrameCount * sizeof(key_frame);
+            MaxRotationError = Max(MaxRotationError, 1.f - Abs(Dot(A->Rotation, B->Rotation)));
+            MaxTranslationError = Max(MaxTranslationError, Magnitude(A->Translation - B->Translation));
         }
+    }
+
+    Assert(MaxTranslationError < 0.001f);
 
-        NextAnimationHeaderOffset += sizeof(model_asset_animation_header) + NextAnimationSampleHeaderOffset;
+    u32 IterationCount = 100000;
+    f32 t = 0.3f;
+
+    f64 ScalarStart = GetWallClockMilliseconds();
+    for (u32 Iteration = 0; Iteration < IterationCount; ++Iteration)
+    {
+        LerpSkeletonPoseScalar(From, t, To, Dest);
     }
+    f64 ScalarElapsed = GetWallClockMilliseconds() - ScalarStart;
 
-    fclose(AssetFile);
+    f64 AdapterStart = GetWallClockMilliseconds();
+    for (u32 Iteration = 0; Iteration < IterationCount; ++Iteration)
+    {
+        Lerp(From, t, To, Dest);
+    }
+    f64 AdapterElapsed = GetWallClockMilliseconds() - AdapterStart;
+
+    f64 SoaStart = GetWallClockMilliseconds();
+    for (u32 Iteration = 0; Iteration < IterationCount; ++Iteration)
+    {
+        Lerp(&FromSoa, t, &ToSoa, &DestSoa);
+    }
+    f64 SoaElapsed = GetWallClockMilliseconds() - SoaStart;
+
+    printf("Pose blending (%u joints, nlerp error: rotation %f, translation %f):\n", Skeleton->JointCount, MaxRotationError, MaxTranslationError);
+    printf("  scalar slerp: %8.4f us/pose\n", ScalarElapsed * 1000.0 / IterationCount);
+    printf("  aos adapter:  %8.4f us/pose (%.2fx)\n", AdapterElapsed * 1000.0 / IterationCount, ScalarElapsed / AdapterElapsed);
+    printf("  soa:          %8.4f us/pose (%.2fx)\n", SoaElapsed * 1000.0 / IterationCount, ScalarElapsed / SoaElapsed);
 }
 
+// Reference: a full pose per clip, folded together with pairwise lerps
 internal void
-WriteAssetFile(const char *FilePath, model_asset *Asset)
+BlendSkeletonPosesPairwise(animation_state *AnimationStates, f32 *Weights, u32 AnimationCount, skeleton_pose *DestPose, memory_arena *Arena)
 {
-    FILE *AssetFile = fopen(FilePath, "wb");
-
-    model_asset_header Header = {};
-    Header.MagicValue = 0x451;
-    Header.Version = 1;
-    // will be filled later
-    Header.SkeletonHeaderOffset = 0;
-    Header.MeshesHeaderOffset = 0;
-    Header.MaterialsHeaderOffset = 0;
-    Header.AnimationsHeaderOffset = 0;
+    scoped_memory ScopedMemory(Arena);
 
-    u64 CurrentStreamPosition = 0;
+    skeleton_pose *SkeletonPoses = PushArray(ScopedMemory.Arena, AnimationCount, skeleton_pose);
 
-    fwrite(&Header, sizeof(model_asset_header), 1, AssetFile);
+    for (u32 AnimationIndex = 0; AnimationIndex < AnimationCount; ++AnimationIndex)
+    {
+        skeleton_pose *SkeletonPose = SkeletonPoses + AnimationIndex;
+        SkeletonPose->Skeleton = DestPose->Skeleton;
+        SkeletonPose->LocalJointPoses = PushArray(ScopedMemory.Arena, DestPose->Skeleton->JointCount, joint_pose);
 
-    CurrentStreamPosition = ftell(AssetFile);
-    Header.SkeletonHeaderOffset = CurrentStreamPosition;
+        for (u32 JointIndex = 0; JointIndex < DestPose->Skeleton->JointCount; ++JointIndex)
+        {
+            SkeletonPose->LocalJointPoses[JointIndex] = DestPose->LocalJointPoses[JointIndex];
+        }
 
-    // Writing skeleton
-    model_asset_skeleton_header SkeletonHeader = {};
-    SkeletonHeader.JointCount = Asset->Skeleton.JointCount;
-    SkeletonHeader.JointsOffset = Header.SkeletonHeaderOffset + sizeof(SkeletonHeader);
+        AnimateSkeletonPose(SkeletonPose, AnimationStates + AnimationIndex);
+    }
 
-    fwrite(&SkeletonHeader, sizeof(model_asset_skeleton_header), 1, AssetFile);
-    fwrite(Asset->Skeleton.Joints, sizeof(joint), Asset->Skeleton.JointCount, AssetFile);
+    Lerp(SkeletonPoses, 0.f, SkeletonPoses, DestPose);
 
-    CurrentStreamPosition = ftell(AssetFile);
-    Header.SkeletonPoseHeaderOffset = CurrentStreamPosition;
+    f32 AccumulatedWeight = Weights[0];
 
-    // Writing skeleton bind pose
-    model_asset_skeleton_pose_header SkeletonPoseHeader = {};
-    SkeletonPoseHeader.LocalJointPosesOffset = Header.SkeletonPoseHeaderOffset + sizeof(model_asset_skeleton_pose_header);
-    SkeletonPoseHeader.GlobalJointPosesOffset = SkeletonPoseHeader.LocalJointPosesOffset + SkeletonHeader.JointCount * sizeof(joint_pose);
+    for (u32 AnimationIndex = 1; AnimationIndex < AnimationCount; ++AnimationIndex)
+    {
+        f32 NextWeight = Weights[AnimationIndex];
+        f32 t = NextWeight / (AccumulatedWeight + NextWeight);
 
-    fwrite(&SkeletonPoseHeader, sizeof(model_asset_skeleton_pose_header), 1, AssetFile);
-    fwrite(Asset->BindPose.LocalJointPoses, sizeof(joint_pose), Asset->Skeleton.JointCount, AssetFile);
-    fwrite(Asset->BindPose.GlobalJointPoses, sizeof(mat4), Asset->Skeleton.JointCount, AssetFile);
+        Lerp(DestPose, t, SkeletonPoses + AnimationIndex, DestPose);
 
-    CurrentStreamPosition = ftell(AssetFile);
-    Header.MeshesHeaderOffset = CurrentStreamPosition;
+        AccumulatedWeight += NextWeight;
+    }
+}
 
-    // Writing meshes
-    model_asset_meshes_header MeshesHeader = {};
-    MeshesHeader.MeshCount = Asset->MeshCount;
-    MeshesHeader.MeshesOffset = Header.MeshesHeaderOffset + sizeof(model_asset_meshes_header);
+internal void
+BlendSkeletonPosesAccumulated(animation_state *AnimationStates, f32 *Weights, u32 AnimationCount, skeleton_pose *DestPose, memory_arena *Arena)
+{
+    scoped_memory ScopedMemory(Arena);
 
-    fwrite(&MeshesHeader, sizeof(model_asset_meshes_header), 1, AssetFile);
+    skeleton_pose_accumulator Accumulator = CreateSkeletonPoseAccumulator(DestPose, ScopedMemory.Arena);
 
-    u32 TotalPrevMeshSize = 0;
-    for (u32 MeshIndex = 0; MeshIndex < Asset->MeshCount; ++MeshIndex)
+    for (u32 AnimationIndex = 0; AnimationIndex < AnimationCount; ++AnimationIndex)
     {
-        mesh *Mesh = Asset->Meshes + MeshIndex;
+        animation_state *AnimationState = AnimationStates + AnimationIndex;
+        AccumulateSkeletonPose(&Accumulator, AnimationState, Weights[AnimationIndex]);
+    }
 
-        model_asset_mesh_header MeshHeader = {};
-        MeshHeader.MaterialIndex = Mesh->MaterialIndex;
-        MeshHeader.VertexCount = Mesh->VertexCount;
-        MeshHeader.IndexCount = Mesh->IndexCount;
-        MeshHeader.VerticesOffset = MeshesHeader.MeshesOffset + sizeof(model_asset_mesh_header) + TotalPrevMeshSize;
-        MeshHeader.IndicesOffset = MeshHeader.VerticesOffset + GetMeshVerticesSize(Mesh);
+    ResolveSkeletonPoseAccumulator(&Accumulator, DestPose);
+}
+
+internal void
+BenchmarkPoseAccumulation(model_asset *Asset, memory_arena *Arena)
+{
+    scoped_memory ScopedMemory(Arena);
+
+    skeleton *Skeleton = &Asset->Skeleton;
+    u32 AnimationCount = Asset->AnimationCount;
 
-        MeshHeader.HasPositions = Mesh->Positions != 0;
-        MeshHeader.HasNormals = Mesh->Normals != 0;
-        MeshHeader.HasTangents = Mesh->Tangents != 0;
-        MeshHeader.HasBitangets = Mesh->Bitangents != 0;
-        MeshHeader.HasTextureCoords = Mesh->TextureCoords != 0;
-        MeshHeader.HasWeights = Mesh->Weights != 0;
-        MeshHeader.HasJointIndices = Mesh->JointIndices != 0;
+    animation_state *AnimationStates = PushArray(ScopedMemory.Arena, AnimationCount, animation_state);
+    f32 *Weights = PushArray(ScopedMemory.Arena, AnimationCount, f32);
 
-        TotalPrevMeshSize += sizeof(model_asset_mesh_header) + GetMeshVerticesSize(Mesh) + Mesh->IndexCount * sizeof(u32);
+    for (u32 AnimationIndex = 0; AnimationIndex < AnimationCount; ++AnimationIndex)
+    {
+        animation_clip *Animation = Asset->Animations + AnimationIndex;
 
-        fwrite(&MeshHeader, sizeof(model_asset_mesh_header), 1, AssetFile);
+        AnimationStates[AnimationIndex] = CreateAnimationState(Animation, ScopedMemory.Arena);
+        AnimationStates[AnimationIndex].Time = Animation->Duration * 0.5f;
+    }
 
-        if (MeshHeader.HasPositions)
-        {
-            fwrite(Mesh->Positions, sizeof(vec3), Mesh->VertexCount, AssetFile);
-        }
+    skeleton_pose PairwisePose = {};
+    PairwisePose.Skeleton = Skeleton;
+    PairwisePose.LocalJointPoses = PushArray(ScopedMemory.Arena, Skeleton->JointCount, joint_pose);
 
-        if (MeshHeader.HasNormals)
+    skeleton_pose AccumulatedPose = {};
+    AccumulatedPose.Skeleton = Skeleton;
+    AccumulatedPose.LocalJointPoses = PushArray(ScopedMemory.Arena, Skeleton->JointCount, joint_pose);
+
+    printf("Pose blending of N clips (pairwise lerps vs accumulation):\n");
+
+    for (u32 BlendCount = 2; BlendCount <= AnimationCount; ++BlendCount)
+    {
+        for (u32 AnimationIndex = 0; AnimationIndex < BlendCount; ++AnimationIndex)
         {
-            fwrite(Mesh->Normals, sizeof(vec3), Mesh->VertexCount, AssetFile);
+            Weights[AnimationIndex] = 1.f / BlendCount;
         }
 
-        if (MeshHeader.HasTangents)
+        f32 MaxRotationError = 0.f;
+        f32 MaxTranslationError = 0.f;
         {
-            fwrite(Mesh->Tangents, sizeof(vec3), Mesh->VertexCount, AssetFile);
+            // Same starting pose for not animated joints
+            AnimateSkeletonPose(&PairwisePose, AnimationStates);
+            AnimateSkeletonPose(&AccumulatedPose, AnimationStates);
+
+            BlendSkeletonPosesPairwise(AnimationStates, Weights, BlendCount, &PairwisePose, ScopedMemory.Arena);
+            BlendSkeletonPosesAccumulated(AnimationStates, Weights, BlendCount, &AccumulatedPose, ScopedMemory.Arena);
+
+            for (u32 JointIndex = 0; JointIndex < Skeleton->JointCount; ++JointIndex)
+            {
+                joint_pose *A = PairwisePose.LocalJointPoses + JointIndex;
+                joint_pose *B = AccumulatedPose.LocalJointPoses + JointIndex;
+
+                MaxRotationError = Max(MaxRotationError, 1.f - Abs(Dot(A->Rotation, B->Rotation)));
+                MaxTranslationError = Max(MaxTranslationError, Magnitude(A->Translation - B->Translation));
+            }
         }
 
-        if (MeshHeader.HasBitangets)
+        u32 IterationCount = 10000;
+
+        f64 PairwiseStart = GetWallClockMilliseconds();
+        for (u32 Iteration = 0; Iteration < IterationCount; ++Iteration)
         {
-            fwrite(Mesh->Bitangents, sizeof(vec3), Mesh->VertexCount, AssetFile);
+            BlendSkeletonPosesPairwise(AnimationStates, Weights, BlendCount, &PairwisePose, ScopedMemory.Arena);
         }
+        f64 PairwiseElapsed = GetWallClockMilliseconds() - PairwiseStart;
 
-        if (MeshHeader.HasTextureCoords)
+        f64 AccumulatedStart = GetWallClockMilliseconds();
+        for (u32 Iteration = 0; Iteration < IterationCount; ++Iteration)
         {
-            fwrite(Mesh->TextureCoords, sizeof(vec2), Mesh->VertexCount, AssetFile);
+            BlendSkeletonPosesAccumulated(AnimationStates, Weights, BlendCount, &AccumulatedPose, ScopedMemory.Arena);
         }
+        f64 AccumulatedElapsed = GetWallClockMilliseconds() - AccumulatedStart;
 
-        if (MeshHeader.HasWeights)
+        printf("  %u clips: pairwise %8.4f us, accumulated %8.4f us (%.2fx), error: rotation %f, translation %f\n",
+            BlendCount, PairwiseElapsed * 1000.0 / IterationCount, AccumulatedElapsed * 1000.0 / IterationCount,
+            PairwiseElapsed / AccumulatedElapsed, MaxRotationError, MaxTranslationError);
+    }
+}
+
+internal void
+BenchmarkAdditivePose(model_asset *Asset, memory_arena *Arena)
+{
+    scoped_memory ScopedMemory(Arena);
+
+    skeleton *Skeleton = &Asset->Skeleton;
+
+    animation_clip *BaseAnimation = 0;
+    animation_clip *AdditiveAnimation = 0;
+
+    for (u32 AnimationIndex = 0; AnimationIndex < Asset->AnimationCount; ++AnimationIndex)
+    {
+        animation_clip *Animation = Asset->Animations + AnimationIndex;
+
+        if (Animation->IsAdditive)
         {
-            fwrite(Mesh->Weights, sizeof(vec4), Mesh->VertexCount, AssetFile);
+            AdditiveAnimation = AdditiveAnimation ? AdditiveAnimation : Animation;
         }
-
-        if (MeshHeader.HasJointIndices)
+        else
         {
-            fwrite(Mesh->JointIndices, sizeof(i32) * 4, Mesh->VertexCount, AssetFile);
+            BaseAnimation = BaseAnimation ? BaseAnimation : Animation;
         }
+    }
 
-        fwrite(Mesh->Indices, sizeof(u32), Mesh->IndexCount, AssetFile);
+    if (!BaseAnimation || !AdditiveAnimation)
+    {
+        return;
     }
 
-    CurrentStreamPosition = ftell(AssetFile);
-    Header.MaterialsHeaderOffset = CurrentStreamPosition;
+    animation_state BaseState = CreateAnimationState(BaseAnimation, ScopedMemory.Arena);
+    BaseState.Time = BaseAnimation->Duration * 0.5f;
 
-    // Writing materials
-    model_asset_materials_header MaterialsHeader = {};
-    MaterialsHeader.MaterialCount = Asset->MaterialCount;
-    MaterialsHeader.MaterialsOffset = Header.MaterialsHeaderOffset + sizeof(model_asset_materials_header);
+    animation_state AdditiveState = CreateAnimationState(AdditiveAnimation, ScopedMemory.Arena);
+    AdditiveState.Time = AdditiveAnimation->Duration * 0.5f;
 
-    fwrite(&MaterialsHeader, sizeof(model_asset_materials_header), 1, AssetFile);
+    // Same variation as a regular (non-additive) clip, which needs its own blend branch
+    animation_state VariationState = CreateAnimationState(BaseAnimation, ScopedMemory.Arena);
+    VariationState.Time = BaseAnimation->Duration * 0.25f;
 
-    u32 TotalPrevPropertiesSize = 0;
-    for (u32 MaterialIndex = 0; MaterialIndex < MaterialsHeader.MaterialCount; ++MaterialIndex)
+    skeleton_pose Pose = {};
+    Pose.Skeleton = Skeleton;
+    Pose.LocalJointPoses = PushArray(ScopedMemory.Arena, Skeleton->JointCount, joint_pose);
+    AnimateSkeletonPose(&Pose, &BaseState);
+
+    skeleton_pose_accumulator Accumulator = CreateSkeletonPoseAccumulator(&Pose, ScopedMemory.Arena);
+
+    u32 IterationCount = 10000;
+
+    f64 BaseStart = GetWallClockMilliseconds();
+    for (u32 Iteration = 0; Iteration < IterationCount; ++Iteration)
     {
-        mesh_material *Material = Asset->Materials + MaterialIndex;
+        AccumulateSkeletonPose(&Accumulator, &BaseState, 1.f);
+        ResolveSkeletonPoseAccumulator(&Accumulator, &Pose);
+    }
+    f64 BaseElapsed = GetWallClockMilliseconds() - BaseStart;
 
-        model_asset_material_header MaterialHeader = {};
-        MaterialHeader.PropertyCount = Material->PropertyCount;
-        MaterialHeader.PropertiesOffset = MaterialsHeader.MaterialsOffset + sizeof(model_asset_material_header) +
-            MaterialIndex * sizeof(model_asset_material_header) + TotalPrevPropertiesSize;
+    f64 BlendStart = GetWallClockMilliseconds();
+    for (u32 Iteration = 0; Iteration < IterationCount; ++Iteration)
+    {
+        AccumulateSkeletonPose(&Accumulator, &BaseState, 1.f);
+        ResolveSkeletonPoseAccumulator(&Accumulator, &Pose);
 
-        fwrite(&MaterialHeader, sizeof(model_asset_material_header), 1, AssetFile);
+        AccumulateSkeletonPose(&Accumulator, &VariationState, 0.5f);
+        ResolveSkeletonPoseAccumulator(&Accumulator, &Pose);
+    }
+    f64 BlendElapsed = GetWallClockMilliseconds() - BlendStart;
 
-        u32 PrevPropertiesSize = 0;
-        for (u32 MaterialPropertyIndex = 0; MaterialPropertyIndex < Material->PropertyCount; ++MaterialPropertyIndex)
-        {
-            material_property *MaterialProperty = Material->Properties + MaterialPropertyIndex;
+    f64 AdditiveStart = GetWallClockMilliseconds();
+    for (u32 Iteration = 0; Iteration < IterationCount; ++Iteration)
+    {
+        AccumulateSkeletonPose(&Accumulator, &BaseState, 1.f);
+        ResolveSkeletonPoseAccumulator(&Accumulator, &Pose);
 
-            model_asset_material_property_header MaterialPropertyHeader = {};
-            MaterialPropertyHeader.Type = MaterialProperty->Type;
+        ApplyAdditiveSkeletonPose(&Accumulator, &AdditiveState, 0.5f);
+    }
+    f64 AdditiveElapsed = GetWallClockMilliseconds() - AdditiveStart;
 
-            switch (MaterialProperty->Type)
-            {
-            case MaterialProperty_Float_Shininess:
-            {
-                MaterialPropertyHeader.Value = MaterialProperty->Value;
+    // Cost on top of the base pose
+    f64 BlendCost = BlendElapsed - BaseElapsed;
+    f64 AdditiveCost = AdditiveElapsed - BaseElapsed;
 
-                fwrite(&MaterialPropertyHeader, sizeof(model_asset_material_property_header), 1, AssetFile);
+    printf("Pose variation on top of the base pose (second blend branch vs additive clip):\n");
+    printf("  base:         %8.4f us/pose\n", BaseElapsed * 1000.0 / IterationCount);
+    printf("  blend branch: %8.4f us/pose (+%.4f us)\n", BlendElapsed * 1000.0 / IterationCount, BlendCost * 1000.0 / IterationCount);
+    printf("  additive:     %8.4f us/pose (+%.4f us, %.2fx)\n", AdditiveElapsed * 1000.0 / IterationCount, AdditiveCost * 1000.0 / IterationCount,
+        BlendCost / AdditiveCost);
+}
 
-                PrevPropertiesSize += sizeof(model_asset_material_property_header);
+// Brute force search, reference for the KD-tree
+internal u32
+SearchMotionDatabaseLinear(motion_database *Database, f32 *Query, f32 *BestDistance)
+{
+    u32 Result = U32_MAX;
+    *BestDistance = F32_MAX;
 
-                break;
-            }
-            case MaterialProperty_Color_Ambient:
-            case MaterialProperty_Color_Diffuse:
-            case MaterialProperty_Color_Specular:
-            {
-                MaterialPropertyHeader.Color = MaterialProperty->Color;
+    for (u32 FrameIndex = 0; FrameIndex < Database->FrameCount; ++FrameIndex)
+    {
+        f32 Distance = GetMotionFeatureDistance(Query, Database->Features + FrameIndex * MOTION_FEATURE_STRIDE);
 
-                fwrite(&MaterialPropertyHeader, sizeof(model_asset_material_property_header), 1, AssetFile);
+        if (Distance < *BestDistance)
+        {
+            *BestDistance = Distance;
+            Result = FrameIndex;
+        }
+    }
 
-                PrevPropertiesSize += sizeof(model_asset_material_property_header);
+    return Result;
+}
 
-                break;
-            }
-            case MaterialProperty_Texture_Diffuse:
-            case MaterialProperty_Texture_Specular:
-            case MaterialProperty_Texture_Shininess:
-            case MaterialProperty_Texture_Normal:
-            {
-                MaterialPropertyHeader.Bitmap = MaterialProperty->Bitmap;
-                MaterialPropertyHeader.BitmapOffset = MaterialHeader.PropertiesOffset + sizeof(model_asset_material_property_header) + PrevPropertiesSize;
+internal void
+BenchmarkMotionMatching(model_asset *Asset, memory_arena *Arena)
+{
+    motion_database *SourceDatabase = &Asset->MotionDatabase;
 
-                fwrite(&MaterialPropertyHeader, sizeof(model_asset_material_property_header), 1, AssetFile);
+    if (SourceDatabase->FrameCount == 0)
+    {
+        return;
+    }
 
-                u32 BitmapSize = MaterialProperty->Bitmap.Width * MaterialProperty->Bitmap.Height * MaterialProperty->Bitmap.Channels;
-                fwrite(MaterialPropertyHeader.Bitmap.Pixels, sizeof(u8), BitmapSize, AssetFile);
+    scoped_memory ScopedMemory(Arena);
 
-                PrevPropertiesSize += sizeof(model_asset_material_property_header) + BitmapSize;
+    random_sequence Entropy = RandomSequence(123);
 
-                break;
-            }
-            default:
+    u32 QueryCount = 1000;
+    f32 *Queries = PushArray(ScopedMemory.Arena, QueryCount * MOTION_FEATURE_STRIDE, f32);
+
+    printf("Motion matching query cost by database size (%d queries, larger databases are jittered copies of the real one):\n", QueryCount);
+
+    for (u32 CopyCount = 1; CopyCount <= 64; CopyCount *= 4)
+    {
+        motion_database Database = {};
+        Database.SampleRate = SourceDatabase->SampleRate;
+        Database.ClipCount = SourceDatabase->ClipCount;
+        Database.Clips = SourceDatabase->Clips;
+        Database.FrameCount = SourceDatabase->FrameCount * CopyCount;
+        Database.Frames = (motion_database_frame *)malloc(Database.FrameCount * sizeof(motion_database_frame));
+        Database.Features = (f32 *)malloc(Database.FrameCount * MOTION_FEATURE_STRIDE * sizeof(f32));
+        Database.ClipFrameIndices = (u32 *)malloc(Database.FrameCount * sizeof(u32));
+
+        for (u32 FrameIndex = 0; FrameIndex < Database.FrameCount; ++FrameIndex)
+        {
+            u32 SourceFrameIndex = FrameIndex % SourceDatabase->FrameCount;
+            f32 Jitter = FrameIndex < SourceDatabase->FrameCount ? 0.f : 0.25f;
+
+            Database.Frames[FrameIndex] = SourceDatabase->Frames[SourceFrameIndex];
+
+            for (u32 FeatureIndex = 0; FeatureIndex < MOTION_FEATURE_STRIDE; ++FeatureIndex)
             {
-                Assert(!"Invalid material property");
+                f32 Value = SourceDatabase->Features[SourceFrameIndex * MOTION_FEATURE_STRIDE + FeatureIndex];
+                Database.Features[FrameIndex * MOTION_FEATURE_STRIDE + FeatureIndex] = FeatureIndex < MotionFeature_Count ? Value + RandomBetween(&Entropy, -Jitter, Jitter) : 0.f;
             }
+        }
+
+        BuildMotionKdTree(&Database);
+
+        // Queries are close to the database (pose of the playing frame), the trajectory differs more
+        for (u32 QueryIndex = 0; QueryIndex < QueryCount; ++QueryIndex)
+        {
+            u32 FrameIndex = RandomChoice(&Entropy, Database.FrameCount);
+
+            for (u32 FeatureIndex = 0; FeatureIndex < MOTION_FEATURE_STRIDE; ++FeatureIndex)
+            {
+                f32 Noise = FeatureIndex < MotionFeature_TrajectoryPositions ? 0.1f : 1.f;
+                f32 Value = Database.Features[FrameIndex * MOTION_FEATURE_STRIDE + FeatureIndex];
+
+                Queries[QueryIndex * MOTION_FEATURE_STRIDE + FeatureIndex] = FeatureIndex < MotionFeature_Count ? Value + RandomBetween(&Entropy, -Noise, Noise) : 0.f;
             }
         }
 
-        TotalPrevPropertiesSize += PrevPropertiesSize;
+        f32 TreeDistanceSum = 0.f;
+        f64 TreeStart = GetWallClockMilliseconds();
+        for (u32 QueryIndex = 0; QueryIndex < QueryCount; ++QueryIndex)
+        {
+            f32 Distance;
+            SearchMotionDatabase(&Database, Queries + QueryIndex * MOTION_FEATURE_STRIDE, &Distance);
+            TreeDistanceSum += Distance;
+        }
+        f64 TreeElapsed = GetWallClockMilliseconds() - TreeStart;
+
+        f32 LinearDistanceSum = 0.f;
+        f64 LinearStart = GetWallClockMilliseconds();
+        for (u32 QueryIndex = 0; QueryIndex < QueryCount; ++QueryIndex)
+        {
+            f32 Distance;
+            SearchMotionDatabaseLinear(&Database, Queries + QueryIndex * MOTION_FEATURE_STRIDE, &Distance);
+            LinearDistanceSum += Distance;
+        }
+        f64 LinearElapsed = GetWallClockMilliseconds() - LinearStart;
+
+        // Both searches are exact
+        Assert(TreeDistanceSum == LinearDistanceSum);
+
+        printf("  %7d frames: kd-tree %8.3f us/query, linear %8.3f us/query (%.1fx)\n", Database.FrameCount,
+            TreeElapsed * 1000.0 / QueryCount, LinearElapsed * 1000.0 / QueryCount, LinearElapsed / TreeElapsed);
+
+        free(Database.Frames);
+        free(Database.Features);
+        free(Database.ClipFrameIndices);
+        free(Database.Nodes);
     }
+}
 
+// Sums every vertex position, which pages in the mesh data of mapped assets
+inline f32
+TouchMeshes(model_asset *Asset)
+{
+    f32 Result = 0.f;
 
-    CurrentStreamPosition = ftell(AssetFile);
-    Header.AnimationsHeaderOffset = CurrentStreamPosition;
+    for (u32 MeshIndex = 0; MeshIndex < Asset->MeshCount; ++MeshIndex)
+    {
+        mesh *Mesh = Asset->Meshes + MeshIndex;
 
-    // Writing animation clips
-    model_asset_animations_header AnimationsHeader = {};
-    AnimationsHeader.AnimationCount = Asset->AnimationCount;
-    AnimationsHeader.AnimationsOffset = Header.AnimationsHeaderOffset + sizeof(model_asset_animations_header);
+        for (u32 VertexIndex = 0; VertexIndex < Mesh->VertexCount; ++VertexIndex)
+        {
+            Result += Mesh->Positions[VertexIndex].x;
+        }
+    }
 
-    fwrite(&AnimationsHeader, sizeof(model_asset_animations_header), 1, AssetFile);
+    return Result;
+}
 
-    u64 TotalPrevKeyFrameSize = 0;
-    for (u32 AnimationIndex = 0; AnimationIndex < Asset->AnimationCount; ++AnimationIndex)
+// Loading the game asset file with a copy into the arena and with a mapping (asset has to be built first)
+internal void
+BenchmarkAssetLoading(char *FileName)
+{
+    if (!fs::exists(FileName))
     {
-        animation_clip *Animation = Asset->Animations + AnimationIndex;
+        printf("Asset loading: %s not found, skipping\n", FileName);
+        return;
+    }
 
-        model_asset_animation_header AnimationHeader = {};
-        CopyString(Animation->Name, AnimationHeader.Name, MAX_ANIMATION_NAME_LENGTH);
-        AnimationHeader.Duration = Animation->Duration;
-        AnimationHeader.IsLooping = Animation->IsLooping;
-        AnimationHeader.InPlace = Animation->InPlace;
-        AnimationHeader.PoseSampleCount = Animation->PoseSampleCount;
-        AnimationHeader.PoseSamplesOffset = AnimationsHeader.AnimationsOffset + sizeof(model_asset_animation_header) +
-            AnimationIndex * sizeof(model_asset_animation_header) + TotalPrevKeyFrameSize;
+    platform_work_queue Queue;
+    platform_api Platform = CreateBuilderPlatformApi(&Queue);
 
-        fwrite(&AnimationHeader, sizeof(model_asset_animation_header), 1, AssetFile);
+    platform_api CopyPlatform = Platform;
+    CopyPlatform.MapFile = 0;
 
-        u64 PrevKeyFrameSize = 0;
-        for (u32 AnimationPoseIndex = 0; AnimationPoseIndex < Animation->PoseSampleCount; ++AnimationPoseIndex)
-        {
-            animation_sample *AnimationPose = Animation->PoseSamples + AnimationPoseIndex;
+    umm FileSize = fs::file_size(FileName);
 
-            model_asset_animation_sample_header AnimationSampleHeader = {};
-            AnimationSampleHeader.JointIndex = AnimationPose->JointIndex;
-            AnimationSampleHeader.KeyFrameCount = AnimationPose->KeyFrameCount;
-            AnimationSampleHeader.KeyFramesOffset = AnimationHeader.PoseSamplesOffset + sizeof(model_asset_animation_sample_header) +
-                PrevKeyFrameSize;
+    memory_arena Arena;
+    umm ArenaSize = FileSize + Megabytes(4);
+    InitMemoryArena(&Arena, malloc(ArenaSize), ArenaSize);
 
-            PrevKeyFrameSize += sizeof(model_asset_animation_sample_header) + AnimationSampleHeader.KeyFrameCount * sizeof(key_frame);
+    u32 IterationCount = 20;
 
-            fwrite(&AnimationSampleHeader, sizeof(model_asset_animation_sample_header), 1, AssetFile);
-            fwrite(AnimationPose->KeyFrames, sizeof(key_frame), AnimationPose->KeyFrameCount, AssetFile);
-        }
+    platform_api *Platforms[] = { &CopyPlatform, &Platform };
+    const char *PlatformNames[] = { "copy", "map" };
 
-        TotalPrevKeyFrameSize += PrevKeyFrameSize;
-    }
+    printf("Asset loading (%s, %.2f MB):\n", FileName, FileSize / (f64)Megabytes(1));
 
-    fseek(AssetFile, 0, SEEK_SET);
-    fwrite(&Header, sizeof(model_asset_header), 1, AssetFile);
+    for (u32 PlatformIndex = 0; PlatformIndex < ArrayCount(Platforms); ++PlatformIndex)
+    {
+        platform_api *LoadPlatform = Platforms[PlatformIndex];
 
-    fclose(AssetFile);
-}
+        f64 LoadElapsed = 0.0;
+        f64 TouchElapsed = 0.0;
+        umm ArenaUsed = 0;
+        f32 Checksum = 0.f;
 
-internal void
-ProcessPelegriniModel()
-{
-    u32 Flags =
-        aiProcess_Triangulate |
-        aiProcess_FlipUVs |
-        aiProcess_GenNormals |
-        aiProcess_CalcTangentSpace |
-        aiProcess_JoinIdenticalVertices |
-        aiProcess_ValidateDataStructure |
-        aiProcess_LimitBoneWeights |
-        //aiProcess_GlobalScale |
-        aiProcess_RemoveRedundantMaterials |
-        aiProcess_FixInfacingNormals |
-        aiProcess_OptimizeGraph;
-        aiProcess_OptimizeMeshes;
+        for (u32 Iteration = 0; Iteration < IterationCount; ++Iteration)
+        {
+            scoped_memory ScopedMemory(&Arena);
 
-    model_asset Asset;
-    LoadModelAsset("models\\pelegrini\\pelegrini.fbx", &Asset, Flags);
+            f64 LoadStart = GetWallClockMilliseconds();
+            model_asset *Asset = LoadModelAsset(LoadPlatform, FileName, ScopedMemory.Arena);
+            LoadElapsed += GetWallClockMilliseconds() - LoadStart;
+
+            f64 TouchStart = GetWallClockMilliseconds();
+            Checksum += TouchMeshes(Asset);
+            TouchElapsed += GetWallClockMilliseconds() - TouchStart;
 
-    // todo: create config file
-    Asset.AnimationCount = 7;
-    Asset.Animations = (animation_clip *)malloc(Asset.AnimationCount * sizeof(animation_clip));
+            ArenaUsed = Arena.Used - ScopedMemory.Used;
 
-    u32 AnimationIndex = 0;
-    LoadAnimationClipAsset("models\\pelegrini\\animations\\idle (1).fbx", Flags, &Asset, "Idle", true, false, AnimationIndex++);
-    LoadAnimationClipAsset("models\\pelegrini\\animations\\idle (2).fbx", Flags, &Asset, "Idle_2", false, false, AnimationIndex++);
-    LoadAnimationClipAsset("models\\pelegrini\\animations\\idle (3).fbx", Flags, &Asset, "Idle_3", false, false, AnimationIndex++);
-    LoadAnimationClipAsset("models\\pelegrini\\animations\\idle (4).fbx", Flags, &Asset, "Idle_4", true, false, AnimationIndex++);
-    LoadAnimationClipAsset("models\\pelegrini\\animations\\walking.fbx", Flags, &Asset, "Walking", true, true, AnimationIndex++);
-    LoadAnimationClipAsset("models\\pelegrini\\animations\\running.fbx", Flags, &Asset, "Running", true, true, AnimationIndex++);
-    LoadAnimationClipAsset("models\\pelegrini\\animations\\samba.fbx", Flags, &Asset, "Samba", true, false, AnimationIndex++);
+            if (Asset->File)
+            {
+                Platform.UnmapFile(Asset->File);
+            }
+        }
 
-    WriteAssetFile("assets\\pelegrini.asset", &Asset);
+        // Arena memory is private to the process, mapped pages are shared and only resident once touched
+        printf("  %-4s: load %8.3f ms, first mesh access %8.3f ms, arena %10.2f KB (checksum %f)\n", PlatformNames[PlatformIndex],
+            LoadElapsed / IterationCount, TouchElapsed / IterationCount, ArenaUsed / 1024.0, Checksum / IterationCount);
+    }
 
-#if 1
-    model_asset TestAsset = {};
-    ReadAssetFile("assets\\pelegrini.asset", &TestAsset, &Asset);
-#endif
+    free(Arena.Base);
 }
 
 internal void
-ProcessAsset(const char *FilePath, const char *OutputPath)
+RunBenchmarks()
 {
-    u32 Flags =
-        aiProcess_Triangulate |
-        aiProcess_FlipUVs |
-        aiProcess_GenNormals |
-        aiProcess_CalcTangentSpace |
-        aiProcess_JoinIdenticalVertices |
-        aiProcess_ValidateDataStructure |
-        aiProcess_OptimizeMeshes |
-        aiProcess_LimitBoneWeights |
-        //aiProcess_GlobalScale |
-        aiProcess_RemoveRedundantMaterials |
-        aiProcess_FixInfacingNormals |
-        aiProcess_OptimizeGraph;
+    memory_arena Arena;
+    umm ArenaSize = Megabytes(64);
+    InitMemoryArena(&Arena, malloc(ArenaSize), ArenaSize);
+
+    platform_work_queue Queue;
+    platform_api Platform = CreateBuilderPlatformApi(&Queue);
+
+    model_asset Asset = {};
+    LoadPelegriniModel(&Asset, &Platform);
+
+    BenchmarkKeyFrameSearch(&Asset, &Arena);
+    BenchmarkAnimationClipFormats(&Asset, &Arena);
+    BenchmarkGlobalJointPoses(&Asset, &Arena);
+    BenchmarkSkinningPalette(&Asset, &Arena);
+    BenchmarkSkinning(&Asset, &Arena);
+    BenchmarkPoseBlending(&Asset, &Arena);
+    BenchmarkPoseAccumulation(&Asset, &Arena);
+    BenchmarkAdditivePose(&Asset, &Arena);
+    BenchmarkMotionMatching(&Asset, &Arena);
+    BenchmarkAssetLoading((char *)"assets\\pelegrini.asset");
+}
 
-    model_asset Asset;
-    LoadModelAsset(FilePath, &Asset, Flags);
-    // todo: check if has animations and process them as well
+i32 main(i32 ArgCount, char **Args)
+{
+    if (ArgCount > 1 && StringEquals(Args[1], "-benchmark"))
+    {
+        RunBenchmarks();
+        return 0;
+    }
 
+    b32 BuildPelegrini = ArgCount > 1 && StringEquals(Args[1], "-pelegrini");
 
+    platform_work_queue Queue;
+    platform_api Platform = CreateBuilderPlatformApi(&Queue);
 
-    WriteAssetFile(OutputPath, &Asset);
-}
+    build_cache Cache;
+    LoadBuildCache(BUILD_CACHE_PATH, &Cache);
+
+    // Entries of all current outputs, rebuilt or not
+    dynamic_array<build_cache_entry> CacheEntries;
+    u32 RebuiltAssetCount = 0;
+    // Failed assets get no cache entry, so they are retried on the next run
+    u32 FailedAssetCount = 0;
 
-i32 main(i32 ArgCount, char **Args)
-{
     // todo: get from Args
     string Path = "models\\";
     //string Path = "models\\pelegrini";
 
 #if 1
+    // Jobs point into the array, so all of them are collected before the queue is filled
+    dynamic_array<asset_build_job> AssetJobs;
+    // Cache entries of AssetJobs, kept once the job has built its asset
+    dynamic_array<build_cache_entry> AssetJobCacheEntries;
+
     for (const fs::directory_entry &Entry : fs::directory_iterator(Path))
     {
         if (Entry.is_directory())
@@ -1396,11 +4693,9 @@ i32 main(i32 ArgCount, char **Args)
             fs::path FileName = Entry.path().filename();
             fs::path AssetName = Entry.path().stem();
 
-            char FilePath[64];
-            FormatString(FilePath, ArrayCount(FilePath), "models\\%s", FileName.generic_string().c_str());
-
-            char OutputPath[64];
-            FormatString(OutputPath, ArrayCount(OutputPath), "assets\\%s.asset", AssetName.generic_string().c_str());
+            asset_build_job Job = {};
+            FormatString(Job.FilePath, ArrayCount(Job.FilePath), "models\\%s", FileName.generic_string().c_str());
+            FormatString(Job.OutputPath, ArrayCount(Job.OutputPath), "assets\\%s.asset", AssetName.generic_string().c_str());
 
 #if 1
             fs::path FileExtension = Entry.path().extension();
@@ -1411,13 +4706,100 @@ i32 main(i32 ArgCount, char **Args)
             }
 #endif
 
-            // todo: multithreading (std::thread maybe?)
-            ProcessAsset(FilePath, OutputPath);
+            const char *FilePaths[] = { Job.FilePath };
+            build_cache_entry CacheEntry = CreateBuildCacheEntry(Job.OutputPath, AssetImportFlags, FilePaths, ArrayCount(FilePaths));
+            asset_build_status Status = GetAssetBuildStatus(&Cache, &CacheEntry);
+
+            if (Status == AssetBuildStatus_UpToDate)
+            {
+                CacheEntries.push_back(CacheEntry);
+            }
+            else if (Status == AssetBuildStatus_Outdated)
+            {
+                AssetJobs.push_back(Job);
+                AssetJobCacheEntries.push_back(CacheEntry);
+            }
+        }
+    }
+
+    for (u32 JobIndex = 0; JobIndex < AssetJobs.size(); ++JobIndex)
+    {
+        Platform.AddWorkQueueEntry(Platform.WorkQueue, ProcessAssetJob, AssetJobs.data() + JobIndex);
+    }
+
+    Platform.CompleteAllWork(Platform.WorkQueue);
+
+    for (u32 JobIndex = 0; JobIndex < AssetJobs.size(); ++JobIndex)
+    {
+        if (AssetJobs[JobIndex].IsBuilt)
+        {
+            CacheEntries.push_back(AssetJobCacheEntries[JobIndex]);
+            ++RebuiltAssetCount;
+        }
+        else
+        {
+            ++FailedAssetCount;
         }
     }
 #endif
 
     //ProcessAsset("models\\dungeon.fbx", "dungeon.asset");
 
-    //ProcessPelegriniModel();
+    // Opt-in, the model source is not in the repository
+    if (BuildPelegrini)
+    {
+        // Model and all of its clips
+        const char *FilePaths[1 + ArrayCount(PelegriniAnimationClips)];
+        FilePaths[0] = PELEGRINI_MODEL_PATH;
+
+        for (u32 AnimationIndex = 0; AnimationIndex < ArrayCount(PelegriniAnimationClips); ++AnimationIndex)
+        {
+            FilePaths[AnimationIndex + 1] = PelegriniAnimationClips[AnimationIndex].FilePath;
+        }
+
+        build_cache_entry CacheEntry = CreateBuildCacheEntry(PELEGRINI_ASSET_PATH, PelegriniImportFlags, FilePaths, ArrayCount(FilePaths));
+        asset_build_status Status = GetAssetBuildStatus(&Cache, &CacheEntry);
+
+        if (Status == AssetBuildStatus_UpToDate)
+        {
+            CacheEntries.push_back(CacheEntry);
+        }
+        else if (Status == AssetBuildStatus_Outdated)
+        {
+            if (ProcessPelegriniModel(&Platform))
+            {
+                CacheEntries.push_back(CacheEntry);
+                ++RebuiltAssetCount;
+            }
+            else
+            {
+                ++FailedAssetCount;
+            }
+        }
+    }
+    else
+    {
+        // Previous output is still packed, so its entry is kept for the next opt-in run
+        build_cache_entry *CachedEntry = FindBuildCacheEntry(&Cache, PELEGRINI_ASSET_PATH);
+
+        if (CachedEntry && !Cache.IsVersionChanged)
+        {
+            CacheEntries.push_back(*CachedEntry);
+        }
+    }
+
+    printf("%u of %u assets rebuilt\n", RebuiltAssetCount, (u32)CacheEntries.size());
+
+    if (FailedAssetCount > 0)
+    {
+        printf("%u assets failed\n", FailedAssetCount);
+    }
+
+    WriteAssetPack("assets\\assets.pack", "assets\\");
+
+    // Written last, an interrupted build is redone on the next run
+    WriteBuildCache(BUILD_CACHE_PATH, CacheEntries);
+
+    i32 Result = FailedAssetCount > 0 ? 1 : 0;
+    return Result;
 }
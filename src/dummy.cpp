@@ -8,6 +8,7 @@
 #include "dummy_renderer.h"
 #include "dummy_animation.h"
 #include "dummy_assets.h"
+#include "dummy_skinning.h"
 #include "dummy.h"
 
 #include "dummy_assets.cpp"
@@ -15,6 +16,7 @@
 #include "dummy_physics.cpp"
 #include "dummy_renderer.cpp"
 #include "dummy_animation.cpp"
+#include "dummy_skinning.cpp"
 
 template <typename T>
 inline b32
@@ -187,18 +189,13 @@ CreateMaterial(material_type Type, vec4 Color, b32 Wireframe = false)
 }
 
 inline void
-DrawSkinnedModel(render_commands *RenderCommands, model *Model, skeleton_pose *Pose, transform Transform)
+DrawSkinnedModel(render_commands *RenderCommands, model *Model, entity_pose *Pose, transform Transform)
 {
     Assert(Model->Skeleton);
-    
-    for (u32 JointIndex = 0; JointIndex < Model->Skeleton->JointCount; ++JointIndex)
-    {
-        joint *Joint = Model->Skeleton->Joints + JointIndex;
-        mat4 *GlobalJointPose = Pose->GlobalJointPoses + JointIndex;
-        mat4 *SkinningMatrix = Model->SkinningMatrices + JointIndex;
+    Assert(Pose->SkeletonPose.Skeleton == Model->Skeleton);
 
-        *SkinningMatrix = *GlobalJointPose * Joint->InvBindTranform;
-    }
+    mat4 *SkinningMatrices = PushSkinningPalette(RenderCommands, Model->Skeleton->JointCount);
+    CalculateSkinningPalette(&Pose->SkeletonPose, SkinningMatrices);
 
     for (u32 MeshIndex = 0; MeshIndex < Model->MeshCount; ++MeshIndex)
     {
@@ -206,10 +203,7 @@ DrawSkinnedModel(render_commands *RenderCommands, model *Model, skeleton_pose *P
         mesh_material *MeshMaterial = Model->Materials + Mesh->MaterialIndex;
         material Material = CreateMaterial(MaterialType_BlinnPhong, MeshMaterial);
 
-        DrawSkinnedMesh(
-            RenderCommands, Mesh->Id, {}, Material,
-            Model->SkinningMatrixCount, Model->SkinningMatrices
-        );
+        DrawSkinnedMesh(RenderCommands, Mesh->Id, {}, Material);
     }
 }
 
@@ -246,7 +240,7 @@ DrawModelInstanced(render_commands *RenderCommands, model *Model, u32 InstanceCo
         mesh_material *MeshMaterial = Model->Materials + Mesh->MaterialIndex;
         material Material = CreateMaterial(MaterialType_BlinnPhong, MeshMaterial);
 
-        DrawMeshInstanced(RenderCommands, Mesh->Id, InstanceCount, Instances, Material);
+        DrawMeshInstanced(RenderCommands, Mesh->Id, InstanceCount, Instances, Material, Model->AnimationTextureId);
     }
 }
 
@@ -276,18 +270,22 @@ InitModel(model_asset *Asset, model *Model, const char *Name, memory_arena *Aren
     CopyString(Name, Model->Name, ArrayCount(Model->Name));
     Model->Skeleton = &Asset->Skeleton;
     Model->BindPose = &Asset->BindPose;
-    
-    Model->Pose = PushType(Arena, skeleton_pose);
-    Model->Pose->Skeleton = Model->Skeleton;
-    Model->Pose->LocalJointPoses = PushArray(Arena, Model->Skeleton->JointCount, joint_pose);
-    Model->Pose->GlobalJointPoses = PushArray(Arena, Model->Skeleton->JointCount, mat4);
 
-    for (u32 JointIndex = 0; JointIndex < Model->BindPose->Skeleton->JointCount; ++JointIndex)
+    if (Model->Skeleton->JointCount > 1)
     {
-        joint_pose *SourceLocalJointPose = Model->BindPose->LocalJointPoses + JointIndex;
-        joint_pose *DestLocalJointPose = Model->Pose->LocalJointPoses + JointIndex;
+        Model->JointHeights = PushArray(Arena, Model->Skeleton->JointCount, u32);
 
-        *DestLocalJointPose = *SourceLocalJointPose;
+        // Children are stored after parents, so walking backwards visits children first
+        for (i32 JointIndex = Model->Skeleton->JointCount - 1; JointIndex >= 0; --JointIndex)
+        {
+            joint *Joint = Model->Skeleton->Joints + JointIndex;
+
+            if (Joint->ParentIndex != -1)
+            {
+                u32 *ParentHeight = Model->JointHeights + Joint->ParentIndex;
+                *ParentHeight = Max(*ParentHeight, Model->JointHeights[JointIndex] + 1);
+            }
+        }
     }
 
     Model->MeshCount = Asset->MeshCount;
@@ -296,11 +294,13 @@ InitModel(model_asset *Asset, model *Model, const char *Name, memory_arena *Aren
     Model->Materials = Asset->Materials;
     Model->AnimationCount = Asset->AnimationCount;
     Model->Animations = Asset->Animations;
+    Model->MotionDatabase = Asset->MotionDatabase.FrameCount > 0 ? &Asset->MotionDatabase : 0;
 
-    if (Model->Skeleton)
+    if (Asset->AnimationTexture.ClipCount > 0)
     {
-        Model->SkinningMatrixCount = Model->Skeleton->JointCount;
-        Model->SkinningMatrices = PushArray(Arena, Model->SkinningMatrixCount, mat4);
+        Model->AnimationTexture = &Asset->AnimationTexture;
+        Model->AnimationTextureId = GenerateTextureId();
+        AddAnimationTexture(RenderCommands, Model->AnimationTextureId, Model->AnimationTexture);
     }
 
     for (u32 MeshIndex = 0; MeshIndex < Model->MeshCount; ++MeshIndex)
@@ -334,6 +334,7 @@ InitModel(model_asset *Asset, model *Model, const char *Name, memory_arena *Aren
     }
 
     Model->Bounds = CalculateAxisAlignedBoundingBox(Model);
+    Model->IsResident = true;
 }
 
 inline ray
@@ -363,6 +364,32 @@ ScreenPointToWorldRay(vec2 ScreenPoint, vec2 ScreenSize, game_camera *Camera)
     return Result;
 }
 
+// Each entity gets its own pose, sized by the joint count of its skeleton
+internal entity_pose *
+AllocateEntityPose(entity_pose_pool *Pool, model *Model)
+{
+    skeleton *Skeleton = Model->Skeleton;
+    u32 JointCount = Skeleton->JointCount;
+
+    entity_pose *Result = PushType(Pool->Arena, entity_pose);
+    Result->SkeletonPose.Skeleton = Skeleton;
+    Result->SkeletonPose.LocalJointPoses = PushArray(Pool->Arena, JointCount, joint_pose);
+    Result->SkeletonPose.GlobalJointPoses = PushArray(Pool->Arena, JointCount, mat4);
+    Result->FromLocalJointPoses = PushArray(Pool->Arena, JointCount, joint_pose);
+    Result->ToLocalJointPoses = PushArray(Pool->Arena, JointCount, joint_pose);
+
+    for (u32 JointIndex = 0; JointIndex < JointCount; ++JointIndex)
+    {
+        joint_pose *SourceLocalJointPose = Model->BindPose->LocalJointPoses + JointIndex;
+
+        Result->SkeletonPose.LocalJointPoses[JointIndex] = *SourceLocalJointPose;
+        Result->FromLocalJointPoses[JointIndex] = *SourceLocalJointPose;
+        Result->ToLocalJointPoses[JointIndex] = *SourceLocalJointPose;
+    }
+
+    return Result;
+}
+
 internal model *
 GetModelAsset(game_assets *Assets, const char *Name)
 {
@@ -370,6 +397,78 @@ GetModelAsset(game_assets *Assets, const char *Name)
     return Result;
 }
 
+internal PLATFORM_WORK_QUEUE_CALLBACK(LoadModelAssetInBackground)
+{
+    model_load_job *Job = (model_load_job *)Data;
+
+    asset_pack_entry *Entry = FindAssetPackEntry(Job->Pack, Job->AssetName);
+
+    if (Entry)
+    {
+        // Page faults of the mapped pack are taken here instead of on the main thread when the meshes are uploaded
+        TouchAssetPackEntry(Job->Pack, Entry);
+
+        Job->Asset = ReadModelAsset((u8 *)Job->Pack->Contents + Entry->Offset, Job->Arena);
+    }
+    else
+    {
+        Job->Asset = LoadLooseModelAsset(Job->Platform, Job->AssetName, Job->Arena);
+    }
+
+    AtomicExchangeU32(&Job->State, Job->Asset ? ModelLoadState_Loaded : ModelLoadState_Failed);
+}
+
+// Returns the model right away, it is skipped by rendering until ProcessLoadedModels uploads it
+internal model *
+RequestModelAsset(game_assets *Assets, platform_api *Platform, const char *Name, const char *AssetName, u32 MaxInstanceCount)
+{
+    model *Result = GetModelAsset(Assets, Name);
+
+    if (IsEmpty(Result))
+    {
+        CopyString(Name, Result->Name, ArrayCount(Result->Name));
+
+        Assert(Assets->ModelLoadJobCount < Assets->MaxModelLoadJobCount);
+        model_load_job *Job = Assets->ModelLoadJobs + Assets->ModelLoadJobCount++;
+
+        Job->State = ModelLoadState_Queued;
+        Job->Model = Result;
+        CopyString(Name, Job->ModelName, ArrayCount(Job->ModelName));
+        CopyString(AssetName, Job->AssetName, ArrayCount(Job->AssetName));
+        Job->MaxInstanceCount = MaxInstanceCount;
+        Job->Pack = &Assets->Pack;
+        Job->Platform = Platform;
+        Job->Arena = &Assets->StreamingArena;
+
+        if (Platform->BackgroundWorkQueue)
+        {
+            Platform->AddWorkQueueEntry(Platform->BackgroundWorkQueue, LoadModelAssetInBackground, Job);
+        }
+        else
+        {
+            LoadModelAssetInBackground(0, 0, Job);
+        }
+    }
+
+    return Result;
+}
+
+// Render commands can only be issued from the main thread
+internal void
+ProcessLoadedModels(game_assets *Assets, render_commands *RenderCommands, memory_arena *Arena)
+{
+    for (u32 JobIndex = 0; JobIndex < Assets->ModelLoadJobCount; ++JobIndex)
+    {
+        model_load_job *Job = Assets->ModelLoadJobs + JobIndex;
+
+        if (Job->State == ModelLoadState_Loaded)
+        {
+            InitModel(Job->Asset, Job->Model, Job->ModelName, Arena, RenderCommands, Job->MaxInstanceCount);
+            Job->State = ModelLoadState_Resident;
+        }
+    }
+}
+
 internal entity_render_batch *
 GetEntityBatch(game_state *State, char *Name)
 {
@@ -377,78 +476,95 @@ GetEntityBatch(game_state *State, char *Name)
     return Result;
 }
 
+internal model_asset *
+LoadGameModelAsset(game_assets *Assets, platform_api *Platform, const char *Name, memory_arena *Arena)
+{
+    model_asset *Result = LoadModelAsset(&Assets->Pack, Name, Arena);
+
+    if (!Result)
+    {
+        Result = LoadLooseModelAsset(Platform, Name, Arena);
+    }
+
+    return Result;
+}
+
 internal void
 InitGameAssets(game_assets *Assets, platform_api *Platform, render_commands *RenderCommands, memory_arena *Arena)
 {
     Assets->ModelCount = 32;
     Assets->Models = PushArray(Arena, Assets->ModelCount, model);
 
+    OpenAssetPack(Platform, (char *)"assets\\assets.pack", &Assets->Pack, Arena);
+
+    umm StreamingArenaSize = Megabytes(8);
+    InitMemoryArena(&Assets->StreamingArena, PushSize(Arena, StreamingArenaSize), StreamingArenaSize);
+
+    Assets->MaxModelLoadJobCount = Assets->ModelCount;
+    Assets->ModelLoadJobCount = 0;
+    Assets->ModelLoadJobs = PushArray(Arena, Assets->MaxModelLoadJobCount, model_load_job);
+
     u32 ModelIndex = 0;
 
     {
         char Name[32] = "Pelegrini";
         model *Model = GetModelAsset(Assets, Name);
-        model_asset *Asset = LoadModelAsset(Platform, (char *)"assets\\pelegrini.asset", Arena);
-        InitModel(Asset, Model, Name, Arena, RenderCommands);
+        model_asset *Asset = LoadGameModelAsset(Assets, Platform, "pelegrini", Arena);
+        // Instances are crowd entities, skinned with the animation texture
+        if (Asset)
+        {
+            InitModel(Asset, Model, Name, Arena, RenderCommands, 4096);
+        }
     }
 
+    // Models below are not needed to set up the world and are streamed in the background
     // todo: sRGB?
-    {
-        char Name[32] = "Cube";
-        model *Model = GetModelAsset(Assets, Name);
-        model_asset *Asset = LoadModelAsset(Platform, (char *)"assets\\cube.asset", Arena);
-        InitModel(Asset, Model, Name, Arena, RenderCommands, 256);
-    }
-
-    {
-        char Name[32] = "Sphere";
-        model *Model = GetModelAsset(Assets, Name);
-        model_asset *Asset = LoadModelAsset(Platform, (char *)"assets\\sphere.asset", Arena);
-        InitModel(Asset, Model, Name, Arena, RenderCommands, 256);
-    }
-
-    {
-        char Name[32] = "Skull";
-        model *Model = GetModelAsset(Assets, Name);
-        model_asset *Asset = LoadModelAsset(Platform, (char *)"assets\\skull.asset", Arena);
-        // todo: increasing MaxInstanceCount causes crash in Release mode.
-        InitModel(Asset, Model, Name, Arena, RenderCommands, 256);
-    }
+    RequestModelAsset(Assets, Platform, "Cube", "cube", 256);
+    RequestModelAsset(Assets, Platform, "Sphere", "sphere", 256);
+    // todo: increasing MaxInstanceCount causes crash in Release mode.
+    RequestModelAsset(Assets, Platform, "Skull", "skull", 256);
+    RequestModelAsset(Assets, Platform, "Banner Wall", "banner_wall", 256);
 
+    // Dungeon generation needs the bounds of these
     {
         char Name[32] = "Floor";
         model *Model = GetModelAsset(Assets, Name);
-        model_asset *Asset = LoadModelAsset(Platform, (char *)"assets\\floor.asset", Arena);
+        model_asset *Asset = LoadGameModelAsset(Assets, Platform, "floor", Arena);
         // todo: render instance count?
-        InitModel(Asset, Model, Name, Arena, RenderCommands, 4096);
+        if (Asset)
+        {
+            InitModel(Asset, Model, Name, Arena, RenderCommands, 4096);
+        }
     }
 
     {
         char Name[32] = "Wall";
         model *Model = GetModelAsset(Assets, Name);
-        model_asset *Asset = LoadModelAsset(Platform, (char *)"assets\\wall.asset", Arena);
-        InitModel(Asset, Model, Name, Arena, RenderCommands, 4096);
+        model_asset *Asset = LoadGameModelAsset(Assets, Platform, "wall", Arena);
+        if (Asset)
+        {
+            InitModel(Asset, Model, Name, Arena, RenderCommands, 4096);
+        }
     }
 
     {
         char Name[32] = "Wall_90";
         model *Model = GetModelAsset(Assets, Name);
-        model_asset *Asset = LoadModelAsset(Platform, (char *)"assets\\wall_90.asset", Arena);
-        InitModel(Asset, Model, Name, Arena, RenderCommands, 4096);
+        model_asset *Asset = LoadGameModelAsset(Assets, Platform, "wall_90", Arena);
+        if (Asset)
+        {
+            InitModel(Asset, Model, Name, Arena, RenderCommands, 4096);
+        }
     }
 
     {
         char Name[32] = "Column";
         model *Model = GetModelAsset(Assets, Name);
-        model_asset *Asset = LoadModelAsset(Platform, (char *)"assets\\column.asset", Arena);
-        InitModel(Asset, Model, Name, Arena, RenderCommands, 256);
-    }
-
-    {
-        char Name[32] = "Banner Wall";
-        model *Model = GetModelAsset(Assets, Name);
-        model_asset *Asset = LoadModelAsset(Platform, (char *)"assets\\banner_wall.asset", Arena);
-        InitModel(Asset, Model, Name, Arena, RenderCommands, 256);
+        model_asset *Asset = LoadGameModelAsset(Assets, Platform, "column", Arena);
+        if (Asset)
+        {
+            InitModel(Asset, Model, Name, Arena, RenderCommands, 256);
+        }
     }
 }
 
@@ -507,12 +623,161 @@ RenderCollisionVolume(render_commands *RenderCommands, game_state *State, game_e
     }
 }
 
+global animation_lod_settings AnimationLodSettings[AnimationLodLevel_Count] =
+{
+    // MinScreenSize, MaxDistance, UpdateInterval, MinJointHeight
+    { 0.25f, 32.f, 0.f, 0 },
+    { 0.1f, 64.f, 1.f / 30.f, 0 },
+    { 0.f, F32_MAX, 1.f / 15.f, 1 },
+    { 0.f, 0.f, 0.f, 0 }
+};
+
+// Screen size is the fraction of the screen height covered by the bounding sphere
+internal void
+UpdateAnimationLod(animation_lod *Lod, game_entity *Entity, game_camera *Camera, f32 Aspect)
+{
+    vec3 HalfSize = Entity->Transform.Scale * GetAABBHalfSize(Entity->Model->Bounds);
+    vec3 Center = Entity->Transform.Translation + vec3(0.f, HalfSize.y, 0.f);
+    f32 Radius = Magnitude(HalfSize);
+
+    vec3 Forward = Normalize(Camera->Direction);
+    vec3 Right = Normalize(Cross(Forward, Camera->Up));
+    vec3 Up = Cross(Right, Forward);
+
+    vec3 ToEntity = Center - Camera->Position;
+    f32 x = Dot(ToEntity, Right);
+    f32 y = Dot(ToEntity, Up);
+    f32 z = Dot(ToEntity, Forward);
+
+    f32 TanHalfFovY = Tan(Camera->FovY * 0.5f);
+    f32 TanHalfFovX = TanHalfFovY * Aspect;
+
+    // Bounding sphere against the view frustum side planes
+    b32 IsVisible =
+        (z + Radius > Camera->NearClipPlane) &&
+        (z - Radius < Camera->FarClipPlane) &&
+        (Abs(x) - z * TanHalfFovX < Radius * Sqrt(1.f + Square(TanHalfFovX))) &&
+        (Abs(y) - z * TanHalfFovY < Radius * Sqrt(1.f + Square(TanHalfFovY)));
+
+    Lod->Distance = Magnitude(ToEntity);
+    Lod->ScreenSize = Radius / (Max(z, Radius) * TanHalfFovY);
+
+    if (IsVisible)
+    {
+        u32 Level = AnimationLodLevel_Full;
+
+        while (Level < AnimationLodLevel_Offscreen - 1)
+        {
+            animation_lod_settings *Settings = AnimationLodSettings + Level;
+
+            if (Lod->ScreenSize >= Settings->MinScreenSize && Lod->Distance <= Settings->MaxDistance)
+            {
+                break;
+            }
+
+            ++Level;
+        }
+
+        Lod->Level = (animation_lod_level)Level;
+    }
+    else
+    {
+        Lod->Level = AnimationLodLevel_Offscreen;
+    }
+}
+
+internal PLATFORM_WORK_QUEUE_CALLBACK(AnimateEntity)
+{
+    animation_job *Job = (animation_job *)Data;
+    game_entity *Entity = Job->Entity;
+    memory_arena *Arena = Job->Arenas + ThreadIndex;
+    entity_pose *EntityPose = Entity->Pose;
+    skeleton_pose *Pose = &EntityPose->SkeletonPose;
+    animation_lod *Lod = &Entity->AnimationLod;
+
+    // Clocks are always advanced, so that the entity is in sync whenever it's back on screen
+    AnimationGraphPerFrameUpdate(Entity->Animation, Job->Delta);
+
+    if (Lod->Level == AnimationLodLevel_Offscreen)
+    {
+        // Forcing pose evaluation once the entity is visible again
+        Lod->Time = F32_MAX;
+        return;
+    }
+
+    animation_lod_settings *Settings = AnimationLodSettings + Lod->Level;
+    u32 JointCount = Pose->Skeleton->JointCount;
+
+    if (Settings->UpdateInterval == 0.f)
+    {
+        // Evaluated every frame straight into the displayed pose
+        CalculateSkeletonPose(Entity->Animation, Pose, Arena, Entity->Model->JointHeights, Settings->MinJointHeight, Job->PoseCache);
+
+        // Interpolation poses are not kept up to date, forcing pose evaluation once the entity drops to a reduced update rate
+        Lod->Time = F32_MAX;
+    }
+    else
+    {
+        b32 IsPoseStale = Lod->Time == F32_MAX;
+        Lod->Time += Job->Delta;
+
+        if (Lod->Time >= Settings->UpdateInterval)
+        {
+            // Interpolating from the displayed pose, so that LOD changes don't pop
+            for (u32 JointIndex = 0; JointIndex < JointCount; ++JointIndex)
+            {
+                EntityPose->FromLocalJointPoses[JointIndex] = Pose->LocalJointPoses[JointIndex];
+            }
+
+            if (IsPoseStale)
+            {
+                // Joints skipped by the evaluation keep the displayed pose
+                for (u32 JointIndex = 0; JointIndex < JointCount; ++JointIndex)
+                {
+                    EntityPose->ToLocalJointPoses[JointIndex] = Pose->LocalJointPoses[JointIndex];
+                }
+            }
+
+            skeleton_pose ToPose = {};
+            ToPose.Skeleton = Pose->Skeleton;
+            ToPose.LocalJointPoses = EntityPose->ToLocalJointPoses;
+
+            // Reduced-rate evaluations bypass the pose cache, only full LOD entities sample in sync every frame
+            CalculateSkeletonPose(Entity->Animation, &ToPose, Arena, Entity->Model->JointHeights, Settings->MinJointHeight, 0);
+
+            if (IsPoseStale)
+            {
+                for (u32 JointIndex = 0; JointIndex < JointCount; ++JointIndex)
+                {
+                    EntityPose->FromLocalJointPoses[JointIndex] = EntityPose->ToLocalJointPoses[JointIndex];
+                }
+            }
+
+            Lod->Time = Job->Delta;
+        }
+
+        f32 t = Min(Lod->Time / Settings->UpdateInterval, 1.f);
+
+        skeleton_pose FromPose = {};
+        FromPose.Skeleton = Pose->Skeleton;
+        FromPose.LocalJointPoses = EntityPose->FromLocalJointPoses;
+
+        skeleton_pose ToPose = {};
+        ToPose.Skeleton = Pose->Skeleton;
+        ToPose.LocalJointPoses = EntityPose->ToLocalJointPoses;
+
+        Lerp(&FromPose, t, &ToPose, Pose);
+    }
+
+    UpdateGlobalJointPoses(Pose, Entity->Transform);
+}
+
 internal void
 RenderEntity(render_commands *RenderCommands, game_state *State, game_entity *Entity)
 {
     if (Entity->Model->Skeleton->JointCount > 1)
     {
-        DrawSkinnedModel(RenderCommands, Entity->Model, Entity->Model->Pose, Entity->Transform);
+        DrawSkinnedModel(RenderCommands, Entity->Model, Entity->Pose, Entity->Transform);
     }
     else
     {
@@ -525,7 +790,7 @@ RenderEntity(render_commands *RenderCommands, game_state *State, game_entity *En
 
         if (Entity->Model->Skeleton->JointCount > 1)
         {
-            DrawSkeleton(RenderCommands, State, Entity->Model->Pose);
+            DrawSkeleton(RenderCommands, State, &Entity->Pose->SkeletonPose);
         }
     }
 }
@@ -570,6 +835,8 @@ AddEntityToRenderBatch(entity_render_batch *Batch, game_entity *Entity)
 
     *NextFreeEntity = Entity;
     NextFreeInstance->Model = Transform(Entity->Transform);
+    NextFreeInstance->AnimationClipIndex = Entity->AnimationClipIndex;
+    NextFreeInstance->AnimationTime = Entity->AnimationTime;
 
     Batch->EntityCount++;
 }
@@ -855,6 +1122,54 @@ GenerateDungeon(game_state *State, vec3 Origin, u32 RoomCount, vec3 Scale)
     }
 }
 
+// Crowd of CrowdSize x CrowdSize entities. The first AnimatedCrowdRowCount rows run their own instance of the player
+// animation graph (pose cache and animation LOD), the rest play clips baked into the animation texture if the model has one
+internal void
+SpawnCrowd(game_state *State)
+{
+    u32 CrowdSize = State->CrowdSize;
+    u32 AnimatedCrowdRowCount = 2;
+    f32 CrowdSpacing = 4.f;
+
+    model *CrowdModel = GetModelAsset(&State->Assets, "Pelegrini");
+    animation_texture *AnimationTexture = CrowdModel->AnimationTexture;
+    animation_graph_definition *AnimationGraph = State->Player->Animation->Definition;
+
+    for (u32 y = 0; y < CrowdSize; ++y)
+    {
+        b32 IsAnimatedRow = y < AnimatedCrowdRowCount || !AnimationTexture;
+
+        for (u32 x = 0; x < CrowdSize; ++x)
+        {
+            Assert(State->EntityCount < State->MaxEntityCount);
+
+            game_entity *Entity = State->Entities + State->EntityCount++;
+
+            vec3 Position = vec3((x - CrowdSize / 2.f) * CrowdSpacing, 0.f, 8.f + y * CrowdSpacing);
+
+            Entity->Model = CrowdModel;
+            Entity->Transform = CreateTransform(Position, vec3(3.f), quat(0.f, 0.f, 0.f, 1.f));
+
+            if (IsAnimatedRow)
+            {
+                random_sequence *Entropy = PushType(&State->PermanentArena, random_sequence);
+                *Entropy = RandomSequence(RandomNextU32(&State->RNG));
+
+                Entity->Pose = AllocateEntityPose(&State->PosePool, CrowdModel);
+                Entity->Animation = CreateAnimationGraphInstance(AnimationGraph, &State->PermanentArena, Entropy);
+                ActivateAnimationNode(Entity->Animation, State->PlayerAnimationNodes.Idle);
+            }
+            else
+            {
+                Entity->AnimationClipIndex = RandomChoice(&State->RNG, AnimationTexture->ClipCount);
+                Entity->AnimationTime = RandomBetween(&State->RNG, 0.f, 10.f);
+            }
+        }
+    }
+
+    State->IsCrowdSpawned = true;
+}
+
 DLLExport GAME_INIT(GameInit)
 {
     game_state *State = GetGameState(Memory);
@@ -906,22 +1221,66 @@ DLLExport GAME_INIT(GameInit)
 
     State->EntityCount = 0;
 
+    State->PosePool.Arena = &State->PermanentArena;
+
+    State->AnimationArenaCount = Platform->WorkQueueThreadCount;
+    State->AnimationArenas = PushArray(&State->PermanentArena, State->AnimationArenaCount, memory_arena);
+
+    for (u32 ArenaIndex = 0; ArenaIndex < State->AnimationArenaCount; ++ArenaIndex)
+    {
+        memory_arena *Arena = State->AnimationArenas + ArenaIndex;
+
+        umm ArenaSize = Megabytes(1);
+        InitMemoryArena(Arena, PushSize(&State->PermanentArena, ArenaSize), ArenaSize);
+    }
+
+    // Opt-in (see debug UI)
+    InitPoseCache(&State->PoseCache, 256, 256, &State->PermanentArena);
+    State->PoseCache.IsEnabled = false;
+    State->PoseCache.TimeStep = 1.f / 60.f;
+
     {
         game_entity *Entity = State->Entities + State->EntityCount++;
 
         State->Player = Entity;
 
         State->Player->Model = GetModelAsset(&State->Assets, "Pelegrini");
+        State->Player->Pose = AllocateEntityPose(&State->PosePool, State->Player->Model);
 
         State->Player->Body = PushType(&State->PermanentArena, rigid_body);
         BuildRigidBody(State->Player->Body, vec3(0.f, 0.f, 0.f), quat(0.f, 0.f, 0.f, 1.f), vec3(1.f, 3.f, 1.f));
+        // Velocity comes from root motion, it's kept between ticks without new animation time
+        State->Player->Body->Damping = 1.f;
 
         State->Player->Transform = CreateTransform(vec3(0.f), vec3(3.f), quat(0.f));
         State->Player->State = EntityState_Idle;
 
-        State->Player->Animation = PushType(&State->PermanentArena, animation_graph);
-        BuildAnimationGraph(State->Player->Animation, State->Player->Model, &State->PermanentArena, &State->RNG);
-        ActivateAnimationNode(State->Player->Animation, "Idle_Node");
+        // Each animated entity has its own entropy, graphs are updated on different threads
+        random_sequence *Entropy = PushType(&State->PermanentArena, random_sequence);
+        *Entropy = RandomSequence(RandomNextU32(&State->RNG));
+
+        AddJointMask(State->Player->Model->Skeleton, "UpperBody", "mixamorig:Spine", &State->PermanentArena);
+
+        animation_graph_definition *AnimationGraph = 0;
+
+        {
+            scoped_memory ScopedMemory(&State->TransientArena);
+
+            animation_graph *Graph = PushType(ScopedMemory.Arena, animation_graph);
+            // Experimental motion matching locomotion (Move_Node)
+            b32 UseMotionMatching = false;
+            BuildAnimationGraph(Graph, State->Player->Model, ScopedMemory.Arena, UseMotionMatching);
+
+            AnimationGraph = CompileAnimationGraph(Graph, &State->PermanentArena);
+
+            State->PlayerAnimationNodes.Idle = GetAnimationNode(Graph, "Idle_Node")->Index;
+            State->PlayerAnimationNodes.Move = GetAnimationNode(Graph, "Move_Node")->Index;
+            State->PlayerAnimationNodes.Dance = GetAnimationNode(Graph, "Dance_Node")->Index;
+        }
+
+        State->Player->Animation = CreateAnimationGraphInstance(AnimationGraph, &State->PermanentArena, Entropy);
+        State->Player->Animation->HasRootMotion = true;
+        ActivateAnimationNode(State->Player->Animation, State->PlayerAnimationNodes.Idle);
     }
 
     {
@@ -947,6 +1306,9 @@ DLLExport GAME_INIT(GameInit)
     GenerateDungeon(State, vec3(0.f), 24, vec3(2.f));
 #endif
 
+    // Opt-in (see debug UI)
+    State->CrowdSize = 8;
+
     State->PointLightCount = 2;
     State->PointLights = PushArray(&State->PermanentArena, State->PointLightCount, point_light);
 
@@ -1116,12 +1478,6 @@ DLLExport GAME_PROCESS_INPUT(GameProcessInput)
             vec3 yMoveAxis = Normalize(Projection(State->PlayerCamera.Direction, State->Ground));
             vec3 xMoveAxis = Normalize(Orthogonal(yMoveAxis, State->Ground));
 
-            f32 xMoveY = Dot(yMoveAxis, xAxis) * Move.y;
-            f32 zMoveY = Dot(yMoveAxis, zAxis) * Move.y;
-
-            f32 xMoveX = Dot(xMoveAxis, xAxis) * Move.x;
-            f32 zMoveX = Dot(xMoveAxis, zAxis) * Move.x;
-
             f32 MoveMaginute = Clamp(Magnitude(Move), 0.f, 1.f);
             
             f32 Clock = 1.f;
@@ -1133,11 +1489,9 @@ DLLExport GAME_PROCESS_INPUT(GameProcessInput)
 
             vec3 PlayerDirection = vec3(Dot(vec3(Move.x, 0.f, Move.y), xMoveAxis), 0.f, Dot(vec3(Move.x, 0.f, Move.y), yMoveAxis));
 
+            // Player is moved by the root motion of the animation (see GameUpdate)
             State->TargetMove = Move;
 
-            State->Player->Body->Acceleration.x = (xMoveX + xMoveY) * 120.f;
-            State->Player->Body->Acceleration.z = (zMoveX + zMoveY) * 120.f;
-
             quat PlayerOrientation = AxisAngle2Quat(vec4(yAxis, Atan2(PlayerDirection.x, PlayerDirection.z)));
 
             if (MoveMaginute > 0.f)
@@ -1162,13 +1516,13 @@ DLLExport GAME_PROCESS_INPUT(GameProcessInput)
                     if (Input->Crouch.IsActivated)
                     {
                         State->Player->State = EntityState_Dance;
-                        TransitionToNode(State->Player->Animation, "Dance_Node");
+                        TransitionToNode(State->Player->Animation, State->PlayerAnimationNodes.Dance);
                     }
                     
                     if (MoveMaginute > 0.f)
                     {
                         State->Player->State = EntityState_Moving;
-                        TransitionToNode(State->Player->Animation, "Move_Node");
+                        TransitionToNode(State->Player->Animation, State->PlayerAnimationNodes.Move);
                     }
 
                     break;
@@ -1178,7 +1532,7 @@ DLLExport GAME_PROCESS_INPUT(GameProcessInput)
                     if (MoveMaginute < EPSILON)
                     {
                         State->Player->State = EntityState_Idle;
-                        TransitionToNode(State->Player->Animation, "Idle_Node");
+                        TransitionToNode(State->Player->Animation, State->PlayerAnimationNodes.Idle);
                     }
 
                     break;
@@ -1188,7 +1542,7 @@ DLLExport GAME_PROCESS_INPUT(GameProcessInput)
                     if (Input->Crouch.IsActivated && MoveMaginute < EPSILON)
                     {
                         State->Player->State = EntityState_Idle;
-                        TransitionToNode(State->Player->Animation, "Idle_Node");
+                        TransitionToNode(State->Player->Animation, State->PlayerAnimationNodes.Idle);
                     }
 
                     break;
@@ -1246,6 +1600,11 @@ DLLExport GAME_UPDATE(GameUpdate)
 {
     game_state *State = GetGameState(Memory);
 
+    if (State->IsCrowdRequested && !State->IsCrowdSpawned)
+    {
+        SpawnCrowd(State);
+    }
+
     //if (State->Advance)
     {
         State->Advance = false;
@@ -1264,6 +1623,16 @@ DLLExport GAME_UPDATE(GameUpdate)
         {
             rigid_body *Body = State->Player->Body;
 
+            root_motion RootMotion = ExtractRootMotion(Player->Animation, &State->TransientArena);
+
+            if (RootMotion.Duration > 0.f)
+            {
+                vec3 Translation = Rotate(RootMotion.Translation * Player->Transform.Scale, Body->Orientation);
+
+                Body->Velocity = Translation / RootMotion.Duration;
+                Body->Orientation = Normalize(AxisAngle2Quat(vec4(0.f, 1.f, 0.f, RootMotion.Yaw)) * Body->Orientation);
+            }
+
             //AddGravityForce(Body, vec3(0.f, -10.f, 0.f));
             Integrate(Body, Parameters->UpdateRate);
 
@@ -1311,6 +1680,8 @@ DLLExport GAME_RENDER(GameRender)
     f32 Lag = Parameters->UpdateLag / Parameters->UpdateRate;
 
     SetViewport(RenderCommands, 0, 0, Parameters->WindowWidth, Parameters->WindowHeight);
+
+    ProcessLoadedModels(&State->Assets, RenderCommands, &State->PermanentArena);
     
     switch (State->Mode)
     {
@@ -1384,19 +1755,45 @@ DLLExport GAME_RENDER(GameRender)
             vec2 dMove = (State->TargetMove - State->CurrentMove) / InterpolationTime;
             State->CurrentMove += dMove * Parameters->Delta;
 
-            skeleton_pose *Pose = State->Player->Model->Pose;
-            
             // todo: ?
-            (State->Player->Animation->Nodes + 1)->Params->Move = Clamp(Magnitude(State->CurrentMove), 0.f, 1.f);
-
-            AnimationGraphPerFrameUpdate(State->Player->Animation, Parameters->Delta);
-            CalculateSkeletonPose(State->Player->Animation, Pose, &State->PermanentArena);
+            State->Player->Animation->Params.Move = Clamp(Magnitude(State->CurrentMove), 0.f, 1.f);
 
             // transform.translation for rigid bodies
             State->Player->Transform.Translation = Lerp(State->Player->Body->PrevPosition, Lag, State->Player->Body->Position);
             State->Player->Transform.Rotation = State->Player->Body->Orientation;
 
-            UpdateGlobalJointPoses(Pose, State->Player->Transform);
+            // Animation
+            {
+                platform_api *Platform = Memory->Platform;
+
+                ResetPoseCache(&State->PoseCache);
+
+                animation_job *AnimationJobs = PushArray(&State->TransientArena, State->EntityCount, animation_job);
+
+                for (u32 EntityIndex = 0; EntityIndex < State->EntityCount; ++EntityIndex)
+                {
+                    game_entity *Entity = State->Entities + EntityIndex;
+
+                    if (Entity->Animation)
+                    {
+                        UpdateAnimationLod(&Entity->AnimationLod, Entity, Camera, Aspect);
+
+                        animation_job *Job = AnimationJobs + EntityIndex;
+                        Job->Entity = Entity;
+                        Job->Arenas = State->AnimationArenas;
+                        Job->PoseCache = &State->PoseCache;
+                        Job->Delta = Parameters->Delta;
+
+                        Platform->AddWorkQueueEntry(Platform->WorkQueue, AnimateEntity, Job);
+                    }
+                    else if (Entity->Model->AnimationTexture)
+                    {
+                        Entity->AnimationTime += Parameters->Delta;
+                    }
+                }
+
+                Platform->CompleteAllWork(Platform->WorkQueue);
+            }
 
             // Flying skulls
             {
@@ -1420,6 +1817,20 @@ DLLExport GAME_RENDER(GameRender)
             for (u32 EntityIndex = 0; EntityIndex < State->EntityCount; ++EntityIndex)
             {
                 game_entity *Entity = State->Entities + EntityIndex;
+
+                // Model is still streaming
+                if (!Entity->Model->IsResident)
+                {
+                    continue;
+                }
+
+                // Animated entities are skinned with their own palette
+                if (Entity->Pose)
+                {
+                    RenderEntity(RenderCommands, State, Entity);
+                    continue;
+                }
+
                 entity_render_batch *Batch = GetEntityBatch(State, Entity->Model->Name);
 
                 if (IsEmpty(Batch))
@@ -1437,7 +1848,10 @@ DLLExport GAME_RENDER(GameRender)
 
                 u32 BatchThreshold = 1;
 
-                if (Batch->EntityCount > BatchThreshold)
+                // Skinned entities left here play baked clips, which are only supported by the instanced path
+                b32 IsBakedAnimation = Batch->EntityCount > 0 && Batch->Model->Skeleton->JointCount > 1;
+
+                if (Batch->EntityCount > BatchThreshold || IsBakedAnimation)
                 {
                     // todo: need to add mesh instanced first :(
                     RenderEntityBatch(RenderCommands, State, Batch);
@@ -36,19 +36,78 @@ enum entity_state
     EntityState_Dance
 };
 
+enum animation_lod_level
+{
+    AnimationLodLevel_Full,
+    AnimationLodLevel_Half,
+    AnimationLodLevel_Quarter,
+    // Only clocks are advanced
+    AnimationLodLevel_Offscreen,
+
+    AnimationLodLevel_Count
+};
+
+struct animation_lod_settings
+{
+    f32 MinScreenSize;
+    f32 MaxDistance;
+    f32 UpdateInterval;
+    u32 MinJointHeight;
+};
+
+struct animation_lod
+{
+    animation_lod_level Level;
+    // Time since the last pose evaluation, F32_MAX forces the next one
+    f32 Time;
+    f32 ScreenSize;
+    f32 Distance;
+};
+
+// Pose of a single entity (model only holds shared data)
+struct entity_pose
+{
+    // Displayed pose, interpolated from FromLocalJointPoses to ToLocalJointPoses between pose evaluations
+    skeleton_pose SkeletonPose;
+
+    joint_pose *FromLocalJointPoses;
+    joint_pose *ToLocalJointPoses;
+};
+
+// Entities are never removed, so poses live as long as the pool arena
+struct entity_pose_pool
+{
+    memory_arena *Arena;
+};
+
 struct game_entity
 {
     transform Transform;
 
     model *Model;
     rigid_body *Body;
-    animation_graph *Animation;
+    animation_graph_instance *Animation;
+    entity_pose *Pose;
+    animation_lod AnimationLod;
+
+    // Baked clip of the model animation texture, played by entities without an animation graph
+    u32 AnimationClipIndex;
+    f32 AnimationTime;
 
     entity_state State;
 
     b32 DebugView;
 };
 
+struct animation_job
+{
+    game_entity *Entity;
+    // Scratch arena per work queue thread
+    memory_arena *Arenas;
+    pose_cache *PoseCache;
+    f32 Delta;
+};
+
 struct entity_render_batch
 {
     char Name[256];
@@ -69,10 +128,53 @@ struct game_process
     game_process *Next;
 };
 
+enum model_load_state
+{
+    ModelLoadState_Queued,
+    // Read by the background thread, waiting for the main thread to upload it
+    ModelLoadState_Loaded,
+    ModelLoadState_Resident,
+    // Not a supported model asset, the model is never drawn
+    ModelLoadState_Failed
+};
+
+struct model_load_job
+{
+    u32 volatile State;
+
+    model *Model;
+    char ModelName[64];
+    char AssetName[MAX_ASSET_PACK_NAME_LENGTH];
+    u32 MaxInstanceCount;
+
+    asset_pack *Pack;
+    platform_api *Platform;
+    memory_arena *Arena;
+    // Valid once State is ModelLoadState_Loaded
+    model_asset *Asset;
+};
+
 struct game_assets
 {
+    asset_pack Pack;
+
     u32 ModelCount;
     model *Models;
+
+    // Only used by the background thread
+    memory_arena StreamingArena;
+
+    u32 MaxModelLoadJobCount;
+    u32 ModelLoadJobCount;
+    model_load_job *ModelLoadJobs;
+};
+
+// Compiled node indices, node names are resolved once when the graph is built
+struct player_animation_nodes
+{
+    u32 Idle;
+    u32 Move;
+    u32 Dance;
 };
 
 struct game_state
@@ -92,11 +194,24 @@ struct game_state
     game_assets Assets;
 
     game_entity *Player;
+    player_animation_nodes PlayerAnimationNodes;
 
     u32 MaxEntityCount;
     u32 EntityCount;
     game_entity *Entities;
 
+    entity_pose_pool PosePool;
+
+    u32 AnimationArenaCount;
+    memory_arena *AnimationArenas;
+
+    pose_cache PoseCache;
+
+    // Crowd is spawned once, when requested from the debug UI
+    u32 CrowdSize;
+    b32 IsCrowdRequested;
+    b32 IsCrowdSpawned;
+
     u32 EntityBatchCount;
     entity_render_batch *EntityBatches;
 
@@ -5,78 +5,902 @@ GetRootLocalJointPose(skeleton_pose *Pose)
     return Result;
 }
 
-inline joint_pose *
-GetRootTranslationLocalJointPose(skeleton_pose *SkeletonPose)
+inline joint_pose
+Lerp(joint_pose *From, f32 t, joint_pose *To)
+{
+    joint_pose Result;
+
+    Result.Translation = Lerp(From->Translation, t, To->Translation);
+    Result.Rotation = Slerp(From->Rotation, t, To->Rotation);
+    Result.Scale = Lerp(From->Scale, t, To->Scale);
+
+    return Result;
+}
+
+// Blends Stride joints (multiple of JOINT_POSE_LANE_COUNT) laid out as animation_frame_channel arrays,
+// rotations are nlerp'ed along the shortest path
+internal void
+LerpJointPoseChannels(f32 *From, f32 t, f32 *To, f32 *Dest, u32 Stride)
+{
+    Assert(Stride % JOINT_POSE_LANE_COUNT == 0);
+
+    __m128 T = _mm_set1_ps(t);
+    __m128 One = _mm_set1_ps(1.f);
+    __m128 Zero = _mm_setzero_ps();
+    __m128 SignMask = _mm_set1_ps(-0.f);
+
+    for (u32 LaneIndex = 0; LaneIndex < Stride; LaneIndex += JOINT_POSE_LANE_COUNT)
+    {
+        __m128 FromValues[AnimationFrameChannel_Count];
+        __m128 ToValues[AnimationFrameChannel_Count];
+        __m128 DestValues[AnimationFrameChannel_Count];
+
+        for (u32 ChannelIndex = 0; ChannelIndex < AnimationFrameChannel_Count; ++ChannelIndex)
+        {
+            u32 Offset = ChannelIndex * Stride + LaneIndex;
+            FromValues[ChannelIndex] = _mm_loadu_ps(From + Offset);
+            ToValues[ChannelIndex] = _mm_loadu_ps(To + Offset);
+        }
+
+        __m128 Dot = Zero;
+        for (u32 ChannelIndex = AnimationFrameChannel_RotationX; ChannelIndex <= AnimationFrameChannel_RotationW; ++ChannelIndex)
+        {
+            Dot = _mm_add_ps(Dot, _mm_mul_ps(FromValues[ChannelIndex], ToValues[ChannelIndex]));
+        }
+
+        // Flipping target rotation sign where the quats are in the opposite hemispheres
+        __m128 Sign = _mm_and_ps(Dot, SignMask);
+
+        for (u32 ChannelIndex = AnimationFrameChannel_RotationX; ChannelIndex <= AnimationFrameChannel_RotationW; ++ChannelIndex)
+        {
+            ToValues[ChannelIndex] = _mm_xor_ps(ToValues[ChannelIndex], Sign);
+        }
+
+        for (u32 ChannelIndex = 0; ChannelIndex < AnimationFrameChannel_Count; ++ChannelIndex)
+        {
+            __m128 Delta = _mm_sub_ps(ToValues[ChannelIndex], FromValues[ChannelIndex]);
+            DestValues[ChannelIndex] = _mm_add_ps(FromValues[ChannelIndex], _mm_mul_ps(T, Delta));
+        }
+
+        __m128 LengthSquared = Zero;
+        for (u32 ChannelIndex = AnimationFrameChannel_RotationX; ChannelIndex <= AnimationFrameChannel_RotationW; ++ChannelIndex)
+        {
+            LengthSquared = _mm_add_ps(LengthSquared, _mm_mul_ps(DestValues[ChannelIndex], DestValues[ChannelIndex]));
+        }
+
+        // Padding lanes are zero, keeping them zero instead of dividing by zero
+        __m128 IsValid = _mm_cmpgt_ps(LengthSquared, Zero);
+        __m128 InvLength = _mm_and_ps(_mm_div_ps(One, _mm_sqrt_ps(LengthSquared)), IsValid);
+
+        for (u32 ChannelIndex = AnimationFrameChannel_RotationX; ChannelIndex <= AnimationFrameChannel_RotationW; ++ChannelIndex)
+        {
+            DestValues[ChannelIndex] = _mm_mul_ps(DestValues[ChannelIndex], InvLength);
+        }
+
+        for (u32 ChannelIndex = 0; ChannelIndex < AnimationFrameChannel_Count; ++ChannelIndex)
+        {
+            _mm_storeu_ps(Dest + ChannelIndex * Stride + LaneIndex, DestValues[ChannelIndex]);
+        }
+    }
+}
+
+internal void
+Lerp(skeleton_pose_soa *From, f32 t, skeleton_pose_soa *To, skeleton_pose_soa *Dest)
+{
+    Assert(From->Stride == Dest->Stride);
+    Assert(To->Stride == Dest->Stride);
+
+    LerpJointPoseChannels(From->Channels, t, To->Channels, Dest->Channels, Dest->Stride);
+}
+
+inline u32
+GetJointPoseStride(u32 JointCount)
+{
+    u32 Result = (JointCount + JOINT_POSE_LANE_COUNT - 1) / JOINT_POSE_LANE_COUNT * JOINT_POSE_LANE_COUNT;
+    return Result;
+}
+
+internal skeleton_pose_soa
+CreateSkeletonPoseSoa(skeleton *Skeleton, memory_arena *Arena)
+{
+    skeleton_pose_soa Result = {};
+
+    Result.Skeleton = Skeleton;
+    Result.Stride = GetJointPoseStride(Skeleton->JointCount);
+
+    u32 ValueCount = Result.Stride * AnimationFrameChannel_Count;
+    Result.Channels = PushArray(Arena, ValueCount, f32);
+
+    for (u32 ValueIndex = 0; ValueIndex < ValueCount; ++ValueIndex)
+    {
+        Result.Channels[ValueIndex] = 0.f;
+    }
+
+    return Result;
+}
+
+// joint_pose is Rotation, Translation, Scale - exactly animation_frame_channel order
+inline f32 *
+GetJointPoseValues(joint_pose *Pose)
+{
+    f32 *Result = (f32 *)Pose;
+    return Result;
+}
+
+internal void
+CopyJointPosesToSoa(joint_pose *Poses, u32 JointCount, f32 *Channels, u32 Stride)
+{
+    for (u32 JointIndex = 0; JointIndex < JointCount; ++JointIndex)
+    {
+        f32 *Values = GetJointPoseValues(Poses + JointIndex);
+
+        for (u32 ChannelIndex = 0; ChannelIndex < AnimationFrameChannel_Count; ++ChannelIndex)
+        {
+            Channels[ChannelIndex * Stride + JointIndex] = Values[ChannelIndex];
+        }
+    }
+}
+
+internal void
+CopyJointPosesFromSoa(f32 *Channels, u32 Stride, joint_pose *Poses, u32 JointCount)
+{
+    for (u32 JointIndex = 0; JointIndex < JointCount; ++JointIndex)
+    {
+        f32 *Values = GetJointPoseValues(Poses + JointIndex);
+
+        for (u32 ChannelIndex = 0; ChannelIndex < AnimationFrameChannel_Count; ++ChannelIndex)
+        {
+            Values[ChannelIndex] = Channels[ChannelIndex * Stride + JointIndex];
+        }
+    }
+}
+
+inline void
+CopySkeletonPoseToSoa(skeleton_pose *Pose, skeleton_pose_soa *Dest)
+{
+    CopyJointPosesToSoa(Pose->LocalJointPoses, Pose->Skeleton->JointCount, Dest->Channels, Dest->Stride);
+}
+
+inline void
+CopySkeletonPoseFromSoa(skeleton_pose_soa *Pose, skeleton_pose *Dest)
+{
+    CopyJointPosesFromSoa(Pose->Channels, Pose->Stride, Dest->LocalJointPoses, Dest->Skeleton->JointCount);
+}
+
+// AoS adapter: transposes JOINT_POSE_LANE_COUNT joints at a time into SoA blocks on the stack
+internal void
+Lerp(skeleton_pose *From, f32 t, skeleton_pose *To, skeleton_pose *Dest)
+{
+    u32 JointCount = Dest->Skeleton->JointCount;
+
+    Assert(From->Skeleton->JointCount == JointCount);
+    Assert(To->Skeleton->JointCount == JointCount);
+
+    for (u32 JointIndex = 0; JointIndex < JointCount; JointIndex += JOINT_POSE_LANE_COUNT)
+    {
+        u32 LaneCount = JointCount - JointIndex < JOINT_POSE_LANE_COUNT ? JointCount - JointIndex : JOINT_POSE_LANE_COUNT;
+
+        f32 FromChannels[AnimationFrameChannel_Count * JOINT_POSE_LANE_COUNT] = {};
+        f32 ToChannels[AnimationFrameChannel_Count * JOINT_POSE_LANE_COUNT] = {};
+        f32 DestChannels[AnimationFrameChannel_Count * JOINT_POSE_LANE_COUNT];
+
+        CopyJointPosesToSoa(From->LocalJointPoses + JointIndex, LaneCount, FromChannels, JOINT_POSE_LANE_COUNT);
+        CopyJointPosesToSoa(To->LocalJointPoses + JointIndex, LaneCount, ToChannels, JOINT_POSE_LANE_COUNT);
+
+        LerpJointPoseChannels(FromChannels, t, ToChannels, DestChannels, JOINT_POSE_LANE_COUNT);
+
+        CopyJointPosesFromSoa(DestChannels, JOINT_POSE_LANE_COUNT, Dest->LocalJointPoses + JointIndex, LaneCount);
+    }
+}
+
+// Joints are stored parent-before-child, so each joint only needs its parent's global pose
+internal void
+CalculateGlobalJointPoses(skeleton_pose *Pose)
+{
+    for (u32 JointIndex = 0; JointIndex < Pose->Skeleton->JointCount; ++JointIndex)
+    {
+        joint *Joint = Pose->Skeleton->Joints + JointIndex;
+        joint_pose *LocalJointPose = Pose->LocalJointPoses + JointIndex;
+        mat4 *GlobalJointPose = Pose->GlobalJointPoses + JointIndex;
+
+        Assert(Joint->ParentIndex < (i32)JointIndex);
+
+        mat4 Local = Transform(*LocalJointPose);
+
+        if (Joint->ParentIndex == -1)
+        {
+            *GlobalJointPose = Local;
+        }
+        else
+        {
+            mat4 *ParentGlobalJointPose = Pose->GlobalJointPoses + Joint->ParentIndex;
+            MultiplyMat4(GlobalJointPose, ParentGlobalJointPose, &Local);
+        }
+    }
+}
+
+// Writes GlobalJointPose * InvBindTransform for every joint into Palette (which can be the render command buffer).
+// Global joint poses are affine, so the last row of each product is just the last row of the inverse bind transform
+internal void
+CalculateSkinningPalette(skeleton_pose *Pose, mat4 *Palette)
+{
+    for (u32 JointIndex = 0; JointIndex < Pose->Skeleton->JointCount; ++JointIndex)
+    {
+        joint *Joint = Pose->Skeleton->Joints + JointIndex;
+        mat4 *GlobalJointPose = Pose->GlobalJointPoses + JointIndex;
+        mat4 *SkinningMatrix = Palette + JointIndex;
+
+        __m128 BindRow0 = _mm_loadu_ps(Joint->InvBindTranform.Elements[0]);
+        __m128 BindRow1 = _mm_loadu_ps(Joint->InvBindTranform.Elements[1]);
+        __m128 BindRow2 = _mm_loadu_ps(Joint->InvBindTranform.Elements[2]);
+        __m128 BindRow3 = _mm_loadu_ps(Joint->InvBindTranform.Elements[3]);
+
+        for (u32 RowIndex = 0; RowIndex < 3; ++RowIndex)
+        {
+            __m128 PoseRow = _mm_loadu_ps(GlobalJointPose->Elements[RowIndex]);
+
+            __m128 Row = _mm_mul_ps(_mm_shuffle_ps(PoseRow, PoseRow, _MM_SHUFFLE(0, 0, 0, 0)), BindRow0);
+            Row = _mm_add_ps(Row, _mm_mul_ps(_mm_shuffle_ps(PoseRow, PoseRow, _MM_SHUFFLE(1, 1, 1, 1)), BindRow1));
+            Row = _mm_add_ps(Row, _mm_mul_ps(_mm_shuffle_ps(PoseRow, PoseRow, _MM_SHUFFLE(2, 2, 2, 2)), BindRow2));
+            Row = _mm_add_ps(Row, _mm_mul_ps(_mm_shuffle_ps(PoseRow, PoseRow, _MM_SHUFFLE(3, 3, 3, 3)), BindRow3));
+
+            _mm_storeu_ps(SkinningMatrix->Elements[RowIndex], Row);
+        }
+
+        _mm_storeu_ps(SkinningMatrix->Elements[3], BindRow3);
+    }
+}
+
+inline u32
+GetJointIndex(skeleton *Skeleton, const char *JointName)
+{
+    u32 Result = U32_MAX;
+
+    for (u32 JointIndex = 0; JointIndex < Skeleton->JointCount; ++JointIndex)
+    {
+        if (StringEquals(Skeleton->Joints[JointIndex].Name, JointName))
+        {
+            Result = JointIndex;
+            break;
+        }
+    }
+
+    Assert(Result != U32_MAX);
+
+    return Result;
+}
+
+inline u32
+GetJointMaskIndex(skeleton *Skeleton, const char *MaskName)
+{
+    u32 Result = U32_MAX;
+
+    for (u32 MaskIndex = 0; MaskIndex < Skeleton->JointMaskCount; ++MaskIndex)
+    {
+        if (StringEquals(Skeleton->JointMasks[MaskIndex].Name, MaskName))
+        {
+            Result = MaskIndex;
+            break;
+        }
+    }
+
+    Assert(Result != U32_MAX);
+
+    return Result;
+}
+
+// Mask that covers the subtree of the root joint (root joint included)
+internal u32
+AddJointMask(skeleton *Skeleton, const char *MaskName, const char *RootJointName, memory_arena *Arena)
+{
+    Assert(Skeleton->JointMaskCount < MAX_JOINT_MASK_COUNT);
+
+    u32 Result = Skeleton->JointMaskCount++;
+
+    joint_mask *Mask = Skeleton->JointMasks + Result;
+    CopyString(MaskName, Mask->Name, ArrayCount(Mask->Name));
+    Mask->Weights = PushArray(Arena, Skeleton->JointCount, f32);
+
+    u32 RootJointIndex = GetJointIndex(Skeleton, RootJointName);
+
+    for (u32 JointIndex = 0; JointIndex < Skeleton->JointCount; ++JointIndex)
+    {
+        i32 ParentIndex = Skeleton->Joints[JointIndex].ParentIndex;
+
+        if (JointIndex == RootJointIndex)
+        {
+            Mask->Weights[JointIndex] = 1.f;
+        }
+        else
+        {
+            Mask->Weights[JointIndex] = ParentIndex == -1 ? 0.f : Mask->Weights[ParentIndex];
+        }
+    }
+
+    return Result;
+}
+
+inline f32
+GetKeyFrameTime(key_frame *KeyFrame)
+{
+    f32 Result = KeyFrame->Time;
+    return Result;
+}
+
+inline f32
+GetKeyFrameTime(f32 *Time)
+{
+    f32 Result = *Time;
+    return Result;
+}
+
+// Returns index of the key frame that starts the interval containing CurrentTime.
+// Expects KeyFrames[Low].Time <= CurrentTime < KeyFrames[High].Time
+template <typename key_frame_type>
+inline u32
+BinarySearchKeyFrame(key_frame_type *KeyFrames, u32 Low, u32 High, f32 CurrentTime)
+{
+    while (High - Low > 1)
+    {
+        u32 Middle = Low + (High - Low) / 2;
+
+        if (GetKeyFrameTime(KeyFrames + Middle) <= CurrentTime)
+        {
+            Low = Middle;
+        }
+        else
+        {
+            High = Middle;
+        }
+    }
+
+    return Low;
+}
+
+// Returns index of the previous key frame, the next one is the following key frame
+// (or the first one if CurrentTime is outside of the key frames range)
+template <typename key_frame_type>
+internal u32
+FindKeyFrameIndex(key_frame_type *KeyFrames, u32 KeyFrameCount, f32 CurrentTime, u32 *Cursor)
+{
+    u32 Result = 0;
+
+    if (KeyFrameCount > 1)
+    {
+        u32 LastKeyFrameIndex = KeyFrameCount - 1;
+
+        if (CurrentTime < GetKeyFrameTime(KeyFrames) || CurrentTime >= GetKeyFrameTime(KeyFrames + LastKeyFrameIndex))
+        {
+            Result = LastKeyFrameIndex;
+        }
+        else
+        {
+            u32 KeyFrameIndex = *Cursor < LastKeyFrameIndex ? *Cursor : LastKeyFrameIndex - 1;
+
+            if (GetKeyFrameTime(KeyFrames + KeyFrameIndex) <= CurrentTime)
+            {
+                // Time usually moves forward by less than a few key frames per update
+                u32 Step = 0;
+                while (CurrentTime >= GetKeyFrameTime(KeyFrames + KeyFrameIndex + 1) && Step < MAX_KEY_FRAME_CURSOR_STEPS)
+                {
+                    ++KeyFrameIndex;
+                    ++Step;
+                }
+
+                if (CurrentTime >= GetKeyFrameTime(KeyFrames + KeyFrameIndex + 1))
+                {
+                    KeyFrameIndex = BinarySearchKeyFrame(KeyFrames, KeyFrameIndex + 1, LastKeyFrameIndex, CurrentTime);
+                }
+            }
+            else
+            {
+                // Seeking backwards (loop wrap, animation reset)
+                KeyFrameIndex = BinarySearchKeyFrame(KeyFrames, 0, KeyFrameIndex, CurrentTime);
+            }
+
+            *Cursor = KeyFrameIndex;
+
+            Result = KeyFrameIndex;
+        }
+    }
+
+    return Result;
+}
+
+internal void
+FindClosestKeyFrames(animation_sample *PoseSample, f32 CurrentTime, u32 *Cursor, key_frame **Prev, key_frame **Next)
+{
+    u32 PrevKeyFrameIndex = FindKeyFrameIndex(PoseSample->KeyFrames, PoseSample->KeyFrameCount, CurrentTime, Cursor);
+    u32 NextKeyFrameIndex = (PrevKeyFrameIndex + 1) % PoseSample->KeyFrameCount;
+
+    *Prev = PoseSample->KeyFrames + PrevKeyFrameIndex;
+    *Next = PoseSample->KeyFrames + NextKeyFrameIndex;
+}
+
+inline quat
+DecompressQuat(compressed_quat *Value)
+{
+    u32 LargestIndex = ((Value->Elements[0] >> 15) << 1) | (Value->Elements[1] >> 15);
+
+    f32 Scale = (1.f / 32767.f) * 2.f * SQRT_HALF;
+
+    f32 a = (Value->Elements[0] & 0x7FFF) * Scale - SQRT_HALF;
+    f32 b = (Value->Elements[1] & 0x7FFF) * Scale - SQRT_HALF;
+    f32 c = (Value->Elements[2] & 0x7FFF) * Scale - SQRT_HALF;
+    f32 d = Sqrt(Max(0.f, 1.f - a * a - b * b - c * c));
+
+    quat Result;
+
+    switch (LargestIndex)
+    {
+        case 0: Result = quat(d, a, b, c); break;
+        case 1: Result = quat(a, d, b, c); break;
+        case 2: Result = quat(a, b, d, c); break;
+        default: Result = quat(a, b, c, d); break;
+    }
+
+    return Result;
+}
+
+inline vec3
+DequantizeVec3(quantized_vec3 *Value, vec3 Min, vec3 Extent)
+{
+    f32 Scale = 1.f / 65535.f;
+
+    vec3 Result = vec3(
+        Min.x + Value->Elements[0] * Scale * Extent.x,
+        Min.y + Value->Elements[1] * Scale * Extent.y,
+        Min.z + Value->Elements[2] * Scale * Extent.z
+    );
+
+    return Result;
+}
+
+inline joint_pose
+DecompressJointPose(compressed_animation_sample *PoseSample, u32 KeyFrameIndex)
+{
+    joint_pose Result;
+
+    Result.Rotation = DecompressQuat(PoseSample->Rotations + KeyFrameIndex * PoseSample->RotationStride);
+    Result.Translation = DequantizeVec3(PoseSample->Translations + KeyFrameIndex * PoseSample->TranslationStride, 
+        PoseSample->TranslationMin, PoseSample->TranslationExtent);
+    Result.Scale = DequantizeVec3(PoseSample->Scales + KeyFrameIndex * PoseSample->ScaleStride, 
+        PoseSample->ScaleMin, PoseSample->ScaleExtent);
+
+    return Result;
+}
+
+// Weighted sum of all sampled clips, joints that are not animated by some clip keep their current pose with that clip's weight
+internal skeleton_pose_accumulator
+CreateSkeletonPoseAccumulator(skeleton_pose *Pose, memory_arena *Arena)
+{
+    skeleton_pose_accumulator Result = {};
+
+    u32 JointCount = Pose->Skeleton->JointCount;
+
+    Result.JointCount = JointCount;
+    Result.Skeleton = Pose->Skeleton;
+    Result.ReferencePoses = Pose->LocalJointPoses;
+    Result.Poses = PushArray(Arena, JointCount, joint_pose);
+    Result.Weights = PushArray(Arena, JointCount, f32);
+
+    for (u32 JointIndex = 0; JointIndex < JointCount; ++JointIndex)
+    {
+        joint_pose *AccumulatedPose = Result.Poses + JointIndex;
+        AccumulatedPose->Rotation = quat(0.f);
+        AccumulatedPose->Translation = vec3(0.f);
+        AccumulatedPose->Scale = vec3(0.f);
+
+        Result.Weights[JointIndex] = 0.f;
+    }
+
+    return Result;
+}
+
+inline void
+AccumulateJointPose(skeleton_pose_accumulator *Accumulator, u32 JointIndex, joint_pose *Pose, f32 Weight)
+{
+    joint_pose *AccumulatedPose = Accumulator->Poses + JointIndex;
+    joint_pose *ReferencePose = Accumulator->ReferencePoses + JointIndex;
+
+    // Keeping all rotations in the hemisphere of the current pose so that the sum doesn't cancel out
+    f32 RotationWeight = Dot(Pose->Rotation, ReferencePose->Rotation) < 0.f ? -Weight : Weight;
+
+    AccumulatedPose->Rotation = AccumulatedPose->Rotation + RotationWeight * Pose->Rotation;
+    AccumulatedPose->Translation += Weight * Pose->Translation;
+    AccumulatedPose->Scale += Weight * Pose->Scale;
+
+    Accumulator->Weights[JointIndex] += Weight;
+}
+
+inline b32
+ShouldSampleJoint(skeleton_pose *SkeletonPose, u32 JointIndex)
+{
+    return true;
+}
+
+inline b32
+ShouldSampleJoint(skeleton_pose_accumulator *Accumulator, u32 JointIndex)
+{
+    b32 Result = (!Accumulator->JointHeights || Accumulator->JointHeights[JointIndex] >= Accumulator->MinJointHeight) &&
+        (!Accumulator->JointMask || Accumulator->JointMask[JointIndex] > 0.f);
+    return Result;
+}
+
+inline b32
+ShouldSampleJoint(skeleton_pose_additive *Additive, u32 JointIndex)
+{
+    b32 Result = ShouldSampleJoint(Additive->Accumulator, JointIndex);
+    return Result;
+}
+
+inline void
+WriteJointPose(skeleton_pose *SkeletonPose, u32 JointIndex, joint_pose *Pose)
+{
+    Assert(JointIndex < SkeletonPose->Skeleton->JointCount);
+    SkeletonPose->LocalJointPoses[JointIndex] = *Pose;
+}
+
+inline void
+WriteJointPose(skeleton_pose_accumulator *Accumulator, u32 JointIndex, joint_pose *Pose)
+{
+    Assert(JointIndex < Accumulator->JointCount);
+
+    f32 Weight = Accumulator->Weight;
+
+    if (Accumulator->JointMask)
+    {
+        Weight *= Accumulator->MaskWeight * Accumulator->JointMask[JointIndex];
+    }
+
+    AccumulateJointPose(Accumulator, JointIndex, Pose, Weight);
+}
+
+inline void
+WriteJointPose(skeleton_pose_additive *Additive, u32 JointIndex, joint_pose *Delta)
+{
+    skeleton_pose_accumulator *Accumulator = Additive->Accumulator;
+
+    Assert(JointIndex < Accumulator->JointCount);
+
+    f32 Weight = Additive->Weight;
+
+    if (Accumulator->JointMask)
+    {
+        Weight *= Accumulator->MaskWeight * Accumulator->JointMask[JointIndex];
+    }
+
+    joint_pose *Pose = Accumulator->ReferencePoses + JointIndex;
+
+    if (Weight < 1.f)
+    {
+        // Deltas are stored in the hemisphere of identity (see assets builder), 
+        // so weighting towards identity is a plain lerp, normalized once after the multiply
+        quat DeltaRotation = Delta->Rotation * Weight;
+        DeltaRotation.w += 1.f - Weight;
+
+        Pose->Rotation = Normalize(Pose->Rotation * DeltaRotation);
+        Pose->Translation += Weight * Delta->Translation;
+        Pose->Scale = Pose->Scale * Lerp(vec3(1.f), Weight, Delta->Scale);
+    }
+    else
+    {
+        Pose->Rotation = Pose->Rotation * Delta->Rotation;
+        Pose->Translation += Delta->Translation;
+        Pose->Scale = Pose->Scale * Delta->Scale;
+    }
+}
+
+template <typename pose_output>
+internal void
+AnimateSkeletonPoseCompressed(pose_output *Output, animation_state *AnimationState)
+{
+    animation_clip *Animation = AnimationState->Clip;
+    f32 Time = AnimationState->Time;
+
+    for (u32 PoseSampleIndex = 0; PoseSampleIndex < Animation->PoseSampleCount; ++PoseSampleIndex)
+    {
+        compressed_animation_sample *PoseSample = Animation->CompressedPoseSamples + PoseSampleIndex;
+
+        if (!ShouldSampleJoint(Output, PoseSample->JointIndex))
+        {
+            continue;
+        }
+
+        joint_pose LocalJointPose;
+
+        if (PoseSample->KeyFrameCount > 1)
+        {
+            animation_timeline *Timeline = Animation->Timelines + PoseSample->TimelineIndex;
+            u32 *KeyFrameCursor = AnimationState->KeyFrameCursors + PoseSample->TimelineIndex;
+
+            u32 PrevKeyFrameIndex = FindKeyFrameIndex(Timeline->Times, Timeline->KeyFrameCount, Time, KeyFrameCursor);
+            u32 NextKeyFrameIndex = (PrevKeyFrameIndex + 1) % Timeline->KeyFrameCount;
+
+            f32 PrevTime = Timeline->Times[PrevKeyFrameIndex];
+            f32 NextTime = Timeline->Times[NextKeyFrameIndex];
+
+            f32 t = (Time - PrevTime) / Abs(NextTime - PrevTime);
+
+            Assert(t >= 0.f && t <= 1.f);
+
+            joint_pose PrevPose = DecompressJointPose(PoseSample, PrevKeyFrameIndex);
+            joint_pose NextPose = DecompressJointPose(PoseSample, NextKeyFrameIndex);
+
+            LocalJointPose = Lerp(&PrevPose, t, &NextPose);
+        }
+        else
+        {
+            LocalJointPose = DecompressJointPose(PoseSample, 0);
+        }
+
+        WriteJointPose(Output, PoseSample->JointIndex, &LocalJointPose);
+    }
+}
+
+template <typename pose_output>
+internal void
+AnimateSkeletonPoseKeyFrames(pose_output *Output, animation_state *AnimationState)
+{
+    animation_clip *Animation = AnimationState->Clip;
+    f32 Time = AnimationState->Time;
+
+    // Pose samples are stored in joint order (see LoadModelAsset), so joints and samples are walked together
+    for (u32 PoseSampleIndex = 0; PoseSampleIndex < Animation->PoseSampleCount; ++PoseSampleIndex)
+    {
+        animation_sample *PoseSample = Animation->PoseSamples + PoseSampleIndex;
+        u32 *KeyFrameCursor = AnimationState->KeyFrameCursors + PoseSampleIndex;
+
+        if (!ShouldSampleJoint(Output, PoseSample->JointIndex))
+        {
+            continue;
+        }
+
+        key_frame *PrevKeyFrame = 0;
+        key_frame *NextKeyFrame = 0;
+        FindClosestKeyFrames(PoseSample, Time, KeyFrameCursor, &PrevKeyFrame, &NextKeyFrame);
+
+        f32 t = 0.f;
+
+        if (PoseSample->KeyFrameCount > 1)
+        {
+            t = (Time - PrevKeyFrame->Time) / (Abs(NextKeyFrame->Time - PrevKeyFrame->Time));
+        }
+
+        Assert(t >= 0.f && t <= 1.f);
+
+        joint_pose LocalJointPose = Lerp(&PrevKeyFrame->Pose, t, &NextKeyFrame->Pose);
+
+        WriteJointPose(Output, PoseSample->JointIndex, &LocalJointPose);
+    }
+}
+
+// Previous and next frames come straight from the time, no search
+template <typename pose_output>
+internal void
+AnimateSkeletonPoseUniform(pose_output *Output, animation_state *AnimationState)
 {
-    joint_pose *Result = SkeletonPose->LocalJointPoses + 1;
-    return Result;
+    animation_clip *Animation = AnimationState->Clip;
+    u32 SampleCount = Animation->PoseSampleCount;
+
+    Assert(Animation->FrameCount > 1);
+
+    // Last frame is sampled at the end of the clip, so the last interval can be shorter than 1 / SampleRate
+    f32 Time = Clamp(AnimationState->Time, 0.f, Animation->Duration);
+    u32 FrameIndex = (u32)(Time * Animation->SampleRate);
+    FrameIndex = FrameIndex < Animation->FrameCount - 1 ? FrameIndex : Animation->FrameCount - 2;
+
+    f32 FrameTime = FrameIndex / Animation->SampleRate;
+    f32 NextFrameTime = Min((FrameIndex + 1) / Animation->SampleRate, Animation->Duration);
+
+    f32 t = Clamp((Time - FrameTime) / (NextFrameTime - FrameTime), 0.f, 1.f);
+
+    u32 FrameSize = SampleCount * AnimationFrameChannel_Count;
+    f32 *PrevFrame = Animation->Frames + FrameIndex * FrameSize;
+    f32 *NextFrame = PrevFrame + FrameSize;
+
+    for (u32 SampleIndex = 0; SampleIndex < SampleCount; ++SampleIndex)
+    {
+        u32 JointIndex = Animation->FrameJointIndices[SampleIndex];
+
+        if (!ShouldSampleJoint(Output, JointIndex))
+        {
+            continue;
+        }
+
+        f32 Values[AnimationFrameChannel_Count];
+
+        for (u32 ChannelIndex = 0; ChannelIndex < AnimationFrameChannel_Count; ++ChannelIndex)
+        {
+            u32 ValueIndex = ChannelIndex * SampleCount + SampleIndex;
+            Values[ChannelIndex] = Lerp(PrevFrame[ValueIndex], t, NextFrame[ValueIndex]);
+        }
+
+        // Builder keeps rotations of neighbouring frames in the same hemisphere, so nlerp doesn't need a sign fix
+        f32 RotationLength = Sqrt(
+            Square(Values[AnimationFrameChannel_RotationX]) +
+            Square(Values[AnimationFrameChannel_RotationY]) +
+            Square(Values[AnimationFrameChannel_RotationZ]) +
+            Square(Values[AnimationFrameChannel_RotationW])
+        );
+        f32 InvRotationLength = 1.f / RotationLength;
+
+        joint_pose LocalJointPose;
+
+        LocalJointPose.Rotation = quat(
+            Values[AnimationFrameChannel_RotationX] * InvRotationLength,
+            Values[AnimationFrameChannel_RotationY] * InvRotationLength,
+            Values[AnimationFrameChannel_RotationZ] * InvRotationLength,
+            Values[AnimationFrameChannel_RotationW] * InvRotationLength
+        );
+        LocalJointPose.Translation = vec3(
+            Values[AnimationFrameChannel_TranslationX],
+            Values[AnimationFrameChannel_TranslationY],
+            Values[AnimationFrameChannel_TranslationZ]
+        );
+        LocalJointPose.Scale = vec3(
+            Values[AnimationFrameChannel_ScaleX],
+            Values[AnimationFrameChannel_ScaleY],
+            Values[AnimationFrameChannel_ScaleZ]
+        );
+
+        WriteJointPose(Output, JointIndex, &LocalJointPose);
+    }
 }
 
-inline joint_pose
-Lerp(joint_pose *From, f32 t, joint_pose *To)
+template <typename pose_output>
+internal void
+SampleAnimationClip(pose_output *Output, animation_state *AnimationState)
 {
-    joint_pose Result;
+    animation_clip *Animation = AnimationState->Clip;
 
-    Result.Translation = Lerp(From->Translation, t, To->Translation);
-    Result.Rotation = Slerp(From->Rotation, t, To->Rotation);
-    Result.Scale = Lerp(From->Scale, t, To->Scale);
+    switch (Animation->Format)
+    {
+        case AnimationClipFormat_KeyFrames:
+        {
+            AnimateSkeletonPoseKeyFrames(Output, AnimationState);
+            break;
+        }
+        case AnimationClipFormat_Compressed:
+        {
+            AnimateSkeletonPoseCompressed(Output, AnimationState);
+            break;
+        }
+        case AnimationClipFormat_Uniform:
+        {
+            AnimateSkeletonPoseUniform(Output, AnimationState);
+            break;
+        }
+        default:
+        {
+            Assert(!"Invalid animation clip format");
+        }
+    }
+}
 
-    return Result;
+internal void
+AnimateSkeletonPose(skeleton_pose *SkeletonPose, animation_state *AnimationState)
+{
+    SampleAnimationClip(SkeletonPose, AnimationState);
 }
 
 internal void
-Lerp(skeleton_pose *From, f32 t, skeleton_pose *To, skeleton_pose *Dest)
+InitPoseCache(pose_cache *Cache, u32 EntryCount, u32 MaxJointCount, memory_arena *Arena)
 {
-    u32 JointCount = Dest->Skeleton->JointCount;
+    *Cache = {};
 
-    Assert(From->Skeleton->JointCount == JointCount);
-    Assert(To->Skeleton->JointCount == JointCount);
+    Cache->MaxJointCount = MaxJointCount;
+    Cache->EntryCount = EntryCount;
+    Cache->Entries = PushArray(Arena, EntryCount, pose_cache_entry);
 
-    for (u32 JointIndex = 0; JointIndex < JointCount; ++JointIndex)
+    for (u32 EntryIndex = 0; EntryIndex < EntryCount; ++EntryIndex)
     {
-        joint_pose *FromPose = From->LocalJointPoses + JointIndex;
-        joint_pose *ToPose = To->LocalJointPoses + JointIndex;
-        joint_pose *DestPose = Dest->LocalJointPoses + JointIndex;
+        pose_cache_entry *Entry = Cache->Entries + EntryIndex;
+        Entry->LocalJointPoses = PushArray(Arena, MaxJointCount, joint_pose);
+    }
+}
+
+// Must be called when nobody is using the cache (before animation jobs are started)
+internal void
+ResetPoseCache(pose_cache *Cache)
+{
+    Cache->LastLookupCount = Cache->LookupCount;
+    Cache->LastHitCount = Cache->HitCount;
+    Cache->LookupCount = 0;
+    Cache->HitCount = 0;
 
-        *DestPose = Lerp(FromPose, t, ToPose);
+    for (u32 EntryIndex = 0; EntryIndex < Cache->EntryCount; ++EntryIndex)
+    {
+        pose_cache_entry *Entry = Cache->Entries + EntryIndex;
+        Entry->State = PoseCacheEntryState_Empty;
     }
 }
 
-internal mat4
-CalculateGlobalJointPose(joint *CurrentJoint, joint_pose *CurrentJointPose, skeleton_pose *Pose)
+inline u32
+GetPoseCacheTimeKey(pose_cache *Cache, f32 Time)
 {
-    mat4 Result = mat4(1.f);
+    u32 Result;
 
-    while (true)
+    if (Cache->TimeStep > 0.f)
+    {
+        Result = (u32)(Time / Cache->TimeStep + 0.5f);
+    }
+    else
     {
-        mat4 Global = Transform(*CurrentJointPose);
-        Result = Global * Result;
+        Result = *(u32 *)&Time;
+    }
+
+    return Result;
+}
 
-        if (CurrentJoint->ParentIndex == -1)
+inline u32
+GetAnimationClipJointIndex(animation_clip *Clip, u32 PoseSampleIndex)
+{
+    u32 Result = 0;
+
+    switch (Clip->Format)
+    {
+        case AnimationClipFormat_KeyFrames:
         {
+            Result = Clip->PoseSamples[PoseSampleIndex].JointIndex;
             break;
         }
-
-        CurrentJointPose = Pose->LocalJointPoses + CurrentJoint->ParentIndex;
-        CurrentJoint = Pose->Skeleton->Joints + CurrentJoint->ParentIndex;
+        case AnimationClipFormat_Compressed:
+        {
+            Result = Clip->CompressedPoseSamples[PoseSampleIndex].JointIndex;
+            break;
+        }
+        case AnimationClipFormat_Uniform:
+        {
+            Result = Clip->FrameJointIndices[PoseSampleIndex];
+            break;
+        }
+        default:
+        {
+            Assert(!"Invalid animation clip format");
+        }
     }
 
     return Result;
 }
 
-// todo: optimize (caching?)
-inline animation_sample *
-GetAnimationSampleByJointIndex(animation_clip *Animation, u32 JointIndex)
+// Returns a ready entry (hit) or an entry that the caller has claimed and has to fill, 0 when the cache is full
+internal pose_cache_entry *
+FindPoseCacheEntry(pose_cache *Cache, animation_clip *Clip, skeleton *Skeleton, u32 TimeKey, b32 *IsHit)
 {
-    animation_sample *Result = 0;
+    pose_cache_entry *Result = 0;
+    *IsHit = false;
 
-    for (u32 AnimationSampleIndex = 0; AnimationSampleIndex < Animation->PoseSampleCount; ++AnimationSampleIndex)
+    u64 HashValue = ((umm)Clip >> 4) * 31 + ((umm)Skeleton >> 4) * 17 + TimeKey * 2654435761u;
+    u32 HashSlot = HashValue % Cache->EntryCount;
+
+    // Linear probing, entries are never removed during a frame
+    for (u32 ProbeIndex = 0; ProbeIndex < Cache->EntryCount; ++ProbeIndex)
     {
-        animation_sample *AnimationSample = Animation->PoseSamples + AnimationSampleIndex;
+        pose_cache_entry *Entry = Cache->Entries + (HashSlot + ProbeIndex) % Cache->EntryCount;
+
+        u32 State = Entry->State;
+
+        if (State == PoseCacheEntryState_Empty)
+        {
+            if (AtomicCompareExchangeU32(&Entry->State, PoseCacheEntryState_Sampling, PoseCacheEntryState_Empty) == PoseCacheEntryState_Empty)
+            {
+                Entry->Clip = Clip;
+                Entry->Skeleton = Skeleton;
+                Entry->TimeKey = TimeKey;
+
+                Result = Entry;
+                break;
+            }
+
+            State = Entry->State;
+        }
 
-        if (AnimationSample->JointIndex == JointIndex)
+        // Entries that are still being sampled are skipped (it's cheaper to sample again than to wait)
+        if (State == PoseCacheEntryState_Ready && Entry->Clip == Clip && Entry->Skeleton == Skeleton && Entry->TimeKey == TimeKey)
         {
-            Result = AnimationSample;
+            Result = Entry;
+            *IsHit = true;
             break;
         }
     }
@@ -85,112 +909,386 @@ GetAnimationSampleByJointIndex(animation_clip *Animation, u32 JointIndex)
 }
 
 internal void
-FindClosestKeyFrames(animation_sample *PoseSample, f32 CurrentTime, key_frame **Prev, key_frame **Next)
+AccumulateCachedSkeletonPose(skeleton_pose_accumulator *Accumulator, pose_cache_entry *Entry)
+{
+    animation_clip *Clip = Entry->Clip;
+
+    for (u32 PoseSampleIndex = 0; PoseSampleIndex < Clip->PoseSampleCount; ++PoseSampleIndex)
+    {
+        u32 JointIndex = GetAnimationClipJointIndex(Clip, PoseSampleIndex);
+        WriteJointPose(Accumulator, JointIndex, Entry->LocalJointPoses + JointIndex);
+    }
+}
+
+internal void
+AccumulateSkeletonPose(skeleton_pose_accumulator *Accumulator, animation_state *AnimationState, f32 Weight)
 {
-    if (PoseSample->KeyFrameCount > 1)
+    Accumulator->Weight = Weight;
+    Accumulator->TotalWeight += Weight;
+
+    pose_cache *Cache = Accumulator->PoseCache;
+
+    // Partial (LOD, masked) samples are not shared
+    b32 UseCache = Cache && Cache->IsEnabled && Accumulator->MinJointHeight == 0 && !Accumulator->JointMask && 
+        Accumulator->JointCount <= Cache->MaxJointCount;
+
+    pose_cache_entry *Entry = 0;
+    b32 IsHit = false;
+
+    if (UseCache)
     {
-        b32 Found = false;
+        u32 TimeKey = GetPoseCacheTimeKey(Cache, AnimationState->Time);
+        Entry = FindPoseCacheEntry(Cache, AnimationState->Clip, Accumulator->Skeleton, TimeKey, &IsHit);
+
+        AtomicIncrementU32(&Cache->LookupCount);
 
-        for (u32 KeyFrameIndex = 0; KeyFrameIndex < PoseSample->KeyFrameCount - 1; ++KeyFrameIndex)
+        if (IsHit)
         {
-            key_frame *CurrentKeyFrame = PoseSample->KeyFrames + KeyFrameIndex;
-            key_frame *NextKeyFrame = PoseSample->KeyFrames + KeyFrameIndex + 1;
+            AtomicIncrementU32(&Cache->HitCount);
+        }
+        else if (Entry)
+        {
+            skeleton_pose EntryPose = {};
+            EntryPose.Skeleton = Accumulator->Skeleton;
+            EntryPose.LocalJointPoses = Entry->LocalJointPoses;
 
-            if (CurrentKeyFrame->Time <= CurrentTime && CurrentTime < NextKeyFrame->Time)
+            // Everybody who shares the entry gets the pose at the quantized time
+            f32 Time = AnimationState->Time;
+            if (Cache->TimeStep > 0.f)
             {
-                Found = true;
+                AnimationState->Time = Clamp(TimeKey * Cache->TimeStep, 0.f, AnimationState->Clip->Duration);
+            }
 
-                *Prev = CurrentKeyFrame;
-                *Next = NextKeyFrame;
+            SampleAnimationClip(&EntryPose, AnimationState);
 
-                break;
-            }
-        }
+            AnimationState->Time = Time;
 
-        if (!Found)
-        {
-            *Prev = Last(PoseSample->KeyFrames, PoseSample->KeyFrameCount);
-            *Next = First(PoseSample->KeyFrames);
+            AtomicExchangeU32(&Entry->State, PoseCacheEntryState_Ready);
         }
     }
+
+    if (Entry)
+    {
+        AccumulateCachedSkeletonPose(Accumulator, Entry);
+    }
     else
     {
-        *Prev = First(PoseSample->KeyFrames);
-        *Next = First(PoseSample->KeyFrames);
+        SampleAnimationClip(Accumulator, AnimationState);
     }
 }
 
+// Should be called after the accumulator is resolved, so that deltas are applied on top of the blended pose
+internal void
+ApplyAdditiveSkeletonPose(skeleton_pose_accumulator *Accumulator, animation_state *AnimationState, f32 Weight)
+{
+    Assert(AnimationState->Clip->IsAdditive);
+
+    skeleton_pose_additive Additive = {};
+    Additive.Accumulator = Accumulator;
+    Additive.Weight = Weight;
+
+    SampleAnimationClip(&Additive, AnimationState);
+}
+
+// Single normalization pass: fills the missing weight with the current pose and normalizes the sums.
+// Joints that weren't sampled at all keep the current pose, consumed sums are cleared so that the accumulator can be reused
 internal void
-AnimateSkeletonPose(skeleton_pose *SkeletonPose, animation_clip *Animation, f32 Time)
+ResolveSkeletonPoseAccumulator(skeleton_pose_accumulator *Accumulator, skeleton_pose *Dest)
 {
-    for (u32 JointIndex = 0; JointIndex < SkeletonPose->Skeleton->JointCount; ++JointIndex)
+    Assert(Dest->LocalJointPoses == Accumulator->ReferencePoses);
+
+    for (u32 JointIndex = 0; JointIndex < Accumulator->JointCount; ++JointIndex)
     {
-        joint_pose *LocalJointPose = SkeletonPose->LocalJointPoses + JointIndex;
+        if (Accumulator->Weights[JointIndex] == 0.f)
+        {
+            continue;
+        }
+
+        joint_pose *AccumulatedPose = Accumulator->Poses + JointIndex;
+        joint_pose *DestPose = Dest->LocalJointPoses + JointIndex;
 
-        animation_sample *PoseSample = GetAnimationSampleByJointIndex(Animation, JointIndex);
+        f32 MissingWeight = Accumulator->TotalWeight - Accumulator->Weights[JointIndex];
 
-        if (PoseSample)
+        if (MissingWeight > EPSILON)
         {
-            key_frame *PrevKeyFrame = 0;
-            key_frame *NextKeyFrame = 0;
-            FindClosestKeyFrames(PoseSample, Time, &PrevKeyFrame, &NextKeyFrame);
+            AccumulateJointPose(Accumulator, JointIndex, DestPose, MissingWeight);
+        }
+
+        f32 InvWeight = 1.f / Accumulator->Weights[JointIndex];
+
+        DestPose->Rotation = Normalize(AccumulatedPose->Rotation);
+        DestPose->Translation = AccumulatedPose->Translation * InvWeight;
+        DestPose->Scale = AccumulatedPose->Scale * InvWeight;
+
+        AccumulatedPose->Rotation = quat(0.f);
+        AccumulatedPose->Translation = vec3(0.f);
+        AccumulatedPose->Scale = vec3(0.f);
+        Accumulator->Weights[JointIndex] = 0.f;
+    }
+
+    Accumulator->TotalWeight = 0.f;
+}
+
+// todo: do I need these helper functions?
+inline void
+ResetAnimationState(animation_state *Animation)
+{
+    Animation->Time = 0.f;
+    Animation->RootMotionTime = 0.f;
+}
+
+inline void
+ResetAnimationMixer(animation_mixer *Mixer)
+{
+    *Mixer = {};
+    Mixer->FadeInNodeIndex = U32_MAX;
+    Mixer->FadeOutNodeIndex = U32_MAX;
+}
+
+// Squared distance between two feature vectors
+inline f32
+GetMotionFeatureDistance(f32 *A, f32 *B)
+{
+    __m128 Sum = _mm_setzero_ps();
+
+    for (u32 FeatureIndex = 0; FeatureIndex < MOTION_FEATURE_STRIDE; FeatureIndex += 4)
+    {
+        __m128 Delta = _mm_sub_ps(_mm_loadu_ps(A + FeatureIndex), _mm_loadu_ps(B + FeatureIndex));
+        Sum = _mm_add_ps(Sum, _mm_mul_ps(Delta, Delta));
+    }
+
+    Sum = _mm_add_ps(Sum, _mm_movehl_ps(Sum, Sum));
+    Sum = _mm_add_ss(Sum, _mm_shuffle_ps(Sum, Sum, 1));
+
+    f32 Result = _mm_cvtss_f32(Sum);
+
+    return Result;
+}
+
+// BoundDistance is the squared distance from the query to the node region, 
+// Offsets are per-feature distances to it (only split features of the parent nodes are non-zero)
+internal void
+SearchMotionKdNode(motion_database *Database, u32 NodeIndex, f32 *Query, f32 BoundDistance, f32 *Offsets, u32 ExcludedClipIndex, u32 *BestFrameIndex, f32 *BestDistance)
+{
+    motion_kd_node *Node = Database->Nodes + NodeIndex;
 
-            f32 t = 0.f;
+    if (Node->FrameCount > 0)
+    {
+        for (u32 FrameIndex = Node->FirstFrameIndex; FrameIndex < Node->FirstFrameIndex + Node->FrameCount; ++FrameIndex)
+        {
+            f32 Distance = GetMotionFeatureDistance(Query, Database->Features + FrameIndex * MOTION_FEATURE_STRIDE);
 
-            if (PoseSample->KeyFrameCount > 1)
+            if (Distance < *BestDistance && Database->Frames[FrameIndex].ClipIndex != ExcludedClipIndex)
             {
-                t = (Time - PrevKeyFrame->Time) / (Abs(NextKeyFrame->Time - PrevKeyFrame->Time));
+                *BestDistance = Distance;
+                *BestFrameIndex = FrameIndex;
             }
+        }
+    }
+    else
+    {
+        f32 SplitOffset = Query[Node->SplitFeature] - Node->SplitValue;
 
-            Assert(t >= 0.f && t <= 1.f);
+        u32 NearChildIndex = SplitOffset < 0.f ? Node->ChildIndex : Node->ChildIndex + 1;
+        u32 FarChildIndex = SplitOffset < 0.f ? Node->ChildIndex + 1 : Node->ChildIndex;
+
+        SearchMotionKdNode(Database, NearChildIndex, Query, BoundDistance, Offsets, ExcludedClipIndex, BestFrameIndex, BestDistance);
 
-            *LocalJointPose = Lerp(&PrevKeyFrame->Pose, t, &NextKeyFrame->Pose);
+        f32 PrevOffset = Offsets[Node->SplitFeature];
+        f32 FarBoundDistance = BoundDistance - Square(PrevOffset) + Square(SplitOffset);
+
+        if (FarBoundDistance < *BestDistance)
+        {
+            Offsets[Node->SplitFeature] = SplitOffset;
+            SearchMotionKdNode(Database, FarChildIndex, Query, FarBoundDistance, Offsets, ExcludedClipIndex, BestFrameIndex, BestDistance);
+            Offsets[Node->SplitFeature] = PrevOffset;
         }
     }
+}
+
+// Exact nearest frame to the (normalized) query, U32_MAX if there is none
+internal u32
+SearchMotionDatabase(motion_database *Database, f32 *Query, f32 *BestDistance, u32 ExcludedClipIndex = U32_MAX)
+{
+    u32 Result = U32_MAX;
+    *BestDistance = F32_MAX;
 
-    if (Animation->InPlace)
+    if (Database->NodeCount > 0)
     {
-        joint_pose *RootTranslationLocalJointPose = GetRootTranslationLocalJointPose(SkeletonPose);
-        RootTranslationLocalJointPose->Translation = vec3(0.f, RootTranslationLocalJointPose->Translation.y, 0.f);
+        f32 Offsets[MOTION_FEATURE_STRIDE] = {};
+        SearchMotionKdNode(Database, 0, Query, 0.f, Offsets, ExcludedClipIndex, &Result, BestDistance);
     }
+
+    return Result;
 }
 
-// todo: do I need these helper functions?
-inline void
-ResetAnimationState(animation_state *Animation)
+inline f32
+GetMotionDatabaseClipEndTime(motion_database *Database, u32 ClipIndex)
 {
-    Animation->Time = 0.f;
+    f32 Result = (Database->Clips[ClipIndex].FrameCount - 1) / Database->SampleRate;
+    return Result;
+}
+
+inline u32
+GetMotionDatabaseFrameIndex(motion_database *Database, u32 ClipIndex, f32 Time)
+{
+    motion_database_clip *Clip = Database->Clips + ClipIndex;
+
+    u32 ClipFrameIndex = (u32)(Max(Time, 0.f) * Database->SampleRate + 0.5f);
+    ClipFrameIndex = ClipFrameIndex < Clip->FrameCount ? ClipFrameIndex : Clip->FrameCount - 1;
+
+    u32 Result = Database->ClipFrameIndices[Clip->FirstFrameIndex + ClipFrameIndex];
+
+    return Result;
+}
+
+inline f32
+NormalizeMotionFeature(motion_database *Database, u32 FeatureIndex, f32 Value)
+{
+    f32 Result = (Value - Database->Offsets[FeatureIndex]) * Database->Scales[FeatureIndex];
+    return Result;
+}
+
+// Pose features of the frame that is playing, trajectory features of the desired motion.
+// The game turns the entity towards the input direction, so the desired trajectory goes straight ahead
+internal void
+BuildMotionQuery(motion_database *Database, u32 FrameIndex, f32 Speed, f32 *Query)
+{
+    f32 *Features = Database->Features + FrameIndex * MOTION_FEATURE_STRIDE;
+
+    for (u32 FeatureIndex = 0; FeatureIndex < MOTION_FEATURE_STRIDE; ++FeatureIndex)
+    {
+        Query[FeatureIndex] = Features[FeatureIndex];
+    }
+
+    for (u32 PointIndex = 0; PointIndex < MOTION_TRAJECTORY_POINT_COUNT; ++PointIndex)
+    {
+        u32 PositionIndex = MotionFeature_TrajectoryPositions + PointIndex * 2;
+        u32 DirectionIndex = MotionFeature_TrajectoryDirections + PointIndex * 2;
+
+        Query[PositionIndex + 0] = NormalizeMotionFeature(Database, PositionIndex + 0, 0.f);
+        Query[PositionIndex + 1] = NormalizeMotionFeature(Database, PositionIndex + 1, Speed * Database->TrajectoryTimes[PointIndex]);
+        Query[DirectionIndex + 0] = NormalizeMotionFeature(Database, DirectionIndex + 0, 0.f);
+        Query[DirectionIndex + 1] = NormalizeMotionFeature(Database, DirectionIndex + 1, 1.f);
+    }
+}
+
+internal void
+PlayMotionDatabaseFrame(motion_matching_state *State, motion_database *Database, u32 FrameIndex, b32 Blend)
+{
+    motion_database_frame *Frame = Database->Frames + FrameIndex;
+
+    if (Blend)
+    {
+        State->CurrentIndex ^= 1;
+        State->BlendTime = 0.f;
+    }
+    else
+    {
+        State->BlendTime = MOTION_MATCHING_BLEND_DURATION;
+    }
+
+    animation_state *Animation = State->Animations + State->CurrentIndex;
+    Animation->Clip = Database->Animations + Database->Clips[Frame->ClipIndex].AnimationIndex;
+    Animation->Time = Frame->Time;
+    Animation->RootMotionTime = Frame->Time;
+
+    State->ClipIndices[State->CurrentIndex] = Frame->ClipIndex;
+}
+
+// Jumps (with a crossfade) to the best matching frame if it is better than the one that is playing,
+// Reset jumps straight to the best frame
+internal void
+SearchMotionMatchingNode(animation_graph_instance *Instance, u32 NodeIndex, b32 Reset)
+{
+    animation_graph_node *Node = Instance->Definition->Nodes + NodeIndex;
+    motion_database *Database = Instance->Definition->MotionDatabases[Node->Index];
+    motion_matching_state *State = Instance->MotionMatchers + Node->Index;
+
+    u32 ClipIndex = State->ClipIndices[State->CurrentIndex];
+    animation_state *Animation = State->Animations + State->CurrentIndex;
+
+    // Frames at the end of non-looping clips have no future, the rest of the clip is skipped
+    b32 IsEnding = !Animation->Clip->IsLooping && Animation->Time >= GetMotionDatabaseClipEndTime(Database, ClipIndex);
+
+    u32 FrameIndex = GetMotionDatabaseFrameIndex(Database, ClipIndex, Animation->Time);
+
+    f32 Query[MOTION_FEATURE_STRIDE];
+    BuildMotionQuery(Database, FrameIndex, Instance->Params.Move * Database->MaxSpeed, Query);
+
+    f32 BestDistance;
+    u32 BestFrameIndex = SearchMotionDatabase(Database, Query, &BestDistance, IsEnding ? ClipIndex : U32_MAX);
+
+    if (BestFrameIndex != U32_MAX)
+    {
+        if (Reset)
+        {
+            PlayMotionDatabaseFrame(State, Database, BestFrameIndex, false);
+        }
+        else
+        {
+            motion_database_frame *BestFrame = Database->Frames + BestFrameIndex;
+
+            f32 CurrentDistance = GetMotionFeatureDistance(Query, Database->Features + FrameIndex * MOTION_FEATURE_STRIDE);
+            // Jumping within the blend duration of the clip that is playing doesn't change anything
+            b32 IsNearby = BestFrame->ClipIndex == ClipIndex && Abs(BestFrame->Time - Animation->Time) < MOTION_MATCHING_BLEND_DURATION;
+
+            if (IsEnding || (BestDistance + MOTION_MATCHING_JUMP_COST < CurrentDistance && !IsNearby))
+            {
+                PlayMotionDatabaseFrame(State, Database, BestFrameIndex, true);
+            }
+        }
+    }
+}
+
+inline f32
+GetMotionMatchingBlendWeight(motion_matching_state *State)
+{
+    f32 Result = Min(State->BlendTime / MOTION_MATCHING_BLEND_DURATION, 1.f);
+    return Result;
 }
 
 // todo: similar functions (enable/disable?)
-inline void
-EnableAnimationNode(animation_node *Node)
+internal void
+EnableAnimationNode(animation_graph_instance *Instance, u32 NodeIndex)
 {
-    Node->Weight = 1.f;
+    animation_graph_definition *Definition = Instance->Definition;
+    animation_graph_node *Node = Definition->Nodes + NodeIndex;
+
+    Instance->Nodes[NodeIndex].Weight = 1.f;
 
     switch (Node->Type)
     {
         case AnimationNodeType_SingleMotion:
         {
-            ResetAnimationState(&Node->Animation);
+            ResetAnimationState(Instance->Animations + Node->Index);
 
             break;
         }
         case AnimationNodeType_BlendSpace:
         {
-            for (u32 ValueIndex = 0; ValueIndex < Node->BlendSpace->ValueCount; ++ValueIndex)
+            for (u32 ValueIndex = 0; ValueIndex < Node->Count; ++ValueIndex)
             {
-                blend_space_1d_value *Value = Node->BlendSpace->Values;
+                animation_graph_blend_value *Value = Definition->BlendValues + Node->Index + ValueIndex;
 
-                ResetAnimationState(&Value->AnimationState);
+                ResetAnimationState(Instance->Animations + Value->AnimationIndex);
             }
 
             break;
         }
         case AnimationNodeType_Graph:
         {
-            EnableAnimationNode(Node->Graph->Entry);
-            Node->Graph->Active = Node->Graph->Entry;
+            u32 EntryNodeIndex = Definition->Graphs[Node->Index].EntryNodeIndex;
+
+            EnableAnimationNode(Instance, EntryNodeIndex);
+            Instance->Graphs[Node->Index].ActiveNodeIndex = EntryNodeIndex;
+
+            break;
+        }
+        case AnimationNodeType_MotionMatching:
+        {
+            Instance->MotionMatchers[Node->Index].TimeSinceSearch = 0.f;
+            SearchMotionMatchingNode(Instance, NodeIndex, true);
 
             break;
         }
@@ -198,41 +1296,52 @@ EnableAnimationNode(animation_node *Node)
 }
 
 internal void
-DisableAnimationNode(animation_node *Node)
+DisableAnimationNode(animation_graph_instance *Instance, u32 NodeIndex)
 {
-    Node->Weight = 0.f;
+    animation_graph_definition *Definition = Instance->Definition;
+    animation_graph_node *Node = Definition->Nodes + NodeIndex;
+
+    Instance->Nodes[NodeIndex].Weight = 0.f;
 
     switch (Node->Type)
     {
         case AnimationNodeType_SingleMotion:
         {
-            ResetAnimationState(&Node->Animation);
+            ResetAnimationState(Instance->Animations + Node->Index);
 
             break;
         }
         case AnimationNodeType_BlendSpace:
         {
-            for (u32 ValueIndex = 0; ValueIndex < Node->BlendSpace->ValueCount; ++ValueIndex)
+            for (u32 ValueIndex = 0; ValueIndex < Node->Count; ++ValueIndex)
             {
-                blend_space_1d_value *Value = Node->BlendSpace->Values + ValueIndex;
+                animation_graph_blend_value *Value = Definition->BlendValues + Node->Index + ValueIndex;
 
-                Value->Weight = 0.f;
-                ResetAnimationState(&Value->AnimationState);
+                Instance->BlendValueWeights[Node->Index + ValueIndex] = 0.f;
+                ResetAnimationState(Instance->Animations + Value->AnimationIndex);
             }
 
             break;
         }
         case AnimationNodeType_Graph:
         {
-            for (u32 SubNodeIndex = 0; SubNodeIndex < Node->Graph->NodeCount; ++SubNodeIndex)
+            animation_graph_layout *Graph = Definition->Graphs + Node->Index;
+            animation_graph_state *GraphState = Instance->Graphs + Node->Index;
+
+            for (u32 SubNodeIndex = 0; SubNodeIndex < Graph->NodeCount; ++SubNodeIndex)
             {
-                animation_node *SubNode = Node->Graph->Nodes + SubNodeIndex;
-                DisableAnimationNode(SubNode);
+                DisableAnimationNode(Instance, Graph->FirstNodeIndex + SubNodeIndex);
             }
 
-            Node->Graph->Mixer = {};
-            Node->Graph->Entry->Weight = 1.f;
-            Node->Graph->Active = Node->Graph->Entry;
+            ResetAnimationMixer(&GraphState->Mixer);
+            Instance->Nodes[Graph->EntryNodeIndex].Weight = 1.f;
+            GraphState->ActiveNodeIndex = Graph->EntryNodeIndex;
+
+            break;
+        }
+        case AnimationNodeType_MotionMatching:
+        {
+            Instance->MotionMatchers[Node->Index].BlendTime = MOTION_MATCHING_BLEND_DURATION;
 
             break;
         }
@@ -240,32 +1349,32 @@ DisableAnimationNode(animation_node *Node)
 }
 
 inline void
-FadeIn(animation_mixer* Mixer, animation_node *Node, f32 Duration, f32 FadeInWeight)
+FadeIn(animation_mixer* Mixer, u32 NodeIndex, f32 Duration, f32 FadeInWeight)
 {
     Mixer->Time = 0.f;
     Mixer->Duration = Duration;
-    Mixer->FadeIn = Node;
+    Mixer->FadeInNodeIndex = NodeIndex;
     Mixer->FadeInWeight = FadeInWeight;
 }
 
 inline void
-FadeOut(animation_mixer* Mixer, animation_node *Node, f32 Duration, f32 FadeOutWeight)
+FadeOut(animation_mixer* Mixer, u32 NodeIndex, f32 Duration, f32 FadeOutWeight)
 {
     Mixer->Time = 0.f;
     Mixer->Duration = Duration;
-    Mixer->FadeOut = Node;
+    Mixer->FadeOutNodeIndex = NodeIndex;
     Mixer->FadeOutWeight = FadeOutWeight;
 }
 
 inline void
-CrossFade(animation_mixer *Mixer, animation_node *From, animation_node *To, f32 Duration)
+CrossFade(animation_graph_instance *Instance, animation_mixer *Mixer, u32 FromNodeIndex, u32 ToNodeIndex, f32 Duration)
 {
-    FadeIn(Mixer, To, Duration, To->Weight);
-    FadeOut(Mixer, From, Duration, From->Weight);
+    FadeIn(Mixer, ToNodeIndex, Duration, Instance->Nodes[ToNodeIndex].Weight);
+    FadeOut(Mixer, FromNodeIndex, Duration, Instance->Nodes[FromNodeIndex].Weight);
 }
 
 internal void
-AnimationMixerPerFrameUpdate(animation_mixer *Mixer, f32 Delta)
+AnimationMixerPerFrameUpdate(animation_graph_instance *Instance, animation_mixer *Mixer, f32 Delta)
 {
     Mixer->Time += Delta;
 
@@ -276,34 +1385,38 @@ AnimationMixerPerFrameUpdate(animation_mixer *Mixer, f32 Delta)
 
     f32 Value = Mixer->Time / Mixer->Duration;
 
-    if (Mixer->FadeIn)
+    if (Mixer->FadeInNodeIndex != U32_MAX)
     {
+        animation_node_state *FadeIn = Instance->Nodes + Mixer->FadeInNodeIndex;
+
         f32 FadeInWeight = Min(1.f, Mixer->FadeInWeight + Value);
         Assert(FadeInWeight >= 0.f && FadeInWeight <= 1.f);
 
-        Mixer->FadeIn->Weight = FadeInWeight;
+        FadeIn->Weight = FadeInWeight;
 
         if (Mixer->Time == Mixer->Duration)
         {
-            Assert(Mixer->FadeIn->Weight == 1.f);
+            Assert(FadeIn->Weight == 1.f);
 
             // todo: don't need to do this? 
-            //EnableAnimationNode(Mixer->FadeIn);
+            //EnableAnimationNode(Instance, Mixer->FadeInNodeIndex);
         }
     }
 
-    if (Mixer->FadeOut)
+    if (Mixer->FadeOutNodeIndex != U32_MAX)
     {
+        animation_node_state *FadeOut = Instance->Nodes + Mixer->FadeOutNodeIndex;
+
         f32 FadeOutWeight = Max(0.f, (Mixer->FadeOutWeight - Value));
         Assert(FadeOutWeight >= 0.f && FadeOutWeight <= 1.f);
 
-        Mixer->FadeOut->Weight = FadeOutWeight;
+        FadeOut->Weight = FadeOutWeight;
 
         if (Mixer->Time == Mixer->Duration)
         {
-            Assert(Mixer->FadeOut->Weight == 0.f);
+            Assert(FadeOut->Weight == 0.f);
 
-            DisableAnimationNode(Mixer->FadeOut);
+            DisableAnimationNode(Instance, Mixer->FadeOutNodeIndex);
         }
     }
 }
@@ -316,61 +1429,45 @@ UpdateGlobalJointPoses(skeleton_pose *Pose, transform Transform)
     RootLocalJointPose->Rotation = Transform.Rotation;
     RootLocalJointPose->Scale = Transform.Scale;
 
-    for (u32 JointIndex = 0; JointIndex < Pose->Skeleton->JointCount; ++JointIndex)
-    {
-        joint *Joint = Pose->Skeleton->Joints + JointIndex;
-        joint_pose *LocalJointPose = Pose->LocalJointPoses + JointIndex;
-        mat4 *GlobalJointPose = Pose->GlobalJointPoses + JointIndex;
-
-        *GlobalJointPose = CalculateGlobalJointPose(Joint, LocalJointPose, Pose);
-    }
+    CalculateGlobalJointPoses(Pose);
 }
 
 internal void
-TransitionToNode(animation_graph *Graph, const char *NodeName)
+TakeAnimationTransition(animation_graph_instance *Instance, u32 TransitionIndex)
 {
-    animation_node *FromNode = Graph->Active;
-    animation_transition *Transition = 0;
-
-    for (u32 TransitionIndex = 0; TransitionIndex < FromNode->TransitionCount; ++TransitionIndex)
-    {
-        animation_transition *CurrentTransition = FromNode->Transitions + TransitionIndex;
-
-        if (StringEquals(CurrentTransition->To->Name, NodeName))
-        {
-            Transition = CurrentTransition;
-            break;
-        }
-    }
+    animation_graph_definition *Definition = Instance->Definition;
+    animation_graph_transition *Transition = Definition->Transitions + TransitionIndex;
 
-    Assert(Transition);
+    u32 FromNodeIndex = Transition->FromNodeIndex;
+    u32 ToNodeIndex = Transition->ToNodeIndex;
 
-    animation_node *ToNode = Transition->To;
+    animation_graph_state *Graph = Instance->Graphs + Definition->Nodes[FromNodeIndex].GraphIndex;
+    Assert(Graph->ActiveNodeIndex == FromNodeIndex);
 
     switch (Transition->Type)
     {
         case AnimationTransitionType_Immediate:
         {
-            Graph->Active = ToNode;
+            Graph->ActiveNodeIndex = ToNodeIndex;
 
-            EnableAnimationNode(ToNode);
-            DisableAnimationNode(FromNode);
+            EnableAnimationNode(Instance, ToNodeIndex);
+            DisableAnimationNode(Instance, FromNodeIndex);
 
             break;
         }
         case AnimationTransitionType_Crossfade:
         {
-            Graph->Active = ToNode;
+            Graph->ActiveNodeIndex = ToNodeIndex;
 
-            CrossFade(&Graph->Mixer, FromNode, ToNode, Transition->Duration);
+            CrossFade(Instance, &Graph->Mixer, FromNodeIndex, ToNodeIndex, Transition->Duration);
 
             break;
         }
         case AnimationTransitionType_Transitional:
         {
-            Graph->Active = Transition->TransitionNode;
+            Graph->ActiveNodeIndex = Transition->TransitionNodeIndex;
 
-            CrossFade(&Graph->Mixer, FromNode, Transition->TransitionNode, Transition->Duration);
+            CrossFade(Instance, &Graph->Mixer, FromNodeIndex, Transition->TransitionNodeIndex, Transition->Duration);
 
             break;
         }
@@ -381,10 +1478,33 @@ TransitionToNode(animation_graph *Graph, const char *NodeName)
     }
 
     // todo: check if node is graph and reset it?
-    if (ToNode->Type == AnimationNodeType_Graph)
+    if (Definition->Nodes[ToNodeIndex].Type == AnimationNodeType_Graph)
+    {
+        DisableAnimationNode(Instance, ToNodeIndex);
+    }
+}
+
+internal void
+TransitionToNode(animation_graph_instance *Instance, u32 ToNodeIndex)
+{
+    animation_graph_definition *Definition = Instance->Definition;
+    u32 FromNodeIndex = Instance->Graphs[Definition->Nodes[ToNodeIndex].GraphIndex].ActiveNodeIndex;
+    animation_graph_node *FromNode = Definition->Nodes + FromNodeIndex;
+
+    u32 TransitionIndex = U32_MAX;
+
+    for (u32 Index = FromNode->FirstTransitionIndex; Index < FromNode->FirstTransitionIndex + FromNode->TransitionCount; ++Index)
     {
-        DisableAnimationNode(ToNode);
+        if (Definition->Transitions[Index].ToNodeIndex == ToNodeIndex)
+        {
+            TransitionIndex = Index;
+            break;
+        }
     }
+
+    Assert(TransitionIndex != U32_MAX);
+
+    TakeAnimationTransition(Instance, TransitionIndex);
 }
 
 internal void
@@ -407,85 +1527,118 @@ AnimationStatePerFrameUpdate(animation_state *AnimationState, f32 Delta)
 }
 
 internal void
-LinearLerpBlend(blend_space_1d *BlendSpace, f32 BlendParameter)
+LinearLerpBlend(animation_graph_instance *Instance, animation_graph_node *Node, f32 BlendParameter)
 {
-    Assert(BlendSpace->ValueCount > 1);
+    Assert(Node->Count > 1);
+
+    animation_graph_blend_value *Values = Instance->Definition->BlendValues + Node->Index;
+    f32 *Weights = Instance->BlendValueWeights + Node->Index;
 
-    blend_space_1d_value *BlendValueFrom = 0;
-    blend_space_1d_value *BlendValueTo = 0;
+    u32 BlendValueFromIndex = U32_MAX;
 
-    for (u32 AnimationBlendValueIndex = 0; AnimationBlendValueIndex < BlendSpace->ValueCount - 1; ++AnimationBlendValueIndex)
+    for (u32 AnimationBlendValueIndex = 0; AnimationBlendValueIndex < Node->Count - 1; ++AnimationBlendValueIndex)
     {
-        blend_space_1d_value *CurrentAnimationBlendValue = BlendSpace->Values + AnimationBlendValueIndex;
-        blend_space_1d_value *NextAnimationBlendValue = BlendSpace->Values + AnimationBlendValueIndex + 1;
+        animation_graph_blend_value *CurrentAnimationBlendValue = Values + AnimationBlendValueIndex;
+        animation_graph_blend_value *NextAnimationBlendValue = Values + AnimationBlendValueIndex + 1;
 
         if (InRange(BlendParameter, CurrentAnimationBlendValue->Value, NextAnimationBlendValue->Value))
         {
-            BlendValueFrom = CurrentAnimationBlendValue;
-            BlendValueTo = NextAnimationBlendValue;
+            BlendValueFromIndex = AnimationBlendValueIndex;
             break;
         }
     }
 
     // todo: perhaps, it's better to do a full weights reset after final skeleton pose calculation?
-    for (u32 AnimationBlendValueIndex = 0; AnimationBlendValueIndex < BlendSpace->ValueCount; ++AnimationBlendValueIndex)
+    for (u32 AnimationBlendValueIndex = 0; AnimationBlendValueIndex < Node->Count; ++AnimationBlendValueIndex)
     {
-        blend_space_1d_value *AnimationBlendValue = BlendSpace->Values + AnimationBlendValueIndex;
-        AnimationBlendValue->Weight = 0.f;
+        Weights[AnimationBlendValueIndex] = 0.f;
     }
 
-    Assert(BlendValueFrom && BlendValueTo);
+    Assert(BlendValueFromIndex != U32_MAX);
+
+    animation_graph_blend_value *BlendValueFrom = Values + BlendValueFromIndex;
+    animation_graph_blend_value *BlendValueTo = Values + BlendValueFromIndex + 1;
 
     f32 t = (BlendParameter - BlendValueFrom->Value) / (BlendValueTo->Value - BlendValueFrom->Value);
 
     Assert(t >= 0.f && t <= 1.f);
 
-    BlendValueFrom->Weight = 1.f - t;
-    BlendValueTo->Weight = t;
+    Weights[BlendValueFromIndex] = 1.f - t;
+    Weights[BlendValueFromIndex + 1] = t;
 }
 
 internal void
-AnimationBlendSpacePerFrameUpdate(blend_space_1d *BlendSpace, f32 BlendParameter, f32 Delta)
+AnimationBlendSpacePerFrameUpdate(animation_graph_instance *Instance, u32 NodeIndex, f32 BlendParameter, f32 Delta)
 {
-    LinearLerpBlend(BlendSpace, BlendParameter);
+    animation_graph_node *Node = Instance->Definition->Nodes + NodeIndex;
+    animation_node_state *NodeState = Instance->Nodes + NodeIndex;
+
+    animation_graph_blend_value *Values = Instance->Definition->BlendValues + Node->Index;
+    f32 *Weights = Instance->BlendValueWeights + Node->Index;
+
+    LinearLerpBlend(Instance, Node, BlendParameter);
 
     f32 Duration = 0.f;
-    for (u32 AnimationIndex = 0; AnimationIndex < BlendSpace->ValueCount; ++AnimationIndex)
+    for (u32 AnimationIndex = 0; AnimationIndex < Node->Count; ++AnimationIndex)
     {
-        blend_space_1d_value *Value = BlendSpace->Values + AnimationIndex;
-        Duration += Value->AnimationState.Clip->Duration * Value->Weight;
+        animation_state *AnimationState = Instance->Animations + Values[AnimationIndex].AnimationIndex;
+        Duration += AnimationState->Clip->Duration * Weights[AnimationIndex];
     }
 
     f32 NormalizedDelta = Delta / Duration;
-    BlendSpace->NormalizedTime += NormalizedDelta;
+    NodeState->NormalizedTime += NormalizedDelta;
 
-    if (BlendSpace->NormalizedTime > 1.f)
+    if (NodeState->NormalizedTime > 1.f)
     {
-        BlendSpace->NormalizedTime = 0.f;
+        NodeState->NormalizedTime = 0.f;
     }
 
-    for (u32 AnimationIndex = 0; AnimationIndex < BlendSpace->ValueCount; ++AnimationIndex)
+    for (u32 AnimationIndex = 0; AnimationIndex < Node->Count; ++AnimationIndex)
     {
-        blend_space_1d_value *Value = BlendSpace->Values + AnimationIndex;
-
-        if (Value->Weight > 0.f)
+        if (Weights[AnimationIndex] > 0.f)
         {
-            animation_state *AnimationState = &Value->AnimationState;
-            AnimationState->Time = BlendSpace->NormalizedTime * AnimationState->Clip->Duration;
+            animation_state *AnimationState = Instance->Animations + Values[AnimationIndex].AnimationIndex;
+            AnimationState->Time = NodeState->NormalizedTime * AnimationState->Clip->Duration;
         }
     }
 }
 
-internal void AnimationGraphPerFrameUpdate(animation_graph *Graph, f32 Delta);
+// Searches for a better frame once per MOTION_MATCHING_SEARCH_INTERVAL, not every frame
+internal void
+AnimationMotionMatchingPerFrameUpdate(animation_graph_instance *Instance, u32 NodeIndex, f32 Delta)
+{
+    animation_graph_node *Node = Instance->Definition->Nodes + NodeIndex;
+    motion_matching_state *State = Instance->MotionMatchers + Node->Index;
+
+    AnimationStatePerFrameUpdate(State->Animations + State->CurrentIndex, Delta);
+
+    if (State->BlendTime < MOTION_MATCHING_BLEND_DURATION)
+    {
+        AnimationStatePerFrameUpdate(State->Animations + (State->CurrentIndex ^ 1), Delta);
+    }
+
+    State->BlendTime += Delta;
+    State->TimeSinceSearch += Delta;
+
+    if (State->TimeSinceSearch >= MOTION_MATCHING_SEARCH_INTERVAL)
+    {
+        State->TimeSinceSearch = 0.f;
+        SearchMotionMatchingNode(Instance, NodeIndex, false);
+    }
+}
+
+internal void AnimationGraphPerFrameUpdate(animation_graph_instance *Instance, f32 Delta, u32 GraphIndex);
 
 internal void
-AnimationNodePerFrameUpdate(animation_node *Node, f32 Delta)
+AnimationNodePerFrameUpdate(animation_graph_instance *Instance, u32 NodeIndex, f32 Delta)
 {
-    Assert(Node->Weight > 0.f);
+    animation_graph_node *Node = Instance->Definition->Nodes + NodeIndex;
+
+    Assert(Instance->Nodes[NodeIndex].Weight > 0.f);
 
     if (Node->Update)
     {
-        Node->Update(Node->State, Node->Params, Delta);
+        Node->Update(Instance, NodeIndex, Delta);
     }
 
     // todo: hot-reloading doesn't work for some reason
@@ -493,181 +1646,503 @@ AnimationNodePerFrameUpdate(animation_node *Node, f32 Delta)
     {
         case AnimationNodeType_SingleMotion:
         {
-            AnimationStatePerFrameUpdate(&Node->Animation, Delta);
+            AnimationStatePerFrameUpdate(Instance->Animations + Node->Index, Delta);
             break;
         }
         case AnimationNodeType_BlendSpace:
         {
-            Assert(Node->Params);
+            AnimationBlendSpacePerFrameUpdate(Instance, NodeIndex, Instance->Params.Move, Delta);
+            break;
+        }
+        case AnimationNodeType_Graph:
+        {
+            AnimationGraphPerFrameUpdate(Instance, Delta, Node->Index);
+            break;
+        }
+        case AnimationNodeType_MotionMatching:
+        {
+            AnimationMotionMatchingPerFrameUpdate(Instance, NodeIndex, Delta);
+            break;
+        }
+        default:
+        {
+            Assert(!"Invalid animation node type");
+        }
+    }
+}
+
+internal void
+AnimationGraphPerFrameUpdate(animation_graph_instance *Instance, f32 Delta, u32 GraphIndex = 0)
+{
+    animation_graph_layout *Graph = Instance->Definition->Graphs + GraphIndex;
+
+    AnimationMixerPerFrameUpdate(Instance, &Instance->Graphs[GraphIndex].Mixer, Delta);
+
+    for (u32 NodeIndex = Graph->FirstNodeIndex; NodeIndex < Graph->FirstNodeIndex + Graph->NodeCount; ++NodeIndex)
+    {
+        if (Instance->Nodes[NodeIndex].Weight > 0.f)
+        {
+            AnimationNodePerFrameUpdate(Instance, NodeIndex, Delta);
+        }
+    }
+
+    if (GraphIndex == 0)
+    {
+        if (Instance->HasRootMotion)
+        {
+            Instance->RootMotionDuration += Delta;
+        }
+
+        for (u32 LayerIndex = 0; LayerIndex < Instance->Definition->LayerCount; ++LayerIndex)
+        {
+            if (Instance->LayerWeights[LayerIndex] > 0.f)
+            {
+                AnimationGraphPerFrameUpdate(Instance, Delta, Instance->Definition->Layers[LayerIndex].GraphIndex);
+            }
+        }
+    }
+}
+
+internal animation_clip *
+GetAnimationClip(model *Model, const char *ClipName)
+{
+    animation_clip *Result = 0;
+
+    for (u32 AnimationClipIndex = 0; AnimationClipIndex < Model->AnimationCount; ++AnimationClipIndex)
+    {
+        animation_clip *AnimationClip = Model->Animations + AnimationClipIndex;
+
+        if (StringEquals(AnimationClip->Name, ClipName))
+        {
+            Result = AnimationClip;
+            break;
+        }
+    }
+
+    Assert(Result);
+
+    return Result;
+}
+
+inline u32
+GetKeyFrameCursorCount(animation_clip *Clip)
+{
+    u32 Result = 0;
+
+    switch (Clip->Format)
+    {
+        case AnimationClipFormat_KeyFrames:
+        {
+            Result = Clip->PoseSampleCount;
+            break;
+        }
+        case AnimationClipFormat_Compressed:
+        {
+            Result = Clip->TimelineCount;
+            break;
+        }
+        case AnimationClipFormat_Uniform:
+        {
+            // Doesn't search for key frames
+            Result = 0;
+            break;
+        }
+    }
+
+    return Result;
+}
+
+inline animation_state
+CreateAnimationState(animation_clip *Clip, memory_arena *Arena)
+{
+    animation_state Result = {};
+    Result.Clip = Clip;
+    Result.KeyFrameCursors = PushArray(Arena, GetKeyFrameCursorCount(Clip), u32);
+    Result.RootMotionTime = -1.f;
+
+    return Result;
+}
+
+inline void
+BuildAnimationNode(animation_node *Node, const char *Name, animation_clip *Clip)
+{
+    *Node = {};
+    Node->Type = AnimationNodeType_SingleMotion;
+    CopyString(Name, Node->Name, ArrayCount(Node->Name));
+    Node->Clip = Clip;
+}
+
+inline void
+BuildAnimationNode(animation_node *Node, const char *Name, blend_space_1d *BlendSpace)
+{
+    *Node = {};
+    Node->Type = AnimationNodeType_BlendSpace;
+    CopyString(Name, Node->Name, ArrayCount(Node->Name));
+    Node->BlendSpace = BlendSpace;
+}
+
+inline void
+BuildAnimationNode(animation_node *Node, const char *Name, animation_graph *Graph)
+{
+    *Node = {};
+    Node->Type = AnimationNodeType_Graph;
+    CopyString(Name, Node->Name, ArrayCount(Node->Name));
+    Node->Graph = Graph;
+}
+
+inline void
+BuildAnimationNode(animation_node *Node, const char *Name, motion_database *MotionDatabase)
+{
+    *Node = {};
+    Node->Type = AnimationNodeType_MotionMatching;
+    CopyString(Name, Node->Name, ArrayCount(Node->Name));
+    Node->MotionDatabase = MotionDatabase;
+}
+
+inline void
+BuildAnimationTransition(
+    animation_transition *Transition, 
+    animation_node *From, 
+    animation_node *To, 
+    animation_transition_type Type, 
+    f32 Duration = 0.f,
+    animation_node *TransitionNode = 0
+)
+{
+    *Transition = {};
+    Transition->From = From;
+    Transition->To = To;
+    Transition->Type = Type;
+    Transition->Duration = Duration;
+    Transition->TransitionNode = TransitionNode;
+}
+
+// Build-time only (node names don't exist in the compiled graph), use Index of the result after compiling
+inline animation_node *
+GetAnimationNode(animation_graph *Graph, const char *NodeName)
+{
+    animation_node *Result = 0;
+
+    for (u32 NodeIndex = 0; NodeIndex < Graph->NodeCount; ++NodeIndex)
+    {
+        animation_node *Node = Graph->Nodes + NodeIndex;
+
+        if (StringEquals(Node->Name, NodeName))
+        {
+            Result = Node;
+        }
+    }
+
+    Assert(Result);
+
+    return Result;
+}
+
+// Reserves contiguous node range for each (sub)graph and assigns indices to build-time nodes
+internal void
+AssignAnimationGraphIndices(animation_graph *Graph, animation_graph_definition *Definition)
+{
+    Graph->Index = Definition->GraphCount++;
+
+    u32 FirstNodeIndex = Definition->NodeCount;
+    Definition->NodeCount += Graph->NodeCount;
+
+    for (u32 NodeIndex = 0; NodeIndex < Graph->NodeCount; ++NodeIndex)
+    {
+        animation_node *Node = Graph->Nodes + NodeIndex;
+
+        Node->Index = FirstNodeIndex + NodeIndex;
+        Definition->TransitionCount += Node->TransitionCount;
+
+        switch (Node->Type)
+        {
+            case AnimationNodeType_SingleMotion:
+            {
+                Definition->AnimationCount += 1;
+                break;
+            }
+            case AnimationNodeType_BlendSpace:
+            {
+                Definition->BlendValueCount += Node->BlendSpace->ValueCount;
+                Definition->AnimationCount += Node->BlendSpace->ValueCount;
+                break;
+            }
+            case AnimationNodeType_MotionMatching:
+            {
+                Definition->MotionMatcherCount += 1;
+                break;
+            }
+        }
+    }
+
+    for (u32 NodeIndex = 0; NodeIndex < Graph->NodeCount; ++NodeIndex)
+    {
+        animation_node *Node = Graph->Nodes + NodeIndex;
+
+        if (Node->Type == AnimationNodeType_Graph)
+        {
+            AssignAnimationGraphIndices(Node->Graph, Definition);
+        }
+    }
+
+    Assert(Graph->Index == 0 || Graph->LayerCount == 0);
+
+    Definition->LayerCount += Graph->LayerCount;
+
+    for (u32 LayerIndex = 0; LayerIndex < Graph->LayerCount; ++LayerIndex)
+    {
+        AssignAnimationGraphIndices(Graph->Layers[LayerIndex].Graph, Definition);
+    }
+}
+
+// Counts are used as cursors, compiled arrays are already allocated
+internal void
+FillAnimationGraphDefinition(animation_graph *Graph, animation_graph_definition *Definition)
+{
+    animation_graph_layout *Layout = Definition->Graphs + Graph->Index;
+    Layout->FirstNodeIndex = Graph->NodeCount > 0 ? Graph->Nodes[0].Index : 0;
+    Layout->NodeCount = Graph->NodeCount;
+    Layout->EntryNodeIndex = Graph->Entry->Index;
+
+    for (u32 NodeIndex = 0; NodeIndex < Graph->NodeCount; ++NodeIndex)
+    {
+        animation_node *Node = Graph->Nodes + NodeIndex;
+        animation_graph_node *CompiledNode = Definition->Nodes + Node->Index;
+
+        CompiledNode->Type = Node->Type;
+        CompiledNode->GraphIndex = Graph->Index;
+        CompiledNode->MaxTime = Node->MaxTime;
+        CompiledNode->Update = Node->Update;
+
+        switch (Node->Type)
+        {
+            case AnimationNodeType_SingleMotion:
+            {
+                CompiledNode->Index = Definition->AnimationCount;
+                Definition->Clips[Definition->AnimationCount++] = Node->Clip;
+
+                break;
+            }
+            case AnimationNodeType_BlendSpace:
+            {
+                CompiledNode->Index = Definition->BlendValueCount;
+                CompiledNode->Count = Node->BlendSpace->ValueCount;
+
+                for (u32 ValueIndex = 0; ValueIndex < Node->BlendSpace->ValueCount; ++ValueIndex)
+                {
+                    blend_space_1d_value *Value = Node->BlendSpace->Values + ValueIndex;
+                    animation_graph_blend_value *CompiledValue = Definition->BlendValues + Definition->BlendValueCount++;
+
+                    CompiledValue->Value = Value->Value;
+                    CompiledValue->AnimationIndex = Definition->AnimationCount;
+                    Definition->Clips[Definition->AnimationCount++] = Value->Clip;
+                }
+
+                break;
+            }
+            case AnimationNodeType_Graph:
+            {
+                CompiledNode->Index = Node->Graph->Index;
 
-            AnimationBlendSpacePerFrameUpdate(Node->BlendSpace, Node->Params->Move, Delta);
-            break;
-        }
-        case AnimationNodeType_Graph:
-        {
-            AnimationGraphPerFrameUpdate(Node->Graph, Delta);
-            break;
+                break;
+            }
+            case AnimationNodeType_MotionMatching:
+            {
+                CompiledNode->Index = Definition->MotionMatcherCount;
+                Definition->MotionDatabases[Definition->MotionMatcherCount++] = Node->MotionDatabase;
+
+                break;
+            }
         }
-        default:
+
+        CompiledNode->FirstTransitionIndex = Definition->TransitionCount;
+        CompiledNode->TransitionCount = Node->TransitionCount;
+
+        for (u32 TransitionIndex = 0; TransitionIndex < Node->TransitionCount; ++TransitionIndex)
         {
-            Assert(!"Invalid animation node type");
+            animation_transition *Transition = Node->Transitions + TransitionIndex;
+            animation_graph_transition *CompiledTransition = Definition->Transitions + Definition->TransitionCount++;
+
+            Assert(Transition->From == Node);
+
+            CompiledTransition->Type = Transition->Type;
+            CompiledTransition->FromNodeIndex = Transition->From->Index;
+            CompiledTransition->ToNodeIndex = Transition->To->Index;
+            CompiledTransition->TransitionNodeIndex = Transition->TransitionNode ? Transition->TransitionNode->Index : U32_MAX;
+            CompiledTransition->Duration = Transition->Duration;
         }
     }
-}
-
-internal void
-AnimationGraphPerFrameUpdate(animation_graph *Graph, f32 Delta)
-{
-    AnimationMixerPerFrameUpdate(&Graph->Mixer, Delta);
 
     for (u32 NodeIndex = 0; NodeIndex < Graph->NodeCount; ++NodeIndex)
     {
         animation_node *Node = Graph->Nodes + NodeIndex;
 
-        if (Node->Weight > 0.f)
+        if (Node->Type == AnimationNodeType_Graph)
         {
-            AnimationNodePerFrameUpdate(Node, Delta);
+            FillAnimationGraphDefinition(Node->Graph, Definition);
         }
     }
+
+    for (u32 LayerIndex = 0; LayerIndex < Graph->LayerCount; ++LayerIndex)
+    {
+        animation_layer *Layer = Graph->Layers + LayerIndex;
+        animation_graph_layer *CompiledLayer = Definition->Layers + LayerIndex;
+
+        CompiledLayer->GraphIndex = Layer->Graph->Index;
+        CompiledLayer->JointMaskIndex = Layer->JointMaskIndex;
+
+        FillAnimationGraphDefinition(Layer->Graph, Definition);
+    }
 }
 
-internal animation_clip *
-GetAnimationClip(model *Model, const char *ClipName)
+// Build-time graph can be discarded afterwards
+internal animation_graph_definition *
+CompileAnimationGraph(animation_graph *Graph, memory_arena *Arena)
 {
-    animation_clip *Result = 0;
+    animation_graph_definition *Result = PushType(Arena, animation_graph_definition);
 
-    for (u32 AnimationClipIndex = 0; AnimationClipIndex < Model->AnimationCount; ++AnimationClipIndex)
-    {
-        animation_clip *AnimationClip = Model->Animations + AnimationClipIndex;
+    AssignAnimationGraphIndices(Graph, Result);
 
-        if (StringEquals(AnimationClip->Name, ClipName))
-        {
-            Result = AnimationClip;
-            break;
-        }
-    }
+    u32 TransitionCount = Result->TransitionCount;
+    u32 BlendValueCount = Result->BlendValueCount;
+    u32 AnimationCount = Result->AnimationCount;
+    u32 MotionMatcherCount = Result->MotionMatcherCount;
 
-    Assert(Result);
+    Result->Graphs = PushArray(Arena, Result->GraphCount, animation_graph_layout);
+    Result->Nodes = PushArray(Arena, Result->NodeCount, animation_graph_node);
+    Result->Transitions = PushArray(Arena, TransitionCount, animation_graph_transition);
+    Result->BlendValues = PushArray(Arena, BlendValueCount, animation_graph_blend_value);
+    Result->Clips = PushArray(Arena, AnimationCount, animation_clip *);
+    Result->Layers = PushArray(Arena, Result->LayerCount, animation_graph_layer);
+    Result->MotionDatabases = PushArray(Arena, MotionMatcherCount, motion_database *);
 
-    return Result;
-}
+    Result->TransitionCount = 0;
+    Result->BlendValueCount = 0;
+    Result->AnimationCount = 0;
+    Result->MotionMatcherCount = 0;
 
-inline animation_state
-CreateAnimationState(animation_clip *Clip)
-{
-    animation_state Result = {};
-    Result.Clip = Clip;
+    FillAnimationGraphDefinition(Graph, Result);
+
+    Assert(Result->TransitionCount == TransitionCount);
+    Assert(Result->BlendValueCount == BlendValueCount);
+    Assert(Result->AnimationCount == AnimationCount);
+    Assert(Result->MotionMatcherCount == MotionMatcherCount);
 
     return Result;
 }
 
-inline void
-BuildAnimationNode(animation_node *Node, const char *Name, animation_clip *Clip)
+internal animation_graph_instance *
+CreateAnimationGraphInstance(animation_graph_definition *Definition, memory_arena *Arena, random_sequence *Entropy)
 {
-    *Node = {};
-    Node->Type = AnimationNodeType_SingleMotion;
-    CopyString(Name, Node->Name, ArrayCount(Node->Name));
-    Node->Animation = CreateAnimationState(Clip);
-}
+    animation_graph_instance *Result = PushType(Arena, animation_graph_instance);
+    Result->Definition = Definition;
+    Result->Entropy = Entropy;
+
+    Result->Nodes = PushArray(Arena, Definition->NodeCount, animation_node_state);
+    Result->Graphs = PushArray(Arena, Definition->GraphCount, animation_graph_state);
+    Result->BlendValueWeights = PushArray(Arena, Definition->BlendValueCount, f32);
+    Result->Animations = PushArray(Arena, Definition->AnimationCount, animation_state);
+    Result->LayerWeights = PushArray(Arena, Definition->LayerCount, f32);
+    Result->MotionMatchers = PushArray(Arena, Definition->MotionMatcherCount, motion_matching_state);
+
+    for (u32 AnimationIndex = 0; AnimationIndex < Definition->AnimationCount; ++AnimationIndex)
+    {
+        Result->Animations[AnimationIndex] = CreateAnimationState(Definition->Clips[AnimationIndex], Arena);
+    }
 
-inline void
-BuildAnimationNode(animation_node *Node, const char *Name, blend_space_1d *BlendSpace)
-{
-    *Node = {};
-    Node->Type = AnimationNodeType_BlendSpace;
-    CopyString(Name, Node->Name, ArrayCount(Node->Name));
-    Node->BlendSpace = BlendSpace;
-}
+    for (u32 MotionMatcherIndex = 0; MotionMatcherIndex < Definition->MotionMatcherCount; ++MotionMatcherIndex)
+    {
+        motion_database *Database = Definition->MotionDatabases[MotionMatcherIndex];
+        motion_matching_state *State = Result->MotionMatchers + MotionMatcherIndex;
 
-inline void
-BuildAnimationNode(animation_node *Node, const char *Name, animation_graph *Graph)
-{
-    *Node = {};
-    Node->Type = AnimationNodeType_Graph;
-    CopyString(Name, Node->Name, ArrayCount(Node->Name));
-    Node->Graph = Graph;
-}
+        Assert(Database->ClipCount > 0);
 
-inline void
-BuildAnimationTransition(
-    animation_transition *Transition, 
-    animation_node *From, 
-    animation_node *To, 
-    animation_transition_type Type, 
-    f32 Duration = 0.f,
-    animation_node *TransitionNode = 0
-)
-{
-    *Transition = {};
-    Transition->From = From;
-    Transition->To = To;
-    Transition->Type = Type;
-    Transition->Duration = Duration;
-    Transition->TransitionNode = TransitionNode;
-}
+        // Both slots play any of the database clips
+        u32 MaxCursorCount = 0;
+        for (u32 ClipIndex = 0; ClipIndex < Database->ClipCount; ++ClipIndex)
+        {
+            u32 CursorCount = GetKeyFrameCursorCount(Database->Animations + Database->Clips[ClipIndex].AnimationIndex);
+            MaxCursorCount = CursorCount > MaxCursorCount ? CursorCount : MaxCursorCount;
+        }
 
-inline animation_node *
-GetAnimationNode(animation_graph *Graph, char *NodeName)
-{
-    animation_node *Result = 0;
+        for (u32 SlotIndex = 0; SlotIndex < ArrayCount(State->Animations); ++SlotIndex)
+        {
+            animation_state *Animation = State->Animations + SlotIndex;
+            *Animation = {};
+            Animation->Clip = Database->Animations + Database->Clips[0].AnimationIndex;
+            Animation->KeyFrameCursors = PushArray(Arena, MaxCursorCount, u32);
+            Animation->RootMotionTime = -1.f;
+        }
 
-    for (u32 NodeIndex = 0; NodeIndex < Graph->NodeCount; ++NodeIndex)
+        State->BlendTime = MOTION_MATCHING_BLEND_DURATION;
+    }
+
+    for (u32 GraphIndex = 0; GraphIndex < Definition->GraphCount; ++GraphIndex)
     {
-        animation_node *Node = Graph->Nodes + NodeIndex;
+        animation_graph_layout *Graph = Definition->Graphs + GraphIndex;
+        animation_graph_state *GraphState = Result->Graphs + GraphIndex;
 
-        if (StringEquals(Node->Name, NodeName))
+        GraphState->ActiveNodeIndex = Graph->EntryNodeIndex;
+        ResetAnimationMixer(&GraphState->Mixer);
+
+        // Root graph is inactive until ActivateAnimationNode is called, layers - until they have some weight
+        if (GraphIndex > 0)
         {
-            Result = Node;
+            Result->Nodes[Graph->EntryNodeIndex].Weight = 1.f;
         }
     }
 
-    Assert(Result);
-
     return Result;
 }
 
 inline void
-ActivateAnimationNode(animation_graph *Graph, const char *NodeName)
+ActivateAnimationNode(animation_graph_instance *Instance, u32 NodeIndex)
 {
-    animation_node *Node= GetAnimationNode(Graph, (char *)NodeName);
-
-    Graph->Active = Node;
-    EnableAnimationNode(Node);
+    Instance->Graphs[Instance->Definition->Nodes[NodeIndex].GraphIndex].ActiveNodeIndex = NodeIndex;
+    EnableAnimationNode(Instance, NodeIndex);
 }
 
 ANIMATION_NODE_UPDATE(IdleEntryNodeUpdate)
 {
+    animation_graph_node *Node = Instance->Definition->Nodes + NodeIndex;
+    animation_node_state *State = Instance->Nodes + NodeIndex;
+
     State->Time += Delta;
 
-    if (State->Time > State->MaxTime)
+    if (State->Time > Node->MaxTime)
     {
         State->Time = 0.f;
 
-        if (Random01(State->Entropy) > 0.5f)
+        Assert(Node->TransitionCount == 2);
+
+        if (Random01(Instance->Entropy) > 0.5f)
         {
-            TransitionToNode(State->Graph, "Idle_Node#Node_1");
+            TakeAnimationTransition(Instance, Node->FirstTransitionIndex + 0);
         }
         else
         {
-            TransitionToNode(State->Graph, "Idle_Node#Node_2");
+            TakeAnimationTransition(Instance, Node->FirstTransitionIndex + 1);
         }
     }
 }
 
 ANIMATION_NODE_UPDATE(LongIdleNodeUpdate)
 {
-    if (State->Graph->Active->Animation.Time > State->Graph->Active->Animation.Clip->Duration)
+    animation_graph_node *Node = Instance->Definition->Nodes + NodeIndex;
+    animation_state *Animation = Instance->Animations + Node->Index;
+
+    if (Instance->Graphs[Node->GraphIndex].ActiveNodeIndex == NodeIndex && Animation->Time > Animation->Clip->Duration)
     {
-        TransitionToNode(State->Graph, "Idle_Node#Node_0");
+        TakeAnimationTransition(Instance, Node->FirstTransitionIndex + 0);
     }
 }
 
+// Motion matching (experimental) replaces the Move_Node blend space when the model has a motion database
 internal void
-BuildAnimationGraph(animation_graph *Graph, model *Model, memory_arena *Arena, random_sequence *Entropy)
+BuildAnimationGraph(animation_graph *Graph, model *Model, memory_arena *Arena, b32 UseMotionMatching = false)
 {
     *Graph = {};
 
-    Graph->Mixer = {};
     Graph->NodeCount = 3;
     Graph->Nodes = PushArray(Arena, Graph->NodeCount, animation_node);
 
@@ -680,7 +2155,6 @@ BuildAnimationGraph(animation_graph *Graph, model *Model, memory_arena *Arena, r
 
     animation_graph *IdleGraph = PushType(Arena, animation_graph);
 
-    IdleGraph->Mixer = {};
     IdleGraph->NodeCount = 3;
     IdleGraph->Nodes = PushArray(Arena, IdleGraph->NodeCount, animation_node);
 
@@ -691,23 +2165,15 @@ BuildAnimationGraph(animation_graph *Graph, model *Model, memory_arena *Arena, r
 
         animation_node *IdleEntry = IdleGraph->Nodes + 0;
         BuildAnimationNode(IdleEntry, "Idle_Node#Node_0", GetAnimationClip(Model, "Idle"));
-        IdleEntry->State = PushType(Arena, animation_node_state);
-        IdleEntry->State->Time = 0.f;
-        IdleEntry->State->MaxTime = 5.f;
-        IdleEntry->State->Entropy = Entropy;
-        IdleEntry->State->Graph = IdleGraph;
+        IdleEntry->MaxTime = 5.f;
         IdleEntry->Update = IdleEntryNodeUpdate;
 
         animation_node *LongIdleEntry = IdleGraph->Nodes + 1;
         BuildAnimationNode(LongIdleEntry, "Idle_Node#Node_1", GetAnimationClip(Model, "Idle_2"));
-        LongIdleEntry->State = PushType(Arena, animation_node_state);
-        LongIdleEntry->State->Graph = IdleGraph;
         LongIdleEntry->Update = LongIdleNodeUpdate;
 
         animation_node *LongIdle2Entry = IdleGraph->Nodes + 2;
         BuildAnimationNode(LongIdle2Entry, "Idle_Node#Node_2", GetAnimationClip(Model, "Idle_3"));
-        LongIdle2Entry->State = PushType(Arena, animation_node_state);
-        LongIdle2Entry->State->Graph = IdleGraph;
         LongIdle2Entry->Update = LongIdleNodeUpdate;
 
         // Transitions
@@ -738,38 +2204,41 @@ BuildAnimationGraph(animation_graph *Graph, model *Model, memory_arena *Arena, r
 
         //
         IdleGraph->Entry = IdleEntry;
-        IdleGraph->Active = IdleGraph->Entry;
-        IdleEntry->Weight = 1.f;
     }
 
     // Moving
     animation_node *NodeWalking = Graph->Nodes + NodeIndex++;
 
-    blend_space_1d *BlendSpace = PushType(Arena, blend_space_1d);
-    BlendSpace->ValueCount = 3;
-    BlendSpace->Values = PushArray(Arena, BlendSpace->ValueCount, blend_space_1d_value);
-
+    if (UseMotionMatching && Model->MotionDatabase)
     {
-        blend_space_1d_value *Value = BlendSpace->Values + 0;
-        Value->Value = 0.f;
-        Value->AnimationState = CreateAnimationState(GetAnimationClip(Model, "Idle_4"));
+        BuildAnimationNode(NodeWalking, "Move_Node", Model->MotionDatabase);
     }
-
+    else
     {
-        blend_space_1d_value *Value = BlendSpace->Values + 1;
-        Value->Value = 0.5f;
-        Value->AnimationState = CreateAnimationState(GetAnimationClip(Model, "Walking"));
-    }
+        blend_space_1d *BlendSpace = PushType(Arena, blend_space_1d);
+        BlendSpace->ValueCount = 3;
+        BlendSpace->Values = PushArray(Arena, BlendSpace->ValueCount, blend_space_1d_value);
 
-    {
-        blend_space_1d_value *Value = BlendSpace->Values + 2;
-        Value->Value = 1.f;
-        Value->AnimationState = CreateAnimationState(GetAnimationClip(Model, "Running"));
-    }
+        {
+            blend_space_1d_value *Value = BlendSpace->Values + 0;
+            Value->Value = 0.f;
+            Value->Clip = GetAnimationClip(Model, "Idle_4");
+        }
+
+        {
+            blend_space_1d_value *Value = BlendSpace->Values + 1;
+            Value->Value = 0.5f;
+            Value->Clip = GetAnimationClip(Model, "Walking");
+        }
+
+        {
+            blend_space_1d_value *Value = BlendSpace->Values + 2;
+            Value->Value = 1.f;
+            Value->Clip = GetAnimationClip(Model, "Running");
+        }
 
-    BuildAnimationNode(NodeWalking, "Move_Node", BlendSpace);
-    NodeWalking->Params = PushType(Arena, animation_node_params);
-    NodeWalking->Params->Move = 0.f;
+        BuildAnimationNode(NodeWalking, "Move_Node", BlendSpace);
+    }
 
     // Dancing
     animation_node *NodeDancing = Graph->Nodes + NodeIndex++;
@@ -801,21 +2270,57 @@ BuildAnimationGraph(animation_graph *Graph, model *Model, memory_arena *Arena, r
     animation_transition *DanceToIdleTransition = NodeDancing->Transitions + 0;
     BuildAnimationTransition(DanceToIdleTransition, NodeDancing, NodeIdle, AnimationTransitionType_Crossfade, 0.2f);
 
+    // Layers
+
+    // Upper body dance and breathing (weights are set in debug UI)
+    Graph->LayerCount = 2;
+    Graph->Layers = PushArray(Arena, Graph->LayerCount, animation_layer);
+
+    {
+        animation_graph *UpperBodyGraph = PushType(Arena, animation_graph);
+
+        UpperBodyGraph->NodeCount = 1;
+        UpperBodyGraph->Nodes = PushArray(Arena, UpperBodyGraph->NodeCount, animation_node);
+
+        BuildAnimationNode(UpperBodyGraph->Nodes + 0, "Upper_Body_Layer#Node_0", GetAnimationClip(Model, "Samba"));
+        UpperBodyGraph->Entry = UpperBodyGraph->Nodes + 0;
+
+        animation_layer *UpperBodyLayer = Graph->Layers + 0;
+        UpperBodyLayer->Graph = UpperBodyGraph;
+        UpperBodyLayer->JointMaskIndex = GetJointMaskIndex(Model->Skeleton, "UpperBody");
+    }
+
+    {
+        animation_graph *BreathingGraph = PushType(Arena, animation_graph);
+
+        BreathingGraph->NodeCount = 1;
+        BreathingGraph->Nodes = PushArray(Arena, BreathingGraph->NodeCount, animation_node);
+
+        BuildAnimationNode(BreathingGraph->Nodes + 0, "Breathing_Layer#Node_0", GetAnimationClip(Model, "Idle_Additive"));
+        BreathingGraph->Entry = BreathingGraph->Nodes + 0;
+
+        animation_layer *BreathingLayer = Graph->Layers + 1;
+        BreathingLayer->Graph = BreathingGraph;
+        BreathingLayer->JointMaskIndex = GetJointMaskIndex(Model->Skeleton, "UpperBody");
+    }
+
     //
     Graph->Entry = NodeIdle;
-    Graph->Active = NodeIdle;
 }
 
 internal u32
-GetActiveAnimationCount(animation_graph *Graph)
+GetActiveAnimationCount(animation_graph_instance *Instance, u32 GraphIndex = 0)
 {
+    animation_graph_definition *Definition = Instance->Definition;
+    animation_graph_layout *Graph = Definition->Graphs + GraphIndex;
+
     u32 Result = 0;
 
-    for (u32 NodeIndex = 0; NodeIndex < Graph->NodeCount; ++NodeIndex)
+    for (u32 NodeIndex = Graph->FirstNodeIndex; NodeIndex < Graph->FirstNodeIndex + Graph->NodeCount; ++NodeIndex)
     {
-        animation_node *Node = Graph->Nodes + NodeIndex;
+        animation_graph_node *Node = Definition->Nodes + NodeIndex;
 
-        if (Node->Weight > 0.f)
+        if (Instance->Nodes[NodeIndex].Weight > 0.f)
         {
             switch (Node->Type)
             {
@@ -826,11 +2331,9 @@ GetActiveAnimationCount(animation_graph *Graph)
                 }
                 case AnimationNodeType_BlendSpace:
                 {
-                    for (u32 Index = 0; Index < Node->BlendSpace->ValueCount; ++Index)
+                    for (u32 Index = 0; Index < Node->Count; ++Index)
                     {
-                        blend_space_1d_value *Value = Node->BlendSpace->Values + Index;
-
-                        if (Value->Weight > 0.f)
+                        if (Instance->BlendValueWeights[Node->Index + Index] > 0.f)
                         {
                             ++Result;
                         }
@@ -840,7 +2343,12 @@ GetActiveAnimationCount(animation_graph *Graph)
                 }
                 case AnimationNodeType_Graph:
                 {
-                    Result += GetActiveAnimationCount(Node->Graph);
+                    Result += GetActiveAnimationCount(Instance, Node->Index);
+                    break;
+                }
+                case AnimationNodeType_MotionMatching:
+                {
+                    Result += GetMotionMatchingBlendWeight(Instance->MotionMatchers + Node->Index) < 1.f ? 2 : 1;
                     break;
                 }
             }
@@ -850,37 +2358,50 @@ GetActiveAnimationCount(animation_graph *Graph)
     return Result;
 }
 
+// Weights are returned in ActiveAnimationWeights (indexed like ActiveAnimations), animation states are not modified
 internal void
-GetActiveAnimations(animation_graph *Graph, animation_state **ActiveAnimations, u32 &ActiveAnimationIndex, f32 GraphWeight)
+GetActiveAnimations(
+    animation_graph_instance *Instance,
+    animation_state **ActiveAnimations,
+    f32 *ActiveAnimationWeights,
+    u32 &ActiveAnimationIndex,
+    f32 GraphWeight,
+    u32 GraphIndex = 0
+)
 {
-    for (u32 NodeIndex = 0; NodeIndex < Graph->NodeCount; ++NodeIndex)
+    animation_graph_definition *Definition = Instance->Definition;
+    animation_graph_layout *Graph = Definition->Graphs + GraphIndex;
+
+    for (u32 NodeIndex = Graph->FirstNodeIndex; NodeIndex < Graph->FirstNodeIndex + Graph->NodeCount; ++NodeIndex)
     {
-        animation_node *Node = Graph->Nodes + NodeIndex;
+        animation_graph_node *Node = Definition->Nodes + NodeIndex;
+        f32 NodeWeight = Instance->Nodes[NodeIndex].Weight;
 
-        if (Node->Weight > 0.f)
+        if (NodeWeight > 0.f)
         {
             switch (Node->Type)
             {
                 case AnimationNodeType_SingleMotion:
                 {
-                    animation_state **ActiveAnimationState = ActiveAnimations + ActiveAnimationIndex++;
-                    
-                    *ActiveAnimationState = &Node->Animation;
-                    (*ActiveAnimationState)->Weight = GraphWeight * Node->Weight;
+                    ActiveAnimations[ActiveAnimationIndex] = Instance->Animations + Node->Index;
+                    ActiveAnimationWeights[ActiveAnimationIndex] = GraphWeight * NodeWeight;
+                    ++ActiveAnimationIndex;
 
                     break;
                 }
                 case AnimationNodeType_BlendSpace:
                 {
-                    for (u32 Index = 0; Index < Node->BlendSpace->ValueCount; ++Index)
+                    for (u32 Index = 0; Index < Node->Count; ++Index)
                     {
-                        blend_space_1d_value *Value = Node->BlendSpace->Values + Index;
+                        f32 ValueWeight = Instance->BlendValueWeights[Node->Index + Index];
 
-                        if (Value->Weight > 0.f)
+                        if (ValueWeight > 0.f)
                         {
-                            animation_state **ActiveAnimationState = ActiveAnimations + ActiveAnimationIndex++;
-                            *ActiveAnimationState = &Value->AnimationState;
-                            (*ActiveAnimationState)->Weight = GraphWeight * Node->Weight * Value->Weight;
+                            animation_graph_blend_value *Value = Definition->BlendValues + Node->Index + Index;
+
+                            ActiveAnimations[ActiveAnimationIndex] = Instance->Animations + Value->AnimationIndex;
+                            ActiveAnimationWeights[ActiveAnimationIndex] = GraphWeight * NodeWeight * ValueWeight;
+                            ++ActiveAnimationIndex;
                         }
                     }
 
@@ -888,7 +2409,25 @@ GetActiveAnimations(animation_graph *Graph, animation_state **ActiveAnimations,
                 }
                 case AnimationNodeType_Graph:
                 {
-                    GetActiveAnimations(Node->Graph, ActiveAnimations, ActiveAnimationIndex, Node->Weight);
+                    GetActiveAnimations(Instance, ActiveAnimations, ActiveAnimationWeights, ActiveAnimationIndex, GraphWeight * NodeWeight, Node->Index);
+
+                    break;
+                }
+                case AnimationNodeType_MotionMatching:
+                {
+                    motion_matching_state *State = Instance->MotionMatchers + Node->Index;
+                    f32 BlendWeight = GetMotionMatchingBlendWeight(State);
+
+                    ActiveAnimations[ActiveAnimationIndex] = State->Animations + State->CurrentIndex;
+                    ActiveAnimationWeights[ActiveAnimationIndex] = GraphWeight * NodeWeight * BlendWeight;
+                    ++ActiveAnimationIndex;
+
+                    if (BlendWeight < 1.f)
+                    {
+                        ActiveAnimations[ActiveAnimationIndex] = State->Animations + (State->CurrentIndex ^ 1);
+                        ActiveAnimationWeights[ActiveAnimationIndex] = GraphWeight * NodeWeight * (1.f - BlendWeight);
+                        ++ActiveAnimationIndex;
+                    }
 
                     break;
                 }
@@ -897,91 +2436,254 @@ GetActiveAnimations(animation_graph *Graph, animation_state **ActiveAnimations,
     }
 }
 
+// Blends active animations of the (sub)graph over the current pose, additive clips are applied after the rest are resolved
 internal void
-CalculateSkeletonPose(animation_graph *Graph, skeleton_pose *DestPose, memory_arena *Arena)
+BlendAnimationGraph(skeleton_pose_accumulator *Accumulator, animation_graph_instance *Instance, u32 GraphIndex, skeleton_pose *DestPose, memory_arena *Arena)
 {
-    u32 ActiveAnimationCount = GetActiveAnimationCount(Graph);
+    u32 ActiveAnimationCount = GetActiveAnimationCount(Instance, GraphIndex);
 
     if (ActiveAnimationCount > 0)
     {
         scoped_memory ScopedMemory(Arena);
 
-        skeleton_pose *SkeletonPoses = PushArray(ScopedMemory.Arena, ActiveAnimationCount, skeleton_pose);
         animation_state **ActiveAnimations = PushArray(ScopedMemory.Arena, ActiveAnimationCount, animation_state *);
+        f32 *ActiveAnimationWeights = PushArray(ScopedMemory.Arena, ActiveAnimationCount, f32);
         
         u32 ActiveAnimationIndex = 0;
-        GetActiveAnimations(Graph, ActiveAnimations, ActiveAnimationIndex, 1.f);
+        GetActiveAnimations(Instance, ActiveAnimations, ActiveAnimationWeights, ActiveAnimationIndex, 1.f, GraphIndex);
         
         // Checking weights (not necessary)
         f32 TotalWeight = 0.f;
         for (u32 ActiveAnimationIndex = 0; ActiveAnimationIndex < ActiveAnimationCount; ++ActiveAnimationIndex)
         {
-            animation_state *Animation = ActiveAnimations[ActiveAnimationIndex];
-            TotalWeight += Animation->Weight;
+            TotalWeight += ActiveAnimationWeights[ActiveAnimationIndex];
         }
         Assert(Abs(1.f - TotalWeight) < EPSILON);
         //
-        
-        // Creating skeleton pose for each input clip
-        for (u32 SkeletonPoseIndex = 0; SkeletonPoseIndex < ActiveAnimationCount; ++SkeletonPoseIndex)
+
+        // todo: multithreading?
+        // Each clip is sampled straight into the accumulator, so memory usage doesn't depend on the number of clips
+        b32 HasAdditiveAnimations = false;
+        b32 HasAccumulatedAnimations = false;
+
+        for (u32 AnimationIndex = 0; AnimationIndex < ActiveAnimationCount; ++AnimationIndex)
+        {
+            animation_state *AnimationState = ActiveAnimations[AnimationIndex];
+
+            if (AnimationState->Clip->IsAdditive)
+            {
+                HasAdditiveAnimations = true;
+            }
+            else
+            {
+                AccumulateSkeletonPose(Accumulator, AnimationState, ActiveAnimationWeights[AnimationIndex]);
+                HasAccumulatedAnimations = true;
+            }
+        }
+
+        if (HasAccumulatedAnimations)
         {
-            skeleton_pose *SkeletonPose = SkeletonPoses + SkeletonPoseIndex;
-            SkeletonPose->Skeleton = DestPose->Skeleton;
-            SkeletonPose->LocalJointPoses = PushArray(ScopedMemory.Arena, DestPose->Skeleton->JointCount, joint_pose);
+            ResolveSkeletonPoseAccumulator(Accumulator, DestPose);
+        }
 
-            for (u32 JointIndex = 0; JointIndex < DestPose->Skeleton->JointCount; ++JointIndex)
+        if (HasAdditiveAnimations)
+        {
+            for (u32 AnimationIndex = 0; AnimationIndex < ActiveAnimationCount; ++AnimationIndex)
             {
-                joint_pose *LocalJointPose = SkeletonPose->LocalJointPoses + JointIndex;
-                joint_pose *SkeletonLocalJointPose = DestPose->LocalJointPoses + JointIndex;
+                animation_state *AnimationState = ActiveAnimations[AnimationIndex];
 
-                *LocalJointPose = *SkeletonLocalJointPose;
+                if (AnimationState->Clip->IsAdditive)
+                {
+                    ApplyAdditiveSkeletonPose(Accumulator, AnimationState, ActiveAnimationWeights[AnimationIndex]);
+                }
             }
         }
+    }
+}
 
-        // todo: multithreading?
-        // Extracting skeleton pose from each input clip
-        for (u32 AnimationIndex = 0; AnimationIndex < ActiveAnimationCount; ++AnimationIndex)
+// Joints lower than MinJointHeight (see JointHeights) keep their current pose.
+// Layers are blended over the root graph pose in order, only the joints in their masks are sampled.
+// Additive clips cost a single delta application per sampled joint, without a separate blend pass
+internal void
+CalculateSkeletonPose(animation_graph_instance *Instance, skeleton_pose *DestPose, memory_arena *Arena, u32 *JointHeights = 0, u32 MinJointHeight = 0, pose_cache *PoseCache = 0)
+{
+    scoped_memory ScopedMemory(Arena);
+
+    skeleton_pose_accumulator Accumulator = CreateSkeletonPoseAccumulator(DestPose, ScopedMemory.Arena);
+    Accumulator.JointHeights = JointHeights;
+    Accumulator.MinJointHeight = MinJointHeight;
+    Accumulator.PoseCache = PoseCache;
+
+    BlendAnimationGraph(&Accumulator, Instance, 0, DestPose, ScopedMemory.Arena);
+
+    animation_graph_definition *Definition = Instance->Definition;
+
+    for (u32 LayerIndex = 0; LayerIndex < Definition->LayerCount; ++LayerIndex)
+    {
+        animation_graph_layer *Layer = Definition->Layers + LayerIndex;
+        f32 LayerWeight = Instance->LayerWeights[LayerIndex];
+
+        if (LayerWeight > 0.f)
         {
-            animation_state *AnimationState = ActiveAnimations[AnimationIndex];
-            skeleton_pose *SkeletonPose = SkeletonPoses + AnimationIndex;
+            Assert(Layer->JointMaskIndex < DestPose->Skeleton->JointMaskCount);
+
+            // Resolve leaves the accumulator cleared
+            Accumulator.JointMask = DestPose->Skeleton->JointMasks[Layer->JointMaskIndex].Weights;
+            Accumulator.MaskWeight = Min(LayerWeight, 1.f);
 
-            AnimateSkeletonPose(SkeletonPose, AnimationState->Clip, AnimationState->Time);
+            BlendAnimationGraph(&Accumulator, Instance, Layer->GraphIndex, DestPose, ScopedMemory.Arena);
         }
+    }
+}
+
+internal root_motion_key
+SampleRootMotion(root_motion_track *Track, f32 Time)
+{
+    Assert(Track->KeyFrameCount > 0);
 
-        // Lerping between all skeleton poses
-        skeleton_pose *Pose = First(SkeletonPoses);
-        animation_state *Animation = *First(ActiveAnimations);
+    root_motion_key *KeyFrames = Track->KeyFrames;
+    u32 LastKeyFrameIndex = Track->KeyFrameCount - 1;
 
-        Lerp(Pose, 0.f, Pose, DestPose);
+    root_motion_key Result;
 
-        f32 AccumulatedWeight = Animation->Weight;
-        u32 CurrentPoseIndex = 1;
+    if (Time <= KeyFrames[0].Time)
+    {
+        Result = KeyFrames[0];
+    }
+    else if (Time >= KeyFrames[LastKeyFrameIndex].Time)
+    {
+        Result = KeyFrames[LastKeyFrameIndex];
+    }
+    else
+    {
+        // Sampled once per tick, so there is no cursor
+        u32 Low = 0;
+        u32 High = LastKeyFrameIndex;
 
-        while (CurrentPoseIndex < ActiveAnimationCount)
+        while (High - Low > 1)
         {
-            skeleton_pose *NextPose = SkeletonPoses + CurrentPoseIndex;
-            animation_state *NextAnimation = ActiveAnimations[CurrentPoseIndex];
-            ++CurrentPoseIndex;
+            u32 Middle = (Low + High) / 2;
 
-            f32 NextWeight = NextAnimation->Weight;
+            if (KeyFrames[Middle].Time <= Time)
+            {
+                Low = Middle;
+            }
+            else
+            {
+                High = Middle;
+            }
+        }
 
-            f32 t = NextWeight / (AccumulatedWeight + NextWeight);
+        root_motion_key *PrevKeyFrame = KeyFrames + Low;
+        root_motion_key *NextKeyFrame = KeyFrames + High;
 
-            Assert(t >= 0.f && t <= 1.f);
+        f32 t = (Time - PrevKeyFrame->Time) / (NextKeyFrame->Time - PrevKeyFrame->Time);
+
+        Result.Time = Time;
+        Result.Translation = Lerp(PrevKeyFrame->Translation, t, NextKeyFrame->Translation);
+        Result.Yaw = Lerp(PrevKeyFrame->Yaw, t, NextKeyFrame->Yaw);
+    }
+
+    return Result;
+}
+
+// Rotation around the up axis
+inline vec3
+RotateYaw(vec3 Vector, f32 Yaw)
+{
+    f32 CosYaw = Cos(Yaw);
+    f32 SinYaw = Sin(Yaw);
+
+    vec3 Result = vec3(Vector.x * CosYaw + Vector.z * SinYaw, Vector.y, Vector.z * CosYaw - Vector.x * SinYaw);
+
+    return Result;
+}
+
+// Motion between two times of the clip, looping clips can wrap around the end
+internal root_motion
+GetAnimationClipRootMotion(animation_clip *Clip, f32 FromTime, f32 ToTime)
+{
+    root_motion_track *Track = &Clip->RootMotion;
+
+    root_motion_key From = SampleRootMotion(Track, FromTime);
+    root_motion_key To = SampleRootMotion(Track, ToTime);
+
+    root_motion Result = {};
+
+    if (ToTime >= FromTime)
+    {
+        Result.Translation = RotateYaw(To.Translation - From.Translation, -From.Yaw);
+        Result.Yaw = To.Yaw - From.Yaw;
+    }
+    else
+    {
+        // Track starts at zero, so the motion after the wrap is just continued from where the clip ended
+        root_motion_key *End = Track->KeyFrames + Track->KeyFrameCount - 1;
+
+        Result.Translation = RotateYaw(End->Translation - From.Translation, -From.Yaw) + RotateYaw(To.Translation, End->Yaw - From.Yaw);
+        Result.Yaw = End->Yaw - From.Yaw + To.Yaw;
+    }
+
+    return Result;
+}
+
+// Blended motion of the root graph clips since the previous call (layers don't move the entity), 
+// expected to be called once per update tick
+internal root_motion
+ExtractRootMotion(animation_graph_instance *Instance, memory_arena *Arena)
+{
+    Assert(Instance->HasRootMotion);
+
+    root_motion Result = {};
+    Result.Duration = Instance->RootMotionDuration;
+
+    Instance->RootMotionDuration = 0.f;
+
+    scoped_memory ScopedMemory(Arena);
+
+    u32 ActiveAnimationCount = GetActiveAnimationCount(Instance, 0);
+    animation_state **ActiveAnimations = PushArray(ScopedMemory.Arena, ActiveAnimationCount, animation_state *);
+    f32 *ActiveAnimationWeights = PushArray(ScopedMemory.Arena, ActiveAnimationCount, f32);
+
+    u32 ActiveAnimationIndex = 0;
+    GetActiveAnimations(Instance, ActiveAnimations, ActiveAnimationWeights, ActiveAnimationIndex, 1.f, 0);
 
-            Lerp(Pose, t, NextPose, DestPose);
+    for (u32 AnimationIndex = 0; AnimationIndex < ActiveAnimationCount; ++AnimationIndex)
+    {
+        animation_state *AnimationState = ActiveAnimations[AnimationIndex];
+        animation_clip *Clip = AnimationState->Clip;
+
+        if (Clip->RootMotion.KeyFrameCount > 0 && AnimationState->RootMotionTime >= 0.f)
+        {
+            root_motion ClipRootMotion = GetAnimationClipRootMotion(Clip, AnimationState->RootMotionTime, AnimationState->Time);
 
-            Pose = DestPose;
-            Animation = NextAnimation;
-            AccumulatedWeight += NextWeight;
+            Result.Translation += ClipRootMotion.Translation * ActiveAnimationWeights[AnimationIndex];
+            Result.Yaw += ClipRootMotion.Yaw * ActiveAnimationWeights[AnimationIndex];
         }
 
-        // Clearing weights (not necessary?)
+        AnimationState->RootMotionTime = AnimationState->Time;
+    }
+
+    // Time of inactive clips can jump (blend spaces) before they become active again
+    for (u32 AnimationIndex = 0; AnimationIndex < Instance->Definition->AnimationCount; ++AnimationIndex)
+    {
+        animation_state *AnimationState = Instance->Animations + AnimationIndex;
+        b32 IsActive = false;
+
         for (u32 ActiveAnimationIndex = 0; ActiveAnimationIndex < ActiveAnimationCount; ++ActiveAnimationIndex)
         {
-            animation_state *Animation = ActiveAnimations[ActiveAnimationIndex];
-            Animation->Weight = 0.f;
+            if (ActiveAnimations[ActiveAnimationIndex] == AnimationState)
+            {
+                IsActive = true;
+                break;
+            }
+        }
+
+        if (!IsActive)
+        {
+            AnimationState->RootMotionTime = -1.f;
         }
     }
-}
 
+    return Result;
+}
@@ -2,6 +2,17 @@
 
 #define MAX_JOINT_NAME_LENGTH 256
 #define MAX_ANIMATION_NAME_LENGTH 256
+#define MAX_KEY_FRAME_CURSOR_STEPS 4
+#define JOINT_POSE_LANE_COUNT 4
+#define ROOT_TRANSLATION_JOINT_INDEX 1
+#define MAX_JOINT_MASK_COUNT 8
+#define MOTION_FEATURE_STRIDE 28
+#define MOTION_TRAJECTORY_POINT_COUNT 3
+#define MOTION_KD_TREE_LEAF_SIZE 16
+#define MOTION_MATCHING_SEARCH_INTERVAL 0.1f
+#define MOTION_MATCHING_BLEND_DURATION 0.2f
+// Squared feature distance a better frame has to win by, so that the clip doesn't jump back and forth because of noise
+#define MOTION_MATCHING_JUMP_COST 0.05f
 
 #define joint_pose transform
 
@@ -16,10 +27,20 @@ struct joint
     i32 ParentIndex;
 };
 
+// Per-joint weights in [0, 1], used by animation layers
+struct joint_mask
+{
+    char Name[64];
+    f32 *Weights;
+};
+
 struct skeleton
 {
     u32 JointCount;
     joint *Joints;
+
+    u32 JointMaskCount;
+    joint_mask JointMasks[MAX_JOINT_MASK_COUNT];
 };
 
 struct skeleton_pose
@@ -29,6 +50,15 @@ struct skeleton_pose
     mat4 *GlobalJointPoses;
 };
 
+// Structure of arrays: channel (animation_frame_channel) values of all joints are stored together,
+// Stride is JointCount rounded up to JOINT_POSE_LANE_COUNT
+struct skeleton_pose_soa
+{
+    skeleton *Skeleton;
+    u32 Stride;
+    f32 *Channels;
+};
+
 struct joint_weight
 {
     u32 JointIndex;
@@ -48,38 +78,299 @@ struct animation_sample
     key_frame *KeyFrames;
 };
 
+// Smallest three: the largest component is dropped (and restored from unit length),
+// the other three are quantized to 15 bits, index of the dropped one is stored in the top bits of the first two
+struct compressed_quat
+{
+    u16 Elements[3];
+};
+
+// Quantized to 16 bits within the [Min, Min + Extent] range of the track
+struct quantized_vec3
+{
+    u16 Elements[3];
+};
+
+// Key frame times, shared by all compressed samples that have the same timeline
+struct animation_timeline
+{
+    u32 KeyFrameCount;
+    f32 *Times;
+};
+
+struct compressed_animation_sample
+{
+    u32 JointIndex;
+    // 1 when all channels are constant (static joint), otherwise equals timeline key frame count
+    u32 KeyFrameCount;
+    u32 TimelineIndex;
+
+    // 0 for constant channels (a single value is stored), 1 otherwise
+    u32 RotationStride;
+    u32 TranslationStride;
+    u32 ScaleStride;
+
+    vec3 TranslationMin;
+    vec3 TranslationExtent;
+    vec3 ScaleMin;
+    vec3 ScaleExtent;
+
+    compressed_quat *Rotations;
+    quantized_vec3 *Translations;
+    quantized_vec3 *Scales;
+};
+
+enum animation_clip_format
+{
+    AnimationClipFormat_KeyFrames,
+    AnimationClipFormat_Compressed,
+    AnimationClipFormat_Uniform
+};
+
+// Channels of a uniformly sampled frame, each channel stores values of all samples (SoA)
+enum animation_frame_channel
+{
+    AnimationFrameChannel_RotationX,
+    AnimationFrameChannel_RotationY,
+    AnimationFrameChannel_RotationZ,
+    AnimationFrameChannel_RotationW,
+    AnimationFrameChannel_TranslationX,
+    AnimationFrameChannel_TranslationY,
+    AnimationFrameChannel_TranslationZ,
+    AnimationFrameChannel_ScaleX,
+    AnimationFrameChannel_ScaleY,
+    AnimationFrameChannel_ScaleZ,
+
+    AnimationFrameChannel_Count
+};
+
+// Motion of the root translation joint on the ground plane and its turn around the up axis, 
+// accumulated from the start of the clip (entity space)
+struct root_motion_key
+{
+    f32 Time;
+    vec3 Translation;
+    f32 Yaw;
+};
+
+struct root_motion_track
+{
+    u32 KeyFrameCount;
+    root_motion_key *KeyFrames;
+};
+
+// Delta since the previous extraction, relative to the entity orientation at that time
+struct root_motion
+{
+    vec3 Translation;
+    f32 Yaw;
+    // Animation time that has passed
+    f32 Duration;
+};
+
 struct animation_clip
 {
     char Name[MAX_ANIMATION_NAME_LENGTH];
     f32 Duration;
     b32 IsLooping;
+    // Root motion is extracted by the asset builder, the root translation joint stays in place
     b32 InPlace;
+    // Key frames store deltas against the reference pose (first frame of the source clip), 
+    // applied on top of the current pose instead of being blended with it
+    b32 IsAdditive;
+
+    animation_clip_format Format;
 
     u32 PoseSampleCount;
-    animation_sample *PoseSamples;
+    union
+    {
+        animation_sample *PoseSamples;
+        compressed_animation_sample *CompressedPoseSamples;
+    };
+
+    u32 TimelineCount;
+    animation_timeline *Timelines;
+
+    // Uniform format: every sample has a key frame at each 1 / SampleRate,
+    // FrameCount * AnimationFrameChannel_Count * PoseSampleCount values
+    f32 SampleRate;
+    u32 FrameCount;
+    u32 *FrameJointIndices;
+    f32 *Frames;
+
+    // InPlace clips only
+    root_motion_track RootMotion;
+};
+
+// Offsets of the feature groups in a motion database frame (entity space, model units),
+// the rest of MOTION_FEATURE_STRIDE is zero padding
+enum motion_feature
+{
+    MotionFeature_LeftFootPosition = 0,
+    MotionFeature_RightFootPosition = 3,
+    MotionFeature_LeftFootVelocity = 6,
+    MotionFeature_RightFootVelocity = 9,
+    MotionFeature_HipVelocity = 12,
+    // x and z of each future trajectory point
+    MotionFeature_TrajectoryPositions = 15,
+    MotionFeature_TrajectoryDirections = 21,
+
+    MotionFeature_Count = 27
+};
+
+struct motion_database_frame
+{
+    u32 ClipIndex;
+    f32 Time;
+};
+
+struct motion_database_clip
+{
+    // Index into the model clips
+    u32 AnimationIndex;
+    // Clip frames (in time order) are ClipFrameIndices[FirstFrameIndex, FirstFrameIndex + FrameCount)
+    u32 FirstFrameIndex;
+    u32 FrameCount;
+};
+
+// Leaf nodes own a contiguous range of database frames, inner nodes split the frames by a single feature
+struct motion_kd_node
+{
+    // 0 for inner nodes
+    u32 FrameCount;
+    u32 FirstFrameIndex;
+
+    u32 SplitFeature;
+    f32 SplitValue;
+    // Frames with smaller values of the split feature, the other child is at ChildIndex + 1
+    u32 ChildIndex;
+};
+
+// Features of the sampled clip frames, built by the asset builder and searched by motion matching nodes.
+// Features are normalized ((Value - Offset) * Scale) and weighted, frames are stored in KD-tree leaf order
+struct motion_database
+{
+    f32 SampleRate;
+    f32 TrajectoryTimes[MOTION_TRAJECTORY_POINT_COUNT];
+    // Of the trajectory, full locomotion speed
+    f32 MaxSpeed;
+
+    f32 Offsets[MOTION_FEATURE_STRIDE];
+    f32 Scales[MOTION_FEATURE_STRIDE];
+
+    u32 FrameCount;
+    motion_database_frame *Frames;
+    f32 *Features;
+
+    u32 ClipCount;
+    motion_database_clip *Clips;
+    u32 *ClipFrameIndices;
+
+    u32 NodeCount;
+    motion_kd_node *Nodes;
+
+    // Model clips, set on load
+    animation_clip *Animations;
 };
 
 struct animation_state
 {
     f32 Time;
-    // todo: This weight is used to store computed values during final pose computing. 
-    // This of a better name or place it somewhere else?
-    f32 Weight;
 
     animation_clip *Clip;
+
+    // Time of the last root motion extraction, negative if the clip wasn't active at that moment
+    f32 RootMotionTime;
+
+    // Per-sample (per-timeline for compressed clips) key frame cursors (last found key frame index),
+    // so that sampling doesn't have to search from the start
+    u32 *KeyFrameCursors;
+};
+
+enum pose_cache_entry_state
+{
+    PoseCacheEntryState_Empty,
+    PoseCacheEntryState_Sampling,
+    PoseCacheEntryState_Ready
+};
+
+struct pose_cache_entry
+{
+    u32 volatile State;
+
+    animation_clip *Clip;
+    skeleton *Skeleton;
+    u32 TimeKey;
+
+    // Only joints animated by the clip are valid
+    joint_pose *LocalJointPoses;
+};
+
+// Clip samples shared by all instances that evaluate the same clip at the same (quantized) time during a frame,
+// safe to use from multiple threads
+struct pose_cache
+{
+    b32 IsEnabled;
+    // 0 - only exactly the same times are shared
+    f32 TimeStep;
+
+    u32 MaxJointCount;
+    u32 EntryCount;
+    pose_cache_entry *Entries;
+
+    u32 volatile LookupCount;
+    u32 volatile HitCount;
+
+    // Stats of the previous frame
+    u32 LastLookupCount;
+    u32 LastHitCount;
+};
+
+struct skeleton_pose_accumulator
+{
+    u32 JointCount;
+    skeleton *Skeleton;
+    // Current pose: rotation hemisphere reference and the value for joints that are not animated by some clip
+    joint_pose *ReferencePoses;
+
+    // Weighted sums (rotations are not normalized) and per-joint sum of weights
+    joint_pose *Poses;
+    f32 *Weights;
+    f32 TotalWeight;
+
+    // Weight of the clip that is being sampled
+    f32 Weight;
+
+    // Joints lower than MinJointHeight are not sampled (optional)
+    u32 *JointHeights;
+    u32 MinJointHeight;
+
+    // Joints with zero mask weight are not sampled, the rest are blended over the current pose with MaskWeight * JointMask weight (optional)
+    f32 *JointMask;
+    f32 MaskWeight;
+
+    // Optional
+    pose_cache *PoseCache;
 };
 
+// Applies additive clip deltas straight to the accumulator's current pose, 
+// joints are skipped the same way as by the accumulator
+struct skeleton_pose_additive
+{
+    skeleton_pose_accumulator *Accumulator;
+    f32 Weight;
+};
+
+// Build-time graph description (see BuildAnimationGraph), compiled by CompileAnimationGraph and then discarded
+
 struct blend_space_1d_value
 {
-    animation_state AnimationState;
+    animation_clip *Clip;
     f32 Value;
-    f32 Weight;
 };
 
 struct blend_space_1d
 {
-    f32 NormalizedTime;
-
     u32 ValueCount;
     blend_space_1d_value *Values;
 };
@@ -106,46 +397,152 @@ enum animation_node_type
 {
     AnimationNodeType_SingleMotion,
     AnimationNodeType_BlendSpace,
-    AnimationNodeType_Graph
-};
-
-struct animation_node_params
-{
-    f32 Move;
+    AnimationNodeType_Graph,
+    // Experimental: plays the database frame that matches the current pose and the desired trajectory best
+    AnimationNodeType_MotionMatching
 };
 
-struct animation_node_state
-{
-    f32 Time;
-    f32 MaxTime;
-    random_sequence *Entropy;
-    animation_graph *Graph;
-};
+struct animation_graph_instance;
 
-#define ANIMATION_NODE_UPDATE(name) void name(animation_node_state *State, animation_node_params *Params, f32 Delta)
+#define ANIMATION_NODE_UPDATE(name) void name(animation_graph_instance *Instance, u32 NodeIndex, f32 Delta)
 typedef ANIMATION_NODE_UPDATE(animation_node_update);
 
 struct animation_node
 {
     char Name[64];
-    f32 Weight;
+    // Assigned by CompileAnimationGraph
+    u32 Index;
 
     animation_node_type Type;
     union
     {
-        animation_state Animation;
+        animation_clip *Clip;
         blend_space_1d *BlendSpace;
         animation_graph *Graph;
+        motion_database *MotionDatabase;
     };
 
     u32 TransitionCount;
     animation_transition *Transitions;
 
-    animation_node_state *State;
-    animation_node_params *Params;
+    f32 MaxTime;
+    animation_node_update *Update;
+};
+
+// Graph that is blended over the masked joints of the root graph result
+struct animation_layer
+{
+    animation_graph *Graph;
+    u32 JointMaskIndex;
+};
+
+struct animation_graph
+{
+    // Assigned by CompileAnimationGraph
+    u32 Index;
+
+    u32 NodeCount;
+    animation_node *Nodes;
+
+    animation_node *Entry;
+
+    // Root graph only, applied in order
+    u32 LayerCount;
+    animation_layer *Layers;
+};
+
+// Compiled graph definition, shared by all instances.
+// Nodes of each (sub)graph are stored contiguously, everything is referenced by index
+
+struct animation_graph_node
+{
+    animation_node_type Type;
+    // Graph that the node belongs to
+    u32 GraphIndex;
+
+    // SingleMotion: animation index, BlendSpace: first blend value index, Graph: sub-graph index, MotionMatching: motion matcher index
+    u32 Index;
+    // BlendSpace: blend value count
+    u32 Count;
+
+    u32 FirstTransitionIndex;
+    u32 TransitionCount;
+
+    f32 MaxTime;
     animation_node_update *Update;
 };
 
+struct animation_graph_transition
+{
+    animation_transition_type Type;
+
+    u32 FromNodeIndex;
+    u32 ToNodeIndex;
+    u32 TransitionNodeIndex;
+
+    f32 Duration;
+};
+
+struct animation_graph_blend_value
+{
+    u32 AnimationIndex;
+    f32 Value;
+};
+
+struct animation_graph_layout
+{
+    u32 FirstNodeIndex;
+    u32 NodeCount;
+    u32 EntryNodeIndex;
+};
+
+struct animation_graph_layer
+{
+    u32 GraphIndex;
+    u32 JointMaskIndex;
+};
+
+struct animation_graph_definition
+{
+    // Graph 0 is the root graph
+    u32 GraphCount;
+    animation_graph_layout *Graphs;
+
+    u32 NodeCount;
+    animation_graph_node *Nodes;
+
+    u32 TransitionCount;
+    animation_graph_transition *Transitions;
+
+    u32 BlendValueCount;
+    animation_graph_blend_value *BlendValues;
+
+    u32 AnimationCount;
+    animation_clip **Clips;
+
+    u32 LayerCount;
+    animation_graph_layer *Layers;
+
+    u32 MotionMatcherCount;
+    motion_database **MotionDatabases;
+};
+
+// Per-instance runtime state
+
+struct animation_node_params
+{
+    f32 Move;
+};
+
+struct animation_node_state
+{
+    f32 Weight;
+    // Used by node update function
+    f32 Time;
+    // Blend space only
+    f32 NormalizedTime;
+};
+
 struct animation_mixer
 {
     f32 Time;
@@ -153,17 +550,45 @@ struct animation_mixer
     f32 FadeInWeight;
     f32 FadeOutWeight;
 
-    animation_node *FadeIn;
-    animation_node *FadeOut;
+    // U32_MAX if not set
+    u32 FadeInNodeIndex;
+    u32 FadeOutNodeIndex;
 };
 
-struct animation_graph
+struct motion_matching_state
 {
-    u32 NodeCount;
-    animation_node *Nodes;
+    // Playing clip and the one that is faded out after the last jump
+    animation_state Animations[2];
+    u32 ClipIndices[2];
+    u32 CurrentIndex;
 
-    animation_node *Entry;
-    animation_node *Active;
+    f32 BlendTime;
+    f32 TimeSinceSearch;
+};
 
+struct animation_graph_state
+{
+    u32 ActiveNodeIndex;
     animation_mixer Mixer;
 };
+
+struct animation_graph_instance
+{
+    animation_graph_definition *Definition;
+
+    animation_node_state *Nodes;
+    animation_graph_state *Graphs;
+    animation_state *Animations;
+    f32 *BlendValueWeights;
+    // Layers with zero weight are neither updated nor sampled
+    f32 *LayerWeights;
+    motion_matching_state *MotionMatchers;
+
+    animation_node_params Params;
+    random_sequence *Entropy;
+
+    // Set for entities that call ExtractRootMotion every update tick, otherwise RootMotionDuration is not tracked
+    b32 HasRootMotion;
+    // Time the root graph has advanced since root motion was last extracted
+    f32 RootMotionDuration;
+};
@@ -1,11 +1,30 @@
+// Static assets of older versions are still readable (header fields are only appended), animated ones are not
+// because the clip format has changed
+internal b32
+IsModelAssetSupported(void *Buffer)
+{
+    model_asset_header *Header = (model_asset_header *)Buffer;
+
+    b32 Result = Header->MagicValue == MODEL_ASSET_MAGIC_VALUE && Header->Version >= 1 && Header->Version <= MODEL_ASSET_VERSION;
+
+    if (Result && Header->Version != MODEL_ASSET_VERSION)
+    {
+        model_asset_animations_header *AnimationsHeader = (model_asset_animations_header *)
+            ((u8 *)Buffer + Header->AnimationsHeaderOffset);
+
+        Result = AnimationsHeader->AnimationCount == 0;
+    }
+
+    return Result;
+}
+
+// Vertices, indices, bitmaps, key frames and other bulk data are not copied, asset points into the file contents
+// (which have to outlive it). Arena only gets the arrays patched with pointers
 internal model_asset *
-LoadModelAsset(platform_api *Platform, char *FileName, memory_arena *Arena)
+ReadModelAssetContents(void *Buffer, memory_arena *Arena)
 {
     model_asset *Result = PushType(Arena, model_asset);
 
-    read_file_result AssetFile = Platform->ReadFile(FileName, Arena, false);
-    void *Buffer = AssetFile.Contents;
-
     model_asset_header *Header = (model_asset_header *)Buffer;
 
     // Skeleton
@@ -171,27 +190,384 @@ LoadModelAsset(platform_api *Platform, char *FileName, memory_arena *Arena)
         Animation->Duration = AnimationHeader->Duration;
         Animation->IsLooping = AnimationHeader->IsLooping;
         Animation->InPlace = AnimationHeader->InPlace;
+        Animation->IsAdditive = AnimationHeader->IsAdditive;
+        Animation->Format = AnimationHeader->Format;
         Animation->PoseSampleCount = AnimationHeader->PoseSampleCount;
-        Animation->PoseSamples = PushArray(Arena, Animation->PoseSampleCount, animation_sample);
 
-        u64 NextAnimationSampleHeaderOffset = 0;
-        for (u32 AnimationPoseIndex = 0; AnimationPoseIndex < AnimationHeader->PoseSampleCount; ++AnimationPoseIndex)
+        switch (Animation->Format)
+        {
+            case AnimationClipFormat_KeyFrames:
+            {
+                Animation->PoseSamples = PushArray(Arena, Animation->PoseSampleCount, animation_sample);
+
+                u64 NextAnimationSampleHeaderOffset = 0;
+                for (u32 AnimationPoseIndex = 0; AnimationPoseIndex < AnimationHeader->PoseSampleCount; ++AnimationPoseIndex)
+                {
+                    model_asset_animation_sample_header *AnimationSampleHeader = (model_asset_animation_sample_header *)
+                        ((u8 *)Buffer + AnimationHeader->PoseSamplesOffset + NextAnimationSampleHeaderOffset);
+
+                    animation_sample *AnimationSample = Animation->PoseSamples + AnimationPoseIndex;
+
+                    AnimationSample->JointIndex = AnimationSampleHeader->JointIndex;
+                    AnimationSample->KeyFrameCount = AnimationSampleHeader->KeyFrameCount;
+                    AnimationSample->KeyFrames = (key_frame *)((u8 *)Buffer + AnimationSampleHeader->KeyFramesOffset);
+
+                    NextAnimationSampleHeaderOffset += sizeof(model_asset_animation_sample_header) +
+                        AnimationSampleHeader->KeyFrameCount * sizeof(key_frame);
+                }
+
+                // Sampler expects pose samples in joint order
+                for (u32 PoseSampleIndex = 1; PoseSampleIndex < Animation->PoseSampleCount; ++PoseSampleIndex)
+                {
+                    animation_sample PoseSample = Animation->PoseSamples[PoseSampleIndex];
+
+                    u32 InsertIndex = PoseSampleIndex;
+                    while (InsertIndex > 0 && Animation->PoseSamples[InsertIndex - 1].JointIndex > PoseSample.JointIndex)
+                    {
+                        Animation->PoseSamples[InsertIndex] = Animation->PoseSamples[InsertIndex - 1];
+                        --InsertIndex;
+                    }
+
+                    Animation->PoseSamples[InsertIndex] = PoseSample;
+                }
+
+                NextAnimationHeaderOffset += sizeof(model_asset_animation_header) + NextAnimationSampleHeaderOffset;
+
+                break;
+            }
+            case AnimationClipFormat_Compressed:
+            {
+                Animation->TimelineCount = AnimationHeader->TimelineCount;
+                Animation->Timelines = PushArray(Arena, Animation->TimelineCount, animation_timeline);
+
+                u64 NextTimelineHeaderOffset = 0;
+                for (u32 TimelineIndex = 0; TimelineIndex < AnimationHeader->TimelineCount; ++TimelineIndex)
+                {
+                    model_asset_animation_timeline_header *TimelineHeader = (model_asset_animation_timeline_header *)
+                        ((u8 *)Buffer + AnimationHeader->TimelinesOffset + NextTimelineHeaderOffset);
+
+                    animation_timeline *Timeline = Animation->Timelines + TimelineIndex;
+                    Timeline->KeyFrameCount = TimelineHeader->KeyFrameCount;
+                    Timeline->Times = (f32 *)((u8 *)Buffer + TimelineHeader->TimesOffset);
+
+                    NextTimelineHeaderOffset += sizeof(model_asset_animation_timeline_header) + TimelineHeader->KeyFrameCount * sizeof(f32);
+                }
+
+                Animation->CompressedPoseSamples = PushArray(Arena, Animation->PoseSampleCount, compressed_animation_sample);
+
+                u64 NextAnimationSampleHeaderOffset = 0;
+                for (u32 AnimationPoseIndex = 0; AnimationPoseIndex < AnimationHeader->PoseSampleCount; ++AnimationPoseIndex)
+                {
+                    model_asset_compressed_animation_sample_header *AnimationSampleHeader = (model_asset_compressed_animation_sample_header *)
+                        ((u8 *)Buffer + AnimationHeader->PoseSamplesOffset + NextAnimationSampleHeaderOffset);
+
+                    compressed_animation_sample *AnimationSample = Animation->CompressedPoseSamples + AnimationPoseIndex;
+
+                    AnimationSample->JointIndex = AnimationSampleHeader->JointIndex;
+                    AnimationSample->KeyFrameCount = AnimationSampleHeader->KeyFrameCount;
+                    AnimationSample->TimelineIndex = AnimationSampleHeader->TimelineIndex;
+                    AnimationSample->RotationStride = AnimationSampleHeader->RotationStride;
+                    AnimationSample->TranslationStride = AnimationSampleHeader->TranslationStride;
+                    AnimationSample->ScaleStride = AnimationSampleHeader->ScaleStride;
+                    AnimationSample->TranslationMin = AnimationSampleHeader->TranslationMin;
+                    AnimationSample->TranslationExtent = AnimationSampleHeader->TranslationExtent;
+                    AnimationSample->ScaleMin = AnimationSampleHeader->ScaleMin;
+                    AnimationSample->ScaleExtent = AnimationSampleHeader->ScaleExtent;
+                    AnimationSample->Rotations = (compressed_quat *)((u8 *)Buffer + AnimationSampleHeader->RotationsOffset);
+                    AnimationSample->Translations = (quantized_vec3 *)((u8 *)Buffer + AnimationSampleHeader->TranslationsOffset);
+                    AnimationSample->Scales = (quantized_vec3 *)((u8 *)Buffer + AnimationSampleHeader->ScalesOffset);
+
+                    u32 RotationCount = AnimationSample->RotationStride ? AnimationSample->KeyFrameCount : 1;
+                    u32 TranslationCount = AnimationSample->TranslationStride ? AnimationSample->KeyFrameCount : 1;
+                    u32 ScaleCount = AnimationSample->ScaleStride ? AnimationSample->KeyFrameCount : 1;
+
+                    NextAnimationSampleHeaderOffset += sizeof(model_asset_compressed_animation_sample_header) +
+                        RotationCount * sizeof(compressed_quat) + (TranslationCount + ScaleCount) * sizeof(quantized_vec3);
+                }
+
+                NextAnimationHeaderOffset += sizeof(model_asset_animation_header) + NextTimelineHeaderOffset + NextAnimationSampleHeaderOffset;
+
+                break;
+            }
+            case AnimationClipFormat_Uniform:
+            {
+                Animation->SampleRate = AnimationHeader->SampleRate;
+                Animation->FrameCount = AnimationHeader->FrameCount;
+                Animation->FrameJointIndices = (u32 *)((u8 *)Buffer + AnimationHeader->PoseSamplesOffset);
+                Animation->Frames = (f32 *)((u8 *)Buffer + AnimationHeader->FramesOffset);
+
+                NextAnimationHeaderOffset += sizeof(model_asset_animation_header) + Animation->PoseSampleCount * sizeof(u32) +
+                    Animation->FrameCount * AnimationFrameChannel_Count * Animation->PoseSampleCount * sizeof(f32);
+
+                break;
+            }
+            default:
+            {
+                Assert(!"Invalid animation clip format");
+            }
+        }
+
+        Animation->RootMotion.KeyFrameCount = AnimationHeader->RootMotionKeyFrameCount;
+        Animation->RootMotion.KeyFrames = (root_motion_key *)((u8 *)Buffer + AnimationHeader->RootMotionOffset);
+
+        NextAnimationHeaderOffset += AnimationHeader->RootMotionKeyFrameCount * sizeof(root_motion_key);
+    }
+
+    // Motion Database
+    if (Header->Version >= MODEL_ASSET_MOTION_DATABASE_VERSION && Header->MotionDatabaseHeaderOffset)
+    {
+        model_asset_motion_database_header *MotionDatabaseHeader = (model_asset_motion_database_header *)
+            ((u8 *)Buffer + Header->MotionDatabaseHeaderOffset);
+
+        motion_database *MotionDatabase = &Result->MotionDatabase;
+        MotionDatabase->SampleRate = MotionDatabaseHeader->SampleRate;
+        MotionDatabase->MaxSpeed = MotionDatabaseHeader->MaxSpeed;
+
+        for (u32 PointIndex = 0; PointIndex < MOTION_TRAJECTORY_POINT_COUNT; ++PointIndex)
+        {
+            MotionDatabase->TrajectoryTimes[PointIndex] = MotionDatabaseHeader->TrajectoryTimes[PointIndex];
+        }
+
+        for (u32 FeatureIndex = 0; FeatureIndex < MOTION_FEATURE_STRIDE; ++FeatureIndex)
+        {
+            MotionDatabase->Offsets[FeatureIndex] = MotionDatabaseHeader->Offsets[FeatureIndex];
+            MotionDatabase->Scales[FeatureIndex] = MotionDatabaseHeader->Scales[FeatureIndex];
+        }
+
+        MotionDatabase->FrameCount = MotionDatabaseHeader->FrameCount;
+        MotionDatabase->Frames = (motion_database_frame *)((u8 *)Buffer + MotionDatabaseHeader->FramesOffset);
+        MotionDatabase->Features = (f32 *)((u8 *)Buffer + MotionDatabaseHeader->FeaturesOffset);
+
+        MotionDatabase->ClipCount = MotionDatabaseHeader->ClipCount;
+        MotionDatabase->Clips = (motion_database_clip *)((u8 *)Buffer + MotionDatabaseHeader->ClipsOffset);
+        MotionDatabase->ClipFrameIndices = (u32 *)((u8 *)Buffer + MotionDatabaseHeader->ClipFrameIndicesOffset);
+
+        MotionDatabase->NodeCount = MotionDatabaseHeader->NodeCount;
+        MotionDatabase->Nodes = (motion_kd_node *)((u8 *)Buffer + MotionDatabaseHeader->NodesOffset);
+
+        MotionDatabase->Animations = Result->Animations;
+    }
+
+    // Animation Texture
+    if (Header->Version >= MODEL_ASSET_ANIMATION_TEXTURE_VERSION && Header->AnimationTextureHeaderOffset)
+    {
+        model_asset_animation_texture_header *AnimationTextureHeader = (model_asset_animation_texture_header *)
+            ((u8 *)Buffer + Header->AnimationTextureHeaderOffset);
+
+        animation_texture *AnimationTexture = &Result->AnimationTexture;
+        AnimationTexture->Width = AnimationTextureHeader->Width;
+        AnimationTexture->Height = AnimationTextureHeader->Height;
+        AnimationTexture->Texels = (vec4 *)((u8 *)Buffer + AnimationTextureHeader->TexelsOffset);
+
+        AnimationTexture->ClipCount = AnimationTextureHeader->ClipCount;
+        AnimationTexture->Clips = (animation_texture_clip *)((u8 *)Buffer + AnimationTextureHeader->ClipsOffset);
+    }
+
+    return Result;
+}
+
+// Returns 0 if the buffer is not a supported model asset
+internal model_asset *
+ReadModelAsset(void *Buffer, memory_arena *Arena)
+{
+    model_asset *Result = 0;
+
+    if (IsModelAssetSupported(Buffer))
+    {
+        Result = ReadModelAssetContents(Buffer, Arena);
+    }
+
+    return Result;
+}
+
+// Files are mapped if the platform supports it, with a fallback to a copy in the arena if mapping fails.
+// Returns 0 if the file can't be read or is not a supported model asset
+internal model_asset *
+LoadModelAsset(platform_api *Platform, char *FileName, memory_arena *Arena)
+{
+    model_asset *Result = 0;
+
+    mapped_file File = {};
+
+    if (Platform->MapFile)
+    {
+        File = Platform->MapFile(FileName);
+    }
+
+    if (File.Contents)
+    {
+        if (File.Size >= sizeof(model_asset_header))
         {
-            model_asset_animation_sample_header *AnimationSampleHeader = (model_asset_animation_sample_header *)
-                ((u8 *)Buffer + AnimationHeader->PoseSamplesOffset + NextAnimationSampleHeaderOffset);
+            Result = ReadModelAsset(File.Contents, Arena);
+        }
 
-            animation_sample *AnimationSample = Animation->PoseSamples + AnimationPoseIndex;
+        if (Result)
+        {
+            Result->File = PushType(Arena, mapped_file);
+            *Result->File = File;
+        }
+        else
+        {
+            Platform->UnmapFile(&File);
+        }
+    }
+    else
+    {
+        read_file_result AssetFile = Platform->ReadFile(FileName, Arena, false);
 
-            AnimationSample->JointIndex = AnimationSampleHeader->JointIndex;
-            AnimationSample->KeyFrameCount = AnimationSampleHeader->KeyFrameCount;
-            AnimationSample->KeyFrames = (key_frame *)((u8 *)Buffer + AnimationSampleHeader->KeyFramesOffset);
+        if (AssetFile.Contents && AssetFile.Size >= sizeof(model_asset_header))
+        {
+            Result = ReadModelAsset(AssetFile.Contents, Arena);
+        }
+    }
+
+    return Result;
+}
 
-            NextAnimationSampleHeaderOffset += sizeof(model_asset_animation_sample_header) +
-                AnimationSampleHeader->KeyFrameCount * sizeof(key_frame);
+// Tables and entries have to lie inside the file, and the name index has to be a power of two with at least one empty slot, 
+// so that lookups of missing names terminate
+internal b32
+IsAssetPackValid(asset_pack_header *Header, umm Size)
+{
+    b32 Result = 
+        Header->EntriesOffset <= Size &&
+        (u64)Header->EntryCount * sizeof(asset_pack_entry) <= Size - Header->EntriesOffset &&
+        Header->NameIndexOffset <= Size &&
+        (u64)Header->NameIndexSize * sizeof(u32) <= Size - Header->NameIndexOffset &&
+        Header->NameIndexSize > Header->EntryCount &&
+        (Header->NameIndexSize & (Header->NameIndexSize - 1)) == 0;
+
+    if (Result)
+    {
+        u8 *Contents = (u8 *)Header;
+        asset_pack_entry *Entries = (asset_pack_entry *)(Contents + Header->EntriesOffset);
+        u32 *NameIndex = (u32 *)(Contents + Header->NameIndexOffset);
+
+        for (u32 EntryIndex = 0; Result && EntryIndex < Header->EntryCount; ++EntryIndex)
+        {
+            asset_pack_entry *Entry = Entries + EntryIndex;
+
+            Result = Entry->Offset <= Size && Entry->Size <= Size - Entry->Offset;
         }
 
-        NextAnimationHeaderOffset += sizeof(model_asset_animation_header) + NextAnimationSampleHeaderOffset;
+        for (u32 Slot = 0; Result && Slot < Header->NameIndexSize; ++Slot)
+        {
+            Result = NameIndex[Slot] < Header->EntryCount || NameIndex[Slot] == U32_MAX;
+        }
+    }
+
+    return Result;
+}
+
+// Pack is left empty (every lookup fails) if the file can't be read or is not a supported pack
+internal b32
+OpenAssetPack(platform_api *Platform, char *FileName, asset_pack *Pack, memory_arena *Arena)
+{
+    *Pack = {};
+
+    umm Size = 0;
+
+    if (Platform->MapFile)
+    {
+        mapped_file File = Platform->MapFile(FileName);
+
+        if (File.Contents)
+        {
+            Pack->File = PushType(Arena, mapped_file);
+            *Pack->File = File;
+            Pack->Contents = File.Contents;
+            Size = File.Size;
+        }
     }
 
+    if (!Pack->Contents)
+    {
+        read_file_result PackFile = Platform->ReadFile(FileName, Arena, false);
+        Pack->Contents = PackFile.Contents;
+        Size = PackFile.Size;
+    }
+
+    asset_pack_header *Header = (asset_pack_header *)Pack->Contents;
+
+    b32 Result = 
+        Pack->Contents && Size >= sizeof(asset_pack_header) &&
+        Header->MagicValue == ASSET_PACK_MAGIC_VALUE &&
+        Header->Version == ASSET_PACK_VERSION &&
+        IsAssetPackValid(Header, Size);
+
+    if (Result)
+    {
+        Pack->EntryCount = Header->EntryCount;
+        Pack->Entries = (asset_pack_entry *)((u8 *)Pack->Contents + Header->EntriesOffset);
+        Pack->NameIndexSize = Header->NameIndexSize;
+        Pack->NameIndex = (u32 *)((u8 *)Pack->Contents + Header->NameIndexOffset);
+    }
+
+    return Result;
+}
+
+internal asset_pack_entry *
+FindAssetPackEntry(asset_pack *Pack, const char *Name)
+{
+    asset_pack_entry *Result = 0;
+
+    u64 NameHash = Hash((char *)Name);
+    u32 SlotMask = Pack->NameIndexSize - 1;
+
+    for (u32 Slot = NameHash & SlotMask; Pack->NameIndexSize > 0 && Pack->NameIndex[Slot] != U32_MAX; Slot = (Slot + 1) & SlotMask)
+    {
+        asset_pack_entry *Entry = Pack->Entries + Pack->NameIndex[Slot];
+
+        if (Entry->NameHash == NameHash && StringEquals(Entry->Name, Name))
+        {
+            Result = Entry;
+            break;
+        }
+    }
+
+    return Result;
+}
+
+// Reads one byte per page, so that a mapped entry is loaded from disk by the calling thread
+internal u32
+TouchAssetPackEntry(asset_pack *Pack, asset_pack_entry *Entry)
+{
+    u32 Result = 0;
+
+    u8 volatile *Contents = (u8 *)Pack->Contents + Entry->Offset;
+
+    for (u64 Offset = 0; Offset < Entry->Size; Offset += ASSET_PACK_ALIGNMENT)
+    {
+        Result += Contents[Offset];
+    }
+
+    return Result;
+}
+
+internal model_asset *
+LoadModelAsset(asset_pack *Pack, const char *Name, memory_arena *Arena)
+{
+    model_asset *Result = 0;
+
+    asset_pack_entry *Entry = FindAssetPackEntry(Pack, Name);
+
+    if (Entry)
+    {
+        Result = ReadModelAsset((u8 *)Pack->Contents + Entry->Offset, Arena);
+    }
+
+    return Result;
+}
+
+// Loose asset files are checked in and written by the builder next to the pack, 
+// they are used when the pack is missing or doesn't have the asset
+internal model_asset *
+LoadLooseModelAsset(platform_api *Platform, const char *Name, memory_arena *Arena)
+{
+    char FileName[256];
+    FormatString(FileName, ArrayCount(FileName), "assets\\%s.asset", Name);
+
+    model_asset *Result = LoadModelAsset(Platform, FileName, Arena);
+
     return Result;
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+struct mapped_file;
+
 enum material_property_type
 {
     MaterialProperty_Float_Shininess,
@@ -59,14 +61,40 @@ struct mesh
     u32 *Indices;
 };
 
+#define ANIMATION_TEXTURE_TEXELS_PER_JOINT 3
+
+struct animation_texture_clip
+{
+    // Index into the model clips
+    u32 AnimationIndex;
+    u32 FirstRow;
+    u32 FrameCount;
+};
+
+// Skinning matrices of the baked clips for instanced skinning: one row per frame, each joint takes three texels
+// (the first three matrix rows). Row 0 is the clip table, texel i is (FirstRow, FrameCount, Duration, IsLooping) of clip i.
+// Looping clips are sampled at FrameIndex * Duration / FrameCount, others at FrameIndex * Duration / (FrameCount - 1)
+struct animation_texture
+{
+    u32 Width;
+    u32 Height;
+    vec4 *Texels;
+
+    u32 ClipCount;
+    animation_texture_clip *Clips;
+};
+
 // todo: break this?
 struct model
 {
     char Name[64];
+    // Streamed models are only named until the main thread uploads them
+    b32 IsResident;
 
     skeleton *Skeleton;
     skeleton_pose *BindPose;
-    skeleton_pose *Pose;
+    // Longest path to a leaf joint (0 for leaf joints), used to skip joints at lower animation LODs
+    u32 *JointHeights;
 
     aabb Bounds;
 
@@ -79,8 +107,11 @@ struct model
     u32 AnimationCount;
     animation_clip *Animations;
 
-    u32 SkinningMatrixCount;
-    mat4 *SkinningMatrices;
+    // Optional
+    motion_database *MotionDatabase;
+    // Optional, 0 if there is no animation texture
+    animation_texture *AnimationTexture;
+    u32 AnimationTextureId;
 };
 
 struct model_asset
@@ -96,8 +127,22 @@ struct model_asset
 
     u32 AnimationCount;
     animation_clip *Animations;
+
+    // Empty (FrameCount is 0) for most models
+    motion_database MotionDatabase;
+    // Empty (ClipCount is 0) for most models
+    animation_texture AnimationTexture;
+
+    // Set if the asset has its own mapped file (which is read-only), 0 if it points into a copy in the arena or into a pack
+    mapped_file *File;
 };
 
+#define MODEL_ASSET_MAGIC_VALUE 0x451
+#define MODEL_ASSET_VERSION 7
+// Header fields are appended, older assets don't have the fields of later versions
+#define MODEL_ASSET_MOTION_DATABASE_VERSION 6
+#define MODEL_ASSET_ANIMATION_TEXTURE_VERSION 7
+
 #pragma pack(push, 1)
 
 struct asset_header
@@ -114,6 +159,10 @@ struct model_asset_header
     u64 MeshesHeaderOffset;
     u64 MaterialsHeaderOffset;
     u64 AnimationsHeaderOffset;
+    // 0 if there is no motion database
+    u64 MotionDatabaseHeaderOffset;
+    // 0 if there is no animation texture
+    u64 AnimationTextureHeaderOffset;
 };
 
 struct model_asset_skeleton_header
@@ -188,8 +237,21 @@ struct model_asset_animation_header
     f32 Duration;
     b32 IsLooping;
     b32 InPlace;
+    b32 IsAdditive;
     u32 PoseSampleCount;
     u64 PoseSamplesOffset;
+
+    animation_clip_format Format;
+    u32 TimelineCount;
+    u64 TimelinesOffset;
+
+    f32 SampleRate;
+    u32 FrameCount;
+    u64 FramesOffset;
+
+    // Stored after the pose samples
+    u32 RootMotionKeyFrameCount;
+    u64 RootMotionOffset;
 };
 
 struct model_asset_animation_sample_header
@@ -199,4 +261,102 @@ struct model_asset_animation_sample_header
     u64 KeyFramesOffset;
 };
 
+struct model_asset_animation_timeline_header
+{
+    u32 KeyFrameCount;
+    u64 TimesOffset;
+};
+
+struct model_asset_compressed_animation_sample_header
+{
+    u32 JointIndex;
+    u32 KeyFrameCount;
+    u32 TimelineIndex;
+
+    u32 RotationStride;
+    u32 TranslationStride;
+    u32 ScaleStride;
+
+    vec3 TranslationMin;
+    vec3 TranslationExtent;
+    vec3 ScaleMin;
+    vec3 ScaleExtent;
+
+    u64 RotationsOffset;
+    u64 TranslationsOffset;
+    u64 ScalesOffset;
+};
+
+struct model_asset_motion_database_header
+{
+    f32 SampleRate;
+    f32 TrajectoryTimes[MOTION_TRAJECTORY_POINT_COUNT];
+    f32 MaxSpeed;
+
+    f32 Offsets[MOTION_FEATURE_STRIDE];
+    f32 Scales[MOTION_FEATURE_STRIDE];
+
+    u32 FrameCount;
+    u32 ClipCount;
+    u32 NodeCount;
+
+    u64 FramesOffset;
+    u64 FeaturesOffset;
+    u64 ClipsOffset;
+    u64 ClipFrameIndicesOffset;
+    u64 NodesOffset;
+};
+
+struct model_asset_animation_texture_header
+{
+    u32 Width;
+    u32 Height;
+    u32 ClipCount;
+
+    u64 TexelsOffset;
+    u64 ClipsOffset;
+};
+
+#define ASSET_PACK_MAGIC_VALUE 0x4B434150
+#define ASSET_PACK_VERSION 1
+// Assets start on page boundaries, so they can be mapped or read separately later
+#define ASSET_PACK_ALIGNMENT 4096
+#define MAX_ASSET_PACK_NAME_LENGTH 64
+
+// Pack file: header, table of contents (entries sorted by name), name index, then the asset files
+struct asset_pack_header
+{
+    i32 MagicValue;
+    i32 Version;
+
+    u32 EntryCount;
+    // Power of two
+    u32 NameIndexSize;
+
+    u64 EntriesOffset;
+    u64 NameIndexOffset;
+};
+
+struct asset_pack_entry
+{
+    char Name[MAX_ASSET_PACK_NAME_LENGTH];
+    u64 NameHash;
+
+    u64 Offset;
+    u64 Size;
+};
+
 #pragma pack(pop)
+
+struct asset_pack
+{
+    mapped_file *File;
+    void *Contents;
+
+    u32 EntryCount;
+    asset_pack_entry *Entries;
+
+    // Open addressing table of entry indices (U32_MAX for empty slots), probed linearly from NameHash
+    u32 NameIndexSize;
+    u32 *NameIndex;
+};
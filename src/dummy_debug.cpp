@@ -47,8 +47,11 @@ Win32InitImGui(win32_platform_state *PlatformState)
 }
 
 internal void
-RenderAnimationGraphInfo(animation_graph *Graph, u32 Depth = 0)
+RenderAnimationGraphInfo(animation_graph_instance *Instance, u32 GraphIndex = 0, u32 Depth = 0)
 {
+    animation_graph_definition *Definition = Instance->Definition;
+    animation_graph_layout *Graph = Definition->Graphs + GraphIndex;
+
     char Prefix[8];
 
     for (u32 DepthLevel = 0; DepthLevel < Depth; ++DepthLevel)
@@ -58,35 +61,39 @@ RenderAnimationGraphInfo(animation_graph *Graph, u32 Depth = 0)
 
     Prefix[Depth] = 0;
 
-    ImGui::Text("%sActive Node: %s", Prefix, Graph->Active->Name);
+    ImGui::Text("%sActive Node: %d", Prefix, Instance->Graphs[GraphIndex].ActiveNodeIndex);
 
     ImGui::NewLine();
 
-    for (u32 NodeIndex = 0; NodeIndex < Graph->NodeCount; ++NodeIndex)
+    for (u32 NodeIndex = Graph->FirstNodeIndex; NodeIndex < Graph->FirstNodeIndex + Graph->NodeCount; ++NodeIndex)
     {
-        animation_node *Node = Graph->Nodes + NodeIndex;
+        animation_graph_node *Node = Definition->Nodes + NodeIndex;
 
+        ImGui::Text("%sNode: %d\n", Prefix, NodeIndex);
         ImGui::Text("%sNode Type: %d\n", Prefix, Node->Type);
-        ImGui::Text("%sNode Weight: %.3f\n", Prefix, Node->Weight);
+        ImGui::Text("%sNode Weight: %.3f\n", Prefix, Instance->Nodes[NodeIndex].Weight);
 
         switch (Node->Type)
         {
             case AnimationNodeType_SingleMotion:
             {
-                ImGui::Text("%s\tName: %s", Prefix, Node->Animation.Clip->Name);
-                ImGui::Text("%s\tTime: %.3f", Prefix, Node->Animation.Time);
+                animation_state *Animation = Instance->Animations + Node->Index;
+
+                ImGui::Text("%s\tName: %s", Prefix, Animation->Clip->Name);
+                ImGui::Text("%s\tTime: %.3f", Prefix, Animation->Time);
 
                 break;
             }
             case AnimationNodeType_BlendSpace:
             {
-                for (u32 Index = 0; Index < Node->BlendSpace->ValueCount; ++Index)
+                for (u32 Index = 0; Index < Node->Count; ++Index)
                 {
-                    blend_space_1d_value *Value = Node->BlendSpace->Values + Index;
+                    animation_graph_blend_value *Value = Definition->BlendValues + Node->Index + Index;
+                    animation_state *Animation = Instance->Animations + Value->AnimationIndex;
 
-                    ImGui::Text("%s\tName: %s", Prefix, Value->AnimationState.Clip->Name);
-                    ImGui::Text("%s\tTime: %.3f", Prefix, Value->AnimationState.Time);
-                    ImGui::Text("%s\tWeight: %.3f", Prefix, Value->Weight);
+                    ImGui::Text("%s\tName: %s", Prefix, Animation->Clip->Name);
+                    ImGui::Text("%s\tTime: %.3f", Prefix, Animation->Time);
+                    ImGui::Text("%s\tWeight: %.3f", Prefix, Instance->BlendValueWeights[Node->Index + Index]);
 
                     ImGui::NewLine();
                 }
@@ -95,7 +102,18 @@ RenderAnimationGraphInfo(animation_graph *Graph, u32 Depth = 0)
             }
             case AnimationNodeType_Graph:
             {
-                RenderAnimationGraphInfo(Node->Graph, Depth + 1);
+                RenderAnimationGraphInfo(Instance, Node->Index, Depth + 1);
+
+                break;
+            }
+            case AnimationNodeType_MotionMatching:
+            {
+                motion_matching_state *State = Instance->MotionMatchers + Node->Index;
+                animation_state *Animation = State->Animations + State->CurrentIndex;
+
+                ImGui::Text("%s\tName: %s", Prefix, Animation->Clip->Name);
+                ImGui::Text("%s\tTime: %.3f", Prefix, Animation->Time);
+                ImGui::Text("%s\tBlend: %.3f", Prefix, GetMotionMatchingBlendWeight(State));
 
                 break;
             }
@@ -137,6 +155,19 @@ RenderEntityInfo(game_entity *Entity, model *Model)
         }
     }
 
+    if (Entity->Animation)
+    {
+        if (ImGui::CollapsingHeader("Animation LOD", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            animation_lod *Lod = &Entity->AnimationLod;
+
+            ImGui::Text("Level: %d", Lod->Level);
+            ImGui::Text("Screen Size: %.3f", Lod->ScreenSize);
+            ImGui::Text("Distance: %.1f", Lod->Distance);
+            ImGui::Text("\n");
+        }
+    }
+
     if (Entity->Body)
     {
         if (ImGui::CollapsingHeader("Ridig Body", ImGuiTreeNodeFlags_DefaultOpen))
@@ -219,11 +250,73 @@ RenderDebugInfo(win32_platform_state *PlatformState, game_memory *GameMemory, ga
 
     ImGui::ColorEdit3("Directional Light Color", (f32 *)&GameState->DirectionalColor);
 
+    if (ImGui::CollapsingHeader("Pose Cache"))
+    {
+        pose_cache *PoseCache = &GameState->PoseCache;
+
+        ImGui::Checkbox("Enabled", (bool *)&PoseCache->IsEnabled);
+        ImGui::SliderFloat("Time Step", &PoseCache->TimeStep, 0.f, 1.f / 10.f, "%.4f");
+
+        f32 HitRate = PoseCache->LastLookupCount > 0 ? (f32)PoseCache->LastHitCount / (f32)PoseCache->LastLookupCount : 0.f;
+        ImGui::Text("Hits: %d / %d (%.1f%%)", PoseCache->LastHitCount, PoseCache->LastLookupCount, HitRate * 100.f);
+    }
+
+    if (ImGui::CollapsingHeader("Crowd"))
+    {
+        if (GameState->IsCrowdRequested)
+        {
+            ImGui::Text("Size: %d x %d", GameState->CrowdSize, GameState->CrowdSize);
+        }
+        else
+        {
+            ImGui::SliderInt("Size", (i32 *)&GameState->CrowdSize, 1, 32);
+
+            if (ImGui::Button("Spawn"))
+            {
+                GameState->IsCrowdRequested = true;
+            }
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Animation LOD"))
+    {
+        u32 LevelCounts[AnimationLodLevel_Count] = {};
+
+        for (u32 EntityIndex = 0; EntityIndex < GameState->EntityCount; ++EntityIndex)
+        {
+            game_entity *Entity = GameState->Entities + EntityIndex;
+
+            if (Entity->Animation)
+            {
+                ++LevelCounts[Entity->AnimationLod.Level];
+
+                ImGui::Text("Entity %d (%s): LOD %d", EntityIndex, Entity->Model->Name, Entity->AnimationLod.Level);
+            }
+        }
+
+        ImGui::Text("Full: %d, Half: %d, Quarter: %d, Offscreen: %d",
+            LevelCounts[AnimationLodLevel_Full], LevelCounts[AnimationLodLevel_Half],
+            LevelCounts[AnimationLodLevel_Quarter], LevelCounts[AnimationLodLevel_Offscreen]);
+    }
+
     ImGui::End();
 
     ImGui::SetNextWindowPos(ImVec2((f32)PlatformState->WindowWidth - 480.f, 10.f));
 
     ImGui::Begin("Animation Graph");
+    {
+        animation_graph_instance *Animation = GameState->Player->Animation;
+
+        for (u32 LayerIndex = 0; LayerIndex < Animation->Definition->LayerCount; ++LayerIndex)
+        {
+            ImGui::PushID(LayerIndex);
+            ImGui::Text("Layer %d (mask %d)", LayerIndex, Animation->Definition->Layers[LayerIndex].JointMaskIndex);
+            ImGui::SliderFloat("Layer Weight", Animation->LayerWeights + LayerIndex, 0.f, 1.f);
+            ImGui::PopID();
+        }
+
+        ImGui::NewLine();
+    }
     RenderAnimationGraphInfo(GameState->Player->Animation);
     ImGui::End();
 
@@ -2,6 +2,7 @@
 
 #include <stdint.h>
 #include <float.h>
+#include <intrin.h>
 
 #define internal static
 #define global static
@@ -41,5 +42,26 @@
 
 #define wchar wchar_t
 
-#define U32_MAX UINT32_MAX;
-#define F32_MAX FLT_MAX
\ No newline at end of file
+#define U32_MAX UINT32_MAX
+#define F32_MAX FLT_MAX
+
+inline u32
+AtomicCompareExchangeU32(u32 volatile *Value, u32 New, u32 Expected)
+{
+    u32 Result = _InterlockedCompareExchange((long volatile *)Value, New, Expected);
+    return Result;
+}
+
+inline u32
+AtomicExchangeU32(u32 volatile *Value, u32 New)
+{
+    u32 Result = _InterlockedExchange((long volatile *)Value, New);
+    return Result;
+}
+
+inline u32
+AtomicIncrementU32(u32 volatile *Value)
+{
+    u32 Result = _InterlockedIncrement((long volatile *)Value);
+    return Result;
+}
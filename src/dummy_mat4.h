@@ -115,6 +115,28 @@ struct mat4
     }
 };
 
+// SSE version of A * B, each result row is a combination of B rows. Result may alias A or B
+inline void
+MultiplyMat4(mat4 *Result, mat4 *A, mat4 *B)
+{
+    __m128 BRow0 = _mm_loadu_ps(B->Elements[0]);
+    __m128 BRow1 = _mm_loadu_ps(B->Elements[1]);
+    __m128 BRow2 = _mm_loadu_ps(B->Elements[2]);
+    __m128 BRow3 = _mm_loadu_ps(B->Elements[3]);
+
+    for (u32 RowIndex = 0; RowIndex < 4; ++RowIndex)
+    {
+        __m128 ARow = _mm_loadu_ps(A->Elements[RowIndex]);
+
+        __m128 Row = _mm_mul_ps(_mm_shuffle_ps(ARow, ARow, _MM_SHUFFLE(0, 0, 0, 0)), BRow0);
+        Row = _mm_add_ps(Row, _mm_mul_ps(_mm_shuffle_ps(ARow, ARow, _MM_SHUFFLE(1, 1, 1, 1)), BRow1));
+        Row = _mm_add_ps(Row, _mm_mul_ps(_mm_shuffle_ps(ARow, ARow, _MM_SHUFFLE(2, 2, 2, 2)), BRow2));
+        Row = _mm_add_ps(Row, _mm_mul_ps(_mm_shuffle_ps(ARow, ARow, _MM_SHUFFLE(3, 3, 3, 3)), BRow3));
+
+        _mm_storeu_ps(Result->Elements[RowIndex], Row);
+    }
+}
+
 inline mat4
 Inverse(mat4 M)
 {
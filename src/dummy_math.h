@@ -4,6 +4,7 @@
 
 #include <cmath>
 #include <cstdarg>
+#include <xmmintrin.h>
 
 struct quat;
 inline f32 Square(f32 Value);
@@ -15,6 +16,7 @@ inline f32 Max(f32 a, f32 b);
 #define EPSILON 0.0001f
 #define PI 3.14159265359f
 #define HALF_PI (PI / 2.f)
+#define SQRT_HALF 0.70710678118f
 
 #define RADIANS(Angle) ((Angle) * PI) / 180.f
 #define DEGREES(Angle) ((Angle) * 180.f) / PI
@@ -447,6 +449,17 @@ AxisAngle2Quat(vec4 AxisAngle)
     return Result;
 }
 
+inline vec3
+Rotate(vec3 Vector, quat Rotation)
+{
+    vec3 Axis = vec3(Rotation.x, Rotation.y, Rotation.z);
+    vec3 t = 2.f * Cross(Axis, Vector);
+
+    vec3 Result = Vector + Rotation.w * t + Cross(Axis, t);
+
+    return Result;
+}
+
 inline f32
 Lerp(f32 A, f32 t, f32 B)
 {
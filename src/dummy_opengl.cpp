@@ -460,6 +460,14 @@ OpenGLAddMeshBufferInstanced(
     glVertexAttribPointer(10, 4, GL_FLOAT, GL_FALSE, sizeof(render_instance), (void *)(BufferSize + StructOffset(render_instance, Model) + 3 * sizeof(vec4)));
     glVertexAttribDivisor(10, 1);
 
+    glEnableVertexAttribArray(12);
+    glVertexAttribIPointer(12, 1, GL_UNSIGNED_INT, sizeof(render_instance), (void *)(BufferSize + StructOffset(render_instance, AnimationClipIndex)));
+    glVertexAttribDivisor(12, 1);
+
+    glEnableVertexAttribArray(13);
+    glVertexAttribPointer(13, 1, GL_FLOAT, GL_FALSE, sizeof(render_instance), (void *)(BufferSize + StructOffset(render_instance, AnimationTime)));
+    glVertexAttribDivisor(13, 1);
+
 #if 0
     glEnableVertexAttribArray(11);
     glVertexAttribIPointer(11, 1, GL_UNSIGNED_INT, sizeof(render_instance), (void *)(VertexCount * sizeof(skinned_vertex) + StructOffset(render_instance, Flags)));
@@ -522,6 +530,30 @@ OpenGLAddTexture(opengl_state *State, u32 Id, bitmap *Bitmap)
     Texture->Handle = TextureHandle;
 }
 
+internal void
+OpenGLAddAnimationTexture(opengl_state *State, u32 Id, animation_texture *AnimationTexture)
+{
+    Assert(State->CurrentTextureCount < OPENGL_MAX_TEXTURE_COUNT);
+
+    GLuint TextureHandle;
+
+    glGenTextures(1, &TextureHandle);
+    glBindTexture(GL_TEXTURE_2D, TextureHandle);
+
+    // Read with texelFetch, frames are interpolated in the shader
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, AnimationTexture->Width, AnimationTexture->Height, 0, GL_RGBA, GL_FLOAT, AnimationTexture->Texels);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    opengl_texture *Texture = State->Textures + State->CurrentTextureCount++;
+    Texture->Id = Id;
+    Texture->Handle = TextureHandle;
+}
+
 internal void
 OpenGLLoadShaderUniforms(opengl_shader *Shader)
 {
@@ -531,6 +563,8 @@ OpenGLLoadShaderUniforms(opengl_shader *Shader)
     Shader->ViewUniformLocation = glGetUniformLocation(Program, "u_View");
     Shader->ProjectionUniformLocation = glGetUniformLocation(Program, "u_Projection");
     Shader->SkinningMatricesSamplerUniformLocation = glGetUniformLocation(Program, "u_SkinningMatricesSampler");
+    Shader->AnimationTextureUniformLocation = glGetUniformLocation(Program, "u_AnimationTexture");
+    Shader->HasAnimationTextureUniformLocation = glGetUniformLocation(Program, "u_HasAnimationTexture");
 
     Shader->ColorUniformLocation = glGetUniformLocation(Program, "u_Color");
     Shader->CameraPositionUniformLocation = glGetUniformLocation(Program, "u_CameraPosition");
@@ -960,8 +994,7 @@ OpenGLProcessRenderCommands(opengl_state *State, render_commands *Commands)
 
                 glGenBuffers(1, &State->SkinningTBO);
                 glBindBuffer(GL_TEXTURE_BUFFER, State->SkinningTBO);
-                // todo: size?
-                glBufferData(GL_TEXTURE_BUFFER, Kilobytes(32), 0, GL_STREAM_DRAW);
+                glBufferData(GL_TEXTURE_BUFFER, OPENGL_MAX_SKINNING_MATRIX_COUNT * sizeof(mat4), 0, GL_STREAM_DRAW);
 
                 glGenTextures(1, &State->SkinningTBOTexture);
 
@@ -1025,6 +1058,14 @@ OpenGLProcessRenderCommands(opengl_state *State, render_commands *Commands)
                 
                 break;
             }
+            case RenderCommand_AddAnimationTexture:
+            {
+                render_command_add_animation_texture *Command = (render_command_add_animation_texture *)Entry;
+
+                OpenGLAddAnimationTexture(State, Command->Id, Command->AnimationTexture);
+
+                break;
+            }
             case RenderCommand_SetViewport:
             {
                 render_command_set_viewport *Command = (render_command_set_viewport *)Entry;
@@ -1244,6 +1285,24 @@ OpenGLProcessRenderCommands(opengl_state *State, render_commands *Commands)
 
                 break;
             }
+            case RenderCommand_SetSkinningPalette:
+            {
+                render_command_set_skinning_palette *Command = (render_command_set_skinning_palette *)Entry;
+
+                Assert(Command->SkinningMatrixCount <= OPENGL_MAX_SKINNING_MATRIX_COUNT);
+
+                // An oversized upload fails with GL_INVALID_VALUE and leaves the whole palette stale, 
+                // clamping keeps the first joints updated in release builds
+                u32 SkinningMatrixCount = Command->SkinningMatrixCount < OPENGL_MAX_SKINNING_MATRIX_COUNT
+                    ? Command->SkinningMatrixCount
+                    : OPENGL_MAX_SKINNING_MATRIX_COUNT;
+
+                glBindBuffer(GL_TEXTURE_BUFFER, State->SkinningTBO);
+                glBufferSubData(GL_TEXTURE_BUFFER, 0, SkinningMatrixCount * sizeof(mat4), Command->SkinningMatrices);
+                glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+                break;
+            }
             case RenderCommand_DrawMesh:
             {
                 render_command_draw_mesh *Command = (render_command_draw_mesh *)Entry;
@@ -1326,10 +1385,6 @@ OpenGLProcessRenderCommands(opengl_state *State, render_commands *Commands)
 
                         glUseProgram(Shader->Program);
 
-                        glBindBuffer(GL_TEXTURE_BUFFER, State->SkinningTBO);
-                        glBufferSubData(GL_TEXTURE_BUFFER, 0, Command->SkinningMatrixCount * sizeof(mat4), Command->SkinningMatrices);
-                        glBindBuffer(GL_TEXTURE_BUFFER, 0);
-
                         glActiveTexture(GL_TEXTURE0);
                         glBindTexture(GL_TEXTURE_BUFFER, State->SkinningTBOTexture);
                         glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, State->SkinningTBO);
@@ -1388,6 +1443,17 @@ OpenGLProcessRenderCommands(opengl_state *State, render_commands *Commands)
 
                         OpenGLBlinnPhongShading(State, Shader, Command->Material.MeshMaterial);
 
+                        if (Command->AnimationTextureId)
+                        {
+                            opengl_texture *AnimationTexture = OpenGLGetTexture(State, Command->AnimationTextureId);
+
+                            glActiveTexture(GL_TEXTURE0 + OPENGL_ANIMATION_TEXTURE_UNIT);
+                            glBindTexture(GL_TEXTURE_2D, AnimationTexture->Handle);
+                            glUniform1i(Shader->AnimationTextureUniformLocation, OPENGL_ANIMATION_TEXTURE_UNIT);
+                        }
+
+                        glUniform1i(Shader->HasAnimationTextureUniformLocation, Command->AnimationTextureId ? 1 : 0);
+
                         break;
                     }
                     case MaterialType_Unlit:
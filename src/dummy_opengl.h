@@ -5,6 +5,8 @@
 #define OPENGL_MAX_MESH_BUFFER_COUNT 64
 #define OPENGL_MAX_TEXTURE_COUNT 64
 #define OPENGL_MAX_SHADER_COUNT 64
+// Size of the skinning TBO, larger palettes are clamped
+#define OPENGL_MAX_SKINNING_MATRIX_COUNT 512
 
 #define OPENGL_SIMPLE_SHADER_ID 0x1
 #define OPENGL_PHONG_SHADING_SHADER_ID 0x2
@@ -14,6 +16,8 @@
 #define OPENGL_INSTANCED_PHONG_SHADING_SHADER_ID 0x6
 
 #define OPENGL_MAX_POINT_LIGHT_COUNT 8
+// Past the material maps
+#define OPENGL_ANIMATION_TEXTURE_UNIT 15
 
 struct opengl_mesh_buffer
 {
@@ -53,6 +57,8 @@ struct opengl_shader
     GLint ViewUniformLocation;
     GLint ProjectionUniformLocation;
     GLint SkinningMatricesSamplerUniformLocation;
+    GLint AnimationTextureUniformLocation;
+    GLint HasAnimationTextureUniformLocation;
 
     GLint ColorUniformLocation;
     GLint CameraPositionUniformLocation;
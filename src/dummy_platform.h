@@ -17,21 +17,57 @@ struct read_file_result
     void *Contents;
 };
 
+struct mapped_file
+{
+    umm Size;
+    void *Contents;
+};
+
 #define PLATFORM_SET_MOUSE_MODE(name) void name(void *PlatformHandle, mouse_mode MouseMode)
 typedef PLATFORM_SET_MOUSE_MODE(platform_set_mouse_mode);
 
 #define PLATFORM_READ_FILE(name) read_file_result name(char *FileName, memory_arena *Arena, b32 Text)
 typedef PLATFORM_READ_FILE(platform_read_file);
 
+// Read-only view of the whole file, pages are loaded on first access (from the OS page cache shared with other processes).
+// Contents is 0 if the file can't be mapped
+#define PLATFORM_MAP_FILE(name) mapped_file name(char *FileName)
+typedef PLATFORM_MAP_FILE(platform_map_file);
+
+#define PLATFORM_UNMAP_FILE(name) void name(mapped_file *File)
+typedef PLATFORM_UNMAP_FILE(platform_unmap_file);
+
 #define PLATFORM_DEBUG_PRINT_STRING(name) i32 name(const char *String, ...)
 typedef PLATFORM_DEBUG_PRINT_STRING(platform_debug_print_string);
 
+struct platform_work_queue;
+
+// ThreadIndex is 0 for the thread that calls CompleteAllWork, worker threads get 1..WorkQueueThreadCount - 1
+#define PLATFORM_WORK_QUEUE_CALLBACK(name) void name(platform_work_queue *Queue, u32 ThreadIndex, void *Data)
+typedef PLATFORM_WORK_QUEUE_CALLBACK(platform_work_queue_callback);
+
+#define PLATFORM_ADD_WORK_QUEUE_ENTRY(name) void name(platform_work_queue *Queue, platform_work_queue_callback *Callback, void *Data)
+typedef PLATFORM_ADD_WORK_QUEUE_ENTRY(platform_add_work_queue_entry);
+
+#define PLATFORM_COMPLETE_ALL_WORK(name) void name(platform_work_queue *Queue)
+typedef PLATFORM_COMPLETE_ALL_WORK(platform_complete_all_work);
+
 struct platform_api
 {
     void *PlatformHandle;
     platform_set_mouse_mode *SetMouseMode;
     platform_read_file *ReadFile;
+    platform_map_file *MapFile;
+    platform_unmap_file *UnmapFile;
     platform_debug_print_string *DebugPrintString;
+
+    platform_work_queue *WorkQueue;
+    u32 WorkQueueThreadCount;
+    platform_add_work_queue_entry *AddWorkQueueEntry;
+    platform_complete_all_work *CompleteAllWork;
+
+    // Single thread for long running jobs (asset loading), never waited on with CompleteAllWork during a frame
+    platform_work_queue *BackgroundWorkQueue;
 };
 
 struct game_memory
@@ -109,6 +109,14 @@ Normalize(quat q)
     return Result;
 }
 
+// Inverse of a unit quaternion
+inline quat
+Conjugate(quat q)
+{
+    quat Result = quat(-q.x, -q.y, -q.z, q.w);
+    return Result;
+}
+
 inline mat4
 GetRotationMatrix(quat q)
 {
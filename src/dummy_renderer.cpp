@@ -71,6 +71,15 @@ AddTexture(render_commands *Commands, u32 Id, bitmap *Bitmap)
     Command->Bitmap = Bitmap;
 }
 
+inline void
+AddAnimationTexture(render_commands *Commands, u32 Id, animation_texture *AnimationTexture)
+{
+    render_command_add_animation_texture *Command = 
+        PushRenderCommand(Commands, render_command_add_animation_texture, RenderCommand_AddAnimationTexture, 0);
+    Command->Id = Id;
+    Command->AnimationTexture = AnimationTexture;
+}
+
 inline void
 SetViewport(render_commands *Commands, u32 x, u32 y, u32 Width, u32 Height, u32 RenderTarget = 0)
 {
@@ -173,8 +182,6 @@ DrawSkinnedMesh(
     u32 MeshId,
     transform Transform,
     material Material,
-    u32 SkinningMatrixCount,
-    mat4 *SkinningMatrices,
     u32 RenderTarget = 0
 )
 {
@@ -183,8 +190,6 @@ DrawSkinnedMesh(
     Command->MeshId = MeshId;
     Command->Transform = Transform;
     Command->Material = Material;
-    Command->SkinningMatrixCount = SkinningMatrixCount;
-    Command->SkinningMatrices = SkinningMatrices;
 }
 
 inline void
@@ -194,6 +199,7 @@ DrawMeshInstanced(
     u32 InstanceCount,
     render_instance *Instances,
     material Material,
+    u32 AnimationTextureId = 0,
     u32 RenderTarget = 0
 )
 {
@@ -203,6 +209,7 @@ DrawMeshInstanced(
     Command->InstanceCount = InstanceCount;
     Command->Instances = Instances;
     Command->Material = Material;
+    Command->AnimationTextureId = AnimationTextureId;
 }
 
 inline void
@@ -221,3 +228,17 @@ SetPointLights(render_commands *Commands, u32 PointLightCount, point_light *Poin
     Command->PointLightCount = PointLightCount;
     Command->PointLights = PointLights;
 }
+
+// Reserves the palette inside the command buffer, so it's filled in place and uploaded from there
+inline mat4 *
+PushSkinningPalette(render_commands *Commands, u32 SkinningMatrixCount, u32 RenderTarget = 0)
+{
+    u32 Size = sizeof(render_command_set_skinning_palette) + SkinningMatrixCount * sizeof(mat4);
+
+    render_command_set_skinning_palette *Command =
+        (render_command_set_skinning_palette *)PushRenderCommand_(Commands, Size, RenderCommand_SetSkinningPalette, RenderTarget);
+    Command->SkinningMatrixCount = SkinningMatrixCount;
+    Command->SkinningMatrices = (mat4 *)(Command + 1);
+
+    return Command->SkinningMatrices;
+}
@@ -57,6 +57,10 @@ struct spot_light
 struct render_instance
 {
     mat4 Model;
+
+    // Clip of the mesh animation texture and time in it, unused for meshes drawn without one
+    u32 AnimationClipIndex;
+    f32 AnimationTime;
 };
 
 enum render_command_type
@@ -64,6 +68,7 @@ enum render_command_type
     RenderCommand_InitRenderer,
     RenderCommand_AddMesh,
     RenderCommand_AddTexture,
+    RenderCommand_AddAnimationTexture,
 
     RenderCommand_SetViewport,
     RenderCommand_SetOrthographicProjection,
@@ -72,6 +77,7 @@ enum render_command_type
     RenderCommand_SetTime,
     RenderCommand_SetDirectionalLight,
     RenderCommand_SetPointLights,
+    RenderCommand_SetSkinningPalette,
 
     RenderCommand_Clear,
     
@@ -126,6 +132,14 @@ struct render_command_add_texture
     // todo: filtering, wrapping, mipmapping...
 };
 
+struct render_command_add_animation_texture
+{
+    render_command_header Header;
+
+    u32 Id;
+    animation_texture *AnimationTexture;
+};
+
 struct render_command_set_viewport
 {
     render_command_header Header;
@@ -188,6 +202,14 @@ struct render_command_set_point_lights
     point_light *PointLights;
 };
 
+// Matrices are stored in the command buffer right after the command
+struct render_command_set_skinning_palette
+{
+    render_command_header Header;
+    u32 SkinningMatrixCount;
+    mat4 *SkinningMatrices;
+};
+
 struct render_command_set_time
 {
     render_command_header Header;
@@ -231,6 +253,7 @@ struct render_command_draw_mesh
     material Material;
 };
 
+// Skinned with the last skinning palette
 struct render_command_draw_skinned_mesh
 {
     render_command_header Header;
@@ -239,9 +262,6 @@ struct render_command_draw_skinned_mesh
 
     transform Transform;
     material Material;
-
-    u32 SkinningMatrixCount;
-    mat4 *SkinningMatrices;
 };
 
 struct render_command_draw_mesh_instanced
@@ -254,6 +274,8 @@ struct render_command_draw_mesh_instanced
     render_instance *Instances;
 
     material Material;
+    // Skins the instances with their baked clips, 0 for static meshes
+    u32 AnimationTextureId;
 };
 
 struct render_commands
@@ -0,0 +1,204 @@
+inline b32
+IsAVXSupported()
+{
+    persist b32 IsChecked = false;
+    persist b32 Result = false;
+
+    if (!IsChecked)
+    {
+        i32 Info[4];
+
+        __cpuidex(Info, 1, 0);
+        b32 SSE41 = Info[2] & (1 << 19);
+        b32 OSXSAVE = Info[2] & (1 << 27);
+        b32 AVX = Info[2] & (1 << 28);
+
+        // OS has to save YMM registers too
+        Result = SSE41 && OSXSAVE && AVX && ((_xgetbv(0) & 6) == 6);
+        IsChecked = true;
+    }
+
+    return Result;
+}
+
+inline void
+SkinVertex(skinning_job *Job, u32 VertexIndex)
+{
+    mesh *Mesh = Job->Mesh;
+    vec4 Weights = Mesh->Weights[VertexIndex];
+    i32 *JointIndices = Mesh->JointIndices + VertexIndex * 4;
+
+    // Skinning matrices are affine, the last row is never used
+    vec4 Rows[3] = { vec4(0.f), vec4(0.f), vec4(0.f) };
+
+    for (u32 WeightIndex = 0; WeightIndex < 4; ++WeightIndex)
+    {
+        mat4 *SkinningMatrix = Job->SkinningMatrices + JointIndices[WeightIndex];
+
+        for (u32 RowIndex = 0; RowIndex < 3; ++RowIndex)
+        {
+            Rows[RowIndex] += SkinningMatrix->Rows[RowIndex] * Weights[WeightIndex];
+        }
+    }
+
+    vec4 Position = vec4(Mesh->Positions[VertexIndex], 1.f);
+    Job->Positions[VertexIndex] = vec3(Dot(Rows[0], Position), Dot(Rows[1], Position), Dot(Rows[2], Position));
+
+    if (Job->Normals)
+    {
+        vec4 Normal = vec4(Mesh->Normals[VertexIndex], 0.f);
+        Job->Normals[VertexIndex] = Normalize(vec3(Dot(Rows[0], Normal), Dot(Rows[1], Normal), Dot(Rows[2], Normal)));
+    }
+}
+
+internal void
+SkinVerticesScalar(skinning_job *Job)
+{
+    for (u32 VertexIndex = Job->FirstVertexIndex; VertexIndex < Job->FirstVertexIndex + Job->VertexCount; ++VertexIndex)
+    {
+        SkinVertex(Job, VertexIndex);
+    }
+}
+
+// One vertex per iteration, blending the transposed palette two columns per register: the transform is then
+// (C0 * x + C2 * z) + (C1 * y + C3), i.e. one add of the register halves instead of dot products.
+// Needs AVX and SSE4.1 (normal length). 8-wide SoA with AVX2 palette gathers measured ~3x slower than this
+internal void
+SkinVerticesAVX(skinning_job *Job)
+{
+    mesh *Mesh = Job->Mesh;
+    f32 *Palette = (f32 *)Job->TransposedSkinningMatrices;
+
+    Assert(Palette);
+    Assert(!Job->Normals || Mesh->Normals);
+
+    __m256 ZeroOne = _mm256_setr_ps(0.f, 0.f, 0.f, 0.f, 1.f, 1.f, 1.f, 1.f);
+
+    for (u32 VertexIndex = Job->FirstVertexIndex; VertexIndex < Job->FirstVertexIndex + Job->VertexCount; ++VertexIndex)
+    {
+        f32 *Weights = Mesh->Weights[VertexIndex].Elements;
+        i32 *JointIndices = Mesh->JointIndices + VertexIndex * 4;
+
+        __m256 Columns01 = _mm256_setzero_ps();
+        __m256 Columns23 = _mm256_setzero_ps();
+
+        for (u32 WeightIndex = 0; WeightIndex < 4; ++WeightIndex)
+        {
+            __m256 Weight = _mm256_set1_ps(Weights[WeightIndex]);
+            f32 *SkinningMatrix = Palette + JointIndices[WeightIndex] * 16;
+
+            Columns01 = _mm256_add_ps(Columns01, _mm256_mul_ps(Weight, _mm256_loadu_ps(SkinningMatrix + 0)));
+            Columns23 = _mm256_add_ps(Columns23, _mm256_mul_ps(Weight, _mm256_loadu_ps(SkinningMatrix + 8)));
+        }
+
+        f32 Result[4];
+
+        vec3 *Position = Mesh->Positions + VertexIndex;
+        __m256 PositionXY = _mm256_setr_m128(_mm_set1_ps(Position->x), _mm_set1_ps(Position->y));
+        __m256 PositionZ1 = _mm256_blend_ps(_mm256_set1_ps(Position->z), ZeroOne, 0xF0);
+
+        __m256 Sum = _mm256_add_ps(_mm256_mul_ps(Columns01, PositionXY), _mm256_mul_ps(Columns23, PositionZ1));
+        _mm_storeu_ps(Result, _mm_add_ps(_mm256_castps256_ps128(Sum), _mm256_extractf128_ps(Sum, 1)));
+
+        Job->Positions[VertexIndex] = vec3(Result[0], Result[1], Result[2]);
+
+        if (Job->Normals)
+        {
+            vec3 *Normal = Mesh->Normals + VertexIndex;
+            __m256 NormalXY = _mm256_setr_m128(_mm_set1_ps(Normal->x), _mm_set1_ps(Normal->y));
+            __m256 NormalZ0 = _mm256_blend_ps(_mm256_set1_ps(Normal->z), _mm256_setzero_ps(), 0xF0);
+
+            Sum = _mm256_add_ps(_mm256_mul_ps(Columns01, NormalXY), _mm256_mul_ps(Columns23, NormalZ0));
+            __m128 SkinnedNormal = _mm_add_ps(_mm256_castps256_ps128(Sum), _mm256_extractf128_ps(Sum, 1));
+
+            // w is 0 here
+            __m128 Length = _mm_sqrt_ps(_mm_dp_ps(SkinnedNormal, SkinnedNormal, 0xFF));
+            _mm_storeu_ps(Result, _mm_div_ps(SkinnedNormal, Length));
+
+            Job->Normals[VertexIndex] = vec3(Result[0], Result[1], Result[2]);
+        }
+    }
+}
+
+internal void
+TransposeSkinningMatrices(u32 Count, mat4 *SkinningMatrices, mat4 *TransposedSkinningMatrices)
+{
+    for (u32 Index = 0; Index < Count; ++Index)
+    {
+        TransposedSkinningMatrices[Index] = Transpose(SkinningMatrices[Index]);
+    }
+}
+
+internal void
+SkinVertices(skinning_job *Job)
+{
+    if (Job->TransposedSkinningMatrices && IsAVXSupported())
+    {
+        SkinVerticesAVX(Job);
+    }
+    else
+    {
+        SkinVerticesScalar(Job);
+    }
+}
+
+internal PLATFORM_WORK_QUEUE_CALLBACK(SkinVerticesJob)
+{
+    skinning_job *Job = (skinning_job *)Data;
+    SkinVertices(Job);
+}
+
+// Positions and Normals (optional) have Mesh->VertexCount elements.
+// Waits for the whole work queue, so it can't be called from inside a work queue job
+internal void
+SkinMesh(
+    platform_api *Platform,
+    mesh *Mesh,
+    u32 SkinningMatrixCount,
+    mat4 *SkinningMatrices,
+    vec3 *Positions,
+    vec3 *Normals,
+    memory_arena *Arena
+)
+{
+    Assert(Mesh->Weights && Mesh->JointIndices);
+
+    scoped_memory ScopedMemory(Arena);
+
+    mat4 *TransposedSkinningMatrices = PushArray(ScopedMemory.Arena, SkinningMatrixCount, mat4);
+    TransposeSkinningMatrices(SkinningMatrixCount, SkinningMatrices, TransposedSkinningMatrices);
+
+    u32 ChunkCount = (Mesh->VertexCount + SKINNING_CHUNK_VERTEX_COUNT - 1) / SKINNING_CHUNK_VERTEX_COUNT;
+    skinning_job *Jobs = PushArray(ScopedMemory.Arena, ChunkCount, skinning_job);
+
+    for (u32 ChunkIndex = 0; ChunkIndex < ChunkCount; ++ChunkIndex)
+    {
+        skinning_job *Job = Jobs + ChunkIndex;
+        Job->Mesh = Mesh;
+        Job->SkinningMatrices = SkinningMatrices;
+        Job->TransposedSkinningMatrices = TransposedSkinningMatrices;
+        Job->FirstVertexIndex = ChunkIndex * SKINNING_CHUNK_VERTEX_COUNT;
+        Job->VertexCount = ChunkIndex < ChunkCount - 1
+            ? SKINNING_CHUNK_VERTEX_COUNT
+            : Mesh->VertexCount - Job->FirstVertexIndex;
+        Job->Positions = Positions;
+        Job->Normals = Normals;
+    }
+
+    if (ChunkCount > 1 && Platform->WorkQueue)
+    {
+        for (u32 ChunkIndex = 0; ChunkIndex < ChunkCount; ++ChunkIndex)
+        {
+            Platform->AddWorkQueueEntry(Platform->WorkQueue, SkinVerticesJob, Jobs + ChunkIndex);
+        }
+
+        Platform->CompleteAllWork(Platform->WorkQueue);
+    }
+    else
+    {
+        for (u32 ChunkIndex = 0; ChunkIndex < ChunkCount; ++ChunkIndex)
+        {
+            SkinVertices(Jobs + ChunkIndex);
+        }
+    }
+}
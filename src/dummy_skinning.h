@@ -0,0 +1,20 @@
+#pragma once
+
+// Meshes with more vertices are split into chunks of this size across the work queue
+#define SKINNING_CHUNK_VERTEX_COUNT 4096
+
+// Linear blend skinning of a vertex range on the CPU, outputs are indexed the same way as the mesh streams
+struct skinning_job
+{
+    mesh *Mesh;
+    // Row-major palette for the scalar path and its transpose (one column per row) for the SIMD path
+    mat4 *SkinningMatrices;
+    mat4 *TransposedSkinningMatrices;
+
+    u32 FirstVertexIndex;
+    u32 VertexCount;
+
+    vec3 *Positions;
+    // Optional
+    vec3 *Normals;
+};
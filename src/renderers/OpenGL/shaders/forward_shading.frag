@@ -3,7 +3,7 @@ in VS_OUT {
     vec3 Normal;
     vec2 TextureCoords;
     mat3 TBN;
-    flat unsigned int Highlight;
+    flat uint Highlight;
 } fs_in; 
 
 out vec4 out_Color;
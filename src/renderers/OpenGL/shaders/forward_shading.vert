@@ -9,7 +9,7 @@ out VS_OUT {
     vec3 Normal;
     vec2 TextureCoords;
     mat3 TBN;
-    unsigned int Highlight;
+    uint Highlight;
 } vs_out; 
 
 uniform mat4 u_Projection;
@@ -3,28 +3,76 @@ layout(location = 1) in vec3 in_Normal;
 layout(location = 2) in vec3 in_Tangent;
 layout(location = 3) in vec3 in_Bitangent;
 layout(location = 4) in vec2 in_TextureCoords;
-// -- ?
-layout(location = 5) in ivec4 in_JointIndices;
-layout(location = 6) in vec4 in_Weights;
-// --
+layout(location = 5) in vec4 in_Weights;
+layout(location = 6) in ivec4 in_JointIndices;
 layout(location = 7) in mat4 in_InstanceModel;
-layout(location = 11) in unsigned int in_Highlight;
+layout(location = 11) in uint in_Highlight;
+layout(location = 12) in uint in_AnimationClipIndex;
+layout(location = 13) in float in_AnimationTime;
 
 out VS_OUT {
     vec3 VertexPosition;
     vec3 Normal;
     vec2 TextureCoords;
     mat3 TBN;
-    unsigned int Highlight;
+    uint Highlight;
 } vs_out; 
 
 uniform mat4 u_Projection;
 uniform mat4 u_View;
 
+uniform bool u_HasAnimationTexture;
+uniform sampler2D u_AnimationTexture;
+
+// Skinning matrix rows of the joint, interpolated between two frames (texture rows)
+mat4 GetBakedSkinningMatrix(int JointIndex, int Row0, int Row1, float t)
+{
+    int Column = JointIndex * 3;
+
+    vec4 MatrixRow0 = mix(texelFetch(u_AnimationTexture, ivec2(Column + 0, Row0), 0), texelFetch(u_AnimationTexture, ivec2(Column + 0, Row1), 0), t);
+    vec4 MatrixRow1 = mix(texelFetch(u_AnimationTexture, ivec2(Column + 1, Row0), 0), texelFetch(u_AnimationTexture, ivec2(Column + 1, Row1), 0), t);
+    vec4 MatrixRow2 = mix(texelFetch(u_AnimationTexture, ivec2(Column + 2, Row0), 0), texelFetch(u_AnimationTexture, ivec2(Column + 2, Row1), 0), t);
+
+    return transpose(mat4(MatrixRow0, MatrixRow1, MatrixRow2, vec4(0.f, 0.f, 0.f, 1.f)));
+}
+
+mat4 GetBakedSkinning()
+{
+    // Clip table: (FirstRow, FrameCount, Duration, IsLooping)
+    vec4 Clip = texelFetch(u_AnimationTexture, ivec2(in_AnimationClipIndex, 0), 0);
+
+    int FirstRow = int(Clip.x);
+    int FrameCount = int(Clip.y);
+    float Duration = Clip.z;
+    bool IsLooping = Clip.w > 0.f;
+
+    float Frame = IsLooping
+        ? fract(in_AnimationTime / Duration) * FrameCount
+        : Saturate(in_AnimationTime / Duration) * (FrameCount - 1);
+
+    int Frame0 = min(int(Frame), FrameCount - 1);
+    int Frame1 = IsLooping ? (Frame0 + 1) % FrameCount : min(Frame0 + 1, FrameCount - 1);
+    float t = Frame - Frame0;
+
+    mat4 Result = mat4(0.f);
+
+    for (int Index = 0; Index < 4; ++Index)
+    {
+        Result += GetBakedSkinningMatrix(in_JointIndices[Index], FirstRow + Frame0, FirstRow + Frame1, t) * in_Weights[Index];
+    }
+
+    return Result;
+}
+
 void main()
 {
     mat4 InstanceModel = transpose(in_InstanceModel);
 
+    if (u_HasAnimationTexture)
+    {
+        InstanceModel = InstanceModel * GetBakedSkinning();
+    }
+
     vec3 T = normalize(vec3(InstanceModel * vec4(in_Tangent, 0.f)));
     vec3 B = normalize(vec3(InstanceModel * vec4(in_Bitangent, 0.f)));
     vec3 N = normalize(vec3(InstanceModel * vec4(in_Normal, 0.f)));
@@ -681,118 +681,169 @@ internal PLATFORM_READ_FILE(Win32ReadFile)
     return Result;
 }
 
-//
-#include <intrin.h>
+internal PLATFORM_MAP_FILE(Win32MapFile)
+{
+    mapped_file Result = {};
 
-#define WriteBarrier _WriteBarrier(); _mm_sfence();
-#define ReadBarrier _ReadBarrier();
+    HANDLE FileHandle = CreateFileA(FileName, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0);
+    if (FileHandle != INVALID_HANDLE_VALUE)
+    {
+        LARGE_INTEGER FileSize;
+        if (GetFileSizeEx(FileHandle, &FileSize))
+        {
+            HANDLE MappingHandle = CreateFileMappingA(FileHandle, 0, PAGE_READONLY, 0, 0, 0);
+            if (MappingHandle)
+            {
+                Result.Contents = MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0);
 
-struct win32_thread_proc_parameter
-{
-    u32 ThreadIndex;
-    HANDLE Semaphore;
-};
+                if (Result.Contents)
+                {
+                    Result.Size = (umm)FileSize.QuadPart;
+                }
+                else
+                {
+                    DWORD Error = GetLastError();
+                }
+
+                // View keeps the mapping alive
+                CloseHandle(MappingHandle);
+            }
+            else
+            {
+                DWORD Error = GetLastError();
+            }
+        }
+        else
+        {
+            DWORD Error = GetLastError();
+        }
 
-struct work_queue_entry
+        CloseHandle(FileHandle);
+    }
+    else
+    {
+        DWORD Error = GetLastError();
+    }
+
+    return Result;
+}
+
+internal PLATFORM_UNMAP_FILE(Win32UnmapFile)
 {
-    u32 Data;
-};
+    if (File->Contents)
+    {
+        UnmapViewOfFile(File->Contents);
+    }
 
-#define MAX_ENTRY_COUNT 32
+    *File = {};
+}
 
-global u32 volatile CompletedEntryIndex;
-global u32 volatile NextEntryIndex;
-global u32 volatile CurrentEntryIndex;
-work_queue_entry Entries[MAX_ENTRY_COUNT];
+#include <intrin.h>
 
-internal void
-PushEntry(u32 Data, HANDLE Semaphore)
+#define WriteBarrier _WriteBarrier(); _mm_sfence();
+#define ReadBarrier _ReadBarrier();
+
+internal PLATFORM_ADD_WORK_QUEUE_ENTRY(Win32AddWorkQueueEntry)
 {
-    Assert(CurrentEntryIndex < MAX_ENTRY_COUNT);
+    u32 NewNextEntryToWrite = (Queue->NextEntryToWrite + 1) % ArrayCount(Queue->Entries);
+    Assert(NewNextEntryToWrite != Queue->NextEntryToRead);
 
-    work_queue_entry *Entry = Entries + CurrentEntryIndex;
+    platform_work_queue_entry *Entry = Queue->Entries + Queue->NextEntryToWrite;
+    Entry->Callback = Callback;
     Entry->Data = Data;
 
+    ++Queue->CompletionGoal;
+
     WriteBarrier;
 
-    ++CurrentEntryIndex;
+    Queue->NextEntryToWrite = NewNextEntryToWrite;
 
-    ReleaseSemaphore(Semaphore, 1, 0);
+    ReleaseSemaphore(Queue->Semaphore, 1, 0);
 }
 
-DWORD WINAPI ThreadProc(_In_ LPVOID lpParameter)
+// Returns true if there is nothing to do
+internal b32
+Win32DoNextWorkQueueEntry(platform_work_queue *Queue, u32 ThreadIndex)
 {
-    win32_thread_proc_parameter *Parameter = (win32_thread_proc_parameter *)lpParameter;
+    b32 ShouldSleep = false;
 
-    while (true)
+    u32 OriginalNextEntryToRead = Queue->NextEntryToRead;
+    u32 NewNextEntryToRead = (OriginalNextEntryToRead + 1) % ArrayCount(Queue->Entries);
+
+    if (OriginalNextEntryToRead != Queue->NextEntryToWrite)
     {
-        // todo: InterlockedCompareExchange
-        if (NextEntryIndex < CurrentEntryIndex)
-        {
-            u32 EntryIndex = InterlockedIncrement((LONG volatile *)&NextEntryIndex) - 1;
+        u32 EntryIndex = InterlockedCompareExchange((LONG volatile *)&Queue->NextEntryToRead, NewNextEntryToRead, OriginalNextEntryToRead);
 
+        if (EntryIndex == OriginalNextEntryToRead)
+        {
             ReadBarrier;
 
-            work_queue_entry *Entry = Entries + EntryIndex;
+            platform_work_queue_entry Entry = Queue->Entries[EntryIndex];
+            Entry.Callback(Queue, ThreadIndex, Entry.Data);
 
-            Win32DebugPrintString("Thread %d: Work #%d\n", Parameter->ThreadIndex, Entry->Data);
-
-            InterlockedIncrement((LONG volatile *)&CompletedEntryIndex);
-        }
-        else
-        {
-            WaitForSingleObject(Parameter->Semaphore, INFINITE);
+            InterlockedIncrement((LONG volatile *)&Queue->CompletionCount);
         }
     }
+    else
+    {
+        ShouldSleep = true;
+    }
 
-    return 0;
+    return ShouldSleep;
 }
-//
 
-int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPWSTR lpCmdLine, _In_ int nShowCmd)
+// Calling thread helps with the work instead of just waiting
+internal PLATFORM_COMPLETE_ALL_WORK(Win32CompleteAllWork)
 {
-#if 0
-    // Multithreading playground 
-    SYSTEM_INFO SystemInfo;
-    GetSystemInfo(&SystemInfo);
-
-    u32 ThreadCount = SystemInfo.dwNumberOfProcessors - 1;
+    while (Queue->CompletionGoal != Queue->CompletionCount)
+    {
+        Win32DoNextWorkQueueEntry(Queue, 0);
+    }
 
-    win32_thread_proc_parameter ThreadParameters[32];
+    Queue->CompletionGoal = 0;
+    Queue->CompletionCount = 0;
+}
 
-    HANDLE Semaphore = CreateSemaphore(0, 0, ThreadCount, 0);
+DWORD WINAPI ThreadProc(_In_ LPVOID lpParameter)
+{
+    win32_thread_proc_parameter *Parameter = (win32_thread_proc_parameter *)lpParameter;
 
-    for (u32 ThreadIndex = 0; ThreadIndex < ThreadCount; ++ThreadIndex)
+    while (true)
     {
-        win32_thread_proc_parameter *ThreadParameter = ThreadParameters + ThreadIndex;
-        ThreadParameter->ThreadIndex = ThreadIndex;
-        ThreadParameter->Semaphore = Semaphore;
-
-        DWORD ThreadId;
-        HANDLE ThreadHandle = CreateThread(0, 0, ThreadProc, ThreadParameter, 0, &ThreadId);
+        if (Win32DoNextWorkQueueEntry(Parameter->Queue, Parameter->ThreadIndex))
+        {
+            WaitForSingleObjectEx(Parameter->Queue->Semaphore, INFINITE, false);
+        }
     }
 
-    for (u32 EntryIndex = 0; EntryIndex < 10; ++EntryIndex)
-    {
-        work_queue_entry *Entry = Entries + EntryIndex;
+    return 0;
+}
 
-        PushEntry(EntryIndex, Semaphore);
-    }
+internal void
+Win32InitWorkQueue(platform_work_queue *Queue, win32_thread_proc_parameter *ThreadParameters, u32 ThreadCount)
+{
+    Queue->CompletionGoal = 0;
+    Queue->CompletionCount = 0;
+    Queue->NextEntryToWrite = 0;
+    Queue->NextEntryToRead = 0;
 
-    //Sleep(1000);
+    Queue->Semaphore = CreateSemaphoreEx(0, 0, ThreadCount, 0, 0, SEMAPHORE_ALL_ACCESS);
 
-    for (u32 EntryIndex = 0; EntryIndex < 10; ++EntryIndex)
+    for (u32 ThreadIndex = 0; ThreadIndex < ThreadCount; ++ThreadIndex)
     {
-        work_queue_entry *Entry = Entries + EntryIndex;
+        win32_thread_proc_parameter *ThreadParameter = ThreadParameters + ThreadIndex;
+        // 0 is reserved for the main thread
+        ThreadParameter->ThreadIndex = ThreadIndex + 1;
+        ThreadParameter->Queue = Queue;
 
-        PushEntry(10 + EntryIndex, Semaphore);
+        DWORD ThreadId;
+        HANDLE ThreadHandle = CreateThread(0, 0, ThreadProc, ThreadParameter, 0, &ThreadId);
+        CloseHandle(ThreadHandle);
     }
+}
 
-    while (CurrentEntryIndex != CompletedEntryIndex);
-
-    Win32DebugPrintString("Work has been completed.\n");
-    //
-#endif
+int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPWSTR lpCmdLine, _In_ int nShowCmd)
+{
     SetProcessDPIAware();
 
     win32_platform_state PlatformState = {};
@@ -812,8 +863,31 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
     PlatformApi.PlatformHandle = (void *)&PlatformState;
     PlatformApi.SetMouseMode = Win32SetMouseMode;
     PlatformApi.ReadFile = Win32ReadFile;
+    PlatformApi.MapFile = Win32MapFile;
+    PlatformApi.UnmapFile = Win32UnmapFile;
     PlatformApi.DebugPrintString = Win32DebugPrintString;
 
+    SYSTEM_INFO SystemInfo;
+    GetSystemInfo(&SystemInfo);
+
+    u32 WorkerThreadCount = SystemInfo.dwNumberOfProcessors - 1;
+    WorkerThreadCount = WorkerThreadCount < MAX_WORKER_THREAD_COUNT ? WorkerThreadCount : MAX_WORKER_THREAD_COUNT;
+
+    win32_thread_proc_parameter ThreadParameters[MAX_WORKER_THREAD_COUNT];
+    persist platform_work_queue WorkQueue;
+    Win32InitWorkQueue(&WorkQueue, ThreadParameters, WorkerThreadCount);
+
+    PlatformApi.WorkQueue = &WorkQueue;
+    PlatformApi.WorkQueueThreadCount = WorkerThreadCount + 1;
+    PlatformApi.AddWorkQueueEntry = Win32AddWorkQueueEntry;
+    PlatformApi.CompleteAllWork = Win32CompleteAllWork;
+
+    win32_thread_proc_parameter BackgroundThreadParameters[1];
+    persist platform_work_queue BackgroundWorkQueue;
+    Win32InitWorkQueue(&BackgroundWorkQueue, BackgroundThreadParameters, ArrayCount(BackgroundThreadParameters));
+
+    PlatformApi.BackgroundWorkQueue = &BackgroundWorkQueue;
+
     game_memory GameMemory = {};
     GameMemory.PermanentStorageSize = Megabytes(256);
     GameMemory.TransientStorageSize = Megabytes(256);
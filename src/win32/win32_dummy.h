@@ -54,3 +54,31 @@ struct win32_file_attributes
 {
     FILETIME LastWriteTime;
 };
+
+#define MAX_WORKER_THREAD_COUNT 32
+
+struct platform_work_queue_entry
+{
+    platform_work_queue_callback *Callback;
+    void *Data;
+};
+
+// Single producer (main thread), multiple consumers
+struct platform_work_queue
+{
+    u32 volatile CompletionGoal;
+    u32 volatile CompletionCount;
+
+    u32 volatile NextEntryToWrite;
+    u32 volatile NextEntryToRead;
+
+    HANDLE Semaphore;
+
+    platform_work_queue_entry Entries[4096];
+};
+
+struct win32_thread_proc_parameter
+{
+    u32 ThreadIndex;
+    platform_work_queue *Queue;
+};